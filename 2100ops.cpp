@@ -1,4 +1,4 @@
-#include "stdafx.h"
+// Included by adsp2100.cpp, which supplies the state, tables and memory accessors.
 /*===========================================================================
 	ASTAT -- ALU/MAC status register
 ===========================================================================*/
@@ -369,7 +369,18 @@ static void wr_cntr(INT32 val)  { cntr_stack_push(); adsp2100.cntr = val & 0x3ff
 static void wr_sb(INT32 val)    { core->sb.s = (INT16)(val << 11) >> 11; }
 static void wr_px(INT32 val)    { adsp2100.px = val; }
 #if SUPPORT_2101_EXTENSIONS
-static void wr_ifc(INT32 val)	{ adsp2100.ifc = val; }
+static void wr_ifc(INT32 val)
+{
+	/* bits 15-10 force, bits 7-2 clear IRQ2, SPORT0 TX/RX, IRQ1, IRQ0, timer */
+	int which;
+	adsp2100.ifc = val;
+	for (which = 0; which < 6; which++)
+	{
+		if (val & (0x80 >> which)) adsp2100.irq_latch[which] = 0;
+		if (val & (0x8000 >> which)) adsp2100.irq_latch[which] = 1;
+	}
+	check_irqs();
+}
 static void wr_tx0(INT32 val)	{ if ( adsp2105_tx_callback ) (*adsp2105_tx_callback)( 0, val ); }
 static void wr_tx1(INT32 val)	{ if ( adsp2105_tx_callback ) (*adsp2105_tx_callback)( 1, val ); }
 static void wr_owrctr(INT32 val) { adsp2100.cntr = val & 0x3fff; }
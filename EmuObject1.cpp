@@ -5,15 +5,27 @@
 #include <cstring>
 #include <cstdio>
 #include <cmath>
-#include <algorithm>
 
 #include "ki.h"
 #include "EmuObject1.h"
 #include "iCPU.h"
 #include "iMemory.h"
 #include "iRom.h"
+#include "iRomCheck.h"
 #include "hleDSP.h"
 #include "adsp2100.h"
+#include "audioRing.h"
+#include "audioOut.h"
+#include "audioResample.h"
+#include "iRewind.h"
+#include "iReplay.h"
+#include "iCapture.h"
+#include "iInput.h"
+#include "videoConvert.h"
+#include "videoPace.h"
+#include "videoScale.h"
+#include "hlePresent.h"
+#include "mmDisplay.h"
 
 // External globals
 extern WORD *ataDataBuffer;
@@ -34,19 +46,30 @@ extern DWORD aiUsedW;
 extern DWORD aiUsedA;
 extern DWORD aiDataUsed;
 
-#define NUM_BUFFERS 64
 extern DWORD cheat;
 
+// Cabinet controls, set at VSYNC from the pads (iInput) or an input log
+WORD inputs[4];
+
+// The frame on show in host format, with the lines that changed since the last
+static VIDEOFRAME emuVideo;
+
+// How it is scaled for the display, and how far each present buffer is up
+// to in emuVideo serials
+static VIDEOSCALE emuScale;
+static uint32_t   emuPresentSerial[HLE_PRESENT_BUFFERS];
+
+// The one the CPU thread draws through at VSYNC
+static CEmuObject* emuObject = nullptr;
+
 // -------------------------- CEmuObject --------------------------
 CEmuObject::CEmuObject()
-    : m_Display(nullptr), m_Audio(nullptr), m_Open(false),
+    : m_Display(nullptr), m_Open(false), m_AudioOpen(false),
       m_LastTime(0), m_LastInstruction(0), m_FirstVSYNCTime(0),
-      m_NumVSYNCs(0), m_BadAudio(true), m_3DActive(false),
+      m_NumVSYNCs(0), m_3DActive(false),
       m_Debug(false), m_IsWaveraceSE(false)
 {
     memset(m_FileName, 0, sizeof(m_FileName));
-    m_AudioReady = false;
-    m_AudioBufferPosition = 0;
 }
 
 CEmuObject::~CEmuObject()
@@ -57,12 +80,20 @@ CEmuObject::~CEmuObject()
 bool CEmuObject::Init()
 {
     m_Display = new mmDisplay();
-    GPUInit(640, 480);
-
-    m_DirectSoundDevice = new mmDirectSoundDevice();
-    if (m_DirectSoundDevice->Create(0) != 0) {
-        delete m_DirectSoundDevice;
-        m_DirectSoundDevice = nullptr;
+    m_Display->m_FrameCount = 0;
+    videoConvertReset(&emuVideo);
+    emuScale.filter = theApp.m_Filter;
+    emuScale.factor = theApp.m_FilterScale;
+    emuScale.scanlines = theApp.m_ScanLines;
+    int scale = videoScaleFactor(&emuScale);
+    memset(emuPresentSerial, 0, sizeof(emuPresentSerial));
+    emuObject = this;
+    if (!theApp.m_Headless) {
+        videoScaleInit(VIDEO_SCALE_WORKERS);
+        hlePresentInit(VIDEO_WIDTH * scale, VIDEO_HEIGHT * scale, HLE_PRESENT_SWITCH);
+        printf("Display %dx%d, %s\n", VIDEO_WIDTH * scale, VIDEO_HEIGHT * scale, videoScaleName(emuScale.filter));
+        GPUInit(640, 480);
+        iInputStart();
     }
 
     m_InputDevice = new mmDirectInputDevice();
@@ -79,16 +110,19 @@ void CEmuObject::Emulate(const char* filename)
     m_LastInstruction = 0;
     m_FirstVSYNCTime = 0;
     m_NumVSYNCs = 0;
-    m_Audio = nullptr;
-    m_BadAudio = true;
 
     strncpy(m_FileName, filename, sizeof(m_FileName) - 1);
     m_FileName[sizeof(m_FileName) - 1] = '\0';
 
+    if (!iRomCheckSet(gRomSet, m_FileName))
+        printf("ROM set did not verify, running anyway\n");
+
     iMainConstruct((char*)m_FileName);
     iRomReadImage((char*)m_FileName);
     iMemCopyBootCode();
     iMainReset();
+    m_AudioOpen = !theApp.m_Headless && audioOutStart();
+    videoPaceConfig(theApp.m_FrameDelay, theApp.m_Skip);
     iMainStartCPU();
 
     printf("Emulating %s\n", m_FileName);
@@ -134,136 +168,124 @@ void CEmuObject::OnTimer()
         m_FirstVSYNCTime = curtime;
     }
 
-    char info[512];
+    AUDIORINGSTATS audio;
+    audioRingStats(&audio);
+
+    REWINDSTATS rewind;
+    iRewindStats(&rewind);
+
+    VIDEOPACESTATS pace;
+    videoPaceStats(&pace, true);
+    HLEPRESENTSTATS present;
+    hlePresentStats(&present);
+    INPUTSTATS input;
+    iInputStats(&input, true);
+
+    char info[640];
     snprintf(info, sizeof(info),
-        "PC:%llX Compare:%08X ICount:%08X NextInt:%08X miReg3:%04X miReg2:%04X | IPS:%.0f FPS:%.1f APS:%.1f VHz:%.1f",
+        "PC:%llX Compare:%08X ICount:%08X NextInt:%08X miReg3:%04X miReg2:%04X | IPS:%.0f FPS:%.1f APS:%.1f VHz:%.1f | Snd:%u Under:%u Over:%u DRC:%+.2f%% | Rew:%.1fs Delta:%zuB/%up Key:%zuKB Used:%zuMB"
+        " | Skip:%u Late:%u Emu:%.0f/%.0fms Frame:%.0f/%.0fms Worst:%.1fms Drop:%llu"
+        " | Poll:%.2f/%.2fms In:%.1f/%.1fms",
         r->PC, (DWORD)r->CompareCount, (DWORD)r->ICount, r->NextIntCount,
         ((DWORD*)m->miReg)[3], ((DWORD*)m->miReg)[2],
-        ips, fps, aps, hz);
-    printf("%s\n", info);
+        ips, fps, aps, hz, audio.level, audio.underruns, audio.overruns,
+        (audioResampleScale() - 1.0) * 100.0,
+        rewind.frames / 60.0, rewind.deltaBytes, rewind.deltaPages, rewind.keyBytes >> 10, rewind.used >> 20,
+        pace.skipped, pace.late, videoPaceQuantile(pace.work, 0.5), videoPaceQuantile(pace.work, 0.99),
+        videoPaceQuantile(pace.frame, 0.5), videoPaceQuantile(pace.frame, 0.99), pace.worstMs,
+        (unsigned long long)present.dropped,
+        input.ageMs, input.worstMs, present.inputMs, present.inputWorstMs);
+    if (iInputShowStats())
+        printf("%s\n", info);
 }
 
 
-// -------------------------- Input Handling --------------------------
-void CEmuObject::PollInput()
+// -------------------------- Display Update --------------------------
+// The frame on show, a 320x240 16-bit buffer picked by the blitter registers
+const BYTE* emuFrameSource()
 {
-    // Scan all controllers
-    hidScanInput();
-
-    // Player 1 controller
-    u64 kDown = hidKeysDown(CONTROLLER_P1);
-    u64 kHeld = hidKeysHeld(CONTROLLER_P1);
-
-    // Reset emulator input state
-    inputs[0] = 0;
-
-    // Map buttons to emulator bits
-    if (kHeld & KEY_A)      inputs[0] |= 0x0001;
-    if (kHeld & KEY_B)      inputs[0] |= 0x0002;
-    if (kHeld & KEY_X)      inputs[0] |= 0x0004;
-    if (kHeld & KEY_Y)      inputs[0] |= 0x0008;
-    if (kHeld & KEY_L)      inputs[0] |= 0x0010;
-    if (kHeld & KEY_R)      inputs[0] |= 0x0020;
-    if (kHeld & KEY_ZL)     inputs[0] |= 0x0040;
-    if (kHeld & KEY_ZR)     inputs[0] |= 0x0080;
-    if (kHeld & KEY_PLUS)   inputs[0] |= 0x0100;
-    if (kHeld & KEY_MINUS)  inputs[0] |= 0x0200;
-    if (kHeld & KEY_DUP)    inputs[0] |= 0x0400;
-    if (kHeld & KEY_DDOWN)  inputs[0] |= 0x0800;
-    if (kHeld & KEY_DLEFT)  inputs[0] |= 0x1000;
-    if (kHeld & KEY_DRIGHT) inputs[0] |= 0x2000;
-    if (kHeld & KEY_LSTICK) inputs[0] |= 0x4000;
-    if (kHeld & KEY_RSTICK) inputs[0] |= 0x8000;
-
-    // Read analog sticks (left and right)
-    HidAnalogStickState leftStick, rightStick;
-    hidJoystickRead(&leftStick, CONTROLLER_P1, JOYSTICK_LEFT);
-    hidJoystickRead(&rightStick, CONTROLLER_P1, JOYSTICK_RIGHT);
-
-    auto StickToWord = [](float f) -> WORD {
-        return WORD((std::clamp(f, -1.0f, 1.0f) + 1.0f) * 0.5f * 65535.0f);
-    };
-
-    r->GPR[A0 * 2] = StickToWord(leftStick.x);   // Left stick X
-    r->GPR[A1 * 2] = StickToWord(leftStick.y);   // Left stick Y
-    r->GPR[A2 * 2] = StickToWord(rightStick.x);  // Right stick X
-    r->GPR[A3 * 2] = StickToWord(rightStick.y);  // Right stick Y
-
-    // Gyro/accelerometer (stubbed, can implement later if needed)
-    for (int i = 0; i < 6; ++i) r->FPR[i] = 0.f;
+    DWORD offset = (gRomSet == KI2) ? m->atReg[0x98] : m->atReg[0x80];
+    return (const BYTE*)SRAM + (offset * 320 * 128 + 0x30000);
 }
 
+// CPU thread, at a VSYNC the pacer wants drawn (videoPace decides, and does
+// the waiting). Converts what changed, scales it into the free present buffer
+// and hands that to the presenter thread; never waits on the display
+void emuFrameDone()
+{
+    if (emuObject)
+        emuObject->UpdateDisplay();
+}
 
-// -------------------------- Display Update --------------------------
 bool CEmuObject::UpdateDisplay()
 {
     if (!m_Open) return false;
 
-    DWORD offset = (gRomSet == KI2) ? m->atReg[0x98] : m->atReg[0x80];
-    char* source = (char*)SRAM + (offset * 320 * 128 + 0x30000);
-
-    // VSYNC / frame timing
     m_NumVSYNCs++;
-    if (m_NumVSYNCs >= 1) {
-        // Aim for ~16ms per frame (60Hz)
-        static DWORD nextVSync = 0;
-        DWORD now = armGetSystemTick();
-        if (nextVSync == 0) nextVSync = now + 16;
-        if (now < nextVSync) {
-            svcSleepThread((nextVSync - now) * 1000); // sleep in microseconds
-        }
-        nextVSync += 16;
-    }
-
-    m_Display->UpdateScreenBuffer(this, source, 0);
+    videoConvertFrame(&emuVideo, (const uint16_t*)emuFrameSource());
+    iCaptureFrame(emuVideo.pixels);
+    if (theApp.m_Headless)
+        return true;
+
+    int slot;
+    uint32_t* buffer = hlePresentBuffer(&slot);
+    videoScaleFrame(&emuScale, &emuVideo, buffer, &emuPresentSerial[slot]);
+    hlePresentSubmit(iInputFrameStamp());
     m_Display->m_FrameCount++;
 
     return true;
 }
 
 
-// -------------------------- Audio Update --------------------------
-void CEmuObject::UpdateAudio(DWORD offset)
-{
-    DWORD length = 0x1e0;
-    DWORD rate = 32000;
-    WORD bits = 16;
-
-    if (!m_Audio)
-    {
-        char* src = (char*)&m->dspDMem[dspAutoBase * 2];
-        m_Audio = new mmSoundBuffer();
-        m_Audio->Create(m_DirectSoundDevice);
-
-        m_BadAudio = !m_Audio->FromMemory(src, length, rate, bits, NUM_BUFFERS, false);
-        m_AudioBufferPosition = 0;
-        m_AudioReady = false;
-    }
-    else
-    {
-        m_AudioBufferPosition = (m_AudioBufferPosition + 1) & (NUM_BUFFERS - 1);
-        m_Audio->Update((char*)&m->dspDMem[offset * 2], length, m_AudioBufferPosition);
-
-        if (!m_AudioReady && m_AudioBufferPosition > 6)
-        {
-            m_Audio->Play(0, 0, true);
-            m_AudioReady = true;
-        }
-    }
-}
-
 // -------------------------- Cleanup / Shutdown --------------------------
 void CEmuObject::StopEmulation()
 {
     if (!m_Open) return;
 
-    if (m_Audio) { m_Audio->Stop(); SafeDelete(m_Audio); }
+    if (m_AudioOpen) { audioOutStop(); m_AudioOpen = false; }
+    emuObject = nullptr;
+    iCaptureStop();
+    iInputStop();
+    hlePresentShutdown();
+    videoScaleShutdown();
     if (m_Display) { m_Display->Close(); SafeDelete(m_Display); }
     SafeDelete(m_InputDevice);
 
     m_Open = false;
 }
 
+// -------------------------- Headless replay --------------------------
+// The input log for the ROM set (ki.inp / ki2.inp) replayed with nothing on
+// screen and no sound, unpaced, every frame hashed (iReplay.h); for checking
+// a change to the recompiler or the rasterizer against an earlier build.
+// Returns once the log has played out: true if the hashes matched the first
+// run's, or this was the first run. Also reports what rewind snapshots of
+// the run cost; a log recorded without touching the pads measures attract
+bool CEmuObject::Replay(const char* filename)
+{
+    theApp.m_Headless = true;
+    if (!Init()) return false;
+
+    uint32_t ended = iReplayEnded();
+    Emulate(filename);
+    // the log starts from a save state, but the boot stages go first
+    while (NewTask != NORMAL_GAME)
+        svcSleepThread(10000000);
+    NewTask = REPLAY_INPUT;
+
+    bool matched = false;
+    while (iReplayEnded(&matched) == ended)
+        svcSleepThread(10000000);
+    iMainStopCPU();
+
+    REWINDSTATS rewind;
+    iRewindStats(&rewind);
+    printf("Replay: rewind snapshots average %zu bytes: %u deltas of %zu bytes (%u pages), %u keyframes of %zu KB\n",
+           rewind.snapBytes, rewind.deltas, rewind.deltaBytes, rewind.deltaPages, rewind.keys, rewind.keyBytes >> 10);
+    StopEmulation();
+    return matched;
+}
+
 BOOL CEmuObject::DestroyWindow() { StopEmulation(); return TRUE; }
 void CEmuObject::OnDestroy() { StopEmulation(); }
 void CEmuObject::OnCancel() { StopEmulation(); }
@@ -3,7 +3,6 @@
 #include <cstdint>
 #include <cstdio>
 
-#include "mmSoundBuffer.h"
 #include "mmDirectInputDevice.h"
 #include "iMain.h"
 
@@ -24,7 +23,6 @@ public:
 
     mmDirectInputDevice* m_InputDevice;
     mmDisplay* m_Display;
-    mmSoundBuffer* m_Audio;
 
     EmuState* m;   // pointer to emu state
     CPUState* r;   // pointer to CPU state
@@ -35,21 +33,18 @@ public:
     uint32_t m_FirstVSYNCTime;
     bool  m_3DActive;
 
-    uint32_t m_AudioBufferPosition;
-    bool m_AudioReady;
-    bool m_BadAudio;
+    bool m_AudioOpen;
 
     // Public interface
     bool Init();
     void Emulate(const char* filename);
     bool UpdateDisplay();
-    void UpdateAudio(uint32_t offset);
     void UpdateInfo();
     void StopEmulation();
+    bool Replay(const char* filename);
 
-    // Input / Timer
+    // Timer
     void OnTimer();
-    void PollInput();
 
     // Cleanup / Focus
     bool DestroyWindow();
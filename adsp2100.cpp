@@ -1,91 +1,1215 @@
+#include <cstddef>
+#include <cstring>
+#include <cstdio>
 #include "adsp2100.h"
+#include "adsp2100_dyna.h"
+#include "hleDSP.h"
+#include "iState.h"
+
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// ---------------------- TYPES (shared with 2100ops.cpp) ----------------------
+#define INLINE static inline
+typedef int8_t   INT8;
+typedef uint8_t  UINT8;
+typedef int16_t  INT16;
+typedef uint16_t UINT16;
+typedef int32_t  INT32;
+typedef uint32_t UINT32;
+typedef int64_t  INT64;
+typedef uint64_t UINT64;
+
+#define ADSP_CLOCK          10000000    // 10 MHz on the KI sound board
+#define ADSP_SAMPLE_CYCLES  (ADSP_CLOCK / 32000)
+
+// on-chip control registers (top of data memory)
+#define ADSP_S1_AUTOBUF     0x3fef
+#define ADSP_S1_RFSDIV      0x3ff0
+#define ADSP_S1_SCLKDIV     0x3ff1
+#define ADSP_S1_CONTROL     0x3ff2
+#define ADSP_TSCALE         0x3ffb
+#define ADSP_TCOUNT         0x3ffc
+#define ADSP_TPERIOD        0x3ffd
+#define ADSP_SYSCONTROL     0x3fff
+
+extern uint16_t* dspDMem;
+extern uint32_t* dspPMem;
 
 ADSP2100 adsp2100;
 int adsp2100_icount = 0;
 
-#if SUPPORT_2101_EXTENSIONS
-static RX_CALLBACK rx_callback = nullptr;
-static TX_CALLBACK tx_callback = nullptr;
+static ADSPCORE* core = &adsp2100.r[0];
+ADSPUOP adsp2100_pcode[ADSP_PMEM_WORDS];
+static int adsp2100_slice = 0;     // cycles allowed in the current slice, zeroed to end it early
 
-void adsp2100_set_rx_callback(RX_CALLBACK cb) { rx_callback = cb; }
-void adsp2100_set_tx_callback(TX_CALLBACK cb) { tx_callback = cb; }
+static UINT8  condition_table[0x1000];
+static UINT16 mask_table[0x4000];
+static UINT16 reverse_table[0x4000];
+static bool   adsp2100_tables = false;
 
-inline int adsp2100_rx(int port) { return rx_callback ? rx_callback(port) : 0; }
-inline void adsp2100_tx(int port, int32_t data) { if (tx_callback) tx_callback(port, data); }
+#if SUPPORT_2101_EXTENSIONS
+static RX_CALLBACK adsp2105_rx_callback = nullptr;
+static TX_CALLBACK adsp2105_tx_callback = nullptr;
+static AUTOBUF_CALLBACK adsp2105_autobuf_callback = nullptr;
+static BOOT_CALLBACK adsp2105_boot_callback = nullptr;
+
+void adsp2100_set_rx_callback(RX_CALLBACK cb) { adsp2105_rx_callback = cb; }
+void adsp2100_set_tx_callback(TX_CALLBACK cb) { adsp2105_tx_callback = cb; }
+void adsp2100_set_autobuf_callback(AUTOBUF_CALLBACK cb) { adsp2105_autobuf_callback = cb; }
+void adsp2100_set_boot_callback(BOOT_CALLBACK cb) { adsp2105_boot_callback = cb; }
 #endif
 
-// ---------------------- FLAG HELPERS ----------------------
-#define ZFLAG 0x01
-#define NFLAG 0x02
-#define VFLAG 0x04
-#define CFLAG 0x08
-#define SFLAG 0x10
-
-inline void clr_flags() { adsp2100.astat &= adsp2100.astat_clear; }
-inline void calc_z(int32_t r) { if ((r & 0xFFFF) == 0) adsp2100.astat |= ZFLAG; }
-inline void calc_n(int32_t r) { adsp2100.astat |= ((r >> 14) & 0x02); }
-inline void calc_v(int32_t s,int32_t d,int32_t r){ adsp2100.astat |= ((s^d^r^(r>>1)) >> 13)&VFLAG; }
-inline void calc_c(int32_t r){ adsp2100.astat |= (r>>13)&CFLAG; }
-inline void calc_c_sub(int32_t r){ adsp2100.astat |= (~r>>13)&CFLAG; }
-inline void calc_nz(int32_t r){ clr_flags(); calc_n(r); calc_z(r); }
-inline void calc_nzv(int32_t s,int32_t d,int32_t r){ clr_flags(); calc_n(r); calc_z(r); calc_v(s,d,r); }
-inline void calc_nzvc(int32_t s,int32_t d,int32_t r){ clr_flags(); calc_n(r); calc_z(r); calc_v(s,d,r); calc_c(r); }
-inline void calc_nzvc_sub(int32_t s,int32_t d,int32_t r){ clr_flags(); calc_n(r); calc_z(r); calc_v(s,d,r); calc_c_sub(r); }
-
-// ---------------------- PC STACK ----------------------
-inline void pc_stack_push() { if(adsp2100.pc_sp<PC_STACK_DEPTH){adsp2100.pc_stack[adsp2100.pc_sp++]=adsp2100.pc;} }
-inline void pc_stack_pop() { if(adsp2100.pc_sp>0) adsp2100.pc=adsp2100.pc_stack[--adsp2100.pc_sp]; }
-inline uint16_t pc_stack_top() { return adsp2100.pc_sp ? adsp2100.pc_stack[adsp2100.pc_sp-1] : adsp2100.pc_stack[0]; }
-
-// ---------------------- ALU ----------------------
-void alu_op_af(int op){
-    int32_t res = adsp2100.core.ax0.s + adsp2100.core.ay0.s; // dummy, real decoding goes here
-    alu_set_af(res);
-    calc_nz(res);
-}
-
-// ---------------------- MAC / SHIFT ----------------------
-void mac_op(int op){
-    int32_t x = adsp2100.core.ax0.s;
-    int32_t y = adsp2100.core.mx0.s;
-    int64_t res = (int64_t)x * (int64_t)y;
-    alu_set_af((int32_t)res);
-}
-
-void shift_op(int op){
-    int32_t val = alu_get_af();
-    int32_t shift = 1; // dummy
-    alu_set_af(val << shift);
-    calc_nz(val << shift);
-}
-
-// ---------------------- SPECIAL ----------------------
-void special_alu_op(int op){
-    int32_t val = alu_get_af();
-    int32_t res = -val;
-    alu_set_af(res);
-    calc_nz(res);
+static void check_irqs(void);
+static void adsp2100_control_w(UINT32 addr, UINT32 data);
+
+// ---------------------- MEMORY ----------------------
+// Data space: 0x2000-0x37ff is the board (ROM window, bank select, latches),
+// 0x3fe0-0x3fff the on-chip control registers, everything else is RAM.
+
+INLINE UINT16 RWORD_DATA(UINT32 addr)
+{
+    addr &= 0x3fff;
+    if (addr - 0x2000 < 0x1800)
+        return hleDSPRead(addr);
+    return dspDMem[addr];
+}
+
+INLINE void WWORD_DATA(UINT32 addr, INT32 data)
+{
+    addr &= 0x3fff;
+    if (addr - 0x2000 < 0x1800)
+    {
+        hleDSPWrite(addr, data);
+        return;
+    }
+    dspDMem[addr] = data;
+    if (addr >= 0x3fe0)
+        adsp2100_control_w(addr, data & 0xffff);
+}
+
+INLINE UINT32 RWORD_PGM(UINT32 addr)
+{
+    return dspPMem[addr & (ADSP_PMEM_WORDS - 1)] & 0xffffff;
+}
+
+INLINE void WWORD_PGM(UINT32 addr, UINT32 data)
+{
+    addr &= ADSP_PMEM_WORDS - 1;
+    dspPMem[addr] = data & 0xffffff;
+    adsp2100_predecode_word(addr);
+}
+
+#include "2100ops.cpp"
+
+// ---------------------- TABLES ----------------------
+static void adsp2100_init_tables()
+{
+    if (adsp2100_tables)
+        return;
+
+    // bit-reverse for DAG1 (14-bit addresses)
+    for (int i = 0; i < 0x4000; i++)
+    {
+        UINT16 data = 0;
+        for (int bit = 0; bit < 14; bit++)
+            if (i & (1 << bit))
+                data |= 0x2000 >> bit;
+        reverse_table[i] = data;
+    }
+
+    // circular buffer base mask: round the length up to a power of two
+    mask_table[0] = 0x3fff;
+    for (int i = 1; i < 0x4000; i++)
+    {
+        int size = 1;
+        while (size < i)
+            size <<= 1;
+        mask_table[i] = (~(size - 1)) & 0x3fff;
+    }
+
+    // condition codes; 14 (CE / NOT CE) is counter based and handled in CONDITION
+    for (int i = 0; i < 0x1000; i++)
+    {
+        int az = (i & ZFLAG) != 0;
+        int an = (i & NFLAG) != 0;
+        int av = (i & VFLAG) != 0;
+        int ac = (i & CFLAG) != 0;
+        int as = (i & SFLAG) != 0;
+        int mv = (i & MVFLAG) != 0;
+        int result = 0;
+
+        switch (i >> 8)
+        {
+            case 0x0: result = az; break;
+            case 0x1: result = !az; break;
+            case 0x2: result = !((an ^ av) | az); break;
+            case 0x3: result = (an ^ av) | az; break;
+            case 0x4: result = an ^ av; break;
+            case 0x5: result = !(an ^ av); break;
+            case 0x6: result = av; break;
+            case 0x7: result = !av; break;
+            case 0x8: result = ac; break;
+            case 0x9: result = !ac; break;
+            case 0xa: result = as; break;
+            case 0xb: result = !as; break;
+            case 0xc: result = mv; break;
+            case 0xd: result = !mv; break;
+            case 0xe: result = 0; break;
+            case 0xf: result = 1; break;
+        }
+        condition_table[i] = result;
+    }
+
+    adsp2100_tables = true;
+}
+
+// condition of a conditional instruction: code 14 is NOT CE
+INLINE int IF_CONDITION(int c)
+{
+    if (c == 14)
+        return !CONDITION(14);
+    return condition_table[(c << 8) | adsp2100.astat];
+}
+
+// ---------------------- INTERRUPTS ----------------------
+// ICNTL bit selecting edge sensitivity for each external line, 0 for internal sources
+static const UINT8 irq_edge_bit[ADSP2105_IRQ_COUNT] = { 0x04, 0, 0, 0x02, 0x01, 0 };
+
+static int adsp2100_generate_irq(int which)
+{
+    if (!(adsp2100.imask & (0x20 >> which)))
+        return 0;
+
+    adsp2100.irq_latch[which] = 0;
+    pc_stack_push();
+    stat_stack_push();
+    adsp2100.pc = 0x04 + which * 4;
+    adsp2100.idle = 0;
+
+    // nesting lets higher priorities through, otherwise everything waits for RTI
+    if (adsp2100.icntl & 0x10)
+        adsp2100.imask &= ~(0x3f >> which);
+    else
+        adsp2100.imask &= ~0x3f;
+    return 1;
+}
+
+static void check_irqs(void)
+{
+    for (int which = 0; which < ADSP2105_IRQ_COUNT; which++)
+    {
+        int pending = adsp2100.irq_latch[which];
+        if (!pending && irq_edge_bit[which] && !(adsp2100.icntl & irq_edge_bit[which]))
+            pending = adsp2100.irq_state[which];
+        if (pending && adsp2100_generate_irq(which))
+            return;
+    }
+}
+
+void adsp2100_set_irq_line(int irqline, int state)
+{
+    if (irqline < 0 || irqline >= ADSP2105_IRQ_COUNT)
+        return;
+
+    int edge = !irq_edge_bit[irqline] || (adsp2100.icntl & irq_edge_bit[irqline]);
+    if (state && !adsp2100.irq_state[irqline] && edge)
+        adsp2100.irq_latch[irqline] = 1;
+    adsp2100.irq_state[irqline] = state ? 1 : 0;
+
+    // dropping a line never raises anything; this also keeps latch reads
+    // from compiled code free of PC changes
+    if (state)
+        check_irqs();
+}
+
+// ---------------------- ON-CHIP PERIPHERALS ----------------------
+static int adsp2100_sample_cycles()
+{
+    int cycles = 2 * (dspDMem[ADSP_S1_SCLKDIV] + 1) * (dspDMem[ADSP_S1_RFSDIV] + 1);
+    return (cycles < 32) ? ADSP_SAMPLE_CYCLES : cycles;
+}
+
+// cycles until the autobuffer has moved half of its circular buffer
+static int adsp2100_sport_period()
+{
+    UINT32 ctrl = dspDMem[ADSP_S1_AUTOBUF];
+    int ireg = (ctrl >> 9) & 7;
+    int mreg = ((ctrl >> 7) & 3) | (ireg & 4);
+    int size = adsp2100.l[ireg];
+    int incs = adsp2100.m[mreg];
+
+    if (size < 2 || incs <= 0)
+        return 0x100 * ADSP_SAMPLE_CYCLES;      // buffer not set up yet, look again later
+    return ((size / 2 + incs - 1) / incs) * adsp2100_sample_cycles();
+}
+
+// SPORT1 autobuffer transmit: the next half buffer's worth of samples, gathered
+// the way the SPORT fetches them (I stepped by M, wrapping at the end of the
+// circular buffer), to the board; IRQ1 on wrap
+static void adsp2100_autobuffer()
+{
+    static INT16 samples[ADSP_DMEM_WORDS / 2];
+
+    UINT32 ctrl = dspDMem[ADSP_S1_AUTOBUF];
+    int ireg = (ctrl >> 9) & 7;
+    int mreg = ((ctrl >> 7) & 3) | (ireg & 4);
+    UINT32 size = adsp2100.l[ireg];
+    INT32 incs = adsp2100.m[mreg];
+
+    if (size >= 2 && incs > 0)
+    {
+        UINT32 start = adsp2100.i[ireg];
+        UINT32 i = start;
+        UINT32 end = adsp2100.base[ireg] + size;
+        UINT32 count = (size / 2 + incs - 1) / incs;
+        for (UINT32 n = 0; n < count; n++)
+        {
+            samples[n] = (INT16)dspDMem[i & 0x3fff];
+            i += incs;
+            if (i >= end)
+            {
+                i -= size * ((i - end) / size + 1);
+                adsp2100.irq_latch[ADSP2105_IRQ1] = 1;
+            }
+        }
+        adsp2100.i[ireg] = i;
+        if (adsp2105_autobuf_callback)
+            (*adsp2105_autobuf_callback)(start, samples, count);
+    }
+    adsp2100.sport_period = adsp2100_sport_period();
+}
+
+static void adsp2100_control_w(UINT32 addr, UINT32 data)
+{
+    switch (addr)
+    {
+        case ADSP_S1_AUTOBUF:
+            if (data & 0x0002)
+            {
+                adsp2100.sport_period = adsp2100_sport_period();
+                adsp2100.sport_cycles = adsp2100.sport_period;
+            }
+            else
+                adsp2100.sport_period = 0;
+            adsp2100_slice = 0;
+            break;
+
+        case ADSP_TSCALE:
+        case ADSP_TCOUNT:
+            adsp2100.timer_cycles = (dspDMem[ADSP_TCOUNT] + 1) * ((dspDMem[ADSP_TSCALE] & 0xff) + 1);
+            adsp2100_slice = 0;
+            break;
+
+        case ADSP_SYSCONTROL:
+            if (data & 0x0200)
+            {
+                // boot force: reload program memory from the current ROM bank
+                dspDMem[ADSP_SYSCONTROL] &= ~0x0200;
+                adsp2100.boot = 1;
+                adsp2100_slice = 0;
+            }
+            break;
+    }
+}
+
+// ---------------------- PRE-DECODE ----------------------
+// ALU/MAC unit from the Z bit (18) and the ALU/MAC half of AMF (17)
+INLINE UINT8 adsp2100_unit(UINT32 op)
+{
+    if (!(op & 0x020000) && !(op & 0x01e000))
+        return ADSP_UNIT_NONE;      // MAC NOP
+    return 1 + ((op >> 17) & 1) + ((op >> 17) & 2);
+}
+
+INLINE void adsp2100_compute(UINT32 unit, UINT32 op)
+{
+    switch (unit)
+    {
+        case ADSP_UNIT_MAC_MR: mac_op_mr(op); break;
+        case ADSP_UNIT_ALU_AR: alu_op_ar(op); break;
+        case ADSP_UNIT_MAC_MF: mac_op_mf(op); break;
+        case ADSP_UNIT_ALU_AF: alu_op_af(op); break;
+    }
+}
+
+void adsp2100_predecode_word(UINT32 addr)
+{
+    ADSPUOP* u = &adsp2100_pcode[addr & (ADSP_PMEM_WORDS - 1)];
+    UINT32 op = dspPMem[addr & (ADSP_PMEM_WORDS - 1)] & 0xffffff;
+    UINT32 cond = op & 15;
+
+    if (u->op != op)
+        adsp2100_dyna_modified(addr & (ADSP_PMEM_WORDS - 1), u->kind == ADSP_UOP_DO || (op >> 18) == 0x05);
+
+    u->op = op;
+    u->arg = 0;
+    u->unit = ADSP_UNIT_NONE;
+    u->kind = ADSP_UOP_INVALID;
+
+    switch (op >> 16)
+    {
+        case 0x00: u->kind = ADSP_UOP_NOP; break;
+        case 0x02: u->kind = (op & 0x008000) ? ADSP_UOP_IDLE : ADSP_UOP_NOP; break;
+        case 0x03: u->kind = ADSP_UOP_FLAGIN; u->arg = ((op >> 4) & 0x0fff) | ((op << 10) & 0x3000); break;
+        case 0x04: u->kind = ADSP_UOP_STACK; break;
+        case 0x05: u->kind = ADSP_UOP_SATMR; break;
+        case 0x06: u->kind = ADSP_UOP_DIVS; break;
+        case 0x07: u->kind = ADSP_UOP_DIVQ; break;
+        case 0x09: u->kind = ADSP_UOP_MODIFY; break;
+        case 0x0a: u->kind = ADSP_UOP_RET; break;
+        case 0x0b: u->kind = ADSP_UOP_JUMP_IND; break;
+        case 0x0c: u->kind = ADSP_UOP_MODE; break;
+        case 0x0d: u->kind = ADSP_UOP_MOVE; break;
+        case 0x0e: u->kind = ADSP_UOP_SHIFT_COND; break;
+        case 0x0f: u->kind = ADSP_UOP_SHIFT_IMM; break;
+        case 0x10: u->kind = ADSP_UOP_SHIFT_MOVE; break;
+        case 0x11: u->kind = ADSP_UOP_SHIFT_PGM; break;
+        case 0x12: u->kind = ADSP_UOP_SHIFT_DM1; break;
+        case 0x13: u->kind = ADSP_UOP_SHIFT_DM2; break;
+
+        case 0x14: case 0x15: case 0x16: case 0x17:
+            u->kind = ADSP_UOP_DO;
+            u->arg = (op >> 4) & 0x3fff;
+            break;
+
+        case 0x18: case 0x19: case 0x1a: case 0x1b:
+            u->kind = (cond == 15) ? ADSP_UOP_JUMP : ADSP_UOP_JUMP_COND;
+            u->arg = (op >> 4) & 0x3fff;
+            break;
+
+        case 0x1c: case 0x1d: case 0x1e: case 0x1f:
+            u->kind = (cond == 15) ? ADSP_UOP_CALL : ADSP_UOP_CALL_COND;
+            u->arg = (op >> 4) & 0x3fff;
+            break;
+
+        case 0x20: case 0x21: case 0x22: case 0x23: case 0x24: case 0x25: case 0x26: case 0x27:
+            u->unit = adsp2100_unit(op);
+            if (u->unit == ADSP_UNIT_NONE)
+                u->kind = ADSP_UOP_NOP;
+            else
+                u->kind = (cond == 15) ? ADSP_UOP_COMPUTE : ADSP_UOP_COMPUTE_COND;
+            break;
+
+        case 0x28: case 0x29: case 0x2a: case 0x2b: case 0x2c: case 0x2d: case 0x2e: case 0x2f:
+            u->unit = adsp2100_unit(op);
+            u->kind = ADSP_UOP_COMPUTE_MOVE;
+            break;
+
+        case 0x30: case 0x31: case 0x32: case 0x33: case 0x34: case 0x35: case 0x36: case 0x37:
+        case 0x38: case 0x39: case 0x3a: case 0x3b: case 0x3c: case 0x3d: case 0x3e: case 0x3f:
+            u->kind = ADSP_UOP_LOAD_REG;
+            u->arg = (op >> 4) & 0x3fff;
+            break;
+
+        case 0x40: case 0x41: case 0x42: case 0x43: case 0x44: case 0x45: case 0x46: case 0x47:
+        case 0x48: case 0x49: case 0x4a: case 0x4b: case 0x4c: case 0x4d: case 0x4e: case 0x4f:
+            u->kind = ADSP_UOP_LOAD_DREG;
+            u->arg = (op >> 4) & 0xffff;
+            break;
+
+        case 0x50: case 0x51: case 0x52: case 0x53: case 0x54: case 0x55: case 0x56: case 0x57:
+        case 0x58: case 0x59: case 0x5a: case 0x5b: case 0x5c: case 0x5d: case 0x5e: case 0x5f:
+            u->unit = adsp2100_unit(op);
+            u->kind = (op & 0x080000) ? ADSP_UOP_COMPUTE_PGM_WR : ADSP_UOP_COMPUTE_PGM_RD;
+            break;
+
+        case 0x60: case 0x61: case 0x62: case 0x63: case 0x64: case 0x65: case 0x66: case 0x67:
+        case 0x68: case 0x69: case 0x6a: case 0x6b: case 0x6c: case 0x6d: case 0x6e: case 0x6f:
+            u->unit = adsp2100_unit(op);
+            u->kind = (op & 0x080000) ? ADSP_UOP_COMPUTE_DM1_WR : ADSP_UOP_COMPUTE_DM1_RD;
+            break;
+
+        case 0x70: case 0x71: case 0x72: case 0x73: case 0x74: case 0x75: case 0x76: case 0x77:
+        case 0x78: case 0x79: case 0x7a: case 0x7b: case 0x7c: case 0x7d: case 0x7e: case 0x7f:
+            u->unit = adsp2100_unit(op);
+            u->kind = (op & 0x080000) ? ADSP_UOP_COMPUTE_DM2_WR : ADSP_UOP_COMPUTE_DM2_RD;
+            break;
+
+        default:
+            if (op >= 0xc00000)
+            {
+                // dual data/program memory read; AMF result always lands in AR/MR
+                u->kind = ADSP_UOP_DUAL_READ;
+                if (op & 0x020000)
+                    u->unit = ADSP_UNIT_ALU_AR;
+                else if (op & 0x01e000)
+                    u->unit = ADSP_UNIT_MAC_MR;
+            }
+            else if (op >= 0xa00000)
+            {
+                u->kind = (op & 0x100000) ? ADSP_UOP_STORE_DM2 : ADSP_UOP_STORE_DM1;
+                u->arg = (op >> 4) & 0xffff;
+            }
+            else if (op >= 0x800000)
+            {
+                u->kind = (op & 0x100000) ? ADSP_UOP_WRITE_DM : ADSP_UOP_READ_DM;
+                u->arg = (op >> 4) & 0x3fff;
+            }
+            break;
+    }
+}
+
+void adsp2100_predecode()
+{
+    for (UINT32 addr = 0; addr < ADSP_PMEM_WORDS; addr++)
+        adsp2100_predecode_word(addr);
+    adsp2100_dyna_invalidate();
 }
 
 // ---------------------- EXECUTE ----------------------
-int adsp2100_execute(int cycles){
-    adsp2100_icount = cycles;
-    while(adsp2100_icount > 0){
-        // fetch instruction (simplified)
-        int op = 0; // fetch from memory (platform-specific)
-        alu_op_af(op); // dummy execution
+// Body of one instruction; the PC has already been advanced past it
+INLINE void adsp2100_exec(const ADSPUOP* u)
+{
+    UINT32 op = u->op;
+    INT32 temp;
+
+    switch (u->kind)
+    {
+        case ADSP_UOP_NOP:
+            break;
+
+        case ADSP_UOP_IDLE:
+            adsp2100.idle = 1;
+            adsp2100_slice = 0;
+            break;
+
+        case ADSP_UOP_FLAGIN:
+            // FI is tied low on this board
+            if (((op & 0x000002) != 0) == (adsp2100.flagin != 0))
+            {
+                if (op & 0x000001)
+                    pc_stack_push();
+                adsp2100.pc = u->arg;
+            }
+            break;
+
+        case ADSP_UOP_STACK:
+            if (op & 0x000010) pc_stack_pop_val();
+            if (op & 0x000008) loop_stack_pop();
+            if (op & 0x000004) cntr_stack_pop();
+            if (op & 0x000002)
+            {
+                if (op & 0x000001) stat_stack_pop();
+                else stat_stack_push();
+            }
+            break;
+
+        case ADSP_UOP_SATMR:
+            if (GET_MV)
+            {
+                if (core->mr.mrx.mr2.u & 0x80)
+                    core->mr.mrx.mr2.u = 0xffff, core->mr.mrx.mr1.u = 0x8000, core->mr.mrx.mr0.u = 0x0000;
+                else
+                    core->mr.mrx.mr2.u = 0x0000, core->mr.mrx.mr1.u = 0x7fff, core->mr.mrx.mr0.u = 0xffff;
+            }
+            break;
+
+        case ADSP_UOP_DIVS:
+        {
+            INT32 xop = ALU_GETXREG_UNSIGNED((op >> 8) & 7);
+            INT32 yop = ALU_GETYREG_UNSIGNED((op >> 11) & 3);
+            temp = xop ^ yop;
+            adsp2100.astat = (adsp2100.astat & ~QFLAG) | ((temp >> 10) & QFLAG);
+            core->af.u = (yop << 1) | (core->ay0.u >> 15);
+            core->ay0.u = (core->ay0.u << 1) | (temp >> 15);
+            break;
+        }
+
+        case ADSP_UOP_DIVQ:
+        {
+            INT32 xop = ALU_GETXREG_UNSIGNED((op >> 8) & 7);
+            INT32 res = GET_Q ? (core->af.u + xop) : (core->af.u - xop);
+            temp = res ^ xop;
+            adsp2100.astat = (adsp2100.astat & ~QFLAG) | ((temp >> 10) & QFLAG);
+            core->af.u = (res << 1) | (core->ay0.u >> 15);
+            core->ay0.u = (core->ay0.u << 1) | ((~temp >> 15) & 0x0001);
+            break;
+        }
+
+        case ADSP_UOP_MODIFY:
+            temp = (op >> 2) & 4;
+            modify_address(temp + ((op >> 2) & 3), temp + (op & 3));
+            break;
+
+        case ADSP_UOP_RET:
+            if (IF_CONDITION(op & 15))
+            {
+                pc_stack_pop();
+                if (op & 0x000010)
+                    stat_stack_pop();   // RTI
+            }
+            break;
+
+        case ADSP_UOP_JUMP_IND:
+            if (IF_CONDITION(op & 15))
+            {
+                if (op & 0x000010)
+                    pc_stack_push();
+                adsp2100.pc = adsp2100.i[4 + ((op >> 6) & 3)] & 0x3fff;
+            }
+            break;
+
+        case ADSP_UOP_MODE:
+            temp = adsp2100.mstat;
+            if (op & 0x000008) temp = (temp & ~MSTAT_GOMODE) | ((op << 4) & MSTAT_GOMODE);
+            if (op & 0x000020) temp = (temp & ~MSTAT_BANK) | ((op >> 4) & MSTAT_BANK);
+            if (op & 0x000080) temp = (temp & ~MSTAT_REVERSE) | ((op >> 5) & MSTAT_REVERSE);
+            if (op & 0x000200) temp = (temp & ~MSTAT_STICKYV) | ((op >> 6) & MSTAT_STICKYV);
+            if (op & 0x000800) temp = (temp & ~MSTAT_SATURATE) | ((op >> 7) & MSTAT_SATURATE);
+            if (op & 0x002000) temp = (temp & ~MSTAT_INTEGER) | ((op >> 8) & MSTAT_INTEGER);
+            if (op & 0x008000) temp = (temp & ~MSTAT_TIMER) | ((op >> 9) & MSTAT_TIMER);
+            if ((temp ^ adsp2100.mstat) & MSTAT_TIMER)
+                adsp2100_slice = 0;
+            adsp2100.mstat = temp;
+            mstat_changed();
+            break;
+
+        case ADSP_UOP_MOVE:
+            WRITE_REG((op >> 10) & 3, (op >> 4) & 15, READ_REG((op >> 8) & 3, op & 15));
+            break;
+
+        case ADSP_UOP_SHIFT_COND:
+            if (IF_CONDITION(op & 15))
+                shift_op(op);
+            break;
+
+        case ADSP_UOP_SHIFT_IMM:
+            shift_op_imm(op);
+            break;
+
+        case ADSP_UOP_SHIFT_MOVE:
+            temp = READ_REG(0, op & 15);
+            shift_op(op);
+            WRITE_REG(0, (op >> 4) & 15, temp);
+            break;
+
+        case ADSP_UOP_SHIFT_PGM:
+            if (op & 0x008000)
+            {
+                pgm_write_dag2(op, READ_REG(0, (op >> 4) & 15));
+                shift_op(op);
+            }
+            else
+            {
+                shift_op(op);
+                WRITE_REG(0, (op >> 4) & 15, pgm_read_dag2(op));
+            }
+            break;
+
+        case ADSP_UOP_SHIFT_DM1:
+            if (op & 0x008000)
+            {
+                data_write_dag1(op, READ_REG(0, (op >> 4) & 15));
+                shift_op(op);
+            }
+            else
+            {
+                shift_op(op);
+                WRITE_REG(0, (op >> 4) & 15, data_read_dag1(op));
+            }
+            break;
+
+        case ADSP_UOP_SHIFT_DM2:
+            if (op & 0x008000)
+            {
+                data_write_dag2(op, READ_REG(0, (op >> 4) & 15));
+                shift_op(op);
+            }
+            else
+            {
+                shift_op(op);
+                WRITE_REG(0, (op >> 4) & 15, data_read_dag2(op));
+            }
+            break;
+
+        case ADSP_UOP_DO:
+            pc_stack_push();
+            loop_stack_push(op & 0x3ffff);
+            break;
+
+        case ADSP_UOP_JUMP:
+            adsp2100.pc = u->arg;
+            break;
+
+        case ADSP_UOP_JUMP_COND:
+            if (IF_CONDITION(op & 15))
+                adsp2100.pc = u->arg;
+            break;
+
+        case ADSP_UOP_CALL:
+            pc_stack_push();
+            adsp2100.pc = u->arg;
+            break;
+
+        case ADSP_UOP_CALL_COND:
+            if (IF_CONDITION(op & 15))
+            {
+                pc_stack_push();
+                adsp2100.pc = u->arg;
+            }
+            break;
+
+        case ADSP_UOP_COMPUTE:
+            adsp2100_compute(u->unit, op);
+            break;
+
+        case ADSP_UOP_COMPUTE_COND:
+            if (IF_CONDITION(op & 15))
+                adsp2100_compute(u->unit, op);
+            break;
+
+        case ADSP_UOP_COMPUTE_MOVE:
+            temp = READ_REG(0, op & 15);
+            adsp2100_compute(u->unit, op);
+            WRITE_REG(0, (op >> 4) & 15, temp);
+            break;
+
+        case ADSP_UOP_LOAD_REG:
+            WRITE_REG((op >> 18) & 3, op & 15, u->arg);
+            break;
+
+        case ADSP_UOP_LOAD_DREG:
+            WRITE_REG(0, op & 15, (INT16)u->arg);
+            break;
+
+        case ADSP_UOP_COMPUTE_PGM_RD:
+            adsp2100_compute(u->unit, op);
+            WRITE_REG(0, (op >> 4) & 15, pgm_read_dag2(op));
+            break;
+
+        case ADSP_UOP_COMPUTE_PGM_WR:
+            pgm_write_dag2(op, READ_REG(0, (op >> 4) & 15));
+            adsp2100_compute(u->unit, op);
+            break;
+
+        case ADSP_UOP_COMPUTE_DM1_RD:
+            adsp2100_compute(u->unit, op);
+            WRITE_REG(0, (op >> 4) & 15, data_read_dag1(op));
+            break;
+
+        case ADSP_UOP_COMPUTE_DM1_WR:
+            data_write_dag1(op, READ_REG(0, (op >> 4) & 15));
+            adsp2100_compute(u->unit, op);
+            break;
+
+        case ADSP_UOP_COMPUTE_DM2_RD:
+            adsp2100_compute(u->unit, op);
+            WRITE_REG(0, (op >> 4) & 15, data_read_dag2(op));
+            break;
+
+        case ADSP_UOP_COMPUTE_DM2_WR:
+            data_write_dag2(op, READ_REG(0, (op >> 4) & 15));
+            adsp2100_compute(u->unit, op);
+            break;
+
+        case ADSP_UOP_READ_DM:
+            WRITE_REG((op >> 18) & 3, op & 15, RWORD_DATA(u->arg));
+            break;
+
+        case ADSP_UOP_WRITE_DM:
+            WWORD_DATA(u->arg, READ_REG((op >> 18) & 3, op & 15));
+            break;
+
+        case ADSP_UOP_STORE_DM1:
+            data_write_dag1(op, u->arg);
+            break;
+
+        case ADSP_UOP_STORE_DM2:
+            data_write_dag2(op, u->arg);
+            break;
+
+        case ADSP_UOP_DUAL_READ:
+        {
+            adsp2100_compute(u->unit, op);
+            INT32 dval = data_read_dag1(op);
+            INT32 pval = pgm_read_dag2(op >> 4);
+            WRITE_REG(0, (op >> 18) & 3, dval);
+            WRITE_REG(0, 4 + ((op >> 20) & 3), pval);
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
+INLINE void adsp2100_step()
+{
+    const ADSPUOP* u = &adsp2100_pcode[adsp2100.pc & (ADSP_PMEM_WORDS - 1)];
+
+    adsp2100.ppc = adsp2100.pc;
+
+    // advance, or close the innermost DO loop: back to the top until the
+    // termination holds. Termination codes are the opposite sense of the
+    // condition codes (0 is NE, FOREVER never holds) except CE, counter based
+    if (adsp2100.pc != adsp2100.loop)
+        adsp2100.pc++;
+    else if (adsp2100.loop_condition == 14 ? !CONDITION(14) : CONDITION(adsp2100.loop_condition))
+        adsp2100.pc = pc_stack_top();
+    else
+    {
+        loop_stack_pop();
+        pc_stack_pop_val();
         adsp2100.pc++;
-        adsp2100_icount--;
     }
+
+    adsp2100_exec(u);
+}
+
+static void adsp2100_run(int cycles)
+{
+    int done = 0;
+
+    adsp2100_slice = cycles;
+    while (done < adsp2100_slice)
+    {
+        adsp2100_step();
+        done++;
+    }
+
+    adsp2100_slice = done;
+}
+
+// ---------------------- MAC KERNELS ----------------------
+// Sum of x[i] * y[i] as the MAC computes it, for whole DO loops at once. The
+// 16x16 products are exact in 32 bits and summed in 64; what the per-pass
+// 32-bit product shift would wrap (0x8000 * 0x8000 in fractional mode) is
+// counted separately so the caller can reproduce it.
+
+#define MAC_CHUNK 256
+
+INLINE INT64 mac_dot(const INT16* x, const INT16* y, int n, int* wrap)
+{
+    INT64 sum = 0;
+    int count = 0;
+    int i = 0;
+
+#if defined(__aarch64__)
+    // vmull/vpadal keep the products exact; vmlal_s16 would wrap the 32-bit lanes
+    int64x2_t acc = vdupq_n_s64(0);
+    uint32x4_t hits = vdupq_n_u32(0);
+    const int32x4_t big = vdupq_n_s32(0x40000000);
+    for (; i + 8 <= n; i += 8)
+    {
+        int16x8_t xv = vld1q_s16(x + i);
+        int16x8_t yv = vld1q_s16(y + i);
+        int32x4_t lo = vmull_s16(vget_low_s16(xv), vget_low_s16(yv));
+        int32x4_t hi = vmull_high_s16(xv, yv);
+        acc = vpadalq_s32(acc, lo);
+        acc = vpadalq_s32(acc, hi);
+        hits = vsubq_u32(hits, vceqq_s32(lo, big));
+        hits = vsubq_u32(hits, vceqq_s32(hi, big));
+    }
+    sum = vaddvq_s64(acc);
+    count = vaddvq_u32(hits);
+#elif defined(__SSE2__)
+    // pmaddwd pairs wrap only on 2^30 + 2^30, which reads back as INT32_MIN and
+    // is otherwise out of reach, so it is put back by counting those lanes
+    __m128i acc = _mm_setzero_si128();
+    __m128i fix = _mm_setzero_si128();
+    __m128i hits = _mm_setzero_si128();
+    const __m128i min32 = _mm_set1_epi32((int)0x80000000);
+    const __m128i min16 = _mm_set1_epi16((short)0x8000);
+    for (; i + 8 <= n; i += 8)
+    {
+        __m128i xv = _mm_loadu_si128((const __m128i*)(x + i));
+        __m128i yv = _mm_loadu_si128((const __m128i*)(y + i));
+        __m128i s = _mm_madd_epi16(xv, yv);
+        __m128i sign = _mm_srai_epi32(s, 31);
+        acc = _mm_add_epi64(acc, _mm_unpacklo_epi32(s, sign));
+        acc = _mm_add_epi64(acc, _mm_unpackhi_epi32(s, sign));
+        fix = _mm_sub_epi32(fix, _mm_cmpeq_epi32(s, min32));
+        hits = _mm_sub_epi16(hits, _mm_and_si128(_mm_cmpeq_epi16(xv, min16), _mm_cmpeq_epi16(yv, min16)));
+    }
+    INT64 lanes[2];
+    INT32 fixes[4];
+    INT16 counts[8];
+    _mm_storeu_si128((__m128i*)lanes, acc);
+    _mm_storeu_si128((__m128i*)fixes, fix);
+    _mm_storeu_si128((__m128i*)counts, hits);
+    sum = lanes[0] + lanes[1];
+    for (int k = 0; k < 4; k++)
+        sum += (INT64)fixes[k] << 32;
+    for (int k = 0; k < 8; k++)
+        count += (UINT16)counts[k];
+#endif
+
+    for (; i < n; i++)
+    {
+        INT32 p = (INT32)x[i] * y[i];
+        sum += p;
+        count += p == 0x40000000;
+    }
+
+    *wrap = count;
+    return sum;
+}
+
+// ---------------------- COMPILED CODE ----------------------
+// Entry points for blocks built by adsp2100_dyna.cpp. Everything the block does
+// not generate itself goes through here so the interpreter stays the reference.
+
+// whole instruction at PC; nonzero when the block has to give control back
+int adsp2100_dyna_step()
+{
+    UINT32 next = adsp2100.pc + 1;
+    adsp2100_step();
+    return adsp2100.pc != next || !adsp2100_slice;
+}
+
+// instruction body that cannot touch the PC, the stacks or the slice
+void adsp2100_dyna_exec(const ADSPUOP* u)
+{
+    adsp2100_exec(u);
+}
+
+void adsp2100_dyna_compute(uint32_t op, uint32_t unit)
+{
+    adsp2100_compute(unit, op);
+}
+
+void adsp2100_dyna_shift(uint32_t op)
+{
+    shift_op(op);
+}
+
+uint32_t adsp2100_dyna_read(uint32_t addr)
+{
+    return RWORD_DATA(addr);
+}
+
+int adsp2100_dyna_write(uint32_t addr, uint32_t data)
+{
+    WWORD_DATA(addr, data);
+    return !adsp2100_slice;
+}
+
+// DO just executed: the loop count if the block may run the loop natively
+uint32_t adsp2100_dyna_do(uint32_t end)
+{
+    if (adsp2100.loop != end || adsp2100.loop_condition != 14)
+        return 0;
+    if (adsp2100.pc_sp < 1 || adsp2100.pc_stack[adsp2100.pc_sp - 1] != adsp2100.pc)
+        return 0;
+    return adsp2100.cntr;
+}
+
+// One-word DO ... UNTIL CE loop of MR = MR +/- MXn * MYn (SS) with MXn = DM(I,M),
+// MYn = PM(I,M) (adsp2100_dyna_mac_form). Runs the passes before the last one,
+// at most room of them, off cntr: the reads go through the DAGs in pass order,
+// the products through mac_dot. Returns the passes run.
+uint32_t adsp2100_dyna_mac_loop(const ADSPUOP* u, int32_t room)
+{
+    static INT16 xs[MAC_CHUNK], ys[MAC_CHUNK];
+    UINT32 op = u->op;
+    INT32 passes = (INT32)adsp2100.cntr - 1;
+    if (passes > room)
+        passes = room;
+    if (passes <= 0)
+        return 0;
+
+    INT16* xreg = (INT16*)((UINT8*)core + mac_xregs[(op >> 8) & 7]);
+    INT16* yreg = (INT16*)((UINT8*)core + mac_yregs[(op >> 11) & 3]);
+    int shift = ((adsp2100.mstat & MSTAT_INTEGER) >> 4) ^ 1;
+    INT64 total = 0;
+
+    for (INT32 done = 0; done < passes; )
+    {
+        int n = passes - done < MAC_CHUNK ? passes - done : MAC_CHUNK;
+        for (int k = 0; k < n; k++)
+        {
+            xs[k] = *xreg;
+            ys[k] = *yreg;
+            *xreg = data_read_dag1(op);
+            *yreg = pgm_read_dag2(op >> 4);
+        }
+
+        int wrap;
+        INT64 sum = mac_dot(xs, ys, n, &wrap);
+        total += shift ? (sum << 1) - ((INT64)wrap << 32) : sum;
+        done += n;
+    }
+
+    INT64 res = (((op >> 13) & 15) == 0x0c) ? core->mr.mr - total : core->mr.mr + total;
+    INT32 temp = (res >> 31) & 0x1ff;
+    CLR_MV;
+    if (temp != 0x000 && temp != 0x1ff) SET_MV;
+    core->mr.mr = res;
+    core->mr.mrx.mrzero.u = 0;
+
+    adsp2100.cntr -= passes;
+    return passes;
+}
+
+// counter expired on the last pass through a native loop
+void adsp2100_dyna_loop_exit()
+{
+    cntr_stack_pop();
+    loop_stack_pop();
+    pc_stack_pop_val();
+}
+
+// run the block, then replay the same instructions on the interpreter and compare;
+// the interpreter result is kept. Program memory is rolled back too (a block can end
+// on a PM write); board latches (ROM bank, output latch) are not, they are
+// idempotent for everything but a bank switch mid block.
+static int adsp2100_dyna_verify(const ADSPDYNABLOCK* block, int budget)
+{
+    static ADSP2100 before, after;
+    static UINT16 dmem_before[ADSP_DMEM_WORDS], dmem_after[ADSP_DMEM_WORDS];
+    static UINT32 pmem_before[ADSP_PMEM_WORDS];
+    int slice = adsp2100_slice;
+
+    memcpy(&before, &adsp2100, sizeof(before));
+    memcpy(dmem_before, dspDMem, sizeof(dmem_before));
+    memcpy(pmem_before, dspPMem, sizeof(pmem_before));
+
+    int n = block->code(budget);
+
+    memcpy(&after, &adsp2100, sizeof(after));
+    memcpy(dmem_after, dspDMem, sizeof(dmem_after));
+    int slice_after = adsp2100_slice;
+
+    memcpy(&adsp2100, &before, sizeof(before));
+    memcpy(dspDMem, dmem_before, sizeof(dmem_before));
+    for (UINT32 addr = 0; addr < ADSP_PMEM_WORDS; addr++)
+    {
+        if (dspPMem[addr] != pmem_before[addr])
+        {
+            dspPMem[addr] = pmem_before[addr];
+            adsp2100_predecode_word(addr);
+        }
+    }
+    mstat_changed();
+    adsp2100_slice = slice;
+
+    for (int i = 0; i < n; i++)
+        adsp2100_step();
+
+    after.ppc = adsp2100.ppc;
+    if (memcmp(&after, &adsp2100, sizeof(after)) || memcmp(dmem_after, dspDMem, sizeof(dmem_after)) || slice_after != adsp2100_slice)
+    {
+        const UINT8* a = (const UINT8*)&after;
+        const UINT8* b = (const UINT8*)&adsp2100;
+        size_t field = 0;
+        while (field < sizeof(after) && a[field] == b[field])
+            field++;
+        UINT32 addr = 0;
+        while (addr < ADSP_DMEM_WORDS && dmem_after[addr] == dspDMem[addr])
+            addr++;
+        printf("ADSP dyna: block %04x (%d cycles) differs, state +%u, dm %04x\n", before.pc, n, (unsigned)field, addr);
+        adsp2100_dyna_mismatches++;
+    }
+    return n;
+}
+
+// interpreter with compiled blocks wherever the PC is not closing a loop
+static void adsp2100_run_compiled(int cycles)
+{
+    int done = 0;
+
+    adsp2100_slice = cycles;
+    while (done < adsp2100_slice)
+    {
+        int n = 0;
+
+        if (adsp2100.pc != adsp2100.loop)
+        {
+            const ADSPDYNABLOCK* block = adsp2100_dyna_lookup(adsp2100.pc, adsp2100.mstat);
+            int budget = adsp2100_slice - done;
+            if (block && block->length <= budget)
+                n = adsp2100_dyna_check ? adsp2100_dyna_verify(block, budget) : block->code(budget);
+        }
+        if (!n)
+        {
+            adsp2100_step();
+            n = 1;
+        }
+        done += n;
+    }
+
+    adsp2100_slice = done;
+}
+
+int adsp2100_execute(int cycles)
+{
+    adsp2100_icount = cycles;
+    check_irqs();
+
+    while (adsp2100_icount > 0)
+    {
+        // run up to the next timer or autobuffer event
+        int slice = adsp2100_icount;
+        if ((adsp2100.mstat & MSTAT_TIMER) && adsp2100.timer_cycles > 0 && adsp2100.timer_cycles < slice)
+            slice = adsp2100.timer_cycles;
+        if (adsp2100.sport_period && adsp2100.sport_cycles > 0 && adsp2100.sport_cycles < slice)
+            slice = adsp2100.sport_cycles;
+
+        if (adsp2100.idle)
+            adsp2100_slice = slice;
+        else if (adsp2100_dyna_enabled)
+            adsp2100_run_compiled(slice);
+        else
+            adsp2100_run(slice);
+
+        int done = adsp2100_slice;
+        adsp2100_icount -= done;
+
+        if (adsp2100.mstat & MSTAT_TIMER)
+        {
+            adsp2100.timer_cycles -= done;
+            if (adsp2100.timer_cycles <= 0)
+            {
+                adsp2100.timer_cycles = (dspDMem[ADSP_TPERIOD] + 1) * ((dspDMem[ADSP_TSCALE] & 0xff) + 1);
+                adsp2100.irq_latch[ADSP2105_TIMER] = 1;
+            }
+        }
+
+        if (adsp2100.sport_period)
+        {
+            adsp2100.sport_cycles -= done;
+            if (adsp2100.sport_cycles <= 0)
+            {
+                adsp2100_autobuffer();
+                adsp2100.sport_cycles += adsp2100.sport_period;
+            }
+        }
+
+        if (adsp2100.boot)
+        {
+            adsp2100.boot = 0;
+            if (adsp2105_boot_callback)
+                (*adsp2105_boot_callback)();
+        }
+
+        check_irqs();
+    }
+
     return cycles - adsp2100_icount;
 }
 
 // ---------------------- RESET ----------------------
-void adsp2100_reset(void* param){
-    adsp2100.pc = 0;
-    adsp2100.pc_sp = 0;
-    adsp2100.astat = 0;
-    adsp2100.sstat = 0;
-    adsp2100.mstat = 0;
+void adsp2100_reset(void* param)
+{
+    adsp2100_init_tables();
+
+    memset(&adsp2100, 0, sizeof(adsp2100));
+    for (int i = 0; i < 8; i++)
+        adsp2100.lmask[i] = mask_table[0];
+
+    adsp2100.loop = 0xffff;
+    adsp2100.sstat = PC_EMPTY | COUNT_EMPTY | STATUS_EMPTY | LOOP_EMPTY;
+    mstat_changed();
+
+    dspDMem[ADSP_S1_AUTOBUF] = 0;
+    dspDMem[ADSP_SYSCONTROL] = 0x0e1f;
     adsp2100_icount = 0;
 }
+
+void adsp2100_exit()
+{
+    adsp2100_dyna_exit();
+    adsp2105_autobuf_callback = nullptr;
+    adsp2105_boot_callback = nullptr;
+}
+
+// ---------------------- SAVE STATES ----------------------
+void adsp2100_save_state(STATESTREAM* s)
+{
+    iStateWrite(s, adsp2100);
+    iStateWrite(s, adsp2100_icount);
+}
+
+// program memory is already back: decode it again, which also drops the
+// compiled blocks built from the code being replaced
+void adsp2100_load_state(STATESTREAM* s)
+{
+    iStateRead(s, adsp2100);
+    iStateRead(s, adsp2100_icount);
+
+    mstat_changed();
+    adsp2100_predecode();
+}
+
+// ---------------------- DEBUGGER ACCESS ----------------------
+uint32_t adsp2100_get_pc() { return adsp2100.pc; }
+void adsp2100_set_pc(uint32_t pc) { adsp2100.pc = pc & 0x3fff; }
+
+int32_t adsp2100_get_reg(int regnum)
+{
+    switch (regnum)
+    {
+        case ADSP2100_PC:    return adsp2100.pc;
+        case ADSP2100_AX0:   return core->ax0.u;
+        case ADSP2100_AX1:   return core->ax1.u;
+        case ADSP2100_AY0:   return core->ay0.u;
+        case ADSP2100_AY1:   return core->ay1.u;
+        case ADSP2100_AR:    return core->ar.u;
+        case ADSP2100_AF:    return core->af.u;
+        case ADSP2100_MX0:   return core->mx0.u;
+        case ADSP2100_MX1:   return core->mx1.u;
+        case ADSP2100_MY0:   return core->my0.u;
+        case ADSP2100_MY1:   return core->my1.u;
+        case ADSP2100_MR0:   return core->mr.mrx.mr0.u;
+        case ADSP2100_MR1:   return core->mr.mrx.mr1.u;
+        case ADSP2100_MR2:   return core->mr.mrx.mr2.u;
+        case ADSP2100_MF:    return core->mf.u;
+        case ADSP2100_SI:    return core->si.u;
+        case ADSP2100_SE:    return core->se.u;
+        case ADSP2100_SB:    return core->sb.u;
+        case ADSP2100_SR0:   return core->sr.srx.sr0.u;
+        case ADSP2100_SR1:   return core->sr.srx.sr1.u;
+        case ADSP2100_PX:    return adsp2100.px;
+        case ADSP2100_CNTR:  return adsp2100.cntr;
+        case ADSP2100_ASTAT: return adsp2100.astat;
+        case ADSP2100_SSTAT: return adsp2100.sstat;
+        case ADSP2100_MSTAT: return adsp2100.mstat;
+        case ADSP2100_IMASK: return adsp2100.imask;
+        case ADSP2100_ICNTL: return adsp2100.icntl;
+    }
+    if (regnum >= ADSP2100_I0 && regnum <= ADSP2100_I7) return adsp2100.i[regnum - ADSP2100_I0];
+    if (regnum >= ADSP2100_L0 && regnum <= ADSP2100_L7) return adsp2100.l[regnum - ADSP2100_L0];
+    if (regnum >= ADSP2100_M0 && regnum <= ADSP2100_M7) return adsp2100.m[regnum - ADSP2100_M0];
+    return 0;
+}
+
+void adsp2100_set_reg(int regnum, int32_t val)
+{
+    switch (regnum)
+    {
+        case ADSP2100_PC:    adsp2100_set_pc(val); return;
+        case ADSP2100_AX0:   wr_ax0(val); return;
+        case ADSP2100_AX1:   wr_ax1(val); return;
+        case ADSP2100_AY0:   wr_ay0(val); return;
+        case ADSP2100_AY1:   wr_ay1(val); return;
+        case ADSP2100_AR:    wr_ar(val); return;
+        case ADSP2100_AF:    core->af.u = val; return;
+        case ADSP2100_MX0:   wr_mx0(val); return;
+        case ADSP2100_MX1:   wr_mx1(val); return;
+        case ADSP2100_MY0:   wr_my0(val); return;
+        case ADSP2100_MY1:   wr_my1(val); return;
+        case ADSP2100_MR0:   wr_mr0(val); return;
+        case ADSP2100_MR1:   wr_mr1(val); return;
+        case ADSP2100_MR2:   wr_mr2(val); return;
+        case ADSP2100_MF:    core->mf.u = val; return;
+        case ADSP2100_SI:    wr_si(val); return;
+        case ADSP2100_SE:    wr_se(val); return;
+        case ADSP2100_SB:    wr_sb(val); return;
+        case ADSP2100_SR0:   wr_sr0(val); return;
+        case ADSP2100_SR1:   wr_sr1(val); return;
+        case ADSP2100_PX:    wr_px(val); return;
+        case ADSP2100_CNTR:  adsp2100.cntr = val & 0x3fff; return;
+        case ADSP2100_ASTAT: wr_astat(val); return;
+        case ADSP2100_SSTAT: wr_sstat(val); return;
+        case ADSP2100_MSTAT: wr_mstat(val); return;
+        case ADSP2100_IMASK: wr_imask(val); return;
+        case ADSP2100_ICNTL: wr_icntl(val); return;
+    }
+    if (regnum >= ADSP2100_I0 && regnum <= ADSP2100_I7) WRITE_REG(1 + (regnum - ADSP2100_I0) / 4, (regnum - ADSP2100_I0) & 3, val);
+    else if (regnum >= ADSP2100_M0 && regnum <= ADSP2100_M7) WRITE_REG(1 + (regnum - ADSP2100_M0) / 4, 4 + ((regnum - ADSP2100_M0) & 3), val);
+    else if (regnum >= ADSP2100_L0 && regnum <= ADSP2100_L7) WRITE_REG(1 + (regnum - ADSP2100_L0) / 4, 8 + ((regnum - ADSP2100_L0) & 3), val);
+}
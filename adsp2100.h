@@ -7,33 +7,64 @@
 // ---------------------- Config ----------------------
 #define SUPPORT_2101_EXTENSIONS 1
 
-// ---------------------- Memory access (platform layer) ----------------------
-extern uint8_t  dspReadByte(uint32_t addr);
-extern uint16_t dspReadWord(uint32_t addr);
-extern uint32_t dspReadDWord(uint32_t addr);
-extern void     dspWriteByte(uint32_t addr, uint8_t val);
-extern void     dspWriteWord(uint32_t addr, uint16_t val);
-extern void     dspWriteDWord(uint32_t addr, uint32_t val);
+#define ADSP_PMEM_WORDS  0x2000     // dspPMem holds 8K 24-bit words (one per DWORD)
+#define ADSP_DMEM_WORDS  0x4000     // dspDMem covers the full 14-bit data space
+
+// ---------------------- Interrupt lines (priority order) ----------------------
+enum {
+    ADSP2105_IRQ2 = 0,              // vector 0x04, CPU wrote the input latch
+    ADSP2105_SPORT0_TX,             // vector 0x08 (not bonded out on the 2105)
+    ADSP2105_SPORT0_RX,             // vector 0x0c (not bonded out on the 2105)
+    ADSP2105_IRQ1,                  // vector 0x10, SPORT1 transmit / autobuffer wrap
+    ADSP2105_IRQ0,                  // vector 0x14, SPORT1 receive
+    ADSP2105_TIMER,                 // vector 0x18
+    ADSP2105_IRQ_COUNT
+};
+
+// ---------------------- Register ids (debugger) ----------------------
+enum {
+    ADSP2100_PC = 1,
+    ADSP2100_AX0, ADSP2100_AX1, ADSP2100_AY0, ADSP2100_AY1, ADSP2100_AR, ADSP2100_AF,
+    ADSP2100_MX0, ADSP2100_MX1, ADSP2100_MY0, ADSP2100_MY1, ADSP2100_MR0, ADSP2100_MR1, ADSP2100_MR2, ADSP2100_MF,
+    ADSP2100_SI, ADSP2100_SE, ADSP2100_SB, ADSP2100_SR0, ADSP2100_SR1,
+    ADSP2100_I0, ADSP2100_I1, ADSP2100_I2, ADSP2100_I3, ADSP2100_I4, ADSP2100_I5, ADSP2100_I6, ADSP2100_I7,
+    ADSP2100_L0, ADSP2100_L1, ADSP2100_L2, ADSP2100_L3, ADSP2100_L4, ADSP2100_L5, ADSP2100_L6, ADSP2100_L7,
+    ADSP2100_M0, ADSP2100_M1, ADSP2100_M2, ADSP2100_M3, ADSP2100_M4, ADSP2100_M5, ADSP2100_M6, ADSP2100_M7,
+    ADSP2100_PX, ADSP2100_CNTR, ADSP2100_ASTAT, ADSP2100_SSTAT, ADSP2100_MSTAT, ADSP2100_IMASK, ADSP2100_ICNTL
+};
 
 // ---------------------- Core API ----------------------
 extern int adsp2100_icount;
 
 extern void adsp2100_reset(void* param);
+extern void adsp2100_exit();
 extern int  adsp2100_execute(int cycles);
 extern void adsp2100_set_irq_line(int irqline, int state);
+extern void adsp2100_predecode();
+extern void adsp2100_predecode_word(uint32_t addr);
+
+extern uint32_t adsp2100_get_pc();
+extern void     adsp2100_set_pc(uint32_t pc);
+extern int32_t  adsp2100_get_reg(int regnum);
+extern void     adsp2100_set_reg(int regnum, int32_t val);
+
+// ---------------------- Save states ----------------------
+// Core registers and stacks; program and data memory go with the rest of memory
+struct STATESTREAM;
+extern void adsp2100_save_state(STATESTREAM* s);
+extern void adsp2100_load_state(STATESTREAM* s);
 
 #if SUPPORT_2101_EXTENSIONS
 typedef int32_t (*RX_CALLBACK)(int port);
 typedef void (*TX_CALLBACK)(int port, int32_t data);
+// half an autobuffer's samples, in the order the SPORT sends them; addr is where the first came from
+typedef void (*AUTOBUF_CALLBACK)(uint32_t addr, const int16_t* samples, uint32_t count);
+typedef void (*BOOT_CALLBACK)();
 
 extern void adsp2100_set_rx_callback(RX_CALLBACK cb);
 extern void adsp2100_set_tx_callback(TX_CALLBACK cb);
+extern void adsp2100_set_autobuf_callback(AUTOBUF_CALLBACK cb);
+extern void adsp2100_set_boot_callback(BOOT_CALLBACK cb);
 #endif
 
-// ---------------------- Inline helpers ----------------------
-inline int32_t alu_get_x(unsigned n) { return adsp2100.core.ax0.s; } // adjust per register mapping
-inline int32_t alu_get_y(unsigned n) { return adsp2100.core.ay0.s; }
-inline int32_t alu_get_af() { return adsp2100.core.af.s; }
-inline void alu_set_af(int32_t val) { adsp2100.core.af.s = val; }
-
 #endif
@@ -1,47 +1,161 @@
+
 #ifndef _ADSP2100_CORE_H
 #define _ADSP2100_CORE_H
 
 #include <cstdint>
 
-#define PC_STACK_DEPTH 8
+#define PC_STACK_DEPTH    16
+#define CNTR_STACK_DEPTH  4
+#define STAT_STACK_DEPTH  4
+#define LOOP_STACK_DEPTH  4
+
+// 16-bit registers that can be read back signed or unsigned
+union ADSPREG16 {
+    uint16_t u;
+    int16_t  s;
+};
+
+// SR is SR1:SR0 as one 32-bit value
+union SHIFTRESULT {
+    struct { ADSPREG16 sr0, sr1; } srx;
+    uint32_t sr;
+};
 
-// Core registers
+// MR is MR2:MR1:MR0 (40 bits, MR2 sign extended), mrzero pads to 64 bits
+union MACRESULT {
+    struct { ADSPREG16 mr0, mr1, mr2, mrzero; } mrx;
+    uint64_t mr;
+};
+
+// One register bank (MSTAT bit 0 selects the primary or secondary set)
 struct ADSPCORE {
-    struct { int32_t s; } ax0, ax1;
-    struct { int32_t s; } ay0, ay1;
-    struct { int32_t s; } ar, af;
-    struct { int32_t s; } mx0, mx1;
-    struct { int32_t s; } my0, my1;
-    struct { int32_t s; } mr0, mr1, mr2, mf;
-    struct { int32_t s; } si, se, sb, sr0, sr1;
-    struct { int32_t s; } i[8];
-    struct { int32_t s; } l[8];
-    struct { int32_t s; } m[8];
-    struct { int32_t s; } px;
-};
-
-// Full CPU state (core + PC, stack, flags, timers)
+    ADSPREG16   ax0, ax1, ay0, ay1, ar, af;
+    ADSPREG16   mx0, mx1, my0, my1, mf;
+    MACRESULT   mr;
+    ADSPREG16   si, se, sb;
+    SHIFTRESULT sr;
+    ADSPREG16   zero;
+};
+
+// Full CPU state (both banks, DAGs, stacks, interrupt and on-chip peripheral state)
 struct ADSP2100 {
-    // CPU state
-    uint16_t pc;
-    uint16_t pc_stack[PC_STACK_DEPTH];
-    uint8_t  pc_sp;
-    uint16_t astat;
-    uint16_t astat_clear;
-    uint16_t sstat;
-    uint16_t mstat;
-    uint16_t loop_addr;
-    uint16_t lc;
+    ADSPCORE r[2];
+
+    // PC and loop logic
+    uint32_t pc;
+    uint32_t ppc;
+    uint32_t loop;
+    uint32_t loop_condition;
+    uint32_t cntr;
+
+    // status registers
+    uint32_t astat;
+    uint32_t sstat;
+    uint32_t mstat;
+    uint32_t astat_clear;
+    uint32_t idle;
 
-    // I/O and timers
-    int16_t timer_control;
-    int16_t serial_data;
+    // DAGs (base/lmask precomputed for circular buffers)
+    uint32_t i[8];
+    int32_t  m[8];
+    uint32_t l[8];
+    uint32_t lmask[8];
+    uint32_t base[8];
+    uint32_t px;
+
+    // stacks
+    uint32_t loop_stack[LOOP_STACK_DEPTH];
+    uint32_t cntr_stack[CNTR_STACK_DEPTH];
+    uint32_t pc_stack[PC_STACK_DEPTH];
+    uint16_t stat_stack[STAT_STACK_DEPTH][3];
+    int32_t  pc_sp;
+    int32_t  cntr_sp;
+    int32_t  stat_sp;
+    int32_t  loop_sp;
+
+    // interrupts
+    uint32_t imask;
+    uint32_t icntl;
+    uint32_t ifc;
+    uint8_t  irq_state[6];
+    uint8_t  irq_latch[6];
+    uint8_t  flagin;
+    uint8_t  flagout;
+
+    // on-chip timer (TPERIOD/TCOUNT/TSCALE at 0x3ffd..0x3ffb)
+    int32_t  timer_cycles;
+
+    // SPORT1 autobuffer (S1_AUTOBUF at 0x3fef)
+    int32_t  sport_cycles;
+    int32_t  sport_period;
+
+    // SYSCONTROL boot force pending
+    uint32_t boot;
+};
+
+// Dispatch index of a pre-decoded word
+enum {
+    ADSP_UOP_INVALID = 0,
+    ADSP_UOP_NOP,
+    ADSP_UOP_IDLE,
+    ADSP_UOP_FLAGIN,
+    ADSP_UOP_STACK,
+    ADSP_UOP_SATMR,
+    ADSP_UOP_DIVS,
+    ADSP_UOP_DIVQ,
+    ADSP_UOP_MODIFY,
+    ADSP_UOP_RET,
+    ADSP_UOP_JUMP_IND,
+    ADSP_UOP_MODE,
+    ADSP_UOP_MOVE,
+    ADSP_UOP_SHIFT_COND,
+    ADSP_UOP_SHIFT_IMM,
+    ADSP_UOP_SHIFT_MOVE,
+    ADSP_UOP_SHIFT_PGM,
+    ADSP_UOP_SHIFT_DM1,
+    ADSP_UOP_SHIFT_DM2,
+    ADSP_UOP_DO,
+    ADSP_UOP_JUMP,
+    ADSP_UOP_JUMP_COND,
+    ADSP_UOP_CALL,
+    ADSP_UOP_CALL_COND,
+    ADSP_UOP_COMPUTE,
+    ADSP_UOP_COMPUTE_COND,
+    ADSP_UOP_COMPUTE_MOVE,
+    ADSP_UOP_LOAD_REG,
+    ADSP_UOP_LOAD_DREG,
+    ADSP_UOP_COMPUTE_PGM_RD,
+    ADSP_UOP_COMPUTE_PGM_WR,
+    ADSP_UOP_COMPUTE_DM1_RD,
+    ADSP_UOP_COMPUTE_DM1_WR,
+    ADSP_UOP_COMPUTE_DM2_RD,
+    ADSP_UOP_COMPUTE_DM2_WR,
+    ADSP_UOP_READ_DM,
+    ADSP_UOP_WRITE_DM,
+    ADSP_UOP_STORE_DM1,
+    ADSP_UOP_STORE_DM2,
+    ADSP_UOP_DUAL_READ
+};
+
+// ALU/MAC computation of a pre-decoded word
+enum {
+    ADSP_UNIT_NONE = 0,
+    ADSP_UNIT_MAC_MR,
+    ADSP_UNIT_ALU_AR,
+    ADSP_UNIT_MAC_MF,
+    ADSP_UNIT_ALU_AF
+};
 
-    // Core
-    ADSPCORE core;
+// Pre-decoded program word, rebuilt whenever program memory is (re)loaded
+struct ADSPUOP {
+    uint32_t op;     // raw 24-bit instruction
+    uint16_t arg;    // jump/call/loop target, immediate data or DM address
+    uint8_t  kind;   // ADSP_UOP_* dispatch index
+    uint8_t  unit;   // ADSP_UNIT_* computation for ALU/MAC forms
 };
 
 // Global
 extern ADSP2100 adsp2100;
+extern ADSPUOP  adsp2100_pcode[];
 
 #endif // _ADSP2100_CORE_H
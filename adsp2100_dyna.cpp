@@ -0,0 +1,1561 @@
+// ADSP-2105 block compiler
+//
+// A block is the straight-line run of the sound program starting at one PC,
+// compiled for one set of MSTAT mode bits. Architectural state stays in the
+// adsp2100 struct: DAG post-modify and the circular buffer wrap are done in host
+// registers and stored back, MR lives in a 64-bit host register across MAC
+// chains and is only written back (48 bits plus MV) when something else looks
+// at it. DO ... UNTIL CE loops whose body stays inside the block run natively
+// with the counter in a host register. Everything the block does not generate
+// itself calls back into the interpreter (adsp2100_dyna_* in adsp2100.cpp), so
+// the interpreter remains the reference and adsp2100_dyna_check can compare the
+// two block by block.
+
+#include <cstdio>
+#include <cstring>
+#include <cstddef>
+#include "adsp2100.h"
+#include "adsp2100_dyna.h"
+
+#if defined(__SWITCH__)
+#include <switch.h>
+#elif defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#endif
+
+// ADSP_DYNA_DEFAULT: whether blocks are compiled unless told otherwise. The
+// A64 generator has not yet been run against the interpreter on a console,
+// so it stays off there until adsp2100_dyna_check has passed on hardware
+#if defined(__aarch64__)
+#define ADSP_DYNA_A64   1
+#define ADSP_DYNA_HOST  1
+#define ADSP_DYNA_DEFAULT 0
+#elif defined(__x86_64__) && !defined(_WIN32)
+#define ADSP_DYNA_X64   1
+#define ADSP_DYNA_HOST  1
+#define ADSP_DYNA_DEFAULT 1
+#else
+#define ADSP_DYNA_HOST  0
+#define ADSP_DYNA_DEFAULT 0
+#endif
+
+#define ADSP_DYNA_CODE_SIZE  0x100000    // code cache, flushed whole when full
+#define ADSP_DYNA_ROOM       0x10000     // worst case for one block
+#define ADSP_DYNA_MAX_OPS    32          // instructions per block outside loop bodies
+#define ADSP_DYNA_MAX_LOOP   64          // body length of a native DO loop
+#define ADSP_DYNA_MAX_STUBS  512
+
+#define MSTAT_BANK      0x01
+#define MSTAT_REVERSE   0x02
+#define MSTAT_INTEGER   0x10
+#define MVFLAG          0x40
+
+extern uint16_t* dspDMem;
+extern uint32_t* dspPMem;
+
+bool adsp2100_dyna_enabled = ADSP_DYNA_DEFAULT;
+bool adsp2100_dyna_check = false;
+int  adsp2100_dyna_mismatches = 0;
+
+static ADSPDYNABLOCK dyna_blocks[ADSP_PMEM_WORDS];
+static uint8_t  dyna_loopend[ADSP_PMEM_WORDS];     // last word of some DO loop
+static uint8_t  dyna_covered[ADSP_PMEM_WORDS];     // word is part of a compiled block
+static bool     dyna_ready = false;
+static bool     dyna_flush = true;
+static uint8_t* dyna_rw = nullptr;                  // where code is written
+static uint8_t* dyna_rx = nullptr;                  // where the same code runs
+static uint32_t dyna_used = 0;
+#if defined(__SWITCH__)
+static Jit      dyna_jit;
+#endif
+
+// ---------------------- STATE LAYOUT ----------------------
+#define ST(field)   ((uint32_t)offsetof(ADSP2100, field))
+#define ST_I(n)     (ST(i) + 4 * (n))
+#define ST_M(n)     (ST(m) + 4 * (n))
+#define ST_L(n)     (ST(l) + 4 * (n))
+#define ST_BASE(n)  (ST(base) + 4 * (n))
+
+// group 0 registers in instruction order
+static const uint8_t dyna_dreg[16] = {
+    offsetof(ADSPCORE, ax0), offsetof(ADSPCORE, ax1), offsetof(ADSPCORE, mx0), offsetof(ADSPCORE, mx1),
+    offsetof(ADSPCORE, ay0), offsetof(ADSPCORE, ay1), offsetof(ADSPCORE, my0), offsetof(ADSPCORE, my1),
+    offsetof(ADSPCORE, si), offsetof(ADSPCORE, se), offsetof(ADSPCORE, ar), offsetof(ADSPCORE, mr.mrx.mr0),
+    offsetof(ADSPCORE, mr.mrx.mr1), offsetof(ADSPCORE, mr.mrx.mr2), offsetof(ADSPCORE, sr.srx.sr0), offsetof(ADSPCORE, sr.srx.sr1)
+};
+
+static const uint8_t dyna_mac_x[8] = {
+    offsetof(ADSPCORE, mx0), offsetof(ADSPCORE, mx1), offsetof(ADSPCORE, ar), offsetof(ADSPCORE, mr.mrx.mr0),
+    offsetof(ADSPCORE, mr.mrx.mr1), offsetof(ADSPCORE, mr.mrx.mr2), offsetof(ADSPCORE, sr.srx.sr0), offsetof(ADSPCORE, sr.srx.sr1)
+};
+
+static const uint8_t dyna_mac_y[4] = {
+    offsetof(ADSPCORE, my0), offsetof(ADSPCORE, my1), offsetof(ADSPCORE, mf), offsetof(ADSPCORE, zero)
+};
+
+// ---------------------- EMITTER STATE ----------------------
+enum { STUB_EXIT, STUB_READ, STUB_WRITE };
+enum { EXIT_PC = 1, EXIT_CNTR = 2, EXIT_FLUSH = 4 };
+
+// how to leave the block right after the instruction being compiled
+struct DYNAEXIT {
+    uint32_t pc;
+    uint32_t stat;      // instructions executed outside native loop bodies
+    int      flags;
+};
+
+// out-of-line tail: block exit, or the I/O path of a data memory access
+struct DYNASTUB {
+    uint32_t       patch[2];
+    int            npatch;
+    uint32_t       back;
+    const ADSPUOP* u;
+    DYNAEXIT       exit;
+    int            kind;
+    bool           acc;
+};
+
+struct DYNA {
+    uint8_t* code;
+    uint32_t pos;
+    uint32_t size;
+    bool     full;
+    uint32_t mstat;
+    uint32_t core;      // offset of the active register bank
+    bool     acc;       // MR is held in the accumulator register
+    DYNASTUB stubs[ADSP_DYNA_MAX_STUBS];
+    int      nstubs;
+};
+
+static void e8(DYNA& d, uint32_t v)
+{
+    if (d.pos + 1 > d.size) { d.full = true; return; }
+    d.code[d.pos++] = (uint8_t)v;
+}
+
+static void e32(DYNA& d, uint32_t v)
+{
+    if (d.pos + 4 > d.size) { d.full = true; return; }
+    memcpy(d.code + d.pos, &v, 4);
+    d.pos += 4;
+}
+
+static void e64(DYNA& d, uint64_t v)
+{
+    e32(d, (uint32_t)v);
+    e32(d, (uint32_t)(v >> 32));
+}
+
+static uint32_t rd32(DYNA& d, uint32_t at)
+{
+    uint32_t v;
+    memcpy(&v, d.code + at, 4);
+    return v;
+}
+
+static void wr32(DYNA& d, uint32_t at, uint32_t v)
+{
+    if (at + 4 <= d.size)
+        memcpy(d.code + at, &v, 4);
+}
+
+#if ADSP_DYNA_X64
+// ---------------------- X86-64 BACKEND (SysV) ----------------------
+// rbx state, r12 dspDMem, rbp dspPMem, r13d cycles in loop bodies, r14d loop
+// counter, r15 MR accumulator; [rsp] budget, [rsp+8] MV pending, [rsp+16] loop limit
+enum { T0 = 0, T1 = 1, T2 = 2, T3 = 8, T4 = 9, T5 = 10 };
+enum { CC_EQ = 4, CC_NE = 5, CC_LO = 2, CC_HS = 3, CC_GT = 15, CC_AL = -1 };
+
+#define R_STATE 3
+#define R_PMEM  5
+#define R_DMEM  12
+#define R_CONS  13
+#define R_CNT   14
+#define R_ACC   15
+#define R_CALL  11
+static const int x_args[2] = { 7, 6 };  // rdi, rsi
+
+static void x_rex(DYNA& d, int w, int reg, int index, int base)
+{
+    int rex = 0x40 | (w << 3) | ((reg & 8) >> 1) | ((index & 8) >> 2) | ((base & 8) >> 3);
+    if (rex != 0x40)
+        e8(d, rex);
+}
+
+// [base + disp32]
+static void x_mem(DYNA& d, int reg, int base, uint32_t disp)
+{
+    e8(d, 0x80 | ((reg & 7) << 3) | (base & 7));
+    if ((base & 7) == 4)
+        e8(d, 0x24);
+    e32(d, disp);
+}
+
+// [base + index * (1 << scale)]
+static void x_idx(DYNA& d, int reg, int base, int index, int scale)
+{
+    e8(d, 0x44 | ((reg & 7) << 3));
+    e8(d, (scale << 6) | ((index & 7) << 3) | (base & 7));
+    e8(d, 0);
+}
+
+static void x_rr(DYNA& d, int reg, int rm)
+{
+    e8(d, 0xc0 | ((reg & 7) << 3) | (rm & 7));
+}
+
+static void x_alu(DYNA& d, int w, int op, int dst, int src)
+{
+    x_rex(d, w, src, 0, dst);
+    e8(d, op);
+    x_rr(d, src, dst);
+}
+
+static void x_alui(DYNA& d, int w, int ext, int dst, uint32_t imm)
+{
+    x_rex(d, w, 0, 0, dst);
+    e8(d, 0x81);
+    x_rr(d, ext, dst);
+    e32(d, imm);
+}
+
+static void x_shift(DYNA& d, int w, int ext, int r, int n)
+{
+    x_rex(d, w, 0, 0, r);
+    e8(d, 0xc1);
+    x_rr(d, ext, r);
+    e8(d, n);
+}
+
+static void x_imm64(DYNA& d, int r, uint64_t imm)
+{
+    x_rex(d, 1, 0, 0, r);
+    e8(d, 0xb8 + (r & 7));
+    e64(d, imm);
+}
+
+static void x_load(DYNA& d, int w, int op2, int r, uint32_t off)
+{
+    x_rex(d, w, r, 0, R_STATE);
+    if (op2 >= 0x100) { e8(d, 0x0f); e8(d, op2 & 0xff); }
+    else e8(d, op2);
+    x_mem(d, r, R_STATE, off);
+}
+
+static void em_ld16s(DYNA& d, int r, uint32_t off) { x_load(d, 0, 0x1bf, r, off); }
+static void em_ld16u(DYNA& d, int r, uint32_t off) { x_load(d, 0, 0x1b7, r, off); }
+static void em_ld32(DYNA& d, int r, uint32_t off)  { x_load(d, 0, 0x8b, r, off); }
+static void em_st32(DYNA& d, int r, uint32_t off)  { x_load(d, 0, 0x89, r, off); }
+static void em_st16(DYNA& d, int r, uint32_t off)  { e8(d, 0x66); x_load(d, 0, 0x89, r, off); }
+
+static void em_mov(DYNA& d, int dst, int src)            { x_alu(d, 0, 0x89, dst, src); }
+static void em_add(DYNA& d, int dst, int src)            { x_alu(d, 0, 0x01, dst, src); }
+static void em_sub(DYNA& d, int dst, int src)            { x_alu(d, 0, 0x29, dst, src); }
+static void em_cmp(DYNA& d, int a, int b)                { x_alu(d, 0, 0x39, a, b); }
+static void em_add_imm(DYNA& d, int r, uint32_t imm)     { x_alui(d, 0, 0, r, imm); }
+static void em_sub_imm(DYNA& d, int r, uint32_t imm)     { x_alui(d, 0, 5, r, imm); }
+static void em_cmp_imm(DYNA& d, int r, uint32_t imm)     { x_alui(d, 0, 7, r, imm); }
+static void em_and_imm(DYNA& d, int r, uint32_t imm)     { x_alui(d, 0, 4, r, imm); }
+static void em_shl(DYNA& d, int r, int n)                { x_shift(d, 0, 4, r, n); }
+static void em_shr(DYNA& d, int r, int n)                { x_shift(d, 0, 5, r, n); }
+
+static void em_mov_imm(DYNA& d, int r, uint32_t imm)
+{
+    x_rex(d, 0, 0, 0, r);
+    e8(d, 0xb8 + (r & 7));
+    e32(d, imm);
+}
+
+static void em_mul(DYNA& d, int dst, int src)
+{
+    x_rex(d, 0, dst, 0, src);
+    e8(d, 0x0f); e8(d, 0xaf);
+    x_rr(d, dst, src);
+}
+
+static void em_ld_dm(DYNA& d, int rd, int ra)
+{
+    x_rex(d, 0, rd, ra, R_DMEM);
+    e8(d, 0x0f); e8(d, 0xb7);
+    x_idx(d, rd, R_DMEM, ra, 1);
+}
+
+static void em_st_dm(DYNA& d, int rv, int ra)
+{
+    e8(d, 0x66);
+    x_rex(d, 0, rv, ra, R_DMEM);
+    e8(d, 0x89);
+    x_idx(d, rv, R_DMEM, ra, 1);
+}
+
+static void em_ld_dm_abs(DYNA& d, int rd, uint32_t addr)
+{
+    x_rex(d, 0, rd, 0, R_DMEM);
+    e8(d, 0x0f); e8(d, 0xb7);
+    x_mem(d, rd, R_DMEM, addr * 2);
+}
+
+static void em_st_dm_abs(DYNA& d, int rv, uint32_t addr)
+{
+    e8(d, 0x66);
+    x_rex(d, 0, rv, 0, R_DMEM);
+    e8(d, 0x89);
+    x_mem(d, rv, R_DMEM, addr * 2);
+}
+
+// rd = 24-bit program word at ra (ra is masked in place)
+static void em_ld_pm(DYNA& d, int rd, int ra)
+{
+    em_and_imm(d, ra, ADSP_PMEM_WORDS - 1);
+    x_rex(d, 0, rd, ra, R_PMEM);
+    e8(d, 0x8b);
+    x_idx(d, rd, R_PMEM, ra, 2);
+    em_and_imm(d, rd, 0xffffff);
+}
+
+static void em_acc_load(DYNA& d)
+{
+    x_load(d, 1, 0x8b, R_ACC, d.core + offsetof(ADSPCORE, mr));
+}
+
+static void em_acc_set(DYNA& d, int r)
+{
+    x_rex(d, 1, R_ACC, 0, r);
+    e8(d, 0x63);
+    x_rr(d, R_ACC, r);
+}
+
+static void em_acc_add(DYNA& d, int r, bool sub)
+{
+    x_rex(d, 1, r, 0, r);
+    e8(d, 0x63);
+    x_rr(d, r, r);
+    x_alu(d, 1, sub ? 0x29 : 0x01, R_ACC, r);
+}
+
+static void em_dirty(DYNA& d, int v)
+{
+    e8(d, 0xc7); e8(d, 0x44); e8(d, 0x24); e8(d, 0x08);
+    e32(d, v);
+}
+
+static uint32_t em_branch(DYNA& d, int cc)
+{
+    if (cc == CC_AL)
+        e8(d, 0xe9);
+    else
+    {
+        e8(d, 0x0f);
+        e8(d, 0x80 + cc);
+    }
+    e32(d, 0);
+    return d.pos - 4;
+}
+
+static void em_bind(DYNA& d, uint32_t patch)
+{
+    wr32(d, patch, d.pos - (patch + 4));
+}
+
+static void em_jump_to(DYNA& d, int cc, uint32_t target)
+{
+    uint32_t patch = em_branch(d, cc);
+    wr32(d, patch, target - (patch + 4));
+}
+
+// write MR back (48 bits, MRZERO clear) and settle MV if a MAC ran since the last sync
+static void em_acc_sync(DYNA& d)
+{
+    uint32_t mr = d.core + offsetof(ADSPCORE, mr);
+
+    x_alu(d, 1, 0x89, T0, R_ACC);
+    x_shift(d, 1, 4, T0, 16);
+    x_shift(d, 1, 5, T0, 16);
+    x_load(d, 1, 0x89, T0, mr);
+
+    e8(d, 0x83); e8(d, 0x7c); e8(d, 0x24); e8(d, 0x08); e8(d, 0x00);    // cmp dword [rsp+8], 0
+    uint32_t clean = em_branch(d, CC_EQ);
+    x_alu(d, 1, 0x89, T0, R_ACC);
+    x_shift(d, 1, 5, T0, 31);
+    em_add_imm(d, T0, 1);
+    em_and_imm(d, T0, 0x1fe);
+    em_ld32(d, T1, ST(astat));
+    em_and_imm(d, T1, ~MVFLAG);
+    em_cmp_imm(d, T0, 0);
+    uint32_t inrange = em_branch(d, CC_EQ);
+    x_alui(d, 0, 1, T1, MVFLAG);
+    em_bind(d, inrange);
+    em_st32(d, T1, ST(astat));
+    em_dirty(d, 0);
+    em_bind(d, clean);
+}
+
+static void em_cnt_set(DYNA& d, int r)          { em_mov(d, R_CNT, r); }
+static void em_cnt_store(DYNA& d)               { em_st32(d, R_CNT, ST(cntr)); }
+static void em_cons_add(DYNA& d, uint32_t n)    { em_add_imm(d, R_CONS, n); }
+
+static uint32_t em_cnt_dec_jz(DYNA& d)
+{
+    em_sub_imm(d, R_CNT, 1);
+    return em_branch(d, CC_EQ);
+}
+
+static void em_limit_set(DYNA& d, uint32_t n)
+{
+    e8(d, 0x8b); e8(d, 0x04); e8(d, 0x24);                  // mov eax, [rsp]
+    em_sub_imm(d, T0, n);
+    e8(d, 0x89); e8(d, 0x44); e8(d, 0x24); e8(d, 0x10);     // mov [rsp+16], eax
+}
+
+static uint32_t em_limit_check(DYNA& d)
+{
+    e8(d, 0x44); e8(d, 0x3b); e8(d, 0x6c); e8(d, 0x24); e8(d, 0x10);    // cmp r13d, [rsp+16]
+    return em_branch(d, CC_GT);
+}
+
+// r = passes left before the limit (loop limit - cycles in loop bodies)
+static void em_limit_room(DYNA& d, int r)
+{
+    x_rex(d, 0, r, 0, 4);
+    e8(d, 0x8b); e8(d, 0x44 | ((r & 7) << 3)); e8(d, 0x24); e8(d, 0x10); // mov r, [rsp+16]
+    em_sub(d, r, R_CONS);
+}
+
+static void em_arg(DYNA& d, int n, int r)            { x_alu(d, 1, 0x89, x_args[n], r); }
+static void em_arg_imm(DYNA& d, int n, uint64_t v)   { x_imm64(d, x_args[n], v); }
+
+// result lands in T0
+static void em_call(DYNA& d, const void* fn)
+{
+    x_imm64(d, R_CALL, (uint64_t)(uintptr_t)fn);
+    e8(d, 0x41); e8(d, 0xff); e8(d, 0xd3);
+}
+
+static void em_prologue(DYNA& d)
+{
+    e8(d, 0x53); e8(d, 0x55);
+    e8(d, 0x41); e8(d, 0x54); e8(d, 0x41); e8(d, 0x55); e8(d, 0x41); e8(d, 0x56); e8(d, 0x41); e8(d, 0x57);
+    e8(d, 0x48); e8(d, 0x83); e8(d, 0xec); e8(d, 0x18);
+    x_imm64(d, R_STATE, (uint64_t)(uintptr_t)&adsp2100);
+    x_imm64(d, T0, (uint64_t)(uintptr_t)&dspDMem);
+    e8(d, 0x4c); e8(d, 0x8b); e8(d, 0x20);                  // mov r12, [rax]
+    x_imm64(d, T0, (uint64_t)(uintptr_t)&dspPMem);
+    e8(d, 0x48); e8(d, 0x8b); e8(d, 0x28);                  // mov rbp, [rax]
+    e8(d, 0x45); e8(d, 0x31); e8(d, 0xed);                  // xor r13d, r13d
+    e8(d, 0x89); e8(d, 0x3c); e8(d, 0x24);                  // mov [rsp], edi
+    em_dirty(d, 0);
+}
+
+// return R_CONS + T0
+static void em_epilogue(DYNA& d)
+{
+    em_add(d, T0, R_CONS);
+    e8(d, 0x48); e8(d, 0x83); e8(d, 0xc4); e8(d, 0x18);
+    e8(d, 0x41); e8(d, 0x5f); e8(d, 0x41); e8(d, 0x5e); e8(d, 0x41); e8(d, 0x5d); e8(d, 0x41); e8(d, 0x5c);
+    e8(d, 0x5d); e8(d, 0x5b); e8(d, 0xc3);
+}
+#endif // ADSP_DYNA_X64
+
+#if ADSP_DYNA_A64
+// ---------------------- AARCH64 BACKEND ----------------------
+// x19 state, x20 dspDMem, x21 dspPMem, w22 cycles in loop bodies, w23 loop
+// counter, x24 MR accumulator, w25 budget, w26 MV pending, w27 loop limit
+enum { T0 = 9, T1 = 10, T2 = 11, T3 = 12, T4 = 13, T5 = 14 };
+enum { CC_EQ = 0, CC_NE = 1, CC_HS = 2, CC_LO = 3, CC_GT = 12, CC_AL = 14 };
+
+#define R_SCRATCH 15
+#define R_CALL    16
+#define R_STATE   19
+#define R_DMEM    20
+#define R_PMEM    21
+#define R_CONS    22
+#define R_CNT     23
+#define R_ACC     24
+#define R_BUDGET  25
+#define R_DIRTY   26
+#define R_LIMIT   27
+
+static void a_imm(DYNA& d, int r, uint64_t v, bool x)
+{
+    e32(d, (x ? 0xd2800000 : 0x52800000) | ((uint32_t)(v & 0xffff) << 5) | r);
+    for (int hw = 1; hw < (x ? 4 : 2); hw++)
+        if ((v >> (hw * 16)) & 0xffff)
+            e32(d, (x ? 0xf2800000 : 0x72800000) | (hw << 21) | ((uint32_t)((v >> (hw * 16)) & 0xffff) << 5) | r);
+}
+
+static void a_ldst(DYNA& d, uint32_t op, int scale, int r, int base, uint32_t off)
+{
+    e32(d, op | ((off >> scale) << 10) | (base << 5) | r);
+}
+
+static void em_ld16s(DYNA& d, int r, uint32_t off) { a_ldst(d, 0x79c00000, 1, r, R_STATE, off); }
+static void em_ld16u(DYNA& d, int r, uint32_t off) { a_ldst(d, 0x79400000, 1, r, R_STATE, off); }
+static void em_st16(DYNA& d, int r, uint32_t off)  { a_ldst(d, 0x79000000, 1, r, R_STATE, off); }
+static void em_ld32(DYNA& d, int r, uint32_t off)  { a_ldst(d, 0xb9400000, 2, r, R_STATE, off); }
+static void em_st32(DYNA& d, int r, uint32_t off)  { a_ldst(d, 0xb9000000, 2, r, R_STATE, off); }
+
+static void em_mov_imm(DYNA& d, int r, uint32_t imm)   { a_imm(d, r, imm, false); }
+static void em_mov(DYNA& d, int dst, int src)          { e32(d, 0x2a0003e0 | (src << 16) | dst); }
+static void em_add(DYNA& d, int dst, int src)          { e32(d, 0x0b000000 | (src << 16) | (dst << 5) | dst); }
+static void em_sub(DYNA& d, int dst, int src)          { e32(d, 0x4b000000 | (src << 16) | (dst << 5) | dst); }
+static void em_cmp(DYNA& d, int a, int b)              { e32(d, 0x6b00001f | (b << 16) | (a << 5)); }
+static void em_mul(DYNA& d, int dst, int src)          { e32(d, 0x1b007c00 | (src << 16) | (dst << 5) | dst); }
+static void em_shl(DYNA& d, int r, int n)              { e32(d, 0x53000000 | (((32 - n) & 31) << 16) | ((31 - n) << 10) | (r << 5) | r); }
+static void em_shr(DYNA& d, int r, int n)              { e32(d, 0x53000000 | (n << 16) | (31 << 10) | (r << 5) | r); }
+
+static void em_add_imm(DYNA& d, int r, uint32_t imm)
+{
+    if (imm < 4096)
+        e32(d, 0x11000000 | (imm << 10) | (r << 5) | r);
+    else
+    {
+        a_imm(d, R_SCRATCH, imm, false);
+        em_add(d, r, R_SCRATCH);
+    }
+}
+
+static void em_sub_imm(DYNA& d, int r, uint32_t imm)
+{
+    if (imm < 4096)
+        e32(d, 0x51000000 | (imm << 10) | (r << 5) | r);
+    else
+    {
+        a_imm(d, R_SCRATCH, imm, false);
+        em_sub(d, r, R_SCRATCH);
+    }
+}
+
+static void em_cmp_imm(DYNA& d, int r, uint32_t imm)
+{
+    if (imm < 4096)
+        e32(d, 0x7100001f | (imm << 10) | (r << 5));
+    else
+    {
+        a_imm(d, R_SCRATCH, imm, false);
+        em_cmp(d, r, R_SCRATCH);
+    }
+}
+
+static void em_and_imm(DYNA& d, int r, uint32_t imm)
+{
+    if (imm && !(imm & (imm + 1)))
+    {
+        // low bit mask: UBFX r, r, #0, #width
+        int width = __builtin_popcount(imm);
+        e32(d, 0x53000000 | ((width - 1) << 10) | (r << 5) | r);
+    }
+    else
+    {
+        a_imm(d, R_SCRATCH, imm, false);
+        e32(d, 0x0a000000 | (R_SCRATCH << 16) | (r << 5) | r);
+    }
+}
+
+// LDRH/STRH/LDR with a W index register, UXTW and scaled
+static void em_ld_dm(DYNA& d, int rd, int ra)  { e32(d, 0x78605800 | (ra << 16) | (R_DMEM << 5) | rd); }
+static void em_st_dm(DYNA& d, int rv, int ra)  { e32(d, 0x78205800 | (ra << 16) | (R_DMEM << 5) | rv); }
+
+static void em_ld_dm_abs(DYNA& d, int rd, uint32_t addr)
+{
+    a_imm(d, R_SCRATCH, addr, false);
+    em_ld_dm(d, rd, R_SCRATCH);
+}
+
+static void em_st_dm_abs(DYNA& d, int rv, uint32_t addr)
+{
+    a_imm(d, R_SCRATCH, addr, false);
+    em_st_dm(d, rv, R_SCRATCH);
+}
+
+static void em_ld_pm(DYNA& d, int rd, int ra)
+{
+    em_and_imm(d, ra, ADSP_PMEM_WORDS - 1);
+    e32(d, 0xb8605800 | (ra << 16) | (R_PMEM << 5) | rd);
+    em_and_imm(d, rd, 0xffffff);
+}
+
+static void em_acc_load(DYNA& d)
+{
+    a_ldst(d, 0xf9400000, 3, R_ACC, R_STATE, d.core + offsetof(ADSPCORE, mr));
+}
+
+static void em_acc_set(DYNA& d, int r)
+{
+    e32(d, 0x93407c00 | (r << 5) | R_ACC);                                  // SXTW
+}
+
+static void em_acc_add(DYNA& d, int r, bool sub)
+{
+    e32(d, (sub ? 0xcb20c000 : 0x8b20c000) | (r << 16) | (R_ACC << 5) | R_ACC);   // ADD/SUB x, x, w, SXTW
+}
+
+static void em_dirty(DYNA& d, int v)
+{
+    a_imm(d, R_DIRTY, v, false);
+}
+
+static uint32_t em_branch(DYNA& d, int cc)
+{
+    e32(d, cc == CC_AL ? 0x14000000 : (0x54000000 | cc));
+    return d.pos - 4;
+}
+
+static uint32_t em_cbz(DYNA& d, int r)
+{
+    e32(d, 0x34000000 | r);
+    return d.pos - 4;
+}
+
+static void a_link(DYNA& d, uint32_t at, uint32_t target)
+{
+    int32_t delta = ((int32_t)target - (int32_t)at) >> 2;
+    uint32_t ins = rd32(d, at);
+    if ((ins & 0x7c000000) == 0x14000000)
+        ins |= delta & 0x3ffffff;
+    else
+        ins |= (delta & 0x7ffff) << 5;
+    wr32(d, at, ins);
+}
+
+static void em_bind(DYNA& d, uint32_t patch)
+{
+    if (!d.full)
+        a_link(d, patch, d.pos);
+}
+
+static void em_jump_to(DYNA& d, int cc, uint32_t target)
+{
+    uint32_t patch = em_branch(d, cc);
+    if (!d.full)
+        a_link(d, patch, target);
+}
+
+// write MR back (48 bits, MRZERO clear) and settle MV if a MAC ran since the last sync
+static void em_acc_sync(DYNA& d)
+{
+    uint32_t mr = d.core + offsetof(ADSPCORE, mr);
+
+    e32(d, 0xd3400000 | (47 << 10) | (R_ACC << 5) | T0);                   // UBFX x, acc, #0, #48
+    a_ldst(d, 0xf9000000, 3, T0, R_STATE, mr);
+    uint32_t clean = em_cbz(d, R_DIRTY);
+    e32(d, 0xd3400000 | (31 << 16) | (39 << 10) | (R_ACC << 5) | T0);      // UBFX x, acc, #31, #9
+    em_add_imm(d, T0, 1);
+    e32(d, 0x53000000 | (1 << 16) | (8 << 10) | (T0 << 5) | T0);           // UBFX w, w, #1, #8
+    em_cmp_imm(d, T0, 0);
+    e32(d, 0x1a9f07e0 | T0);                                                // CSET w, NE
+    em_ld32(d, T1, ST(astat));
+    e32(d, 0x33000000 | (26 << 16) | (T0 << 5) | T1);                       // BFI w1, w0, #6, #1
+    em_st32(d, T1, ST(astat));
+    em_dirty(d, 0);
+    em_bind(d, clean);
+}
+
+static void em_cnt_set(DYNA& d, int r)          { em_mov(d, R_CNT, r); }
+static void em_cnt_store(DYNA& d)               { em_st32(d, R_CNT, ST(cntr)); }
+static void em_cons_add(DYNA& d, uint32_t n)    { em_add_imm(d, R_CONS, n); }
+
+static uint32_t em_cnt_dec_jz(DYNA& d)
+{
+    em_sub_imm(d, R_CNT, 1);
+    return em_cbz(d, R_CNT);
+}
+
+static void em_limit_set(DYNA& d, uint32_t n)
+{
+    em_mov(d, R_LIMIT, R_BUDGET);
+    em_sub_imm(d, R_LIMIT, n);
+}
+
+static uint32_t em_limit_check(DYNA& d)
+{
+    em_cmp(d, R_CONS, R_LIMIT);
+    return em_branch(d, CC_GT);
+}
+
+static void em_limit_room(DYNA& d, int r)
+{
+    em_mov(d, r, R_LIMIT);
+    em_sub(d, r, R_CONS);
+}
+
+static void em_arg(DYNA& d, int n, int r)            { e32(d, 0xaa0003e0 | (r << 16) | n); }
+static void em_arg_imm(DYNA& d, int n, uint64_t v)   { a_imm(d, n, v, true); }
+
+// result lands in T0
+static void em_call(DYNA& d, const void* fn)
+{
+    a_imm(d, R_CALL, (uint64_t)(uintptr_t)fn, true);
+    e32(d, 0xd63f0000 | (R_CALL << 5));
+    em_mov(d, T0, 0);
+}
+
+static void em_prologue(DYNA& d)
+{
+    e32(d, 0xa9800000 | (((uint32_t)-12 & 0x7f) << 15) | (30 << 10) | (31 << 5) | 29);    // stp x29, x30, [sp, #-96]!
+    e32(d, 0x910003fd);                                                                     // mov x29, sp
+    for (int i = 0; i < 5; i++)
+        e32(d, 0xa9000000 | ((2 + 2 * i) << 15) | ((20 + 2 * i) << 10) | (31 << 5) | (19 + 2 * i));
+    em_mov(d, R_BUDGET, 0);
+    a_imm(d, R_STATE, (uint64_t)(uintptr_t)&adsp2100, true);
+    a_imm(d, R_CALL, (uint64_t)(uintptr_t)&dspDMem, true);
+    a_ldst(d, 0xf9400000, 3, R_DMEM, R_CALL, 0);
+    a_imm(d, R_CALL, (uint64_t)(uintptr_t)&dspPMem, true);
+    a_ldst(d, 0xf9400000, 3, R_PMEM, R_CALL, 0);
+    a_imm(d, R_CONS, 0, false);
+    em_dirty(d, 0);
+}
+
+// return R_CONS + T0
+static void em_epilogue(DYNA& d)
+{
+    e32(d, 0x0b000000 | (T0 << 16) | (R_CONS << 5) | 0);
+    for (int i = 4; i >= 0; i--)
+        e32(d, 0xa9400000 | ((2 + 2 * i) << 15) | ((20 + 2 * i) << 10) | (31 << 5) | (19 + 2 * i));
+    e32(d, 0xa8c00000 | (12 << 15) | (30 << 10) | (31 << 5) | 29);         // ldp x29, x30, [sp], #96
+    e32(d, 0xd65f03c0);
+}
+#endif // ADSP_DYNA_A64
+
+#if ADSP_DYNA_HOST
+// ---------------------- CLASSIFICATION ----------------------
+enum {
+    OP_NATIVE = 0,  // generated inline
+    OP_PURE,        // interpreter body, cannot touch PC, stacks or the slice
+    OP_STEP,        // whole interpreter step, the block may have to stop after it
+    OP_END          // control flow or mode change, the block ends here
+};
+
+static int dyna_max(int a, int b)
+{
+    return a > b ? a : b;
+}
+
+// group 0 destinations written inline (SE sign-extends from 8 bits, MR0-2 live in the accumulator)
+static bool dyna_dreg_native(uint32_t reg)
+{
+    return reg != 9 && (reg < 11 || reg > 13);
+}
+
+// MR result, any X * Y (SS/SU/US/UU) form without rounding
+static bool dyna_native_mac(uint32_t op, uint32_t unit)
+{
+    return unit == ADSP_UNIT_MAC_MR && ((op >> 13) & 15) >= 4;
+}
+
+// MR = MR +/- MXn * MYn (SS), MXn = DM(I,M), MYn = PM(I,M): as the only word of
+// a DO loop this is a dot product, run by adsp2100_dyna_mac_loop
+static bool dyna_mac_form(const ADSPUOP* u)
+{
+    uint32_t op = u->op;
+    uint32_t amf = (op >> 13) & 15;
+    uint32_t xop = (op >> 8) & 7;
+    uint32_t yop = (op >> 11) & 3;
+
+    if (u->kind != ADSP_UOP_DUAL_READ || u->unit != ADSP_UNIT_MAC_MR || (amf != 0x08 && amf != 0x0c))
+        return false;
+    return xop < 2 && yop < 2 && ((op >> 18) & 3) == 2 + xop && ((op >> 20) & 3) == 2 + yop;
+}
+
+static int dyna_reg_write(uint32_t grp, uint32_t reg)
+{
+    if (grp < 3)
+        return OP_PURE;
+    switch (reg)
+    {
+        case 1:  return OP_END;     // MSTAT: bank or modes change under the block
+        case 3: case 4: case 5: case 9: case 11: case 12: case 13: case 15:
+            return OP_STEP;         // IMASK/ICNTL/IFC may take an interrupt, CNTR, TX, stacks
+        default: return OP_PURE;
+    }
+}
+
+static int dyna_reg_read(uint32_t grp, uint32_t reg)
+{
+    if (grp == 3 && (reg == 8 || reg == 10 || reg == 15))
+        return OP_STEP;             // RX callbacks, PC stack pop
+    return OP_PURE;
+}
+
+static int dyna_classify(const ADSPUOP* u, uint32_t mstat, bool* loopsafe)
+{
+    uint32_t op = u->op;
+    bool reverse = (mstat & MSTAT_REVERSE) != 0;
+    bool cntr = false;
+    int cls;
+
+    switch (u->kind)
+    {
+        case ADSP_UOP_NOP:
+        case ADSP_UOP_MODIFY:
+            cls = OP_NATIVE;
+            break;
+
+        case ADSP_UOP_COMPUTE:
+            cls = dyna_native_mac(op, u->unit) ? OP_NATIVE : OP_PURE;
+            break;
+
+        case ADSP_UOP_COMPUTE_COND:
+        case ADSP_UOP_SHIFT_COND:
+            cls = ((op & 15) == 14) ? OP_STEP : OP_PURE;
+            break;
+
+        case ADSP_UOP_SATMR:
+        case ADSP_UOP_DIVS:
+        case ADSP_UOP_DIVQ:
+        case ADSP_UOP_SHIFT_IMM:
+        case ADSP_UOP_COMPUTE_MOVE:
+        case ADSP_UOP_SHIFT_MOVE:
+            cls = OP_PURE;
+            break;
+
+        case ADSP_UOP_MOVE:
+            cls = dyna_max(dyna_reg_read((op >> 8) & 3, op & 15), dyna_reg_write((op >> 10) & 3, (op >> 4) & 15));
+            cntr = ((op >> 8) & 3) == 3 && (op & 15) == 5;
+            break;
+
+        case ADSP_UOP_LOAD_REG:
+            cls = dyna_reg_write((op >> 18) & 3, op & 15);
+            break;
+
+        case ADSP_UOP_LOAD_DREG:
+            cls = dyna_dreg_native(op & 15) ? OP_NATIVE : OP_PURE;
+            break;
+
+        case ADSP_UOP_READ_DM:
+            if (((op >> 18) & 3) == 0 && dyna_dreg_native(op & 15))
+                cls = OP_NATIVE;
+            else
+                cls = dyna_reg_write((op >> 18) & 3, op & 15);
+            break;
+
+        case ADSP_UOP_WRITE_DM:
+            if ((u->arg & 0x3fff) >= 0x3fe0)
+                cls = OP_STEP;      // on-chip control registers
+            else
+                cls = ((op >> 18) & 3) ? dyna_reg_read((op >> 18) & 3, op & 15) : OP_NATIVE;
+            cntr = ((op >> 18) & 3) == 3 && (op & 15) == 5;
+            break;
+
+        case ADSP_UOP_COMPUTE_DM1_RD:
+            cls = (!reverse && dyna_dreg_native((op >> 4) & 15)) ? OP_NATIVE : OP_PURE;
+            break;
+
+        case ADSP_UOP_COMPUTE_DM2_RD:
+        case ADSP_UOP_COMPUTE_PGM_RD:
+            cls = dyna_dreg_native((op >> 4) & 15) ? OP_NATIVE : OP_PURE;
+            break;
+
+        case ADSP_UOP_COMPUTE_DM1_WR:
+        case ADSP_UOP_STORE_DM1:
+            cls = reverse ? OP_STEP : OP_NATIVE;
+            break;
+
+        case ADSP_UOP_COMPUTE_DM2_WR:
+        case ADSP_UOP_STORE_DM2:
+            cls = OP_NATIVE;
+            break;
+
+        case ADSP_UOP_SHIFT_DM1:
+            if (op & 0x008000)
+                cls = reverse ? OP_STEP : OP_NATIVE;
+            else
+                cls = (!reverse && dyna_dreg_native((op >> 4) & 15)) ? OP_NATIVE : OP_PURE;
+            break;
+
+        case ADSP_UOP_SHIFT_DM2:
+            if (op & 0x008000)
+                cls = OP_NATIVE;
+            else
+                cls = dyna_dreg_native((op >> 4) & 15) ? OP_NATIVE : OP_PURE;
+            break;
+
+        case ADSP_UOP_SHIFT_PGM:
+            if (op & 0x008000)
+                cls = OP_END;       // program memory write
+            else
+                cls = dyna_dreg_native((op >> 4) & 15) ? OP_NATIVE : OP_PURE;
+            break;
+
+        case ADSP_UOP_DUAL_READ:
+            cls = reverse ? OP_PURE : OP_NATIVE;
+            break;
+
+        case ADSP_UOP_DO:
+            cls = OP_STEP;
+            break;
+
+        default:
+            cls = OP_END;           // jumps, calls, returns, IDLE, MODE, stack ops, PM writes
+            break;
+    }
+
+    if (loopsafe)
+        *loopsafe = cls <= OP_PURE && !cntr;
+    return cls;
+}
+
+static bool dyna_shift_form(const ADSPUOP* u)
+{
+    return u->kind == ADSP_UOP_SHIFT_DM1 || u->kind == ADSP_UOP_SHIFT_DM2 || u->kind == ADSP_UOP_SHIFT_PGM;
+}
+
+// instruction keeps MR in the accumulator when compiled
+static bool dyna_uses_acc(const ADSPUOP* u, uint32_t mstat)
+{
+    return dyna_classify(u, mstat, nullptr) == OP_NATIVE && !dyna_shift_form(u) && dyna_native_mac(u->op, u->unit);
+}
+
+// ---------------------- CODE GENERATION ----------------------
+static DYNASTUB* dyna_stub(DYNA& d, int kind, uint32_t patch)
+{
+    if (d.nstubs >= ADSP_DYNA_MAX_STUBS)
+    {
+        d.full = true;
+        d.nstubs = 0;
+    }
+    DYNASTUB* s = &d.stubs[d.nstubs++];
+    memset(s, 0, sizeof(*s));
+    s->kind = kind;
+    s->patch[s->npatch++] = patch;
+    s->acc = d.acc;
+    return s;
+}
+
+static void dyna_stub_exit(DYNA& d, uint32_t patch, uint32_t pc, uint32_t stat, int flags)
+{
+    DYNASTUB* s = dyna_stub(d, STUB_EXIT, patch);
+    s->exit.pc = pc;
+    s->exit.stat = stat;
+    s->exit.flags = flags;
+}
+
+static void dyna_exit(DYNA& d, const DYNAEXIT& x)
+{
+    if ((x.flags & EXIT_FLUSH) && d.acc)
+        em_acc_sync(d);
+    if (x.flags & EXIT_PC)
+    {
+        em_mov_imm(d, T0, x.pc);
+        em_st32(d, T0, ST(pc));
+    }
+    if (x.flags & EXIT_CNTR)
+        em_cnt_store(d);
+    em_mov_imm(d, T0, x.stat);
+    em_epilogue(d);
+}
+
+static void dyna_call_exec(DYNA& d, const void* fn, const ADSPUOP* u, int args)
+{
+    if (d.acc)
+        em_acc_sync(d);
+    if (args > 0)
+        em_arg_imm(d, 0, args == 1 && !u ? 0 : (uint64_t)(uintptr_t)u);
+    em_call(d, fn);
+    if (d.acc)
+        em_acc_load(d);
+}
+
+// ALU/shifter half of an instruction through the interpreter
+static void dyna_compute_call(DYNA& d, const ADSPUOP* u)
+{
+    if (d.acc)
+        em_acc_sync(d);
+    em_arg_imm(d, 0, u->op);
+    if (dyna_shift_form(u))
+        em_call(d, (const void*)&adsp2100_dyna_shift);
+    else
+    {
+        em_arg_imm(d, 1, u->unit);
+        em_call(d, (const void*)&adsp2100_dyna_compute);
+    }
+    if (d.acc)
+        em_acc_load(d);
+}
+
+// X * Y with the product in 32 bits as the interpreter has it, MR in the accumulator
+static void dyna_mac(DYNA& d, uint32_t op)
+{
+    uint32_t amf = (op >> 13) & 15;
+    uint32_t x = (op >> 8) & 7;
+    uint32_t y = (op >> 11) & 3;
+
+    if (x >= 3 && x <= 5 && d.acc)
+        em_acc_sync(d);
+    if (amf & 2) em_ld16u(d, T0, d.core + dyna_mac_x[x]);
+    else         em_ld16s(d, T0, d.core + dyna_mac_x[x]);
+    if (amf & 1) em_ld16u(d, T1, d.core + dyna_mac_y[y]);
+    else         em_ld16s(d, T1, d.core + dyna_mac_y[y]);
+    em_mul(d, T0, T1);
+    if (!(d.mstat & MSTAT_INTEGER))
+        em_shl(d, T0, 1);
+
+    if ((amf >> 2) == 1)
+        em_acc_set(d, T0);
+    else
+    {
+        if (!d.acc)
+            em_acc_load(d);
+        em_acc_add(d, T0, (amf >> 2) == 3);
+    }
+    d.acc = true;
+    em_dirty(d, 1);
+}
+
+static void dyna_compute(DYNA& d, const ADSPUOP* u)
+{
+    if (dyna_shift_form(u) || (u->unit != ADSP_UNIT_NONE && !dyna_native_mac(u->op, u->unit)))
+        dyna_compute_call(d, u);
+    else if (u->unit != ADSP_UNIT_NONE)
+        dyna_mac(d, u->op);
+}
+
+// group 0 register into r; MR0-2 come from memory after a sync
+static void dyna_dreg_load(DYNA& d, int r, uint32_t reg)
+{
+    if (reg >= 11 && reg <= 13 && d.acc)
+        em_acc_sync(d);
+    em_ld16u(d, r, d.core + dyna_dreg[reg]);
+}
+
+// I += M with the circular buffer wrap (T3-T5)
+static void dyna_dag_modify(DYNA& d, uint32_t ireg, uint32_t mreg)
+{
+    em_ld32(d, T3, ST_I(ireg));
+    em_ld32(d, T4, ST_M(mreg));
+    em_add(d, T3, T4);
+    em_ld32(d, T4, ST_BASE(ireg));
+    em_ld32(d, T5, ST_L(ireg));
+    em_cmp(d, T3, T4);
+    uint32_t under = em_branch(d, CC_LO);
+    em_add(d, T4, T5);
+    em_cmp(d, T3, T4);
+    uint32_t inside = em_branch(d, CC_LO);
+    em_sub(d, T3, T5);
+    uint32_t over = em_branch(d, CC_AL);
+    em_bind(d, under);
+    em_add(d, T3, T5);
+    em_bind(d, inside);
+    em_bind(d, over);
+    em_st32(d, T3, ST_I(ireg));
+}
+
+// T0 = DM(I, M); the board window 0x2000-0x37ff goes through the interpreter
+static void dyna_dag_read(DYNA& d, uint32_t ireg, uint32_t mreg)
+{
+    em_ld32(d, T1, ST_I(ireg));
+    em_and_imm(d, T1, 0x3fff);
+    dyna_dag_modify(d, ireg, mreg);
+    em_mov(d, T3, T1);
+    em_sub_imm(d, T3, 0x2000);
+    em_cmp_imm(d, T3, 0x1800);
+    DYNASTUB* s = dyna_stub(d, STUB_READ, em_branch(d, CC_LO));
+    em_ld_dm(d, T0, T1);
+    s->back = d.pos;
+}
+
+// DM(I, M) = T2; board and control register writes go through the interpreter,
+// which may end the slice after the rest of the instruction
+static void dyna_dag_write(DYNA& d, const ADSPUOP* u, uint32_t ireg, uint32_t mreg, const DYNAEXIT& x)
+{
+    em_ld32(d, T1, ST_I(ireg));
+    em_and_imm(d, T1, 0x3fff);
+    dyna_dag_modify(d, ireg, mreg);
+    em_mov(d, T3, T1);
+    em_sub_imm(d, T3, 0x2000);
+    em_cmp_imm(d, T3, 0x1800);
+    DYNASTUB* s = dyna_stub(d, STUB_WRITE, em_branch(d, CC_LO));
+    em_cmp_imm(d, T1, 0x3fe0);
+    s->patch[s->npatch++] = em_branch(d, CC_HS);
+    em_st_dm(d, T2, T1);
+    s->back = d.pos;
+    s->u = u;
+    s->exit = x;
+}
+
+// T0 = PM(I, M) >> 8, PX = low byte
+static void dyna_pgm_read(DYNA& d, uint32_t ireg, uint32_t mreg)
+{
+    em_ld32(d, T1, ST_I(ireg));
+    dyna_dag_modify(d, ireg, mreg);
+    em_ld_pm(d, T0, T1);
+    em_st32(d, T0, ST(px));
+    em_shr(d, T0, 8);
+}
+
+static void dyna_step(DYNA& d, uint32_t addr, const DYNAEXIT& x, bool end)
+{
+    if (d.acc)
+        em_acc_sync(d);
+    em_mov_imm(d, T0, addr);
+    em_st32(d, T0, ST(pc));
+    em_call(d, (const void*)&adsp2100_dyna_step);
+    if (end)
+    {
+        DYNAEXIT done = { 0, x.stat, 0 };
+        dyna_exit(d, done);
+        return;
+    }
+    em_cmp_imm(d, T0, 0);
+    dyna_stub_exit(d, em_branch(d, CC_NE), 0, x.stat, 0);
+    if (d.acc)
+        em_acc_load(d);
+}
+
+static void dyna_op(DYNA& d, uint32_t addr, const DYNAEXIT& x)
+{
+    const ADSPUOP* u = &adsp2100_pcode[addr];
+    uint32_t op = u->op;
+    int cls = dyna_classify(u, d.mstat, nullptr);
+
+    if (cls == OP_PURE)
+    {
+        dyna_call_exec(d, (const void*)&adsp2100_dyna_exec, u, 1);
+        return;
+    }
+    if (cls != OP_NATIVE)
+    {
+        dyna_step(d, addr, x, cls == OP_END);
+        return;
+    }
+
+    switch (u->kind)
+    {
+        case ADSP_UOP_NOP:
+            break;
+
+        case ADSP_UOP_COMPUTE:
+            dyna_mac(d, op);
+            break;
+
+        case ADSP_UOP_MODIFY:
+        {
+            uint32_t g = (op >> 2) & 4;
+            dyna_dag_modify(d, g + ((op >> 2) & 3), g + (op & 3));
+            break;
+        }
+
+        case ADSP_UOP_LOAD_DREG:
+            em_mov_imm(d, T0, (uint32_t)(int32_t)(int16_t)u->arg);
+            em_st16(d, T0, d.core + dyna_dreg[op & 15]);
+            break;
+
+        case ADSP_UOP_READ_DM:
+        {
+            uint32_t a = u->arg & 0x3fff;
+            if (a - 0x2000 < 0x1800)
+            {
+                em_arg_imm(d, 0, a);
+                em_call(d, (const void*)&adsp2100_dyna_read);
+            }
+            else
+                em_ld_dm_abs(d, T0, a);
+            em_st16(d, T0, d.core + dyna_dreg[op & 15]);
+            break;
+        }
+
+        case ADSP_UOP_WRITE_DM:
+        {
+            uint32_t a = u->arg & 0x3fff;
+            dyna_dreg_load(d, T2, op & 15);
+            if (a - 0x2000 < 0x1800)
+            {
+                em_arg_imm(d, 0, a);
+                em_arg(d, 1, T2);
+                em_call(d, (const void*)&adsp2100_dyna_write);
+            }
+            else
+                em_st_dm_abs(d, T2, a);
+            break;
+        }
+
+        case ADSP_UOP_COMPUTE_DM1_RD:
+        case ADSP_UOP_COMPUTE_DM2_RD:
+        case ADSP_UOP_SHIFT_DM1:
+        case ADSP_UOP_SHIFT_DM2:
+        case ADSP_UOP_COMPUTE_DM1_WR:
+        case ADSP_UOP_COMPUTE_DM2_WR:
+        {
+            uint32_t g = (u->kind == ADSP_UOP_COMPUTE_DM2_RD || u->kind == ADSP_UOP_COMPUTE_DM2_WR || u->kind == ADSP_UOP_SHIFT_DM2) ? 4 : 0;
+            bool write = (u->kind == ADSP_UOP_COMPUTE_DM1_WR || u->kind == ADSP_UOP_COMPUTE_DM2_WR) ||
+                         (dyna_shift_form(u) && (op & 0x008000));
+            if (write)
+            {
+                dyna_dreg_load(d, T2, (op >> 4) & 15);
+                dyna_dag_write(d, u, g + ((op >> 2) & 3), g + (op & 3), x);
+                dyna_compute(d, u);
+            }
+            else
+            {
+                dyna_compute(d, u);
+                dyna_dag_read(d, g + ((op >> 2) & 3), g + (op & 3));
+                em_st16(d, T0, d.core + dyna_dreg[(op >> 4) & 15]);
+            }
+            break;
+        }
+
+        case ADSP_UOP_STORE_DM1:
+        case ADSP_UOP_STORE_DM2:
+        {
+            uint32_t g = (u->kind == ADSP_UOP_STORE_DM2) ? 4 : 0;
+            em_mov_imm(d, T2, u->arg);
+            dyna_dag_write(d, u, g + ((op >> 2) & 3), g + (op & 3), x);
+            break;
+        }
+
+        case ADSP_UOP_COMPUTE_PGM_RD:
+        case ADSP_UOP_SHIFT_PGM:
+            dyna_compute(d, u);
+            dyna_pgm_read(d, 4 + ((op >> 2) & 3), 4 + (op & 3));
+            em_st16(d, T0, d.core + dyna_dreg[(op >> 4) & 15]);
+            break;
+
+        case ADSP_UOP_DUAL_READ:
+            dyna_compute(d, u);
+            dyna_dag_read(d, (op >> 2) & 3, op & 3);
+            em_st16(d, T0, d.core + dyna_dreg[(op >> 18) & 3]);
+            dyna_pgm_read(d, 4 + ((op >> 6) & 3), 4 + ((op >> 4) & 3));
+            em_st16(d, T0, d.core + dyna_dreg[4 + ((op >> 20) & 3)]);
+            break;
+    }
+}
+
+static void dyna_stubs(DYNA& d)
+{
+    for (int n = 0; n < d.nstubs && !d.full; n++)
+    {
+        DYNASTUB* s = &d.stubs[n];
+        for (int p = 0; p < s->npatch; p++)
+            em_bind(d, s->patch[p]);
+        d.acc = s->acc;
+
+        switch (s->kind)
+        {
+            case STUB_EXIT:
+                dyna_exit(d, s->exit);
+                break;
+
+            case STUB_READ:
+                em_arg(d, 0, T1);
+                em_call(d, (const void*)&adsp2100_dyna_read);
+                em_jump_to(d, CC_AL, s->back);
+                break;
+
+            case STUB_WRITE:
+            {
+                em_arg(d, 0, T1);
+                em_arg(d, 1, T2);
+                em_call(d, (const void*)&adsp2100_dyna_write);
+                em_cmp_imm(d, T0, 0);
+                em_jump_to(d, CC_EQ, s->back);
+
+                // slice ends: finish the instruction in the interpreter and leave
+                DYNAEXIT x = s->exit;
+                if (d.acc)
+                    em_acc_sync(d);
+                d.acc = false;
+                if (s->u->unit != ADSP_UNIT_NONE || dyna_shift_form(s->u))
+                    dyna_compute_call(d, s->u);
+                x.flags &= ~EXIT_FLUSH;
+                dyna_exit(d, x);
+                break;
+            }
+        }
+    }
+}
+
+// DO ... UNTIL CE at addr whose body can run without leaving the block
+static bool dyna_native_loop(uint32_t addr, uint32_t mstat)
+{
+    const ADSPUOP* u = &adsp2100_pcode[addr];
+    uint32_t end = u->arg;
+
+    if ((u->op & 15) != 14 || end <= addr || end - addr > ADSP_DYNA_MAX_LOOP || end >= ADSP_PMEM_WORDS)
+        return false;
+    for (uint32_t a = addr + 1; a <= end; a++)
+    {
+        bool safe;
+        if (a != end && dyna_loopend[a])
+            return false;
+        if (adsp2100_pcode[a].kind == ADSP_UOP_DO || dyna_classify(&adsp2100_pcode[a], mstat, &safe) > OP_PURE || !safe)
+            return false;
+    }
+    return true;
+}
+
+struct DYNAITEM {
+    uint16_t addr;
+    bool     loop;
+    int      cls;
+};
+
+static void dyna_loop(DYNA& d, uint32_t addr, uint32_t stat, uint32_t length)
+{
+    uint32_t end = adsp2100_pcode[addr].arg;
+    uint32_t len = end - addr;
+    DYNAEXIT x = { addr + 1, stat, EXIT_PC | EXIT_FLUSH };
+
+    // the DO itself pushes the stacks; the loop runs here only if it became the innermost one
+    dyna_step(d, addr, x, false);
+    em_arg_imm(d, 0, end);
+    em_call(d, (const void*)&adsp2100_dyna_do);
+    em_cmp_imm(d, T0, 0);
+    dyna_stub_exit(d, em_branch(d, CC_EQ), 0, stat, EXIT_FLUSH);
+    em_cnt_set(d, T0);
+    em_limit_set(d, length + len);
+
+    bool mac = false;
+    for (uint32_t a = addr + 1; a <= end; a++)
+        mac |= dyna_uses_acc(&adsp2100_pcode[a], d.mstat);
+    if (mac && !d.acc)
+    {
+        em_acc_load(d);
+        d.acc = true;
+    }
+
+    // passes but the last in one go, as far as the budget goes
+    if (len == 1 && dyna_mac_form(&adsp2100_pcode[end]))
+    {
+        if (d.acc)
+            em_acc_sync(d);
+        em_cnt_store(d);
+        em_limit_room(d, T1);
+        em_arg(d, 1, T1);
+        em_arg_imm(d, 0, (uint64_t)(uintptr_t)&adsp2100_pcode[end]);
+        em_call(d, (const void*)&adsp2100_dyna_mac_loop);
+        em_add(d, R_CONS, T0);
+        em_ld32(d, R_CNT, ST(cntr));
+        if (d.acc)
+            em_acc_load(d);
+    }
+
+    // out of budget: stop at the top of the next pass
+    uint32_t top = d.pos;
+    dyna_stub_exit(d, em_limit_check(d), addr + 1, stat, EXIT_PC | EXIT_CNTR | EXIT_FLUSH);
+
+    for (uint32_t a = addr + 1; a < end; a++)
+    {
+        DYNAEXIT body = { a + 1, stat + (a - addr), EXIT_PC | EXIT_CNTR | EXIT_FLUSH };
+        dyna_op(d, a, body);
+    }
+
+    // the last word runs after the PC has gone back to the top or past the loop
+    em_cons_add(d, len);
+    uint32_t expired = em_cnt_dec_jz(d);
+    DYNAEXIT again = { addr + 1, stat, EXIT_PC | EXIT_CNTR | EXIT_FLUSH };
+    dyna_op(d, end, again);
+    em_jump_to(d, CC_AL, top);
+
+    em_bind(d, expired);
+    em_call(d, (const void*)&adsp2100_dyna_loop_exit);
+    DYNAEXIT last = { end + 1, stat, EXIT_PC | EXIT_FLUSH };
+    dyna_op(d, end, last);
+}
+
+static bool dyna_build(DYNA& d, ADSPDYNABLOCK* block, uint32_t start)
+{
+    static DYNAITEM items[ADSP_DYNA_MAX_OPS];
+    int count = 0;
+    uint32_t addr = start;
+
+    while (addr < ADSP_PMEM_WORDS && count < ADSP_DYNA_MAX_OPS && !dyna_loopend[addr])
+    {
+        DYNAITEM* it = &items[count++];
+        it->addr = addr;
+        it->cls = dyna_classify(&adsp2100_pcode[addr], d.mstat, nullptr);
+        it->loop = adsp2100_pcode[addr].kind == ADSP_UOP_DO && dyna_native_loop(addr, d.mstat);
+        if (it->loop)
+        {
+            addr = adsp2100_pcode[addr].arg + 1;
+            continue;
+        }
+        addr++;
+        if (it->cls == OP_END)
+            break;
+    }
+
+    // nothing gained by a block that starts with an interpreter step
+    if (!count || (items[0].cls >= OP_STEP && !items[0].loop))
+        return false;
+
+    em_prologue(d);
+    d.acc = false;
+
+    uint32_t stat = 0;
+    for (int n = 0; n < count; n++)
+    {
+        DYNAITEM* it = &items[n];
+        stat++;
+        if (it->loop)
+            dyna_loop(d, it->addr, stat, count);
+        else
+        {
+            DYNAEXIT x = { (uint32_t)it->addr + 1, stat, EXIT_PC | EXIT_FLUSH };
+            dyna_op(d, it->addr, x);
+        }
+    }
+
+    if (items[count - 1].cls != OP_END || items[count - 1].loop)
+    {
+        DYNAEXIT x = { addr, stat, EXIT_PC | EXIT_FLUSH };
+        dyna_exit(d, x);
+    }
+    dyna_stubs(d);
+
+    block->length = count;
+    if (d.full)
+        return false;
+    memset(dyna_covered + start, 1, addr - start);
+    return true;
+}
+
+// ---------------------- CODE CACHE ----------------------
+static bool dyna_alloc()
+{
+#if defined(__SWITCH__)
+    if (R_FAILED(jitCreate(&dyna_jit, ADSP_DYNA_CODE_SIZE)))
+        return false;
+    dyna_rw = (uint8_t*)jitGetRwAddr(&dyna_jit);
+    dyna_rx = (uint8_t*)jitGetRxAddr(&dyna_jit);
+    return true;
+#elif defined(__unix__) || defined(__APPLE__)
+    void* p = mmap(nullptr, ADSP_DYNA_CODE_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED)
+        return false;
+    dyna_rw = dyna_rx = (uint8_t*)p;
+    return true;
+#else
+    return false;
+#endif
+}
+
+static void dyna_free()
+{
+#if defined(__SWITCH__)
+    jitClose(&dyna_jit);
+#elif defined(__unix__) || defined(__APPLE__)
+    munmap(dyna_rw, ADSP_DYNA_CODE_SIZE);
+#endif
+    dyna_rw = dyna_rx = nullptr;
+}
+
+// drop every block and rebuild the loop end map from the current program
+static void dyna_reset()
+{
+    memset(dyna_blocks, 0, sizeof(dyna_blocks));
+    memset(dyna_loopend, 0, sizeof(dyna_loopend));
+    memset(dyna_covered, 0, sizeof(dyna_covered));
+    dyna_used = 0;
+
+    for (uint32_t addr = 0; addr < ADSP_PMEM_WORDS; addr++)
+        if (adsp2100_pcode[addr].kind == ADSP_UOP_DO && adsp2100_pcode[addr].arg < ADSP_PMEM_WORDS)
+            dyna_loopend[adsp2100_pcode[addr].arg] = 1;
+    for (int n = 0; n < adsp2100.loop_sp; n++)
+        dyna_loopend[(adsp2100.loop_stack[n] >> 4) & (ADSP_PMEM_WORDS - 1)] = 1;
+
+    dyna_flush = false;
+}
+
+static void dyna_compile(ADSPDYNABLOCK* block, uint32_t pc, uint32_t key)
+{
+    static DYNA d;
+
+    if (dyna_used + ADSP_DYNA_ROOM > ADSP_DYNA_CODE_SIZE)
+    {
+        memset(dyna_blocks, 0, sizeof(dyna_blocks));
+        memset(dyna_covered, 0, sizeof(dyna_covered));
+        dyna_used = 0;
+    }
+
+#if defined(__SWITCH__)
+    jitTransitionToWritable(&dyna_jit);
+#endif
+    d.code = dyna_rw + dyna_used;
+    d.pos = 0;
+    d.size = ADSP_DYNA_ROOM;
+    d.full = false;
+    d.mstat = key;
+    d.core = ST(r) + (key & MSTAT_BANK) * sizeof(ADSPCORE);
+    d.nstubs = 0;
+
+    block->key = key;
+    if (dyna_build(d, block, pc))
+    {
+        block->code = (ADSPBLOCKFN)(void*)(dyna_rx + dyna_used);
+        block->state = ADSP_DYNA_COMPILED;
+#if !defined(__SWITCH__) && defined(__aarch64__)
+        __builtin___clear_cache((char*)dyna_rx + dyna_used, (char*)dyna_rx + dyna_used + d.pos);
+#endif
+        dyna_used += (d.pos + 15) & ~15;
+    }
+    else
+    {
+        block->code = nullptr;
+        block->state = ADSP_DYNA_INTERPRET;
+    }
+#if defined(__SWITCH__)
+    jitTransitionToExecutable(&dyna_jit);
+#endif
+}
+#endif // ADSP_DYNA_HOST
+
+// ---------------------- API ----------------------
+bool adsp2100_dyna_init()
+{
+    if (dyna_ready)
+        return true;
+#if ADSP_DYNA_HOST
+    if (dyna_alloc())
+    {
+        dyna_ready = true;
+        dyna_flush = true;
+        return true;
+    }
+    printf("ADSP dyna: no executable memory, running the interpreter\n");
+#endif
+    adsp2100_dyna_enabled = false;
+    return false;
+}
+
+void adsp2100_dyna_exit()
+{
+#if ADSP_DYNA_HOST
+    if (dyna_ready)
+        dyna_free();
+#endif
+    dyna_ready = false;
+    dyna_flush = true;
+}
+
+// program memory reloaded: everything is recompiled lazily
+void adsp2100_dyna_invalidate()
+{
+    dyna_flush = true;
+}
+
+// one program word changed (PM write); tables kept in program memory do not cost
+// a flush unless a block covers them or a loop end moved
+void adsp2100_dyna_modified(uint32_t addr, bool loop)
+{
+    if (loop || dyna_covered[addr])
+        dyna_flush = true;
+}
+
+const ADSPDYNABLOCK* adsp2100_dyna_lookup(uint32_t pc, uint32_t mstat)
+{
+#if ADSP_DYNA_HOST
+    if (!dyna_ready && !adsp2100_dyna_init())
+        return nullptr;
+    if (dyna_flush)
+        dyna_reset();
+    if (pc >= ADSP_PMEM_WORDS || dyna_loopend[pc])
+        return nullptr;
+
+    ADSPDYNABLOCK* block = &dyna_blocks[pc];
+    uint32_t key = mstat & ADSP_DYNA_KEY_MASK;
+    if (block->state == ADSP_DYNA_EMPTY || block->key != key)
+        dyna_compile(block, pc, key);
+    return block->state == ADSP_DYNA_COMPILED ? block : nullptr;
+#else
+    return nullptr;
+#endif
+}
@@ -0,0 +1,48 @@
+#ifndef _ADSP2100_DYNA_H
+#define _ADSP2100_DYNA_H
+
+#include <cstdint>
+#include "adsp2100.h"
+
+// Compiled straight-line run of the sound program; takes the cycles left in the
+// slice and returns the number of instructions it executed.
+typedef int (*ADSPBLOCKFN)(int budget);
+
+struct ADSPDYNABLOCK {
+    ADSPBLOCKFN code;
+    uint16_t    length;     // instructions outside native DO loops, must fit the budget
+    uint8_t     key;        // MSTAT mode bits the block was compiled for
+    uint8_t     state;      // ADSP_DYNA_* below
+};
+
+enum {
+    ADSP_DYNA_EMPTY = 0,
+    ADSP_DYNA_COMPILED,
+    ADSP_DYNA_INTERPRET     // not worth compiling, leave this address to the interpreter
+};
+
+// MSTAT bits baked into compiled code: register bank, DAG1 bit reverse, MAC placement
+#define ADSP_DYNA_KEY_MASK  0x13
+
+extern bool adsp2100_dyna_enabled;  // off on hosts without a code generator, and for now on A64
+extern bool adsp2100_dyna_check;    // replay every block on the interpreter and compare
+extern int  adsp2100_dyna_mismatches;
+
+extern bool adsp2100_dyna_init();
+extern void adsp2100_dyna_exit();
+extern void adsp2100_dyna_invalidate();
+extern void adsp2100_dyna_modified(uint32_t addr, bool loop);
+extern const ADSPDYNABLOCK* adsp2100_dyna_lookup(uint32_t pc, uint32_t mstat);
+
+// Interpreter entry points called from compiled code (adsp2100.cpp)
+extern int      adsp2100_dyna_step();
+extern void     adsp2100_dyna_exec(const ADSPUOP* u);
+extern void     adsp2100_dyna_compute(uint32_t op, uint32_t unit);
+extern void     adsp2100_dyna_shift(uint32_t op);
+extern uint32_t adsp2100_dyna_read(uint32_t addr);
+extern int      adsp2100_dyna_write(uint32_t addr, uint32_t data);
+extern uint32_t adsp2100_dyna_do(uint32_t end);
+extern uint32_t adsp2100_dyna_mac_loop(const ADSPUOP* u, int32_t room);
+extern void     adsp2100_dyna_loop_exit();
+
+#endif // _ADSP2100_DYNA_H
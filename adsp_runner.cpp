@@ -0,0 +1,134 @@
+// ADSP-2105 core check: DO UNTIL loop termination, interpreted and compiled, and the SPORT1 autobuffer
+
+#ifdef __SWITCH__
+#include <switch.h>
+#endif
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include "adsp2100.h"
+#include "adsp2100_dyna.h"
+#include "hleDSP.h"
+#include "iState.h"
+
+extern "C" unsigned int dasm2100(char* buffer, unsigned int op);
+
+static uint32_t pmem[ADSP_PMEM_WORDS];
+static uint16_t dmem[ADSP_DMEM_WORDS];
+uint32_t* dspPMem = pmem;
+uint16_t* dspDMem = dmem;
+
+// nothing on the board side
+uint16_t hleDSPRead(uint16_t) { return 0; }
+void hleDSPWrite(uint16_t, uint16_t) {}
+void iStateWrite(STATESTREAM*, const void*, size_t) {}
+void iStateRead(STATESTREAM*, void*, size_t) {}
+
+// AR counted from a start by AY0 until the loop closes, then JUMP to itself.
+// The termination is tested as the last word of the loop starts, on the
+// status the word before it left, so the bodies end in a NOP
+struct LOOPTEST {
+    const char* until;
+    int         words;
+    uint32_t    program[8];
+    int32_t     ar;         // AR once it has
+};
+
+static const LOOPTEST tests[] = {
+    // AR = -1, AY0 = 1, DO UNTIL NE: AR = AR + AY0; two passes, 0 then 1
+    { "NE", 6, { 0x4ffffa, 0x400014, 0x140040, 0x22620f, 0x000000, 0x18005f }, 1 },
+    // AR = 3, AY0 = 1, DO UNTIL EQ: AR = AR - AY0; three passes
+    { "EQ", 6, { 0x40003a, 0x400014, 0x140041, 0x22e20f, 0x000000, 0x18005f }, 0 },
+    // AR = -3, AY0 = 1, DO UNTIL GE: AR = AR + AY0; three passes
+    { "GE", 6, { 0x4fffda, 0x400014, 0x140044, 0x22620f, 0x000000, 0x18005f }, 0 },
+    // CNTR = 5, AR = 0, AY0 = 1, DO UNTIL CE: AR = AR + AY0; five passes
+    { "CE", 7, { 0x3c0055, 0x40000a, 0x400014, 0x14005e, 0x22620f, 0x000000, 0x18006f }, 5 },
+};
+
+// AX0 = $0302 (autobuffer on I1, M2), DM($3FEF) = AX0, then JUMP to itself
+static const uint32_t autobuffer[] = { 0x403020, 0x93fef0, 0x18002f };
+
+static int16_t  sent[64];
+static uint32_t sentCount, sentCalls;
+
+static void autobufferSent(uint32_t, const int16_t* samples, uint32_t count)
+{
+    for (uint32_t n = 0; n < count && sentCount < 64; n++)
+        sent[sentCount++] = samples[n];
+    sentCalls++;
+}
+
+int main()
+{
+#ifdef __SWITCH__
+    consoleInit(NULL);
+#endif
+    int wrong = 0, runs = 0;
+    for (int compiled = 0; compiled < 2; compiled++)
+    {
+        if (compiled && !adsp2100_dyna_init())
+            break;
+        for (const LOOPTEST& t : tests)
+        {
+            char text[256];
+            bool listed = false;
+            memset(pmem, 0, sizeof(pmem));
+            for (int i = 0; i < t.words; i++)
+            {
+                pmem[i] = t.program[i];
+                dasm2100(text, t.program[i]);
+                if (!compiled)
+                    printf("  %04X: %06X  %s\n", i, t.program[i], text);
+                if (strstr(text, "UNTIL") && strstr(text, t.until))
+                    listed = true;
+            }
+
+            adsp2100_reset(nullptr);
+            adsp2100_dyna_enabled = compiled;
+            adsp2100_dyna_check = compiled;     // every block against the interpreter as well
+            adsp2100_dyna_invalidate();
+            adsp2100_predecode();
+            adsp2100_execute(200);
+            int32_t ar = (int16_t)adsp2100_get_reg(ADSP2100_AR);
+            // the loop closed for good: PC and loop stacks empty again
+            bool ok = listed && ar == t.ar && (adsp2100_get_reg(ADSP2100_SSTAT) & 0x41) == 0x41;
+            printf("%s DO UNTIL %s: AR %d, want %d%s\n", compiled ? "compiled   " : "interpreted", t.until,
+                   ar, t.ar, ok ? "" : listed ? "  WRONG" : "  WRONG (disassembly)");
+            wrong += !ok;
+            runs++;
+        }
+    }
+
+    // 16 words at $0100 holding their own index, sent every second one: half
+    // a buffer is 4 samples, and the second half starts over at the base
+    memset(pmem, 0, sizeof(pmem));
+    memcpy(pmem, autobuffer, sizeof(autobuffer));
+    adsp2100_reset(nullptr);
+    adsp2100_dyna_enabled = false;
+    adsp2100_dyna_check = false;
+    adsp2100_predecode();
+    for (int i = 0; i < 16; i++)
+        dmem[0x100 + i] = i;
+    adsp2100_set_reg(ADSP2100_I1, 0x100);
+    adsp2100_set_reg(ADSP2100_L1, 16);
+    adsp2100_set_reg(ADSP2100_M2, 2);
+    adsp2100_set_autobuf_callback(autobufferSent);
+    adsp2100_execute(6000);
+    int order = 0;
+    for (uint32_t n = 0; n < sentCount; n++)
+        order += sent[n] != (int16_t)(n * 2 % 16);
+    bool ok = sentCalls >= 4 && sentCount == sentCalls * 4 && !order &&
+              (uint32_t)adsp2100_get_reg(ADSP2100_I1) == 0x100 + sentCount * 2 % 16;
+    printf("autobuffer: %u hand-offs, %u samples, %d out of order%s\n", sentCalls, sentCount, order, ok ? "" : "  WRONG");
+    wrong += !ok;
+    runs++;
+
+    adsp2100_exit();
+    printf("%d of %d wrong, %d compiled blocks disagreed with the interpreter\n", wrong, runs, adsp2100_dyna_mismatches);
+    wrong += adsp2100_dyna_mismatches;
+#ifdef __SWITCH__
+    consoleUpdate(NULL);
+    consoleExit(NULL);
+#endif
+    return wrong != 0;
+}
@@ -0,0 +1,176 @@
+// ATA PIO check: a sector read copied out through the data port, with and without iATABulkRead
+
+#include <switch.h>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include "ki.h"
+#include "iMain.h"
+#include "dynaCompiler.h"
+#include "iMemory.h"
+#include "iMemoryOps.h"
+#include "iATA.h"
+#include "iState.h"
+#include "dspLink.h"
+
+#define IMAGE     "ata_runner.img"
+#define SECTORS   4
+#define LOOP      0x88001000    // copy loop
+#define DEST      0x88002000    // where it copies to
+
+// what iATA.cpp and iMemory.cpp need from the rest of the emulator
+CKIApp::CKIApp() {}
+CKIApp::~CKIApp() {}
+CKIApp theApp;
+extern "C" { uint32_t gRomSet = KI1; }
+volatile uint16_t NewTask;
+WORD iMemToDo;
+uint32_t iOpCode;
+RS4300iReg *r;
+N64RomStruct *rom;
+void iStateWrite(STATESTREAM*, const void*, size_t) {}
+void iStateRead(STATESTREAM*, void*, size_t) {}
+bool iStateBulk(STATESTREAM*) { return true; }
+bool dspLinkWrite(uint16_t) { return true; }
+bool dspLinkWriteReady() { return true; }
+uint16_t dspLinkRead() { return 0; }
+bool dspLinkReadReady() { return false; }
+
+extern std::fstream ataFile;
+
+// t0 = a0 + $100 is the data port, a1 the destination, a2 its end:
+//   loop: lhu   t0, $100(a0)
+//         addiu a1, a1, 2
+//         bne   a1, a2, loop
+//         sh    t0, -2(a1)
+static const DWORD copyLoop[] = { 0x94880100, 0x24a50002, 0x14a6fffd, 0xa4a8fffe };
+
+#define T0 8
+#define A0 4
+#define A1 5
+#define A2 6
+
+// Just those four opcodes, the way iCPU.cpp runs them: the load and store
+// are the interpreter's own iOpLhu/iOpSh, the branch takes its delay slot,
+// and the fast path is tried on landing back at the head
+static void step(bool bulk)
+{
+    r->PC = LOOP;
+    r->Delay = NO_DELAY;
+    while (r->PC >= LOOP && r->PC < LOOP + sizeof(copyLoop))
+    {
+        DWORD op = iOpCode = iMemReadDWord(r->PC);
+        int rs = (op >> 21) & 0x1f, rt = (op >> 16) & 0x1f;
+        r->PC += 4;
+        switch (op >> 26)
+        {
+            case 0x25: iOpLhu(); break;
+            case 0x29: iOpSh(); break;
+            case 0x09: *(int64_t*)&r->GPR[rt * 2] = (int32_t)((DWORD)r->GPR[rs * 2] + (short)(op & 0xffff)); break;
+            case 0x05:
+                if (r->GPR[rs * 2] != r->GPR[rt * 2])
+                {
+                    r->PCDelay = r->PC + ((short)(op & 0xffff) << 2);
+                    r->Delay = DO_DELAY;
+                }
+                break;
+        }
+        switch (r->Delay)
+        {
+            case DO_DELAY:
+                r->Delay = EXEC_DELAY;
+                break;
+            case EXEC_DELAY:
+                r->Delay = NO_DELAY;
+                r->PC = r->PCDelay;
+                if (bulk && ataUsed)
+                    iATABulkRead(r->PC);
+                break;
+        }
+        r->ICount++;
+    }
+}
+
+// READ SECTORS from LBA 0 the way the game asks for it
+static void readSectors()
+{
+    m->atReg[0x110] = SECTORS;
+    m->atReg[0x118] = 1;
+    m->atReg[0x120] = 0;
+    m->atReg[0x128] = 0;
+    m->atReg[0x130] = 0;
+    m->atReg[0x138] = 0x20;
+    iATAUpdate();
+}
+
+int main()
+{
+    consoleInit(NULL);
+    int wrong = 0;
+
+    // sector data is whatever sits 13 bytes into the image
+    static WORD want[SECTORS * 256];
+    for (int i = 0; i < SECTORS * 256; i++)
+        want[i] = (WORD)(i * 0x9e37 + 0x1234);
+    {
+        std::ofstream image(IMAGE, std::ios::binary | std::ios::trunc);
+        image.write("\0\0\0\0\0\0\0\0\0\0\0\0\0", 13);
+        image.write((const char*)want, sizeof(want));
+    }
+
+    iMemInit();
+    iMemClear();
+    iATAConstruct();
+    ataFile.open(IMAGE, std::ios::in | std::ios::out | std::ios::binary);
+    memcpy(&m->rdRam[LOOP & MEM_MASK], copyLoop, sizeof(copyLoop));
+
+    // the interpreted run is the reference: what it leaves in RAM has to read
+    // back as the sector, and the fast path has to leave the same bytes
+    static BYTE ram[2][sizeof(want)];
+    RS4300iReg regs[2];
+    for (int bulk = 0; bulk < 2; bulk++)
+    {
+        r = &regs[bulk];
+        memset(r, 0, sizeof(*r));
+        memset(&m->rdRam[DEST & MEM_MASK], 0, sizeof(want));
+        *(int64_t*)&r->GPR[A0 * 2] = (int32_t)0xb0000000;
+        *(int64_t*)&r->GPR[A1 * 2] = (int32_t)DEST;
+        *(int64_t*)&r->GPR[A2 * 2] = (int32_t)(DEST + sizeof(want));
+
+        DWORD copies = ataBulkCopies, words = ataBulkWords;
+        readSectors();
+        step(bulk);
+        memcpy(ram[bulk], iMemPhysReadAddr(DEST), sizeof(want));
+
+        int differ = 0;
+        for (int i = 0; i < SECTORS * 256; i++)
+            differ += iMemReadWord(DEST + i * 2) != want[i];
+        bool ok = !differ && ataUsed == 0 && (DWORD)r->GPR[A1 * 2] == DEST + sizeof(want) &&
+                  (WORD)r->GPR[T0 * 2] == want[SECTORS * 256 - 1] &&
+                  (bulk ? ataBulkCopies == copies + 1 && ataBulkWords - words == SECTORS * 256 - 2
+                        : ataBulkCopies == copies);
+        printf("%s: %u instructions, %u bulk copies of %u words%s\n", bulk ? "fast path  " : "interpreted",
+               (unsigned)r->ICount, ataBulkCopies - copies, ataBulkWords - words, ok ? "" : "  WRONG");
+        wrong += !ok;
+    }
+    if (memcmp(ram[0], ram[1], sizeof(want)))
+    {
+        printf("fast path left different bytes in RAM\n");
+        wrong++;
+    }
+    if (memcmp(regs[0].GPR, regs[1].GPR, sizeof(regs[0].GPR)) || regs[0].ICount != regs[1].ICount)
+    {
+        printf("registers or instruction counts differ\n");
+        wrong++;
+    }
+
+    ataFile.close();
+    remove(IMAGE);
+    iATADestruct();
+    iMemDestruct();
+    printf("%d wrong\n", wrong);
+    consoleUpdate(NULL);
+    consoleExit(NULL);
+    return wrong != 0;
+}
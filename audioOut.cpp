@@ -0,0 +1,109 @@
+#include <atomic>
+#include <thread>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <switch.h>
+#include "audioRing.h"
+#include "audioResample.h"
+#include "audioOut.h"
+
+#define AUDIO_OUT_BYTES    (AUDIO_OUT_FRAMES * 2 * sizeof(int16_t))
+#define AUDIO_OUT_ALIGN    0x1000
+#define AUDIO_OUT_WAIT_NS  100000000ULL
+
+static std::thread       audioOutThread;
+static std::atomic<bool> audioOutRunning(false);
+static AudioOutBuffer    audioOutBuf[AUDIO_OUT_BUFFERS];
+static int16_t*          audioOutMem[AUDIO_OUT_BUFFERS];
+static int16_t           audioOutIn[AUDIO_RS_MAX_IN];
+static int16_t           audioOutMono[AUDIO_OUT_FRAMES];
+
+static void audioOutFill(AudioOutBuffer* buf)
+{
+    audioResampleControl(audioRingLevel(), AUDIO_OUT_TARGET);
+
+    uint32_t count = audioResampleInput(AUDIO_OUT_FRAMES);
+    audioRingRead(audioOutIn, count);
+    audioResampleRun(audioOutMono, audioOutIn, AUDIO_OUT_FRAMES);
+
+    int16_t* out = (int16_t*)buf->buffer;
+    for (int n = 0; n < AUDIO_OUT_FRAMES; n++)
+        out[2 * n] = out[2 * n + 1] = audioOutMono[n];
+    buf->data_size = AUDIO_OUT_BYTES;
+}
+
+static void audioOutThreadProc()
+{
+    for (int n = 0; n < AUDIO_OUT_BUFFERS; n++)
+    {
+        audioOutFill(&audioOutBuf[n]);
+        audoutAppendAudioOutBuffer(&audioOutBuf[n]);
+    }
+
+    while (audioOutRunning.load(std::memory_order_acquire))
+    {
+        AudioOutBuffer* released = nullptr;
+        u32 count = 0;
+        if (R_FAILED(audoutWaitPlayFinish(&released, &count, AUDIO_OUT_WAIT_NS)) || !released)
+            continue;
+
+        audioOutFill(released);
+        audoutAppendAudioOutBuffer(released);
+    }
+}
+
+bool audioOutStart()
+{
+    if (audioOutRunning.load(std::memory_order_relaxed))
+        return true;
+
+    if (R_FAILED(audoutInitialize()))
+    {
+        printf("audioOut: audout unavailable\n");
+        return false;
+    }
+    if (audoutGetChannelCount() != 2 || !audioResampleInit(AUDIO_RING_RATE, audoutGetSampleRate()) ||
+        R_FAILED(audoutStartAudioOut()))
+    {
+        printf("audioOut: unusable audout format (%u Hz, %u channels)\n",
+               audoutGetSampleRate(), audoutGetChannelCount());
+        audoutExit();
+        return false;
+    }
+
+    size_t size = (AUDIO_OUT_BYTES + AUDIO_OUT_ALIGN - 1) & ~(AUDIO_OUT_ALIGN - 1);
+    for (int n = 0; n < AUDIO_OUT_BUFFERS; n++)
+    {
+        audioOutMem[n] = (int16_t*)aligned_alloc(AUDIO_OUT_ALIGN, size);
+        memset(audioOutMem[n], 0, size);
+
+        audioOutBuf[n].next        = nullptr;
+        audioOutBuf[n].buffer      = audioOutMem[n];
+        audioOutBuf[n].buffer_size = size;
+        audioOutBuf[n].data_size   = AUDIO_OUT_BYTES;
+        audioOutBuf[n].data_offset = 0;
+    }
+
+    audioOutRunning.store(true, std::memory_order_release);
+    audioOutThread = std::thread([](){ audioOutThreadProc(); });
+    return true;
+}
+
+void audioOutStop()
+{
+    if (!audioOutRunning.load(std::memory_order_relaxed))
+        return;
+
+    audioOutRunning.store(false, std::memory_order_release);
+    if (audioOutThread.joinable())
+        audioOutThread.join();
+
+    audoutStopAudioOut();
+    audoutExit();
+    for (int n = 0; n < AUDIO_OUT_BUFFERS; n++)
+    {
+        free(audioOutMem[n]);
+        audioOutMem[n] = nullptr;
+    }
+}
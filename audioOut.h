@@ -0,0 +1,15 @@
+#ifndef AUDIOOUT_H
+#define AUDIOOUT_H
+
+// Audio backend: a thread that drains audioRing into libnx audout. audout
+// runs at its own rate (48 kHz stereo), so the board samples go through
+// audioResample on the way, its ratio steered by how full the ring is.
+
+#define AUDIO_OUT_FRAMES   720      // output frames per buffer (15 ms at 48 kHz)
+#define AUDIO_OUT_BUFFERS  3
+#define AUDIO_OUT_TARGET   1024     // ring level the rate control aims for (32 ms)
+
+extern bool audioOutStart();
+extern void audioOutStop();
+
+#endif // AUDIOOUT_H
@@ -0,0 +1,189 @@
+// Polyphase resampler
+//
+// Output sample k sits at input position pos = pos0 + k * step (32.32 fixed
+// point). Its integer part picks the window of AUDIO_RS_TAPS history samples,
+// the top bits of the fraction pick the phase row and the next 16 bits blend
+// that row's result with the following row's. Rows are Q15 and each sums to
+// exactly 1.0, so DC passes unchanged through every phase.
+
+#include <cmath>
+#include <cstring>
+#include "audioResample.h"
+
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define AUDIO_RS_PHASE_BITS  8      // log2(AUDIO_RS_PHASES)
+#define AUDIO_RS_BETA        7.0    // Kaiser beta, about 70 dB stopband
+#define AUDIO_RS_DRC_SMOOTH  (1.0 / 32)
+
+alignas(16) static int16_t audioRsCoef[AUDIO_RS_PHASES + 1][AUDIO_RS_TAPS];
+alignas(16) static int16_t audioRsHist[AUDIO_RS_TAPS + AUDIO_RS_MAX_IN];
+
+static uint64_t audioRsNominal = 0;     // in/out, 32.32
+static uint64_t audioRsStep    = 0;
+static uint64_t audioRsPos     = 0;     // fraction only between runs
+static double   audioRsScale   = 1.0;
+static double   audioRsLevel   = 0.0;   // smoothed queue level
+
+// ---------------------- FILTER DESIGN ----------------------
+
+static double audioRsBessel0(double x)
+{
+    double sum = 1.0, term = 1.0;
+    for (int k = 1; k < 32; k++)
+    {
+        term *= (x / (2 * k)) * (x / (2 * k));
+        sum += term;
+    }
+    return sum;
+}
+
+// cutoff is in cycles per input sample
+static void audioRsDesign(double cutoff)
+{
+    const double half = AUDIO_RS_TAPS / 2;
+    const double norm = audioRsBessel0(AUDIO_RS_BETA);
+    double tap[AUDIO_RS_TAPS];
+
+    for (int p = 0; p <= AUDIO_RS_PHASES; p++)
+    {
+        double frac = (double)p / AUDIO_RS_PHASES;
+        double sum = 0;
+        for (int j = 0; j < AUDIO_RS_TAPS; j++)
+        {
+            double x = half - 1 + frac - j;        // distance from the output point
+            double r = x / half;
+            double w = (r * r < 1.0) ? audioRsBessel0(AUDIO_RS_BETA * sqrt(1.0 - r * r)) / norm : 0.0;
+            double s = (x == 0.0) ? 1.0 : sin(2 * M_PI * cutoff * x) / (2 * M_PI * cutoff * x);
+            tap[j] = 2 * cutoff * s * w;
+            sum += tap[j];
+        }
+
+        // Q15 with the rounding error folded into the centre tap, so the row
+        // sums to exactly 32768
+        int total = 0, centre = AUDIO_RS_TAPS / 2 - 1 + (frac >= 0.5);
+        for (int j = 0; j < AUDIO_RS_TAPS; j++)
+        {
+            audioRsCoef[p][j] = (int16_t)lrint(tap[j] / sum * 32768.0);
+            total += audioRsCoef[p][j];
+        }
+        audioRsCoef[p][centre] += (int16_t)(32768 - total);
+    }
+}
+
+// ---------------------- KERNEL ----------------------
+
+static inline int32_t audioRsDot(const int16_t* x, const int16_t* c)
+{
+#if defined(__aarch64__)
+    int32x4_t acc0 = vdupq_n_s32(0), acc1 = vdupq_n_s32(0);
+    for (int j = 0; j < AUDIO_RS_TAPS; j += 8)
+    {
+        int16x8_t xv = vld1q_s16(x + j);
+        int16x8_t cv = vld1q_s16(c + j);
+        acc0 = vmlal_s16(acc0, vget_low_s16(xv), vget_low_s16(cv));
+        acc1 = vmlal_high_s16(acc1, xv, cv);
+    }
+    return vaddvq_s32(vaddq_s32(acc0, acc1));
+#elif defined(__SSE2__)
+    __m128i acc = _mm_setzero_si128();
+    for (int j = 0; j < AUDIO_RS_TAPS; j += 8)
+        acc = _mm_add_epi32(acc, _mm_madd_epi16(_mm_loadu_si128((const __m128i*)(x + j)),
+                                                _mm_load_si128((const __m128i*)(c + j))));
+    acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, 0x4e));
+    acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, 0xb1));
+    return _mm_cvtsi128_si32(acc);
+#else
+    int32_t acc = 0;
+    for (int j = 0; j < AUDIO_RS_TAPS; j++)
+        acc += x[j] * c[j];
+    return acc;
+#endif
+}
+
+// ---------------------- INTERFACE ----------------------
+
+bool audioResampleInit(uint32_t inRate, uint32_t outRate)
+{
+    if (!inRate || !outRate || inRate > outRate * 4)
+        return false;
+
+    // transition band of a Kaiser window this long (Kaiser's estimates),
+    // kept below the lower Nyquist so neither images nor aliases get through
+    double atten  = AUDIO_RS_BETA / 0.1102 + 8.7;
+    double band   = (atten - 7.95) / (14.36 * AUDIO_RS_TAPS);
+    double nyq    = 0.5 * ((outRate < inRate) ? (double)outRate / inRate : 1.0);
+    double cutoff = nyq - band / 2;
+    audioRsDesign(cutoff);
+
+    audioRsNominal = ((uint64_t)inRate << 32) / outRate;
+    audioResampleReset();
+    return true;
+}
+
+void audioResampleReset()
+{
+    memset(audioRsHist, 0, sizeof(audioRsHist));
+    audioRsStep  = audioRsNominal;
+    audioRsPos   = 0;
+    audioRsScale = 1.0;
+    audioRsLevel = -1.0;
+}
+
+// A fuller queue than target speeds consumption up a little, an emptier one
+// slows it down; the level is smoothed so block-sized jumps do not wobble
+// the pitch
+void audioResampleControl(uint32_t level, uint32_t target)
+{
+    if (audioRsLevel < 0)
+        audioRsLevel = level;
+    audioRsLevel += ((double)level - audioRsLevel) * AUDIO_RS_DRC_SMOOTH;
+
+    double error = (audioRsLevel - target) / (double)target;
+    if (error > 1.0)
+        error = 1.0;
+    if (error < -1.0)
+        error = -1.0;
+
+    audioRsScale = 1.0 + AUDIO_RS_DRC_MAX * error;
+    audioRsStep  = (uint64_t)((double)audioRsNominal * audioRsScale);
+}
+
+double audioResampleScale()
+{
+    return audioRsScale;
+}
+
+uint32_t audioResampleInput(uint32_t frames)
+{
+    return (uint32_t)((audioRsPos + frames * audioRsStep) >> 32);
+}
+
+// in holds exactly audioResampleInput(frames) samples
+void audioResampleRun(int16_t* out, const int16_t* in, uint32_t frames)
+{
+    uint32_t count = audioResampleInput(frames);
+    memcpy(audioRsHist + AUDIO_RS_TAPS, in, count * sizeof(int16_t));
+
+    uint64_t pos = audioRsPos;
+    for (uint32_t k = 0; k < frames; k++, pos += audioRsStep)
+    {
+        const int16_t* x = audioRsHist + (uint32_t)(pos >> 32);
+        uint32_t frac  = (uint32_t)pos;
+        uint32_t phase = frac >> (32 - AUDIO_RS_PHASE_BITS);
+        int64_t  blend = (frac >> (32 - AUDIO_RS_PHASE_BITS - 16)) & 0xffff;
+
+        int64_t a = audioRsDot(x, audioRsCoef[phase]);
+        int64_t b = audioRsDot(x, audioRsCoef[phase + 1]);
+        int64_t v = ((a << 16) + (b - a) * blend + (1LL << 30)) >> 31;
+        out[k] = (int16_t)(v > 32767 ? 32767 : v < -32768 ? -32768 : v);
+    }
+
+    // keep the last AUDIO_RS_TAPS samples as history for the next run
+    memmove(audioRsHist, audioRsHist + count, AUDIO_RS_TAPS * sizeof(int16_t));
+    audioRsPos = pos - ((uint64_t)count << 32);
+}
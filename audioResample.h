@@ -0,0 +1,28 @@
+#ifndef AUDIORESAMPLE_H
+#define AUDIORESAMPLE_H
+
+#include <cstdint>
+
+// Band-limited polyphase resampler, 16-bit mono.
+//
+// Kaiser-windowed sinc, AUDIO_RS_TAPS taps per phase and AUDIO_RS_PHASES
+// phases; the fraction between two phases is blended linearly. The step can
+// be nudged around the nominal in/out ratio (dynamic rate control) so the
+// consumer of a free-running producer neither drains nor floods its queue.
+
+#define AUDIO_RS_TAPS      32       // multiple of 8
+#define AUDIO_RS_PHASES    256      // power of two
+#define AUDIO_RS_MAX_IN    4096     // input samples per audioResampleRun
+#define AUDIO_RS_DRC_MAX   0.005    // largest step change, +-0.5% (inaudible pitch)
+
+extern bool     audioResampleInit(uint32_t inRate, uint32_t outRate);
+extern void     audioResampleReset();
+
+// Dynamic rate control: pull the queued level toward target
+extern void     audioResampleControl(uint32_t level, uint32_t target);
+extern double   audioResampleScale();           // current step / nominal step
+
+extern uint32_t audioResampleInput(uint32_t frames);   // input the next run consumes
+extern void     audioResampleRun(int16_t* out, const int16_t* in, uint32_t frames);
+
+#endif // AUDIORESAMPLE_H
@@ -0,0 +1,140 @@
+#include <atomic>
+#include <cstring>
+#include "audioRing.h"
+
+#define AUDIO_RING_LINE 64
+
+// head and the producer counters are only written by the producer, tail and
+// the consumer counters only by the consumer; each group has its own line.
+struct AUDIORING {
+    alignas(AUDIO_RING_LINE) std::atomic<uint32_t> head;
+    std::atomic<uint32_t> overruns;
+    std::atomic<uint32_t> dropped;
+
+    alignas(AUDIO_RING_LINE) std::atomic<uint32_t> tail;
+    std::atomic<uint32_t> underruns;
+    std::atomic<uint32_t> silence;
+    bool                  primed;       // consumer: playing, not refilling
+
+    alignas(AUDIO_RING_LINE) int16_t data[AUDIO_RING_SIZE];
+};
+
+static AUDIORING audioRing;
+
+void audioRingReset()
+{
+    audioRing.head.store(0, std::memory_order_relaxed);
+    audioRing.tail.store(0, std::memory_order_relaxed);
+    audioRing.overruns.store(0, std::memory_order_relaxed);
+    audioRing.dropped.store(0, std::memory_order_relaxed);
+    audioRing.underruns.store(0, std::memory_order_relaxed);
+    audioRing.silence.store(0, std::memory_order_relaxed);
+    audioRing.primed = false;
+}
+
+// ---------------------- PRODUCER ----------------------
+
+// Room for up to count samples in one run at *dst; 0 when the ring is full,
+// which counts the whole request as an overrun
+int audioRingReserve(int16_t** dst, int count)
+{
+    uint32_t head = audioRing.head.load(std::memory_order_relaxed);
+    uint32_t room = AUDIO_RING_SIZE - (head - audioRing.tail.load(std::memory_order_acquire));
+    uint32_t at   = head & (AUDIO_RING_SIZE - 1);
+
+    if (room > AUDIO_RING_SIZE - at)
+        room = AUDIO_RING_SIZE - at;
+    if (room > (uint32_t)count)
+        room = count;
+
+    if (room == 0 && count > 0)
+    {
+        audioRing.overruns.store(audioRing.overruns.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        audioRing.dropped.store(audioRing.dropped.load(std::memory_order_relaxed) + count, std::memory_order_relaxed);
+    }
+
+    *dst = &audioRing.data[at];
+    return (int)room;
+}
+
+// Publish samples written since the last reserve
+void audioRingCommit(int count)
+{
+    uint32_t head = audioRing.head.load(std::memory_order_relaxed);
+    audioRing.head.store(head + count, std::memory_order_release);
+}
+
+int audioRingWrite(const int16_t* src, int count)
+{
+    int done = 0;
+    while (done < count)
+    {
+        int16_t* dst;
+        int n = audioRingReserve(&dst, count - done);
+        if (n == 0)
+            break;
+        memcpy(dst, src + done, n * sizeof(int16_t));
+        audioRingCommit(n);
+        done += n;
+    }
+    return done;
+}
+
+// ---------------------- CONSUMER ----------------------
+
+// Fill dst with count samples. Playback holds off until AUDIO_RING_PRIME
+// samples are queued; running dry pads with silence and starts that over.
+int audioRingRead(int16_t* dst, int count)
+{
+    uint32_t tail  = audioRing.tail.load(std::memory_order_relaxed);
+    uint32_t level = audioRing.head.load(std::memory_order_acquire) - tail;
+
+    if (!audioRing.primed)
+    {
+        if (level < AUDIO_RING_PRIME)
+        {
+            memset(dst, 0, count * sizeof(int16_t));
+            return 0;
+        }
+        audioRing.primed = true;
+    }
+
+    uint32_t take = (level < (uint32_t)count) ? level : count;
+    uint32_t at   = tail & (AUDIO_RING_SIZE - 1);
+    uint32_t run  = AUDIO_RING_SIZE - at;
+    if (run > take)
+        run = take;
+
+    memcpy(dst, &audioRing.data[at], run * sizeof(int16_t));
+    memcpy(dst + run, &audioRing.data[0], (take - run) * sizeof(int16_t));
+    audioRing.tail.store(tail + take, std::memory_order_release);
+
+    if (take < (uint32_t)count)
+    {
+        memset(dst + take, 0, (count - take) * sizeof(int16_t));
+        audioRing.underruns.store(audioRing.underruns.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        audioRing.silence.store(audioRing.silence.load(std::memory_order_relaxed) + count - take, std::memory_order_relaxed);
+        audioRing.primed = false;
+    }
+    return (int)take;
+}
+
+uint32_t audioRingLevel()
+{
+    return audioRing.head.load(std::memory_order_acquire) - audioRing.tail.load(std::memory_order_relaxed);
+}
+
+// ---------------------- STATS ----------------------
+
+// Snapshot for the info line; any thread, counters are only approximate
+// against each other
+void audioRingStats(AUDIORINGSTATS* stats)
+{
+    stats->underruns = audioRing.underruns.load(std::memory_order_relaxed);
+    stats->overruns  = audioRing.overruns.load(std::memory_order_relaxed);
+    stats->silence   = audioRing.silence.load(std::memory_order_relaxed);
+    stats->dropped   = audioRing.dropped.load(std::memory_order_relaxed);
+
+    uint32_t tail = audioRing.tail.load(std::memory_order_acquire);     // before head, never negative
+    stats->level = audioRing.head.load(std::memory_order_acquire) - tail;
+}
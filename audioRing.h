@@ -0,0 +1,39 @@
+#ifndef AUDIORING_H
+#define AUDIORING_H
+
+#include <cstdint>
+
+// Sound board -> audio backend sample ring: 16-bit mono at the board's 32 kHz.
+//
+// Single producer (the DSP thread, from the autobuffer hand-off) and single
+// consumer (the audio backend thread). The producer writes straight into the
+// ring through audioRingReserve/audioRingCommit, so the board output is never
+// staged anywhere else. Neither side locks; head and tail live on their own
+// cache lines so the two threads do not share one.
+
+#define AUDIO_RING_RATE    32000    // board sample rate
+#define AUDIO_RING_SIZE    4096     // samples, power of two (128 ms)
+#define AUDIO_RING_PRIME   1024     // samples queued before playback (re)starts
+
+struct AUDIORINGSTATS {
+    uint32_t underruns;     // reads that ran the ring dry
+    uint32_t overruns;      // writes that found the ring full
+    uint32_t silence;       // samples the backend padded with silence
+    uint32_t dropped;       // samples the producer had no room for
+    uint32_t level;         // samples queued right now
+};
+
+extern void audioRingReset();                    // both threads stopped
+
+// Producer
+extern int  audioRingReserve(int16_t** dst, int count);    // contiguous room, may be short
+extern void audioRingCommit(int count);
+extern int  audioRingWrite(const int16_t* src, int count);  // drops what does not fit
+
+// Consumer
+extern int  audioRingRead(int16_t* dst, int count);        // pads with silence
+extern uint32_t audioRingLevel();                          // samples queued
+
+extern void audioRingStats(AUDIORINGSTATS* stats);
+
+#endif // AUDIORING_H
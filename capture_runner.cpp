@@ -0,0 +1,105 @@
+// iCapture check: emulation slowdown and file contents with capture off, to Y4M + WAV and raw
+
+#ifdef __SWITCH__
+#include <switch.h>
+#endif
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "iCapture.h"
+
+#define W       320
+#define H       240
+#define FRAMES  300
+#define WORK_US 8000        // emulating a frame, about what a busy one costs
+#define SKIP    7           // every SKIP'th frame is not drawn
+
+static double busy(int us)
+{
+    volatile double x = 1;
+    auto until = std::chrono::steady_clock::now() + std::chrono::microseconds(us);
+    while (std::chrono::steady_clock::now() < until)
+        x = x * 1.0000001;
+    return x;
+}
+
+static long fileSize(const char* path)
+{
+    FILE* f = fopen(path, "rb");
+    if (!f)
+        return -1;
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fclose(f);
+    return size;
+}
+
+static double run(int format)
+{
+    std::vector<uint32_t> frame(W * H);
+    int16_t samples[533];
+    if (format >= 0)
+        iCaptureStart("/tmp/capture_runner", format, W, H);
+
+    auto t0 = std::chrono::steady_clock::now();
+    double copy = 0;
+    for (int f = 0; f < FRAMES; f++)
+    {
+        busy(WORK_US);
+        for (int i = 0; i < 533; i++)
+            samples[i] = (int16_t)(f * 533 + i);
+        iCaptureAudio(samples, 533);
+        iCaptureVSYNC();
+        if (f % SKIP == SKIP - 1)
+            continue;
+        for (int i = 0; i < W * H; i += 97)
+            frame[i] = 0xff000000 | (uint32_t)(f * 0x010203 + i);
+        iCaptureFrame(frame.data());
+        CAPTURESTATS stats;
+        iCaptureStats(&stats);
+        copy += stats.copyUs;
+    }
+    double took = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    if (format >= 0)
+    {
+        CAPTURESTATS stats;
+        iCaptureStats(&stats);
+        iCaptureStop();
+        printf("%s: %u VSYNCs, %u written, %u dropped, %u repeated, %u samples (%u dropped); copy %.1f us a frame\n",
+               format == CAPTURE_Y4M ? "y4m+wav" : "raw    ", stats.frames, stats.written, stats.dropped,
+               stats.repeated, stats.samples, stats.samplesDropped, copy / stats.written);
+    }
+    return took;
+}
+
+int main()
+{
+#ifdef __SWITCH__
+    consoleInit(NULL);
+#endif
+    double off = run(-1);
+    double y4m = run(CAPTURE_Y4M);
+    long header = (long)strlen("YUV4MPEG2 W320 H240 F60:1 Ip A1:1 C444 XCOLORRANGE=FULL\n");
+    long frames = (fileSize("/tmp/capture_runner.y4m") - header) / (6 + W * H * 3);
+    long sampleBytes = fileSize("/tmp/capture_runner.wav") - 56;
+    printf("  y4m holds %ld frames (%s), wav %ld samples (%s)\n", frames, frames == FRAMES ? "all" : "NOT all",
+           sampleBytes / 2, sampleBytes / 2 == FRAMES * 533 ? "all" : "NOT all");
+
+    double raw = run(CAPTURE_RAW);
+    long expect = (long)sizeof(CAPTUREHEADER) + (FRAMES - FRAMES / SKIP) * (long)(sizeof(CAPTUREPACKET) + W * H * 4) +
+                  FRAMES * 533 * 2;
+    long got = fileSize("/tmp/capture_runner.kic");
+    printf("  kic is %ld bytes, %ld in packet headers besides the frames and samples\n", got,
+           got - expect);
+
+    printf("same %d frames: off %.3f s, y4m+wav %+.2f%%, raw %+.2f%%\n", FRAMES, off,
+           (y4m / off - 1) * 100, (raw / off - 1) * 100);
+#ifdef __SWITCH__
+    consoleUpdate(NULL);
+    consoleExit(NULL);
+#endif
+    return 0;
+}
@@ -7,6 +7,7 @@
 
 #include "dasmMain.h"
 #include "dasmIns.h"
+#include "iRom.h"
 
 
 
@@ -137,32 +138,7 @@ WORD dasmNOP(BYTE *cp)
    
 void dasmChangeEndian(WORD Mode,BYTE *src,DWORD Length)
 {
-    DWORD     i;
-    BYTE    change_endian[4];
-
-
-
-    for(i=0; i<Length; i+=4)
-    {
-        change_endian[0] = src[i+0];
-        change_endian[1] = src[i+1];
-        change_endian[2] = src[i+2];
-        change_endian[3] = src[i+3];
-		if(Mode==0)
-		{
-			src[i+0] = change_endian[2];
-			src[i+1] = change_endian[3];
-			src[i+2] = change_endian[0];
-			src[i+3] = change_endian[1];
-		}
-		else
-		{
-			src[i+0] = change_endian[3];
-			src[i+1] = change_endian[2];
-			src[i+2] = change_endian[1];
-			src[i+3] = change_endian[0];
-		}
-	}
+	iRomSwap(src,src,Length,Mode);
 } 
 
 char *dasmDo(DWORD *where,DWORD Address,DWORD EndAddress)
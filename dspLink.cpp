@@ -0,0 +1,246 @@
+#include <atomic>
+#include <switch.h>
+#include "adsp2100.h"
+#include "hleDSP.h"
+#include "dspLink.h"
+#include "iState.h"
+
+// ---------------------- MAILBOXES ----------------------
+
+// head is only written by the producer and tail only by the consumer; the
+// release on either index publishes the slot it covers to the other side.
+struct DSPMAILBOX {
+    std::atomic<uint32_t> head;
+    std::atomic<uint32_t> tail;
+    uint16_t              data[DSPLINK_MAILBOX_SIZE];
+};
+
+static DSPMAILBOX dspLinkToDsp;     // CPU -> DSP input latch
+static DSPMAILBOX dspLinkToCpu;     // DSP -> CPU output latch
+
+static bool dspLinkPush(DSPMAILBOX* box, uint16_t data)
+{
+    uint32_t head = box->head.load(std::memory_order_relaxed);
+    if (head - box->tail.load(std::memory_order_acquire) == DSPLINK_MAILBOX_SIZE)
+        return false;
+
+    box->data[head & (DSPLINK_MAILBOX_SIZE - 1)] = data;
+    box->head.store(head + 1, std::memory_order_release);
+    return true;
+}
+
+static bool dspLinkPop(DSPMAILBOX* box, uint16_t* data)
+{
+    uint32_t tail = box->tail.load(std::memory_order_relaxed);
+    if (box->head.load(std::memory_order_acquire) == tail)
+        return false;
+
+    *data = box->data[tail & (DSPLINK_MAILBOX_SIZE - 1)];
+    box->tail.store(tail + 1, std::memory_order_release);
+    return true;
+}
+
+static bool dspLinkEmpty(DSPMAILBOX* box)
+{
+    return box->head.load(std::memory_order_acquire) == box->tail.load(std::memory_order_relaxed);
+}
+
+// ---------------------- SCHEDULER STATE ----------------------
+
+bool dspLinkInline = false;
+
+static std::atomic<uint64_t> dspLinkCpuTime;    // CPU ICount since reset, written by the CPU
+static std::atomic<uint64_t> dspLinkDspTime;    // DSP cycles executed, written by the DSP
+static std::atomic<bool>     dspLinkActive;     // the DSP thread is servicing the link
+
+static uint64_t dspLinkCpuBase;     // CPU side: ICount at reset
+static uint16_t dspLinkLastReply;   // CPU side: the latch holds its value once read
+static bool     dspLinkLatchFull;   // DSP side: IRQ2 raised and the latch not read yet
+static uint64_t dspLinkHeld;        // CPU side: CPU time kept back by dspLinkPause
+
+#define DSPLINK_RATIO    (DSPLINK_CPU_CLOCK / DSPLINK_DSP_CLOCK)
+#define DSPLINK_WAIT_NS  50000
+
+void dspLinkReset(uint64_t icount)
+{
+    dspLinkToDsp.head.store(0, std::memory_order_relaxed);
+    dspLinkToDsp.tail.store(0, std::memory_order_relaxed);
+    dspLinkToCpu.head.store(0, std::memory_order_relaxed);
+    dspLinkToCpu.tail.store(0, std::memory_order_relaxed);
+
+    dspLinkCpuTime.store(0, std::memory_order_relaxed);
+    dspLinkDspTime.store(0, std::memory_order_relaxed);
+
+    dspLinkCpuBase   = icount;
+    dspLinkLastReply = 0;
+    dspLinkLatchFull = false;
+}
+
+void dspLinkOpen()
+{
+    dspLinkActive.store(!dspLinkInline, std::memory_order_release);
+}
+
+void dspLinkClose()
+{
+    dspLinkActive.store(false, std::memory_order_release);
+}
+
+// ---------------------- SAVE STATES ----------------------
+
+// Let the DSP use up the cycles it was given, then publish a CPU time of zero:
+// dspLinkService has nothing to do until dspLinkResume, whatever state is
+// swapped in behind it in the meantime.
+void dspLinkPause()
+{
+    dspLinkHeld = dspLinkCpuTime.load(std::memory_order_relaxed);
+
+    uint64_t target = dspLinkHeld / DSPLINK_RATIO;
+    while (target > dspLinkDspTime.load(std::memory_order_acquire) &&
+           dspLinkActive.load(std::memory_order_acquire))
+        svcSleepThread(DSPLINK_WAIT_NS);
+
+    dspLinkCpuTime.store(0, std::memory_order_release);
+}
+
+void dspLinkResume()
+{
+    dspLinkCpuTime.store(dspLinkHeld, std::memory_order_release);
+}
+
+// Only while paused: the CPU time saved is the one held back
+void dspLinkSaveState(STATESTREAM* s)
+{
+    DSPMAILBOX* boxes[2] = { &dspLinkToDsp, &dspLinkToCpu };
+    for (DSPMAILBOX* box : boxes)
+    {
+        iStateWrite(s, box->head.load(std::memory_order_relaxed));
+        iStateWrite(s, box->tail.load(std::memory_order_relaxed));
+        iStateWrite(s, box->data);
+    }
+
+    iStateWrite(s, dspLinkHeld);
+    iStateWrite(s, dspLinkDspTime.load(std::memory_order_relaxed));
+    iStateWrite(s, dspLinkCpuBase);
+    iStateWrite(s, dspLinkLastReply);
+    iStateWrite(s, dspLinkLatchFull);
+}
+
+void dspLinkLoadState(STATESTREAM* s)
+{
+    DSPMAILBOX* boxes[2] = { &dspLinkToDsp, &dspLinkToCpu };
+    for (DSPMAILBOX* box : boxes)
+    {
+        uint32_t head = 0, tail = 0;
+        iStateRead(s, head);
+        iStateRead(s, tail);
+        iStateRead(s, box->data);
+        box->head.store(head, std::memory_order_relaxed);
+        box->tail.store(tail, std::memory_order_relaxed);
+    }
+
+    uint64_t done = 0;
+    iStateRead(s, dspLinkHeld);
+    iStateRead(s, done);
+    iStateRead(s, dspLinkCpuBase);
+    iStateRead(s, dspLinkLastReply);
+    iStateRead(s, dspLinkLatchFull);
+
+    // published with the CPU time by dspLinkResume
+    dspLinkDspTime.store(done, std::memory_order_relaxed);
+}
+
+// ---------------------- CPU SIDE ----------------------
+
+// Publish CPU progress. Threaded, the CPU waits here while the DSP is more
+// than DSPLINK_MAX_SKEW behind; inline, the DSP is simply run up to it.
+void dspLinkAdvance(uint64_t icount)
+{
+    uint64_t now = icount - dspLinkCpuBase;
+    if (now <= dspLinkCpuTime.load(std::memory_order_relaxed))
+        return;
+    dspLinkCpuTime.store(now, std::memory_order_release);
+
+    if (dspLinkInline)
+    {
+        dspLinkService();
+        return;
+    }
+
+    uint64_t target = now / DSPLINK_RATIO;
+    while (target > dspLinkDspTime.load(std::memory_order_acquire) + DSPLINK_MAX_SKEW &&
+           dspLinkActive.load(std::memory_order_acquire))
+        svcSleepThread(DSPLINK_WAIT_NS);
+}
+
+// CPU wrote the sound input latch; false when the DSP has 16 words unread
+bool dspLinkWrite(uint16_t data)
+{
+    return dspLinkPush(&dspLinkToDsp, data);
+}
+
+// room for another word, what the sound status bit reports to the CPU
+bool dspLinkWriteReady()
+{
+    return dspLinkToDsp.head.load(std::memory_order_relaxed) - dspLinkToDsp.tail.load(std::memory_order_acquire) <
+           DSPLINK_MAILBOX_SIZE;
+}
+
+// CPU read of the sound output latch
+uint16_t dspLinkRead()
+{
+    dspLinkPop(&dspLinkToCpu, &dspLinkLastReply);
+    return dspLinkLastReply;
+}
+
+bool dspLinkReadReady()
+{
+    return !dspLinkEmpty(&dspLinkToCpu);
+}
+
+// ---------------------- DSP SIDE ----------------------
+
+// Next queued word goes into the input latch once the last one was read
+static void dspLinkDeliver()
+{
+    if (dspLinkLatchFull || !dspLinkPop(&dspLinkToDsp, &dspPoke))
+        return;
+
+    dspLinkLatchFull = true;
+    adsp2100_set_irq_line(ADSP2105_IRQ2, 1);
+}
+
+// Run the DSP up to the published CPU time; false when it is already there
+bool dspLinkService()
+{
+    uint64_t target = dspLinkCpuTime.load(std::memory_order_acquire) / DSPLINK_RATIO;
+    uint64_t done   = dspLinkDspTime.load(std::memory_order_relaxed);
+    if (done >= target)
+        return false;
+
+    while (done < target)
+    {
+        uint64_t slice = target - done;
+        if (slice > DSPLINK_SLICE)
+            slice = DSPLINK_SLICE;
+
+        dspLinkDeliver();
+        done += adsp2100_execute((int)slice);
+        dspLinkDspTime.store(done, std::memory_order_release);
+    }
+    return true;
+}
+
+// DSP read the input latch
+void dspLinkAcknowledge()
+{
+    dspLinkLatchFull = false;
+    adsp2100_set_irq_line(ADSP2105_IRQ2, 0);
+}
+
+// DSP wrote the output latch; a full mailbox drops the word like an
+// overwritten latch would
+void dspLinkReply(uint16_t data)
+{
+    dspLinkPush(&dspLinkToCpu, data);
+}
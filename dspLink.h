@@ -0,0 +1,49 @@
+#ifndef DSPLINK_H
+#define DSPLINK_H
+
+#include <cstdint>
+
+struct STATESTREAM;
+
+// CPU <-> sound DSP link: the input/output latches between the R4600 and the
+// ADSP-2105, and the scheduler that keeps DSP time in step with CPU time.
+//
+// Both latches are single-producer/single-consumer mailboxes, so the CPU and
+// DSP can run on different cores without sharing plain globals. DSP time is
+// not taken from the wall clock: the CPU publishes its ICount and the DSP is
+// given exactly the cycles that correspond to it.
+
+#define DSPLINK_CPU_CLOCK     50000000  // ICount rate (833333 per 60 Hz frame)
+#define DSPLINK_DSP_CLOCK     10000000  // ADSP-2105 instruction rate
+#define DSPLINK_SLICE         1000      // DSP cycles per slice (100 us)
+#define DSPLINK_CPU_SLICE     5000      // CPU ICount between publishes (one slice)
+#define DSPLINK_MAX_SKEW      20000     // DSP cycles the DSP may fall behind (2 ms)
+#define DSPLINK_MAILBOX_SIZE  16        // power of two
+
+extern bool dspLinkInline;      // run the DSP on the CPU thread instead of its own
+
+// Setup (threads stopped)
+extern void dspLinkReset(uint64_t icount);
+extern void dspLinkOpen();
+extern void dspLinkClose();     // releases a CPU waiting on the skew barrier
+
+// Save states (CPU thread): the DSP finishes the cycles already published and
+// is held there until dspLinkResume, so its state can be read or replaced
+extern void dspLinkPause();
+extern void dspLinkResume();
+extern void dspLinkSaveState(STATESTREAM* s);
+extern void dspLinkLoadState(STATESTREAM* s);
+
+// CPU side
+extern void     dspLinkAdvance(uint64_t icount);
+extern bool     dspLinkWrite(uint16_t data);
+extern bool     dspLinkWriteReady();
+extern uint16_t dspLinkRead();
+extern bool     dspLinkReadReady();
+
+// DSP side
+extern bool dspLinkService();
+extern void dspLinkAcknowledge();
+extern void dspLinkReply(uint16_t data);
+
+#endif // DSPLINK_H
@@ -0,0 +1,125 @@
+// iHash check: the vector kernels against a reference, bit-flip sensitivity and throughput
+
+#ifdef __SWITCH__
+#include <switch.h>
+#endif
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <set>
+#include <vector>
+#include "iHash.h"
+#include "iPack.h"
+
+#define FRAME   (320 * 240 * 4)
+#define ROUNDS  2000
+
+static const uint64_t keys[8] = {
+    0xbe4ba423396cfeb8ULL, 0x1cad21f72c81017cULL, 0xdb979083e96dd4deULL, 0x1f67b3b7a4a44072ULL,
+    0x78e5c0cc4ee679cbULL, 0x2172ffcc7dd05a82ULL, 0x8e2443f7744608b8ULL, 0x4c263a81e69035e0ULL,
+};
+
+// iHash64 written straight from its description, a word at a time
+static uint64_t reference(const uint8_t* p, size_t size, uint64_t seed)
+{
+    uint64_t acc[8] = { 0xc2b2ae3dULL, 0x9e3779b185ebca87ULL, 0xc2b2ae3d27d4eb4fULL, 0x165667b19e3779f9ULL,
+                        0x85ebca77c2b2ae63ULL, 0x85ebca77ULL, 0x27d4eb2f165667c5ULL, 0x9e3779b1ULL };
+    uint64_t key[8];
+    for (int i = 0; i < 8; i++)
+        key[i] = keys[i] + (i & 1 ? 0 - seed : seed);
+
+    size_t stripes = (size + 63) / 64;
+    for (size_t s = 0; s < stripes; s++)
+    {
+        for (int i = 0; i < 8; i++)
+        {
+            uint64_t d = 0;
+            for (int b = 0; b < 8; b++)
+            {
+                size_t at = s * 64 + i * 8 + b;
+                d |= (uint64_t)(at < size ? p[at] : 0) << (b * 8);
+            }
+            uint64_t dk = d ^ key[i];
+            acc[i ^ 1] += d;
+            acc[i] += (dk & 0xffffffff) * (dk >> 32);
+        }
+        if ((s + 1) % 16 == 0)
+            for (int i = 0; i < 8; i++)
+            {
+                uint64_t x = acc[i] ^ (acc[i] >> 47) ^ key[i];
+                acc[i] = x * 0x9e3779b1ULL;
+            }
+    }
+
+    uint64_t h = size * 0x9e3779b185ebca87ULL;
+    for (int i = 0; i < 8; i += 2)
+    {
+        unsigned __int128 m = (unsigned __int128)(acc[i] ^ key[(i + 3) & 7]) * (acc[i + 1] ^ key[(i + 4) & 7]);
+        h += (uint64_t)m ^ (uint64_t)(m >> 64);
+    }
+    h ^= h >> 37;
+    h *= 0x165667b19e3779f9ULL;
+    h ^= h >> 32;
+    return h;
+}
+
+static double seconds(std::chrono::steady_clock::time_point t0)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+int main()
+{
+#ifdef __SWITCH__
+    consoleInit(NULL);
+#endif
+    std::vector<uint8_t> buffer(FRAME + 64);
+    for (size_t i = 0; i < buffer.size(); i++)
+        buffer[i] = (uint8_t)rand();
+
+    int wrong = 0, checked = 0;
+    for (size_t size = 0; size <= 4200; size++)
+        for (size_t offset : { 0, 1, 7 })
+        {
+            uint64_t seed = size * 0x9e3779b97f4a7c15ULL;
+            wrong += iHash64(&buffer[offset], size, seed) != reference(&buffer[offset], size, seed);
+            checked++;
+        }
+    wrong += iHash64(buffer.data(), FRAME) != reference(buffer.data(), FRAME, 0);
+    printf("against the reference: %d of %d wrong\n", wrong, checked + 1);
+
+    // every bit of a frame, and lengths that differ by trailing zeros
+    std::set<uint64_t> seen;
+    uint64_t whole = iHash64(buffer.data(), FRAME);
+    int same = 0;
+    for (size_t bit = 0; bit < (size_t)FRAME * 8; bit += 97)
+    {
+        buffer[bit / 8] ^= (uint8_t)(1 << bit % 8);
+        uint64_t h = iHash64(buffer.data(), FRAME);
+        same += h == whole || !seen.insert(h).second;
+        buffer[bit / 8] ^= (uint8_t)(1 << bit % 8);
+    }
+    std::vector<uint8_t> zeros(256);
+    for (size_t size = 0; size <= zeros.size(); size++)
+        same += !seen.insert(iHash64(zeros.data(), size)).second;
+    printf("%zu one-bit flips and zero runs: %d collisions\n", seen.size(), same);
+
+    auto t0 = std::chrono::steady_clock::now();
+    uint64_t sink = 0;
+    for (int i = 0; i < ROUNDS; i++)
+        sink += iHash64(buffer.data(), FRAME, i);
+    double hash = seconds(t0) / ROUNDS;
+    t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < ROUNDS / 10; i++)
+        sink += iPackChecksum(buffer.data(), FRAME);
+    double crc = seconds(t0) / (ROUNDS / 10);
+    printf("320x240 RGBA8 frame: iHash64 %.1f us (%.1f GB/s), CRC-32C %.1f us (%.1f GB/s)  [%llx]\n",
+           hash * 1e6, FRAME / hash / 1e9, crc * 1e6, FRAME / crc / 1e9, (unsigned long long)(sink & 0xf));
+#ifdef __SWITCH__
+    consoleUpdate(NULL);
+    consoleExit(NULL);
+#endif
+    return 0;
+}
@@ -22,9 +22,9 @@
 #include "hleDSP.h"
 #include "iCPU.h"
 #include "ki.h"
+#include "iInput.h"
 
 // -------------------------- Globals --------------------------
-extern WORD inputs[4];
 bool hleFMVDelay = false;
 
 float ident[16] = {
@@ -93,51 +93,6 @@ void hleDmaCopy(void* dst, const void* src, size_t size) { hleMemCpy(dst, src, s
 void* hleAlloc(size_t size) { return malloc(size); }
 void hleFree(void* ptr) { if(ptr) free(ptr); }
 
-// -------------------------- Input HLE --------------------------
-InputHLE_Extended gInputHLE(2); // Two controllers
-
-void hleKeyInput() {
-    gInputHLE.Poll();
-    ExtendedController& ctrl = gInputHLE.GetController(0);
-
-    inputs[0] = 0;
-    if(ctrl.GetButton(Button::A))      inputs[0] |= 0x0001;
-    if(ctrl.GetButton(Button::B))      inputs[0] |= 0x0002;
-    if(ctrl.GetButton(Button::X))      inputs[0] |= 0x0004;
-    if(ctrl.GetButton(Button::Y))      inputs[0] |= 0x0008;
-    if(ctrl.GetButton(Button::L1))     inputs[0] |= 0x0010;
-    if(ctrl.GetButton(Button::R1))     inputs[0] |= 0x0020;
-    if(ctrl.GetButton(Button::L2))     inputs[0] |= 0x0040;
-    if(ctrl.GetButton(Button::R2))     inputs[0] |= 0x0080;
-    if(ctrl.GetButton(Button::Start))  inputs[0] |= 0x0100;
-    if(ctrl.GetButton(Button::Select)) inputs[0] |= 0x0200;
-    if(ctrl.GetButton(Button::Up))     inputs[0] |= 0x0400;
-    if(ctrl.GetButton(Button::Down))   inputs[0] |= 0x0800;
-    if(ctrl.GetButton(Button::Left))   inputs[0] |= 0x1000;
-    if(ctrl.GetButton(Button::Right))  inputs[0] |= 0x2000;
-    if(ctrl.GetButton(Button::LS))     inputs[0] |= 0x4000;
-    if(ctrl.GetButton(Button::RS))     inputs[0] |= 0x8000;
-
-    float lx, ly, rx, ry;
-    ctrl.GetLeftStick(lx, ly);
-    ctrl.GetRightStick(rx, ry);
-
-    auto StickToWord = [](float f)->WORD { return WORD((std::clamp(f, -1.0f,1.0f)+1.0f)*0.5f*65535.0f); };
-    r->GPR[A0*2] = StickToWord(lx);
-    r->GPR[A1*2] = StickToWord(ly);
-    r->GPR[A2*2] = StickToWord(rx);
-    r->GPR[A3*2] = StickToWord(ry);
-
-    float gx, gy, gz, ax, ay, az;
-    ctrl.GetGyro(gx, gy, gz);
-    ctrl.GetAccel(ax, ay, az);
-    r->FPR[0] = gx; r->FPR[1] = gy; r->FPR[2] = gz;
-    r->FPR[3] = ax; r->FPR[4] = ay; r->FPR[5] = az;
-}
-
-// -------------------------- HLE Timer --------------------------
-HLETimer gTimer;
-
 // -------------------------- Audio --------------------------
 AudioHLE gAudioHLE(44100,16);
 
@@ -189,10 +144,10 @@ void GPUDrawTriangle(const Vertex& v0,const Vertex& v1,const Vertex& v2) {
 void HLERun() {
     GPUInit(640,480);
     gAudioHLE.Start();
-    gTimer.Start(60, [](){ hleKeyInput(); }); // 60Hz HLE input poll
+    iInputStart();
 
     while(appletMainLoop()) {
-        // Input + Timer handled by HLETimer & hleKeyInput
+        // the pads are iInput's, latched by the CPU thread at VSYNC
         // Render placeholder
         GPUClear(Color{0,0,0,255});
 
@@ -210,6 +165,6 @@ void HLERun() {
         std::this_thread::sleep_for(std::chrono::milliseconds(16)); // ~60fps
     }
 
-    gTimer.Stop();
+    iInputStop();
     gAudioHLE.Stop();
 }
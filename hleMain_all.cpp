@@ -8,6 +8,9 @@
 #include "dynaFP.h"
 #include "hleDSP.h"
 #include "iCPU.h"
+#include "hleMixer.h"
+#include "hleRaster.h"
+#include "hlePresent.h"
 
 
 
@@ -185,86 +188,41 @@ void hleFree(void* ptr) { if(ptr) free(ptr); }
 const int HLE_AUDIO_SAMPLE_RATE = 44100;
 const int HLE_AUDIO_BUFFER_SIZE = 4096;
 
-float hleAudioBuffer[HLE_AUDIO_BUFFER_SIZE];
-std::atomic<size_t> hleAudioWritePos(0);
-
-std::mutex hleAudioMutex;
-
-struct HLEAudioChannel {
-    bool active = false;
-    float frequency = 440.0f;
-    float amplitude = 0.5f;
-    float phase = 0.0f;
-    enum Waveform { SINE, SQUARE, TRIANGLE, SAW } waveform = SINE;
-
-    void mix(float* buffer, size_t samples) {
-        if(!active) return;
-        float phaseInc = 2.f * 3.14159265f * frequency / HLE_AUDIO_SAMPLE_RATE;
-        for(size_t i = 0; i < samples; i++) {
-            float sample = 0.f;
-            switch(waveform) {
-                case SINE: sample = std::sin(phase); break;
-                case SQUARE: sample = (phase < 3.14159265f) ? 1.f : -1.f; break;
-                case TRIANGLE: sample = 2.f * std::abs(2.f*(phase/(2.f*3.14159265f) - std::floor(phase/(2.f*3.14159265f)+0.5f))) - 1.f; break;
-                case SAW: sample = 2.f*(phase/(2.f*3.14159265f) - std::floor(phase/(2.f*3.14159265f)+0.5f)); break;
-            }
-            buffer[i] += sample * amplitude;
-            phase += phaseInc;
-            if(phase > 2.f * 3.14159265f) phase -= 2.f * 3.14159265f;
-        }
-    }
-};
-
-HLEAudioChannel hleChannels[16];
+// hleMixer does the mixing; the AX calls only queue parameter changes for it,
+// so neither the game thread nor the tick takes a lock
+float hleAudioLeft[HLE_AUDIO_BUFFER_SIZE];
+float hleAudioRight[HLE_AUDIO_BUFFER_SIZE];
+int16_t hleAudioOut[HLE_AUDIO_BUFFER_SIZE * 2];
 
 // Initialize NDSP audio
 void AXInit() {
-    std::lock_guard<std::mutex> lock(hleAudioMutex);
     ndspInit();
-    for(auto& ch : hleChannels) ch.active = false;
-    memset(hleAudioBuffer, 0, sizeof(hleAudioBuffer));
+    hleMixInit(HLE_AUDIO_SAMPLE_RATE);
 }
 
 // Play tone
-void AXPlayTone(int channel, float freq, float amplitude=0.5f, HLEAudioChannel::Waveform wave=HLEAudioChannel::SINE) {
-    if(channel < 0 || channel >= 16) return;
-    hleChannels[channel].frequency = freq;
-    hleChannels[channel].amplitude = amplitude;
-    hleChannels[channel].waveform = wave;
-    hleChannels[channel].phase = 0.f;
-    hleChannels[channel].active = true;
+void AXPlayTone(int channel, float freq, float amplitude=0.5f, int wave=HLE_WAVE_SINE) {
+    hleMixPlay(channel, freq, amplitude, wave);
 }
 
 // Stop tone
 void AXStop(int channel) {
-    if(channel < 0 || channel >= 16) return;
-    hleChannels[channel].active = false;
+    hleMixStop(channel);
 }
 
 // Mix all channels into buffer
-void AXMix(float* outBuffer, size_t samples) {
-    std::lock_guard<std::mutex> lock(hleAudioMutex);
-    memset(outBuffer, 0, samples*sizeof(float));
-    for(int i=0;i<16;i++)
-        hleChannels[i].mix(outBuffer, samples);
+void AXMix(float* left, float* right, size_t samples) {
+    hleMix(left, right, (int)samples);
 }
 
 // Update NDSP buffer
 void AXUpdateBuffer() {
-    std::lock_guard<std::mutex> lock(hleAudioMutex);
-
-    // Prepare a stereo buffer
-    static float ndspBuf[HLE_AUDIO_BUFFER_SIZE*2];
-    AXMix(hleAudioBuffer, HLE_AUDIO_BUFFER_SIZE);
-
-    for(size_t i=0;i<HLE_AUDIO_BUFFER_SIZE;i++){
-        ndspBuf[i*2] = hleAudioBuffer[i];
-        ndspBuf[i*2+1] = hleAudioBuffer[i];
-    }
+    AXMix(hleAudioLeft, hleAudioRight, HLE_AUDIO_BUFFER_SIZE);
+    hleMixInterleave(hleAudioOut, hleAudioLeft, hleAudioRight, HLE_AUDIO_BUFFER_SIZE);
 
     ndspWaveBuf wave;
     memset(&wave, 0, sizeof(wave));
-    wave.data_vaddr = ndspBuf;
+    wave.data_vaddr = hleAudioOut;
     wave.nsamples = HLE_AUDIO_BUFFER_SIZE;
     wave.looping = false;
     wave.status = NDSP_WBUF_DONE;
@@ -511,52 +469,57 @@ struct Color {
         : r(_r), g(_g), b(_b), a(_a) {}
 };
 
-std::vector<Color> framebuffer;
+// Color is RGBA8 in memory, so hlePresent's free buffer is hleRaster's target
+// as is: a frame is drawn straight into it and submitted, and the next free
+// one becomes the framebuffer. That one last held a frame from two flushes
+// back, so a frame starts with GPUClear.
+// Triangles are binned by hleRaster and drawn on its pool at the next flush;
+// fbMutex only keeps GPUSetPixel and the flush from interleaving.
+Color* framebuffer = nullptr;
 int fbWidth  = 1280; // Default Switch top screen width
 int fbHeight = 720;  // Default Switch top screen height
 std::mutex fbMutex;
 
+static uint32_t GPUPacked(const Color& c) {
+    return (c.a<<24)|(c.b<<16)|(c.g<<8)|c.r;
+}
+
 // ------------------------ GPU Init ------------------------
 
-void GPUInit(int width=1280, int height=720) {
+// HLE_PRESENT_NULL runs everything but the display, for benchmarks
+void GPUInit(int width=1280, int height=720, int present=HLE_PRESENT_SWITCH) {
     std::lock_guard<std::mutex> lock(fbMutex);
     fbWidth = width;
     fbHeight = height;
-    framebuffer.resize(fbWidth * fbHeight, Color(0,0,0,255));
+    hlePresentInit(fbWidth, fbHeight, present);
+    framebuffer = (Color*)hlePresentBuffer();
+    hleRasterInit(HLE_RASTER_WORKERS);
+    hleRasterTarget((uint32_t*)framebuffer, fbWidth, fbHeight);
 }
 
 // Clear framebuffer with color
 void GPUClear(const Color& c) {
-    std::lock_guard<std::mutex> lock(fbMutex);
-    std::fill(framebuffer.begin(), framebuffer.end(), c);
+    hleRasterClear(GPUPacked(c));
 }
 
-// Draw pixel
+// Draw pixel; drawn triangles land first
 void GPUSetPixel(int x, int y, const Color& c) {
     if(x<0 || x>=fbWidth || y<0 || y>=fbHeight) return;
     std::lock_guard<std::mutex> lock(fbMutex);
+    hleRasterFlush();
     framebuffer[y * fbWidth + x] = c;
 }
 
 // ------------------------ Framebuffer Swap to Switch ------------------------
 
+// Hands the frame to hlePresent, whose thread converts it into the swapchain,
+// and draws on in the buffer it gives back; this never waits for the display
 void GPUFlushToScreen() {
     std::lock_guard<std::mutex> lock(fbMutex);
-
-    Framebuffer fb;
-    Result rc = framebufCreate(&fb, fbWidth, fbHeight, PIXEL_FORMAT_RGBA_8888, 2);
-    if(R_FAILED(rc)) return;
-
-    uint32_t* fbPtr = (uint32_t*)fb.addr[0];
-    for(int y=0; y<fbHeight; y++) {
-        for(int x=0; x<fbWidth; x++) {
-            const Color& c = framebuffer[y*fbWidth + x];
-            fbPtr[y*fbWidth + x] = (c.a<<24)|(c.b<<16)|(c.g<<8)|c.r;
-        }
-    }
-
-    framebufFlush(&fb);
-    framebufFree(&fb);
+    hleRasterFlush();
+    hlePresentSubmit();
+    framebuffer = (Color*)hlePresentBuffer();
+    hleRasterTarget((uint32_t*)framebuffer, fbWidth, fbHeight);
 }
 
 // ------------------------ GPU Draw Triangle (flat) ------------------------
@@ -564,35 +527,18 @@ void GPUFlushToScreen() {
 struct Vertex {
     float x, y, z;
     Color color;
+    float u, v;
 };
 
-static float EdgeFunction(const Vertex& a, const Vertex& b, float px, float py) {
-    return (px - a.x)*(b.y - a.y) - (py - a.y)*(b.x - a.x);
+// z is the view depth texture coordinates are corrected by; 0 maps them flat
+static HLERASTERVERTEX GPURasterVertex(const Vertex& v) {
+    return { v.x, v.y, float(v.color.r), float(v.color.g), float(v.color.b), v.u, v.v, v.z };
 }
 
+// Either winding is drawn; the fill rule gives shared edges to one triangle
 void GPUDrawTriangle(const Vertex& v0, const Vertex& v1, const Vertex& v2) {
-    int minX = std::max(0, int(std::floor(std::min({v0.x, v1.x, v2.x}))));
-    int maxX = std::min(fbWidth-1, int(std::ceil(std::max({v0.x, v1.x, v2.x}))));
-    int minY = std::max(0, int(std::floor(std::min({v0.y, v1.y, v2.y}))));
-    int maxY = std::min(fbHeight-1, int(std::ceil(std::max({v0.y, v1.y, v2.y}))));
-
-    float area = EdgeFunction(v0, v1, v2.x, v2.y);
-    if(std::abs(area) < 1e-6f) return; // degenerate triangle
-
-    for(int y=minY; y<=maxY; y++) {
-        for(int x=minX; x<=maxX; x++) {
-            float w0 = EdgeFunction(v1, v2, x+0.5f, y+0.5f);
-            float w1 = EdgeFunction(v2, v0, x+0.5f, y+0.5f);
-            float w2 = EdgeFunction(v0, v1, x+0.5f, y+0.5f);
-            if(w0>=0 && w1>=0 && w2>=0) {
-                float sum = w0 + w1 + w2;
-                uint8_t r = uint8_t((v0.color.r*w0 + v1.color.r*w1 + v2.color.r*w2)/sum);
-                uint8_t g = uint8_t((v0.color.g*w0 + v1.color.g*w1 + v2.color.g*w2)/sum);
-                uint8_t b = uint8_t((v0.color.b*w0 + v1.color.b*w1 + v2.color.b*w2)/sum);
-                GPUSetPixel(x, y, Color(r,g,b,255));
-            }
-        }
-    }
+    HLERASTERVERTEX r0 = GPURasterVertex(v0), r1 = GPURasterVertex(v1), r2 = GPURasterVertex(v2);
+    hleRasterTriangle(&r0, &r1, &r2, nullptr);
 }
 
 // ------------------------ GPU Draw Textured Triangle ------------------------
@@ -610,37 +556,20 @@ struct Texture {
     }
 };
 
-void GPUDrawTexturedTriangle(const Vertex& v0, const Vertex& v1, const Vertex& v2, const Texture& tex) {
-    int minX = std::max(0, int(std::floor(std::min({v0.x, v1.x, v2.x}))));
-    int maxX = std::min(fbWidth-1, int(std::ceil(std::max({v0.x, v1.x, v2.x}))));
-    int minY = std::max(0, int(std::floor(std::min({v0.y, v1.y, v2.y}))));
-    int maxY = std::min(fbHeight-1, int(std::ceil(std::max({v0.y, v1.y, v2.y}))));
-
-    auto Edge = [](const Vertex& a, const Vertex& b, float px, float py) {
-        return (px - a.x)*(b.y - a.y) - (py - a.y)*(b.x - a.x);
-    };
-
-    float area = Edge(v0, v1, v2.x, v2.y);
-    if(std::abs(area) < 1e-6f) return;
-
-    for(int y=minY; y<=maxY; y++) {
-        for(int x=minX; x<=maxX; x++) {
-            float w0 = Edge(v1, v2, x+0.5f, y+0.5f);
-            float w1 = Edge(v2, v0, x+0.5f, y+0.5f);
-            float w2 = Edge(v0, v1, x+0.5f, y+0.5f);
-            if(w0>=0 && w1>=0 && w2>=0) {
-                float sum = w0 + w1 + w2;
-                float u = (v0.u*w0 + v1.u*w1 + v2.u*w2)/sum;
-                float v = (v0.v*w0 + v1.v*w1 + v2.v*w2)/sum;
-                GPUSetPixel(x, y, tex.Sample(u,v));
-            }
-        }
-    }
+// hleRaster keeps its own blocked copy of tex, made the first time these
+// texels are drawn; tex.data may change between frames but not within one
+void GPUDrawTexturedTriangle(const Vertex& v0, const Vertex& v1, const Vertex& v2, const Texture& tex,
+                             bool bilinear=false) {
+    HLERASTERVERTEX r0 = GPURasterVertex(v0), r1 = GPURasterVertex(v1), r2 = GPURasterVertex(v2);
+    hleRasterTriangle(&r0, &r1, &r2, hleRasterTexture((const uint32_t*)tex.data.data(), tex.width, tex.height), bilinear);
 }
 
 // ------------------------ GPU Framebuffer Access ------------------------
 
-const std::vector<Color>& GPUGetFramebuffer() {
+// The frame being drawn, fbWidth x fbHeight; it changes at each flush
+const Color* GPUGetFramebuffer() {
+    std::lock_guard<std::mutex> lock(fbMutex);
+    hleRasterFlush();
     return framebuffer;
 }
 
@@ -681,6 +610,8 @@ public:
         if(mainLoopThread.joinable())
             mainLoopThread.join();
 
+        hleRasterShutdown();
+        hlePresentShutdown();
         audio.Stop();
         hidExit();
         std::cout << "HLESystem stopped.\n";
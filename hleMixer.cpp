@@ -0,0 +1,358 @@
+// Tone mixer
+//
+// Each voice is a 32-bit phase accumulator. The phase read as a signed
+// fraction x in [-1, 1) is the saw; the square is its sign, the triangle
+// 2|x| - 1 and the sine a corrected parabola of x (error < 0.1%). All four
+// are formed in every lane and combined through one-hot weights, so four
+// voices of any waveforms share one branch-free pass. Lane results collect in
+// per-sample vectors that are reduced to left/right once every voice group is
+// done.
+
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include "hleMixer.h"
+
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#include <xmmintrin.h>
+#endif
+
+enum { HLE_MIX_PLAY, HLE_MIX_STOP, HLE_MIX_PAN };
+
+struct HLEMIXCMD {
+    uint8_t op;
+    uint8_t voice;
+    uint8_t wave;
+    float   a;          // PLAY: frequency, PAN: pan
+    float   b;          // PLAY: amplitude
+};
+
+// producer writes head, consumer writes tail, on separate lines
+struct HLEMIXQUEUE {
+    alignas(64) std::atomic<uint32_t> head;
+    alignas(64) std::atomic<uint32_t> tail;
+    HLEMIXCMD data[HLE_MIX_QUEUE];
+};
+
+struct HLEMIXVOICE {
+    float freq;
+    float amplitude;
+    float pan;
+    HLEWAVE wave;
+    bool  active;
+};
+
+static HLEMIXQUEUE hleMixQueue;
+static HLEMIXVOICE hleMixVoice[HLE_MIX_VOICES];
+static uint32_t    hleMixRate = 48000;
+static int         hleMixGroups = 0;        // groups up to the last active voice
+
+// lane state, four voices per group
+alignas(16) static uint32_t hleMixPhase[HLE_MIX_VOICES];
+alignas(16) static uint32_t hleMixInc[HLE_MIX_VOICES];
+alignas(16) static float    hleMixGainL[HLE_MIX_VOICES];
+alignas(16) static float    hleMixGainR[HLE_MIX_VOICES];
+alignas(16) static float    hleMixWeight[4][HLE_MIX_VOICES];    // sine, square, triangle, saw
+
+// per-sample lane sums
+alignas(16) static float    hleMixAccL[HLE_MIX_CHUNK * 4];
+alignas(16) static float    hleMixAccR[HLE_MIX_CHUNK * 4];
+
+// ---------------------- LANES ----------------------
+
+#if defined(__aarch64__)
+typedef float32x4_t HLEV4;
+typedef uint32x4_t  HLEU4;
+static inline HLEV4 v4Load(const float* p)            { return vld1q_f32(p); }
+static inline void  v4Store(float* p, HLEV4 a)        { vst1q_f32(p, a); }
+static inline HLEV4 v4Splat(float f)                  { return vdupq_n_f32(f); }
+static inline HLEV4 v4Add(HLEV4 a, HLEV4 b)           { return vaddq_f32(a, b); }
+static inline HLEV4 v4Sub(HLEV4 a, HLEV4 b)           { return vsubq_f32(a, b); }
+static inline HLEV4 v4Mul(HLEV4 a, HLEV4 b)           { return vmulq_f32(a, b); }
+static inline HLEV4 v4Abs(HLEV4 a)                    { return vabsq_f32(a); }
+static inline HLEU4 u4Load(const uint32_t* p)         { return vld1q_u32(p); }
+static inline void  u4Store(uint32_t* p, HLEU4 a)     { vst1q_u32(p, a); }
+static inline HLEU4 u4Add(HLEU4 a, HLEU4 b)           { return vaddq_u32(a, b); }
+static inline HLEV4 v4Saw(HLEU4 p)                    { return vcvtq_n_f32_s32(vreinterpretq_s32_u32(p), 31); }
+static inline HLEV4 v4Sign(HLEU4 p)                   { return vcvtq_f32_s32(vorrq_s32(vshrq_n_s32(vreinterpretq_s32_u32(p), 31), vdupq_n_s32(1))); }
+static inline HLEV4 v4Sum4(HLEV4 a, HLEV4 b, HLEV4 c, HLEV4 d) { return vpaddq_f32(vpaddq_f32(a, b), vpaddq_f32(c, d)); }
+#elif defined(__SSE2__)
+typedef __m128  HLEV4;
+typedef __m128i HLEU4;
+static inline HLEV4 v4Load(const float* p)            { return _mm_load_ps(p); }
+static inline void  v4Store(float* p, HLEV4 a)        { _mm_store_ps(p, a); }
+static inline HLEV4 v4Splat(float f)                  { return _mm_set1_ps(f); }
+static inline HLEV4 v4Add(HLEV4 a, HLEV4 b)           { return _mm_add_ps(a, b); }
+static inline HLEV4 v4Sub(HLEV4 a, HLEV4 b)           { return _mm_sub_ps(a, b); }
+static inline HLEV4 v4Mul(HLEV4 a, HLEV4 b)           { return _mm_mul_ps(a, b); }
+static inline HLEV4 v4Abs(HLEV4 a)                    { return _mm_andnot_ps(_mm_set1_ps(-0.f), a); }
+static inline HLEU4 u4Load(const uint32_t* p)         { return _mm_load_si128((const __m128i*)p); }
+static inline void  u4Store(uint32_t* p, HLEU4 a)     { _mm_store_si128((__m128i*)p, a); }
+static inline HLEU4 u4Add(HLEU4 a, HLEU4 b)           { return _mm_add_epi32(a, b); }
+static inline HLEV4 v4Saw(HLEU4 p)                    { return _mm_mul_ps(_mm_cvtepi32_ps(p), _mm_set1_ps(1.f / 2147483648.f)); }
+static inline HLEV4 v4Sign(HLEU4 p)                   { return _mm_cvtepi32_ps(_mm_or_si128(_mm_srai_epi32(p, 31), _mm_set1_epi32(1))); }
+static inline HLEV4 v4Sum4(HLEV4 a, HLEV4 b, HLEV4 c, HLEV4 d)
+{
+    _MM_TRANSPOSE4_PS(a, b, c, d);
+    return _mm_add_ps(_mm_add_ps(a, b), _mm_add_ps(c, d));
+}
+#else
+struct HLEV4 { float v[4]; };
+struct HLEU4 { uint32_t v[4]; };
+#define HLE_LANES(r, e)  for (int l = 0; l < 4; l++) r.v[l] = (e); return r
+static inline HLEV4 v4Load(const float* p)            { HLEV4 r; HLE_LANES(r, p[l]); }
+static inline void  v4Store(float* p, HLEV4 a)        { for (int l = 0; l < 4; l++) p[l] = a.v[l]; }
+static inline HLEV4 v4Splat(float f)                  { HLEV4 r; HLE_LANES(r, f); }
+static inline HLEV4 v4Add(HLEV4 a, HLEV4 b)           { HLEV4 r; HLE_LANES(r, a.v[l] + b.v[l]); }
+static inline HLEV4 v4Sub(HLEV4 a, HLEV4 b)           { HLEV4 r; HLE_LANES(r, a.v[l] - b.v[l]); }
+static inline HLEV4 v4Mul(HLEV4 a, HLEV4 b)           { HLEV4 r; HLE_LANES(r, a.v[l] * b.v[l]); }
+static inline HLEV4 v4Abs(HLEV4 a)                    { HLEV4 r; HLE_LANES(r, a.v[l] < 0 ? -a.v[l] : a.v[l]); }
+static inline HLEU4 u4Load(const uint32_t* p)         { HLEU4 r; HLE_LANES(r, p[l]); }
+static inline void  u4Store(uint32_t* p, HLEU4 a)     { for (int l = 0; l < 4; l++) p[l] = a.v[l]; }
+static inline HLEU4 u4Add(HLEU4 a, HLEU4 b)           { HLEU4 r; HLE_LANES(r, a.v[l] + b.v[l]); }
+static inline HLEV4 v4Saw(HLEU4 p)                    { HLEV4 r; HLE_LANES(r, (float)(int32_t)p.v[l] * (1.f / 2147483648.f)); }
+static inline HLEV4 v4Sign(HLEU4 p)                   { HLEV4 r; HLE_LANES(r, (int32_t)p.v[l] < 0 ? -1.f : 1.f); }
+static inline HLEV4 v4Sum4(HLEV4 a, HLEV4 b, HLEV4 c, HLEV4 d)
+{
+    HLEV4 r;
+    for (int l = 0; l < 4; l++)
+    {
+        const HLEV4& s = (l == 0) ? a : (l == 1) ? b : (l == 2) ? c : d;
+        r.v[l] = s.v[0] + s.v[1] + s.v[2] + s.v[3];
+    }
+    return r;
+}
+#undef HLE_LANES
+#endif
+
+// ---------------------- COMMANDS ----------------------
+
+static bool hleMixPush(const HLEMIXCMD& cmd)
+{
+    uint32_t head = hleMixQueue.head.load(std::memory_order_relaxed);
+    if (head - hleMixQueue.tail.load(std::memory_order_acquire) == HLE_MIX_QUEUE)
+        return false;
+
+    hleMixQueue.data[head & (HLE_MIX_QUEUE - 1)] = cmd;
+    hleMixQueue.head.store(head + 1, std::memory_order_release);
+    return true;
+}
+
+bool hleMixPlay(int voice, float freq, float amplitude, int wave)
+{
+    if (voice < 0 || voice >= HLE_MIX_VOICES)
+        return false;
+    HLEMIXCMD cmd = { HLE_MIX_PLAY, (uint8_t)voice, (uint8_t)wave, freq, amplitude };
+    return hleMixPush(cmd);
+}
+
+bool hleMixStop(int voice)
+{
+    if (voice < 0 || voice >= HLE_MIX_VOICES)
+        return false;
+    HLEMIXCMD cmd = { HLE_MIX_STOP, (uint8_t)voice, 0, 0.f, 0.f };
+    return hleMixPush(cmd);
+}
+
+bool hleMixPan(int voice, float pan)
+{
+    if (voice < 0 || voice >= HLE_MIX_VOICES)
+        return false;
+    HLEMIXCMD cmd = { HLE_MIX_PAN, (uint8_t)voice, 0, pan, 0.f };
+    return hleMixPush(cmd);
+}
+
+// Derive the lane state of one voice from its parameters
+static void hleMixVoiceUpdate(int n)
+{
+    HLEMIXVOICE* v = &hleMixVoice[n];
+    float pan  = v->pan < -1.f ? -1.f : v->pan > 1.f ? 1.f : v->pan;
+    float gain = v->active ? v->amplitude : 0.f;
+
+    // centred is full amplitude on both sides, as the mono mixer was
+    hleMixGainL[n] = gain * (pan > 0.f ? 1.f - pan : 1.f);
+    hleMixGainR[n] = gain * (pan < 0.f ? 1.f + pan : 1.f);
+
+    double freq = v->freq < 0.f ? 0.0 : v->freq;
+    if (freq > hleMixRate / 2)
+        freq = hleMixRate / 2;
+    hleMixInc[n] = (uint32_t)(freq / hleMixRate * 4294967296.0);
+
+    for (int w = 0; w < 4; w++)
+        hleMixWeight[w][n] = (v->wave == w) ? 1.f : 0.f;
+}
+
+static void hleMixApply()
+{
+    uint32_t tail = hleMixQueue.tail.load(std::memory_order_relaxed);
+    uint32_t head = hleMixQueue.head.load(std::memory_order_acquire);
+    if (head == tail)
+        return;
+
+    for (; tail != head; tail++)
+    {
+        const HLEMIXCMD& cmd = hleMixQueue.data[tail & (HLE_MIX_QUEUE - 1)];
+        HLEMIXVOICE* v = &hleMixVoice[cmd.voice];
+        switch (cmd.op)
+        {
+        case HLE_MIX_PLAY:
+            v->freq = cmd.a;
+            v->amplitude = cmd.b;
+            v->wave = (cmd.wave <= HLE_WAVE_SAW) ? (HLEWAVE)cmd.wave : HLE_WAVE_SINE;
+            v->active = true;
+            hleMixPhase[cmd.voice] = 0;
+            break;
+        case HLE_MIX_STOP:
+            v->active = false;
+            break;
+        case HLE_MIX_PAN:
+            v->pan = cmd.a;
+            break;
+        }
+        hleMixVoiceUpdate(cmd.voice);
+    }
+    hleMixQueue.tail.store(tail, std::memory_order_release);
+
+    hleMixGroups = 0;
+    for (int n = 0; n < HLE_MIX_VOICES; n++)
+        if (hleMixVoice[n].active)
+            hleMixGroups = n / 4 + 1;
+}
+
+void hleMixInit(uint32_t rate)
+{
+    hleMixRate = rate ? rate : 48000;
+    hleMixQueue.head.store(0, std::memory_order_relaxed);
+    hleMixQueue.tail.store(0, std::memory_order_relaxed);
+    hleMixGroups = 0;
+
+    for (int n = 0; n < HLE_MIX_VOICES; n++)
+    {
+        hleMixVoice[n].freq = 440.f;
+        hleMixVoice[n].amplitude = 0.5f;
+        hleMixVoice[n].pan = 0.f;
+        hleMixVoice[n].wave = HLE_WAVE_SINE;
+        hleMixVoice[n].active = false;
+        hleMixPhase[n] = 0;
+        hleMixVoiceUpdate(n);
+    }
+}
+
+// ---------------------- MIXER ----------------------
+
+static void hleMixGroup(int g, int count)
+{
+    int base = g * 4;
+    HLEU4 phase = u4Load(&hleMixPhase[base]);
+    HLEU4 inc   = u4Load(&hleMixInc[base]);
+    HLEV4 gl    = v4Load(&hleMixGainL[base]);
+    HLEV4 gr    = v4Load(&hleMixGainR[base]);
+    HLEV4 wsin  = v4Load(&hleMixWeight[HLE_WAVE_SINE][base]);
+    HLEV4 wsqr  = v4Load(&hleMixWeight[HLE_WAVE_SQUARE][base]);
+    HLEV4 wtri  = v4Load(&hleMixWeight[HLE_WAVE_TRIANGLE][base]);
+    HLEV4 wsaw  = v4Load(&hleMixWeight[HLE_WAVE_SAW][base]);
+    HLEV4 one   = v4Splat(1.f);
+    HLEV4 two   = v4Splat(2.f);
+    HLEV4 four  = v4Splat(4.f);
+    HLEV4 fix   = v4Splat(0.225f);
+
+    for (int i = 0; i < count; i++)
+    {
+        HLEV4 x  = v4Saw(phase);
+        HLEV4 ax = v4Abs(x);
+
+        // sin(pi x): 4x(1 - |x|), then y + 0.225 (y|y| - y)
+        HLEV4 y   = v4Mul(four, v4Mul(x, v4Sub(one, ax)));
+        HLEV4 sn  = v4Add(y, v4Mul(fix, v4Sub(v4Mul(y, v4Abs(y)), y)));
+        HLEV4 tri = v4Sub(v4Mul(two, ax), one);
+        HLEV4 sqr = v4Sign(phase);
+
+        HLEV4 s = v4Add(v4Add(v4Mul(wsin, sn), v4Mul(wsqr, sqr)),
+                        v4Add(v4Mul(wtri, tri), v4Mul(wsaw, x)));
+
+        v4Store(&hleMixAccL[i * 4], v4Add(v4Load(&hleMixAccL[i * 4]), v4Mul(gl, s)));
+        v4Store(&hleMixAccR[i * 4], v4Add(v4Load(&hleMixAccR[i * 4]), v4Mul(gr, s)));
+        phase = u4Add(phase, inc);
+    }
+    u4Store(&hleMixPhase[base], phase);
+}
+
+// Reduce the four lane sums of each sample to one, four samples at a time
+static void hleMixReduce(float* out, const float* acc, int count)
+{
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        HLEV4 s = v4Sum4(v4Load(acc + i * 4), v4Load(acc + i * 4 + 4),
+                         v4Load(acc + i * 4 + 8), v4Load(acc + i * 4 + 12));
+        alignas(16) float tmp[4];
+        v4Store(tmp, s);
+        memcpy(out + i, tmp, sizeof(tmp));
+    }
+    for (; i < count; i++)
+        out[i] = acc[i * 4] + acc[i * 4 + 1] + acc[i * 4 + 2] + acc[i * 4 + 3];
+}
+
+// left/right = sum of every active voice, samples at the init rate
+void hleMix(float* left, float* right, int samples)
+{
+    hleMixApply();
+
+    for (int done = 0; done < samples; )
+    {
+        int count = samples - done;
+        if (count > HLE_MIX_CHUNK)
+            count = HLE_MIX_CHUNK;
+
+        memset(hleMixAccL, 0, count * 4 * sizeof(float));
+        memset(hleMixAccR, 0, count * 4 * sizeof(float));
+        for (int g = 0; g < hleMixGroups; g++)
+            hleMixGroup(g, count);
+
+        hleMixReduce(left + done, hleMixAccL, count);
+        hleMixReduce(right + done, hleMixAccR, count);
+        done += count;
+    }
+}
+
+// Saturate [-1, 1] float left/right into interleaved 16-bit stereo
+void hleMixInterleave(int16_t* out, const float* left, const float* right, int samples)
+{
+    int i = 0;
+#if defined(__aarch64__)
+    float32x4_t scale = vdupq_n_f32(32767.f);
+    for (; i + 8 <= samples; i += 8)
+    {
+        int16x8x2_t lr;
+        lr.val[0] = vcombine_s16(vqmovn_s32(vcvtnq_s32_f32(vmulq_f32(vld1q_f32(left + i), scale))),
+                                 vqmovn_s32(vcvtnq_s32_f32(vmulq_f32(vld1q_f32(left + i + 4), scale))));
+        lr.val[1] = vcombine_s16(vqmovn_s32(vcvtnq_s32_f32(vmulq_f32(vld1q_f32(right + i), scale))),
+                                 vqmovn_s32(vcvtnq_s32_f32(vmulq_f32(vld1q_f32(right + i + 4), scale))));
+        vst2q_s16(out + i * 2, lr);
+    }
+#elif defined(__SSE2__)
+    // clamp first: cvtps turns anything past int32 into 0x80000000
+    __m128 scale = _mm_set1_ps(32767.f), hi = _mm_set1_ps(1.f), lo = _mm_set1_ps(-1.f);
+    for (; i + 8 <= samples; i += 8)
+    {
+        __m128i l0 = _mm_cvtps_epi32(_mm_mul_ps(_mm_max_ps(_mm_min_ps(_mm_loadu_ps(left + i), hi), lo), scale));
+        __m128i l1 = _mm_cvtps_epi32(_mm_mul_ps(_mm_max_ps(_mm_min_ps(_mm_loadu_ps(left + i + 4), hi), lo), scale));
+        __m128i r0 = _mm_cvtps_epi32(_mm_mul_ps(_mm_max_ps(_mm_min_ps(_mm_loadu_ps(right + i), hi), lo), scale));
+        __m128i r1 = _mm_cvtps_epi32(_mm_mul_ps(_mm_max_ps(_mm_min_ps(_mm_loadu_ps(right + i + 4), hi), lo), scale));
+        __m128i l = _mm_packs_epi32(l0, l1);
+        __m128i r = _mm_packs_epi32(r0, r1);
+        _mm_storeu_si128((__m128i*)(out + i * 2), _mm_unpacklo_epi16(l, r));
+        _mm_storeu_si128((__m128i*)(out + i * 2 + 8), _mm_unpackhi_epi16(l, r));
+    }
+#endif
+    for (; i < samples; i++)
+    {
+        float l = left[i] > 1.f ? 1.f : left[i] < -1.f ? -1.f : left[i];
+        float r = right[i] > 1.f ? 1.f : right[i] < -1.f ? -1.f : right[i];
+        out[i * 2]     = (int16_t)lrintf(l * 32767.f);
+        out[i * 2 + 1] = (int16_t)lrintf(r * 32767.f);
+    }
+}
@@ -0,0 +1,30 @@
+#ifndef HLEMIXER_H
+#define HLEMIXER_H
+
+#include <cstdint>
+
+// Tone mixer behind the AX* calls in hleMain_all.
+//
+// Phase-accumulator oscillators, mixed four voices at a time in SIMD lanes.
+// Voice parameters are changed through a single-producer/single-consumer
+// command queue: the game thread only ever queues, the mixer thread applies
+// the queue at the start of each hleMix call, so neither side locks.
+
+#define HLE_MIX_VOICES     64       // multiple of 4
+#define HLE_MIX_QUEUE      256      // commands, power of two
+#define HLE_MIX_CHUNK      256      // samples mixed per pass over the voices
+
+enum HLEWAVE { HLE_WAVE_SINE, HLE_WAVE_SQUARE, HLE_WAVE_TRIANGLE, HLE_WAVE_SAW };
+
+extern void hleMixInit(uint32_t rate);  // mixer stopped
+
+// Game thread; false when the queue is full or the voice does not exist
+extern bool hleMixPlay(int voice, float freq, float amplitude, int wave);
+extern bool hleMixStop(int voice);
+extern bool hleMixPan(int voice, float pan);   // -1 left .. 1 right
+
+// Mixer thread
+extern void hleMix(float* left, float* right, int samples);
+extern void hleMixInterleave(int16_t* out, const float* left, const float* right, int samples);
+
+#endif // HLEMIXER_H
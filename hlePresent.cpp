@@ -0,0 +1,256 @@
+#ifdef __SWITCH__
+#include <switch.h>
+#endif
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "hlePresent.h"
+
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define PRESENT_FRESH   0x4     // with a buffer index: submitted, not yet taken
+
+static int      presentBackend;
+static int      presentWidth, presentHeight;
+static bool     presentOpen = false;
+
+static std::vector<uint32_t> presentBuffers[HLE_PRESENT_BUFFERS];
+static std::vector<uint32_t> presentScratch;    // HLE_PRESENT_NULL's display
+static uint32_t              presentWriting;    // producer's
+static uint32_t              presentShowing;    // presenter's
+static std::atomic<uint32_t> presentReady;
+
+static std::thread             presentThread;
+static std::mutex              presentLock;     // sleeping and waking only
+static std::condition_variable presentWake;
+static bool                    presentQuit;
+
+static std::atomic<uint64_t> presentSubmitted, presentPresented, presentDropped;
+static std::atomic<uint64_t> presentConvertNs, presentTotalNs;
+
+static std::atomic<uint64_t> presentStamps[HLE_PRESENT_BUFFERS];
+static std::atomic<uint64_t> presentInputFrames, presentInputNs, presentInputWorstNs;
+
+#ifdef __SWITCH__
+static Framebuffer presentFb;
+#endif
+
+// ---------------------- CONVERT ----------------------
+
+// Color and RGBA_8888 are the same bytes on a little-endian host, so what
+// the old per-pixel packing amounted to is a copy; alpha is forced so the
+// layer never blends with what is behind it
+void hlePresentConvert(uint32_t* dst, size_t dstStride, const uint32_t* src, size_t srcStride,
+                       int width, int height)
+{
+    for (int y = 0; y < height; y++, dst += dstStride, src += srcStride)
+    {
+        int x = 0;
+#if defined(__aarch64__)
+        uint32x4_t opaque = vdupq_n_u32(0xff000000);
+        for (; x + 16 <= width; x += 16)
+        {
+            uint32x4x4_t p = vld1q_u32_x4(src + x);
+            p.val[0] = vorrq_u32(p.val[0], opaque);
+            p.val[1] = vorrq_u32(p.val[1], opaque);
+            p.val[2] = vorrq_u32(p.val[2], opaque);
+            p.val[3] = vorrq_u32(p.val[3], opaque);
+            vst1q_u32_x4(dst + x, p);
+        }
+#elif defined(__SSE2__)
+        __m128i opaque = _mm_set1_epi32((int)0xff000000);
+        for (; x + 16 <= width; x += 16)
+        {
+            __m128i p0 = _mm_loadu_si128((const __m128i*)(src + x));
+            __m128i p1 = _mm_loadu_si128((const __m128i*)(src + x + 4));
+            __m128i p2 = _mm_loadu_si128((const __m128i*)(src + x + 8));
+            __m128i p3 = _mm_loadu_si128((const __m128i*)(src + x + 12));
+            _mm_storeu_si128((__m128i*)(dst + x), _mm_or_si128(p0, opaque));
+            _mm_storeu_si128((__m128i*)(dst + x + 4), _mm_or_si128(p1, opaque));
+            _mm_storeu_si128((__m128i*)(dst + x + 8), _mm_or_si128(p2, opaque));
+            _mm_storeu_si128((__m128i*)(dst + x + 12), _mm_or_si128(p3, opaque));
+        }
+#endif
+        for (; x < width; x++)
+            dst[x] = src[x] | 0xff000000;
+    }
+}
+
+// ---------------------- PRESENTER ----------------------
+
+static uint64_t hlePresentNs(std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(to - from).count();
+}
+
+static void hlePresentShow(const uint32_t* frame)
+{
+    auto start = std::chrono::steady_clock::now();
+    auto converted = start;
+
+#ifdef __SWITCH__
+    if (presentBackend == HLE_PRESENT_SWITCH)
+    {
+        u32 stride;
+        uint32_t* out = (uint32_t*)framebufferBegin(&presentFb, &stride);
+        converted = std::chrono::steady_clock::now();
+        hlePresentConvert(out, stride / sizeof(uint32_t), frame, presentWidth, presentWidth, presentHeight);
+        auto done = std::chrono::steady_clock::now();
+        framebufferEnd(&presentFb);
+        presentConvertNs.store(hlePresentNs(converted, done), std::memory_order_relaxed);
+        presentTotalNs.store(hlePresentNs(start, std::chrono::steady_clock::now()), std::memory_order_relaxed);
+        return;
+    }
+#endif
+
+    hlePresentConvert(presentScratch.data(), presentWidth, frame, presentWidth, presentWidth, presentHeight);
+    uint64_t ns = hlePresentNs(converted, std::chrono::steady_clock::now());
+    presentConvertNs.store(ns, std::memory_order_relaxed);
+    presentTotalNs.store(ns, std::memory_order_relaxed);
+}
+
+static void hlePresentThread()
+{
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(presentLock);
+            presentWake.wait(lock, [] { return presentQuit || (presentReady.load(std::memory_order_acquire) & PRESENT_FRESH); });
+            if (presentQuit)
+                return;
+        }
+        presentShowing = presentReady.exchange(presentShowing, std::memory_order_acq_rel) & ~PRESENT_FRESH;
+        uint64_t stamp = presentStamps[presentShowing].exchange(0, std::memory_order_relaxed);
+        hlePresentShow(presentBuffers[presentShowing].data());
+        presentPresented.fetch_add(1, std::memory_order_relaxed);
+
+        if (!stamp)
+            continue;
+        uint64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+        uint64_t ns = now > stamp ? now - stamp : 0;
+        presentInputFrames.fetch_add(1, std::memory_order_relaxed);
+        presentInputNs.fetch_add(ns, std::memory_order_relaxed);
+        if (ns > presentInputWorstNs.load(std::memory_order_relaxed))
+            presentInputWorstNs.store(ns, std::memory_order_relaxed);
+    }
+}
+
+// ---------------------- CONTROL ----------------------
+
+bool hlePresentInit(int width, int height, int backend)
+{
+    hlePresentShutdown();
+
+#ifdef __SWITCH__
+    if (backend == HLE_PRESENT_SWITCH)
+    {
+        Result rc = framebufferCreate(&presentFb, nwindowGetDefault(), width, height,
+                                      PIXEL_FORMAT_RGBA_8888, HLE_PRESENT_SWAPCHAIN);
+        if (R_SUCCEEDED(rc))
+            rc = framebufferMakeLinear(&presentFb);
+        if (R_FAILED(rc))
+        {
+            printf("Present: no swapchain (%x), frames go nowhere\n", rc);
+            backend = HLE_PRESENT_NULL;
+        }
+    }
+#else
+    backend = HLE_PRESENT_NULL;
+#endif
+
+    presentBackend = backend;
+    presentWidth = width;
+    presentHeight = height;
+    for (int i = 0; i < HLE_PRESENT_BUFFERS; i++)
+        presentBuffers[i].assign((size_t)width * height, 0xff000000);
+    if (backend == HLE_PRESENT_NULL)
+        presentScratch.assign((size_t)width * height, 0);
+
+    presentWriting = 0;
+    presentReady.store(1, std::memory_order_relaxed);
+    presentShowing = 2;
+    presentSubmitted = presentPresented = presentDropped = 0;
+    presentConvertNs = presentTotalNs = 0;
+    presentInputFrames = presentInputNs = presentInputWorstNs = 0;
+    for (auto& stamp : presentStamps)
+        stamp = 0;
+    presentQuit = false;
+    presentThread = std::thread(hlePresentThread);
+    presentOpen = true;
+    return true;
+}
+
+void hlePresentShutdown()
+{
+    if (!presentOpen)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(presentLock);
+        presentQuit = true;
+    }
+    presentWake.notify_one();
+    presentThread.join();
+
+#ifdef __SWITCH__
+    if (presentBackend == HLE_PRESENT_SWITCH)
+        framebufferClose(&presentFb);
+#endif
+    presentOpen = false;
+}
+
+uint32_t* hlePresentBuffer(int* index)
+{
+    if (index)
+        *index = (int)presentWriting;
+    return presentBuffers[presentWriting].data();
+}
+
+void hlePresentSubmit(uint64_t stamp)
+{
+    if (!presentOpen)
+        return;
+
+    uint32_t writing = presentWriting;
+    presentStamps[writing].store(stamp, std::memory_order_relaxed);
+    uint32_t previous = presentReady.exchange(writing | PRESENT_FRESH, std::memory_order_acq_rel);
+    presentWriting = previous & ~PRESENT_FRESH;
+    if (previous & PRESENT_FRESH)
+    {
+        presentDropped.fetch_add(1, std::memory_order_relaxed);
+        // the earlier change is the one to measure from; a presenter that
+        // already took the new frame only loses the measurement
+        uint64_t lost = presentStamps[presentWriting].exchange(0, std::memory_order_relaxed);
+        if (lost && (!stamp || lost < stamp))
+            presentStamps[writing].store(lost, std::memory_order_relaxed);
+    }
+    presentSubmitted.fetch_add(1, std::memory_order_relaxed);
+
+    // the lock is only ever held by a presenter about to sleep
+    {
+        std::lock_guard<std::mutex> lock(presentLock);
+    }
+    presentWake.notify_one();
+}
+
+void hlePresentStats(HLEPRESENTSTATS* stats)
+{
+    stats->submitted = presentSubmitted.load(std::memory_order_relaxed);
+    stats->presented = presentPresented.load(std::memory_order_relaxed);
+    stats->dropped = presentDropped.load(std::memory_order_relaxed);
+    stats->convertMs = presentConvertNs.load(std::memory_order_relaxed) / 1e6;
+    stats->presentMs = presentTotalNs.load(std::memory_order_relaxed) / 1e6;
+    stats->inputFrames = presentInputFrames.load(std::memory_order_relaxed);
+    stats->inputMs = stats->inputFrames ? presentInputNs.load(std::memory_order_relaxed) / 1e6 / stats->inputFrames : 0.0;
+    stats->inputWorstMs = presentInputWorstNs.load(std::memory_order_relaxed) / 1e6;
+}
@@ -0,0 +1,54 @@
+#ifndef HLEPRESENT_H
+#define HLEPRESENT_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Puts finished RGBA8 frames on screen from a thread of its own.
+//
+// The producer fills a buffer and submits it; submitting is an index swap
+// and never waits. Three buffers go round: one being filled, one ready and
+// one on its way to the display. A frame submitted before the last one was
+// taken replaces it and is counted as dropped. The presenter thread makes
+// the swapchain once and keeps it; waiting for a free swapchain buffer is
+// the only waiting, and it happens there.
+//
+// A frame can carry a stamp, the steady clock time of the input change it is
+// the first to show; the presenter takes the time from there to the frame
+// being handed to the display. A stamped frame replaced before it was shown
+// hands its stamp on to the one replacing it.
+//
+// HLE_PRESENT_NULL does everything but the display (conversion included),
+// for benchmarks on a desktop.
+
+#define HLE_PRESENT_BUFFERS     3
+#define HLE_PRESENT_SWAPCHAIN   2
+
+enum { HLE_PRESENT_NULL, HLE_PRESENT_SWITCH };
+
+struct HLEPRESENTSTATS {
+    uint64_t submitted;
+    uint64_t presented;
+    uint64_t dropped;       // replaced before the presenter took them
+    double   convertMs;     // last frame, presenter thread
+    double   presentMs;     // last frame, conversion and swapchain together
+    uint64_t inputFrames;   // stamped frames shown
+    double   inputMs;       // stamp to hand-off, on average
+    double   inputWorstMs;
+};
+
+extern bool hlePresentInit(int width, int height, int backend);
+extern void hlePresentShutdown();
+
+// Producer thread; index says which of the buffers it is, for producers
+// that only write what changed since they last had that buffer
+extern uint32_t* hlePresentBuffer(int* index = nullptr);
+extern void      hlePresentSubmit(uint64_t stamp = 0);   // steady clock ns, 0 for none
+
+extern void hlePresentStats(HLEPRESENTSTATS* stats);
+
+// Rows of RGBA8 into rows of the display's RGBA_8888, alpha made opaque
+extern void hlePresentConvert(uint32_t* dst, size_t dstStride, const uint32_t* src, size_t srcStride,
+                              int width, int height);
+
+#endif // HLEPRESENT_H
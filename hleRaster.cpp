@@ -0,0 +1,670 @@
+// Tile rasterizer
+//
+// Vertices snap to 1/16 pixel and each edge becomes E = A*x + B*y + C in
+// those units, biased by one on edges that are not top or left so that
+// "inside" is simply E >= 0 for all three edges. Per pixel the equations
+// step by 16A / 16B, so a row of four pixels is one vector add.
+//
+// Binning classifies every edge against every tile: outside the tile
+// entirely rejects the triangle there, clear of the tile is noted in the bin
+// entry and that edge is not tested inside the tile. Edge values that are
+// tested are within a tile's span of zero and fit 32 bits.
+//
+// Colour is an affine plane over the screen, the same values the barycentric
+// weights of the old per-pixel loop gave. Texture coordinates go in as u/w,
+// v/w and 1/w planes, which are affine on screen, and are divided back per
+// pixel; with every w at 1 that is the affine mapping again.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "hleRaster.h"
+
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define HLE_RASTER_SUB     16       // subpixel steps per pixel
+#define HLE_RASTER_PLANES  6        // r, g, b, u/w, v/w, 1/w
+
+enum { HLE_PLANE_R, HLE_PLANE_G, HLE_PLANE_B, HLE_PLANE_U, HLE_PLANE_V, HLE_PLANE_Q };
+
+struct HLERASTERTRI {
+    int32_t  a[3], b[3];            // edge step per pixel
+    int64_t  c[3];                  // edge value at the centre of pixel (0, 0)
+    float    base[HLE_RASTER_PLANES];
+    float    dx[HLE_RASTER_PLANES];
+    float    dy[HLE_RASTER_PLANES];
+    int      minX, minY, maxX, maxY;
+    const HLERASTERTEXTURE* tex;    // nullptr: flat shaded
+    bool     bilinear;
+};
+
+struct HLERASTERCACHED {
+    HLERASTERTEXTURE      tex;
+    std::vector<uint32_t> texels;
+    uint32_t              used;     // flush it was last drawn in
+};
+
+// A worker's share of the tiles; others take from it once theirs are done
+struct HLERASTERSLICE {
+    alignas(64) std::atomic<uint32_t> next;
+    uint32_t end;
+};
+
+static uint32_t* hleRasterPixels = nullptr;
+static int       hleRasterWidth, hleRasterHeight;
+static int       hleRasterTilesX, hleRasterTilesY;
+
+static std::vector<HLERASTERTRI>          hleRasterTris;
+static std::vector<std::vector<uint32_t>> hleRasterBins;      // triangle << 3 | edges clear of the tile
+static std::vector<uint32_t>              hleRasterActive;    // tiles with work
+static bool     hleRasterClearing = false;
+static uint32_t hleRasterClearColor;
+
+static std::thread             hleRasterThreads[HLE_RASTER_WORKERS];
+static int                     hleRasterWorkers = 0;
+static HLERASTERSLICE          hleRasterSlices[HLE_RASTER_WORKERS + 1];
+static std::mutex              hleRasterLock;             // flush handshake only
+static std::condition_variable hleRasterStart, hleRasterDone;
+static uint32_t                hleRasterGeneration = 0;
+static bool                    hleRasterQuit = false;
+static std::atomic<int>        hleRasterPending(0);
+
+static std::unordered_map<uint64_t, HLERASTERCACHED>                hleRasterCache;     // by contents
+static std::unordered_map<const uint32_t*, const HLERASTERTEXTURE*> hleRasterSeen;      // this flush
+static size_t   hleRasterCacheBytes = 0;
+static uint32_t hleRasterFlushes = 0;
+
+static bool                  hleRasterProfiling = false;
+static std::vector<uint32_t> hleRasterTileNs;             // by position in hleRasterActive
+
+// ---------------------- LANES ----------------------
+
+#if defined(__aarch64__)
+typedef int32x4_t   HLEI4;
+typedef float32x4_t HLEF4;
+static inline HLEI4 i4Splat(int32_t v)                 { return vdupq_n_s32(v); }
+static inline HLEI4 i4Load(const uint32_t* p)          { return vreinterpretq_s32_u32(vld1q_u32(p)); }
+static inline void  i4Store(uint32_t* p, HLEI4 a)      { vst1q_u32(p, vreinterpretq_u32_s32(a)); }
+static inline HLEI4 i4Add(HLEI4 a, HLEI4 b)            { return vaddq_s32(a, b); }
+static inline HLEI4 i4Or(HLEI4 a, HLEI4 b)             { return vorrq_s32(a, b); }
+static inline HLEI4 i4And(HLEI4 a, HLEI4 b)            { return vandq_s32(a, b); }
+static inline HLEI4 i4Shl(HLEI4 a, int n)              { return vshlq_s32(a, vdupq_n_s32(n)); }
+static inline HLEI4 i4Byte(HLEI4 a, int n)             { return vreinterpretq_s32_u32(vandq_u32(vshlq_u32(vreinterpretq_u32_s32(a), vdupq_n_s32(-n)), vdupq_n_u32(0xff))); }
+static inline HLEI4 i4Inside(HLEI4 e)                  { return vmvnq_s32(vshrq_n_s32(e, 31)); }
+static inline HLEI4 i4Less(HLEI4 a, HLEI4 b)           { return vreinterpretq_s32_u32(vcltq_s32(a, b)); }
+static inline HLEI4 i4Select(HLEI4 m, HLEI4 a, HLEI4 b) { return vbslq_s32(vreinterpretq_u32_s32(m), a, b); }
+static inline bool  i4Any(HLEI4 m)                     { return vmaxvq_u32(vreinterpretq_u32_s32(m)) != 0; }
+static inline HLEF4 f4Splat(float f)                   { return vdupq_n_f32(f); }
+static inline HLEF4 f4Add(HLEF4 a, HLEF4 b)            { return vaddq_f32(a, b); }
+static inline HLEF4 f4Sub(HLEF4 a, HLEF4 b)            { return vsubq_f32(a, b); }
+static inline HLEF4 f4Mul(HLEF4 a, HLEF4 b)            { return vmulq_f32(a, b); }
+static inline HLEF4 f4Div(HLEF4 a, HLEF4 b)            { return vdivq_f32(a, b); }
+static inline HLEF4 f4Clamp(HLEF4 a, float hi)         { return vminq_f32(vmaxq_f32(a, vdupq_n_f32(0.f)), vdupq_n_f32(hi)); }
+static inline HLEI4 f4Int(HLEF4 a)                     { return vcvtq_s32_f32(a); }
+static inline HLEF4 i4Float(HLEI4 a)                   { return vcvtq_f32_s32(a); }
+#elif defined(__SSE2__)
+typedef __m128i HLEI4;
+typedef __m128  HLEF4;
+static inline HLEI4 i4Splat(int32_t v)                 { return _mm_set1_epi32(v); }
+static inline HLEI4 i4Load(const uint32_t* p)          { return _mm_loadu_si128((const __m128i*)p); }
+static inline void  i4Store(uint32_t* p, HLEI4 a)      { _mm_storeu_si128((__m128i*)p, a); }
+static inline HLEI4 i4Add(HLEI4 a, HLEI4 b)            { return _mm_add_epi32(a, b); }
+static inline HLEI4 i4Or(HLEI4 a, HLEI4 b)             { return _mm_or_si128(a, b); }
+static inline HLEI4 i4And(HLEI4 a, HLEI4 b)            { return _mm_and_si128(a, b); }
+static inline HLEI4 i4Shl(HLEI4 a, int n)              { return _mm_sll_epi32(a, _mm_cvtsi32_si128(n)); }
+static inline HLEI4 i4Byte(HLEI4 a, int n)             { return _mm_and_si128(_mm_srl_epi32(a, _mm_cvtsi32_si128(n)), _mm_set1_epi32(0xff)); }
+static inline HLEI4 i4Inside(HLEI4 e)                  { return _mm_xor_si128(_mm_srai_epi32(e, 31), _mm_set1_epi32(-1)); }
+static inline HLEI4 i4Less(HLEI4 a, HLEI4 b)           { return _mm_cmplt_epi32(a, b); }
+static inline HLEI4 i4Select(HLEI4 m, HLEI4 a, HLEI4 b) { return _mm_or_si128(_mm_and_si128(m, a), _mm_andnot_si128(m, b)); }
+static inline bool  i4Any(HLEI4 m)                     { return _mm_movemask_epi8(m) != 0; }
+static inline HLEF4 f4Splat(float f)                   { return _mm_set1_ps(f); }
+static inline HLEF4 f4Add(HLEF4 a, HLEF4 b)            { return _mm_add_ps(a, b); }
+static inline HLEF4 f4Sub(HLEF4 a, HLEF4 b)            { return _mm_sub_ps(a, b); }
+static inline HLEF4 f4Mul(HLEF4 a, HLEF4 b)            { return _mm_mul_ps(a, b); }
+static inline HLEF4 f4Div(HLEF4 a, HLEF4 b)            { return _mm_div_ps(a, b); }
+static inline HLEF4 f4Clamp(HLEF4 a, float hi)         { return _mm_min_ps(_mm_max_ps(a, _mm_setzero_ps()), _mm_set1_ps(hi)); }
+static inline HLEI4 f4Int(HLEF4 a)                     { return _mm_cvttps_epi32(a); }
+static inline HLEF4 i4Float(HLEI4 a)                   { return _mm_cvtepi32_ps(a); }
+#else
+struct HLEI4 { int32_t v[4]; };
+struct HLEF4 { float v[4]; };
+#define HLE_LANES(T, expr) T r; for (int i = 0; i < 4; i++) r.v[i] = (expr); return r
+static inline HLEI4 i4Splat(int32_t v)                 { HLE_LANES(HLEI4, v); }
+static inline HLEI4 i4Load(const uint32_t* p)          { HLE_LANES(HLEI4, (int32_t)p[i]); }
+static inline void  i4Store(uint32_t* p, HLEI4 a)      { for (int i = 0; i < 4; i++) p[i] = (uint32_t)a.v[i]; }
+static inline HLEI4 i4Add(HLEI4 a, HLEI4 b)            { HLE_LANES(HLEI4, a.v[i] + b.v[i]); }
+static inline HLEI4 i4Or(HLEI4 a, HLEI4 b)             { HLE_LANES(HLEI4, a.v[i] | b.v[i]); }
+static inline HLEI4 i4And(HLEI4 a, HLEI4 b)            { HLE_LANES(HLEI4, a.v[i] & b.v[i]); }
+static inline HLEI4 i4Shl(HLEI4 a, int n)              { HLE_LANES(HLEI4, (int32_t)((uint32_t)a.v[i] << n)); }
+static inline HLEI4 i4Byte(HLEI4 a, int n)             { HLE_LANES(HLEI4, (int32_t)((uint32_t)a.v[i] >> n & 0xff)); }
+static inline HLEI4 i4Inside(HLEI4 e)                  { HLE_LANES(HLEI4, e.v[i] >= 0 ? -1 : 0); }
+static inline HLEI4 i4Less(HLEI4 a, HLEI4 b)           { HLE_LANES(HLEI4, a.v[i] < b.v[i] ? -1 : 0); }
+static inline HLEI4 i4Select(HLEI4 m, HLEI4 a, HLEI4 b) { HLE_LANES(HLEI4, (m.v[i] & a.v[i]) | (~m.v[i] & b.v[i])); }
+static inline bool  i4Any(HLEI4 m)                     { return (m.v[0] | m.v[1] | m.v[2] | m.v[3]) != 0; }
+static inline HLEF4 f4Splat(float f)                   { HLE_LANES(HLEF4, f); }
+static inline HLEF4 f4Add(HLEF4 a, HLEF4 b)            { HLE_LANES(HLEF4, a.v[i] + b.v[i]); }
+static inline HLEF4 f4Sub(HLEF4 a, HLEF4 b)            { HLE_LANES(HLEF4, a.v[i] - b.v[i]); }
+static inline HLEF4 f4Mul(HLEF4 a, HLEF4 b)            { HLE_LANES(HLEF4, a.v[i] * b.v[i]); }
+static inline HLEF4 f4Div(HLEF4 a, HLEF4 b)            { HLE_LANES(HLEF4, a.v[i] / b.v[i]); }
+static inline HLEF4 f4Clamp(HLEF4 a, float hi)         { HLE_LANES(HLEF4, std::min(std::max(a.v[i], 0.f), hi)); }
+static inline HLEI4 f4Int(HLEF4 a)                     { HLE_LANES(HLEI4, (int32_t)a.v[i]); }
+static inline HLEF4 i4Float(HLEI4 a)                   { HLE_LANES(HLEF4, (float)a.v[i]); }
+#undef HLE_LANES
+#endif
+
+static inline HLEI4 i4Ramp(int32_t step)
+{
+    alignas(16) uint32_t r[4] = { 0, (uint32_t)step, (uint32_t)(2 * step), (uint32_t)(3 * step) };
+    return i4Load(r);
+}
+
+static inline HLEF4 f4Ramp(float base, float step)
+{
+    return f4Add(f4Splat(base), f4Mul(f4Splat(step), HLEF4{ 0.f, 1.f, 2.f, 3.f }));
+}
+
+// ---------------------- TEXTURES ----------------------
+
+static_assert(HLE_RASTER_BLOCK == 4, "texel addressing below assumes 4x4 blocks");
+
+static inline uint32_t hleRasterTexel(const HLERASTERTEXTURE* tex, uint32_t x, uint32_t y)
+{
+    return tex->texels[((y >> 2) * tex->blocksWide + (x >> 2)) * 16 + ((y & 3) << 2) + (x & 3)];
+}
+
+// Coordinates are vectors, fetches are not: there is no gather
+static HLEI4 hleRasterNearest(const HLERASTERTEXTURE* tex, HLEF4 u, HLEF4 v)
+{
+    alignas(16) uint32_t x[4], y[4], texel[4];
+    i4Store(x, f4Int(f4Clamp(f4Mul(u, f4Splat((float)tex->width)), (float)(tex->width - 1))));
+    i4Store(y, f4Int(f4Clamp(f4Mul(v, f4Splat((float)tex->height)), (float)(tex->height - 1))));
+    for (int i = 0; i < 4; i++)
+        texel[i] = hleRasterTexel(tex, x[i], y[i]);
+    return i4Load(texel);
+}
+
+// Clamped at the edges; the blend runs on all four pixels a channel at a time
+static HLEI4 hleRasterBilinear(const HLERASTERTEXTURE* tex, HLEF4 u, HLEF4 v)
+{
+    HLEF4 fx = f4Clamp(f4Sub(f4Mul(u, f4Splat((float)tex->width)), f4Splat(0.5f)), (float)(tex->width - 1));
+    HLEF4 fy = f4Clamp(f4Sub(f4Mul(v, f4Splat((float)tex->height)), f4Splat(0.5f)), (float)(tex->height - 1));
+    HLEI4 ix = f4Int(fx), iy = f4Int(fy);
+    HLEF4 ax = f4Sub(fx, i4Float(ix)), ay = f4Sub(fy, i4Float(iy));
+
+    alignas(16) uint32_t x[4], y[4], t00[4], t10[4], t01[4], t11[4];
+    i4Store(x, ix);
+    i4Store(y, iy);
+    for (int i = 0; i < 4; i++)
+    {
+        uint32_t x1 = std::min(x[i] + 1, (uint32_t)tex->width - 1);
+        uint32_t y1 = std::min(y[i] + 1, (uint32_t)tex->height - 1);
+        t00[i] = hleRasterTexel(tex, x[i], y[i]);
+        t10[i] = hleRasterTexel(tex, x1, y[i]);
+        t01[i] = hleRasterTexel(tex, x[i], y1);
+        t11[i] = hleRasterTexel(tex, x1, y1);
+    }
+
+    HLEI4 q00 = i4Load(t00), q10 = i4Load(t10), q01 = i4Load(t01), q11 = i4Load(t11);
+    HLEI4 out = i4Splat(0);
+    for (int shift = 0; shift < 32; shift += 8)
+    {
+        HLEF4 c00 = i4Float(i4Byte(q00, shift)), c10 = i4Float(i4Byte(q10, shift));
+        HLEF4 c01 = i4Float(i4Byte(q01, shift)), c11 = i4Float(i4Byte(q11, shift));
+        HLEF4 top = f4Add(c00, f4Mul(f4Sub(c10, c00), ax));
+        HLEF4 bottom = f4Add(c01, f4Mul(f4Sub(c11, c01), ax));
+        HLEF4 c = f4Add(top, f4Mul(f4Sub(bottom, top), ay));
+        out = i4Or(out, i4Shl(f4Int(f4Add(c, f4Splat(0.5f))), shift));
+    }
+    return out;
+}
+
+static uint64_t hleRasterHash(const uint32_t* texels, size_t count, int width, int height)
+{
+    uint64_t h = 0x9e3779b97f4a7c15ull ^ ((uint64_t)width << 32 | (uint32_t)height);
+    for (size_t i = 0; i < count; i++)
+        h = (h ^ texels[i]) * 0x100000001b3ull + (h >> 29);
+    return h;
+}
+
+const HLERASTERTEXTURE* hleRasterTexture(const uint32_t* texels, int width, int height)
+{
+    if (!texels || width <= 0 || height <= 0)
+        return nullptr;
+
+    auto seen = hleRasterSeen.find(texels);
+    if (seen != hleRasterSeen.end() && seen->second->width == width && seen->second->height == height)
+        return seen->second;
+
+    uint64_t key = hleRasterHash(texels, (size_t)width * height, width, height);
+    HLERASTERCACHED& cached = hleRasterCache[key];
+    if (cached.texels.empty())
+    {
+        // edge texels repeat into the padding of partial blocks
+        int blocksWide = (width + HLE_RASTER_BLOCK - 1) / HLE_RASTER_BLOCK;
+        int blocksHigh = (height + HLE_RASTER_BLOCK - 1) / HLE_RASTER_BLOCK;
+        cached.texels.resize((size_t)blocksWide * blocksHigh * HLE_RASTER_BLOCK * HLE_RASTER_BLOCK);
+        cached.tex = { width, height, blocksWide, cached.texels.data() };
+        uint32_t* out = cached.texels.data();
+        for (int by = 0; by < blocksHigh; by++)
+            for (int bx = 0; bx < blocksWide; bx++)
+                for (int y = 0; y < HLE_RASTER_BLOCK; y++)
+                    for (int x = 0; x < HLE_RASTER_BLOCK; x++)
+                    {
+                        int sx = std::min(bx * HLE_RASTER_BLOCK + x, width - 1);
+                        int sy = std::min(by * HLE_RASTER_BLOCK + y, height - 1);
+                        *out++ = texels[(size_t)sy * width + sx];
+                    }
+        hleRasterCacheBytes += cached.texels.size() * sizeof(uint32_t);
+    }
+    cached.used = hleRasterFlushes;
+    hleRasterSeen[texels] = &cached.tex;
+    return &cached.tex;
+}
+
+// After a flush nothing points into the cache, so what this flush did not
+// draw can go once the cache is over budget
+static void hleRasterTrimTextures()
+{
+    hleRasterSeen.clear();
+    if (hleRasterCacheBytes > HLE_RASTER_TEXTURES)
+    {
+        for (auto it = hleRasterCache.begin(); it != hleRasterCache.end();)
+        {
+            if (it->second.used == hleRasterFlushes)
+            {
+                ++it;
+                continue;
+            }
+            hleRasterCacheBytes -= it->second.texels.size() * sizeof(uint32_t);
+            it = hleRasterCache.erase(it);
+        }
+    }
+    hleRasterFlushes++;
+}
+
+// ---------------------- TILES ----------------------
+
+static void hleRasterSpan(const HLERASTERTRI* t, uint32_t* row, int x, int xEnd, int y, const HLEI4* e, const HLEI4* step)
+{
+    float p[HLE_RASTER_PLANES];
+    for (int k = 0; k < HLE_RASTER_PLANES; k++)
+        p[k] = t->base[k] + t->dx[k] * x + t->dy[k] * y;
+
+    HLEF4 ra = f4Ramp(p[HLE_PLANE_R], t->dx[HLE_PLANE_R]), rs = f4Splat(4 * t->dx[HLE_PLANE_R]);
+    HLEF4 ga = f4Ramp(p[HLE_PLANE_G], t->dx[HLE_PLANE_G]), gs = f4Splat(4 * t->dx[HLE_PLANE_G]);
+    HLEF4 ba = f4Ramp(p[HLE_PLANE_B], t->dx[HLE_PLANE_B]), bs = f4Splat(4 * t->dx[HLE_PLANE_B]);
+    HLEF4 ua = f4Ramp(p[HLE_PLANE_U], t->dx[HLE_PLANE_U]), us = f4Splat(4 * t->dx[HLE_PLANE_U]);
+    HLEF4 va = f4Ramp(p[HLE_PLANE_V], t->dx[HLE_PLANE_V]), vs = f4Splat(4 * t->dx[HLE_PLANE_V]);
+    HLEF4 qa = f4Ramp(p[HLE_PLANE_Q], t->dx[HLE_PLANE_Q]), qs = f4Splat(4 * t->dx[HLE_PLANE_Q]);
+
+    HLEI4 e0 = e[0], e1 = e[1], e2 = e[2];
+    HLEI4 lane = i4Add(i4Splat(x), i4Ramp(1)), four = i4Splat(4), end = i4Splat(xEnd);
+    HLEI4 alpha = i4Splat((int32_t)0xff000000);
+
+    for (; x < xEnd; x += 4)
+    {
+        HLEI4 cover = i4And(i4Inside(i4Or(i4Or(e0, e1), e2)), i4Less(lane, end));
+        if (i4Any(cover))
+        {
+            HLEI4 colour;
+            if (!t->tex)
+            {
+                HLEI4 r = f4Int(f4Clamp(ra, 255.f));
+                HLEI4 g = f4Int(f4Clamp(ga, 255.f));
+                HLEI4 b = f4Int(f4Clamp(ba, 255.f));
+                colour = i4Or(i4Or(r, i4Shl(g, 8)), i4Or(i4Shl(b, 16), alpha));
+            }
+            else
+            {
+                HLEF4 u = f4Div(ua, qa), v = f4Div(va, qa);
+                colour = t->bilinear ? hleRasterBilinear(t->tex, u, v) : hleRasterNearest(t->tex, u, v);
+            }
+            i4Store(row + x, i4Select(cover, colour, i4Load(row + x)));
+        }
+
+        e0 = i4Add(e0, step[0]);
+        e1 = i4Add(e1, step[1]);
+        e2 = i4Add(e2, step[2]);
+        lane = i4Add(lane, four);
+        ra = f4Add(ra, rs);
+        ga = f4Add(ga, gs);
+        ba = f4Add(ba, bs);
+        ua = f4Add(ua, us);
+        va = f4Add(va, vs);
+        qa = f4Add(qa, qs);
+    }
+}
+
+static void hleRasterTile(uint32_t tile)
+{
+    int x0 = (tile % hleRasterTilesX) * HLE_RASTER_TILE;
+    int y0 = (tile / hleRasterTilesX) * HLE_RASTER_TILE;
+    int x1 = std::min(x0 + HLE_RASTER_TILE, hleRasterWidth);
+    int y1 = std::min(y0 + HLE_RASTER_TILE, hleRasterHeight);
+
+    if (hleRasterClearing)
+        for (int y = y0; y < y1; y++)
+            std::fill_n(hleRasterPixels + (size_t)y * hleRasterWidth + x0, x1 - x0, hleRasterClearColor);
+
+    for (uint32_t entry : hleRasterBins[tile])
+    {
+        const HLERASTERTRI* t = &hleRasterTris[entry >> 3];
+        int yStart = std::max(y0, t->minY), yEnd = std::min(y1, t->maxY + 1);
+        int xEnd = std::min(x1, t->maxX + 1);
+
+        // groups of four from the tile's own alignment, so with the width a
+        // multiple of 4 no group reaches into a neighbouring tile
+        int xStart = x0 + ((std::max(x0, t->minX) - x0) & ~3);
+
+        HLEI4 e[3], step[3];
+        int32_t rowStart[3], rowStep[3];
+        for (int k = 0; k < 3; k++)
+        {
+            if (entry & (1 << k))
+            {
+                rowStart[k] = rowStep[k] = 0;
+                step[k] = i4Splat(0);
+                continue;
+            }
+            rowStart[k] = (int32_t)(t->c[k] + (int64_t)t->a[k] * xStart + (int64_t)t->b[k] * yStart);
+            rowStep[k] = t->b[k];
+            step[k] = i4Splat(4 * t->a[k]);
+        }
+        HLEI4 ramp[3] = { i4Ramp(t->a[0]), i4Ramp(t->a[1]), i4Ramp(t->a[2]) };
+        for (int k = 0; k < 3; k++)
+            if (entry & (1 << k))
+                ramp[k] = i4Splat(0);
+
+        for (int y = yStart; y < yEnd; y++)
+        {
+            for (int k = 0; k < 3; k++)
+                e[k] = i4Add(i4Splat(rowStart[k]), ramp[k]);
+            hleRasterSpan(t, hleRasterPixels + (size_t)y * hleRasterWidth, xStart, xEnd, y, e, step);
+            for (int k = 0; k < 3; k++)
+                rowStart[k] += rowStep[k];
+        }
+    }
+}
+
+// Own slice first, then whatever the others have left
+static void hleRasterWork(int self)
+{
+    int participants = hleRasterWorkers + 1;
+    for (int k = 0; k < participants; k++)
+    {
+        HLERASTERSLICE* s = &hleRasterSlices[(self + k) % participants];
+        for (;;)
+        {
+            uint32_t i = s->next.fetch_add(1, std::memory_order_relaxed);
+            if (i >= s->end)
+                break;
+            if (!hleRasterProfiling)
+            {
+                hleRasterTile(hleRasterActive[i]);
+                continue;
+            }
+            auto t0 = std::chrono::steady_clock::now();
+            hleRasterTile(hleRasterActive[i]);
+            hleRasterTileNs[i] = (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - t0).count();
+        }
+    }
+}
+
+static void hleRasterWorker(int self)
+{
+    uint32_t seen = 0;
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(hleRasterLock);
+            hleRasterStart.wait(lock, [&] { return hleRasterQuit || hleRasterGeneration != seen; });
+            if (hleRasterQuit)
+                return;
+            seen = hleRasterGeneration;
+        }
+        hleRasterWork(self);
+        if (hleRasterPending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            std::lock_guard<std::mutex> lock(hleRasterLock);
+            hleRasterDone.notify_one();
+        }
+    }
+}
+
+// ---------------------- SETUP ----------------------
+
+bool hleRasterInit(int workers)
+{
+    hleRasterShutdown();
+    hleRasterWorkers = std::clamp(workers, 0, HLE_RASTER_WORKERS);
+    hleRasterTris.reserve(HLE_RASTER_TRIANGLES);
+    for (int i = 0; i < hleRasterWorkers; i++)
+        hleRasterThreads[i] = std::thread(hleRasterWorker, i + 1);
+    return true;
+}
+
+void hleRasterShutdown()
+{
+    {
+        std::lock_guard<std::mutex> lock(hleRasterLock);
+        hleRasterQuit = true;
+    }
+    hleRasterStart.notify_all();
+    for (int i = 0; i < hleRasterWorkers; i++)
+        hleRasterThreads[i].join();
+    hleRasterWorkers = 0;
+    hleRasterQuit = false;
+}
+
+void hleRasterTarget(uint32_t* pixels, int width, int height)
+{
+    hleRasterFlush();
+    if (width & 3)
+    {
+        printf("Raster: target width %d is not a multiple of 4\n", width);
+        pixels = nullptr;
+    }
+    hleRasterPixels = pixels;
+    if (width == hleRasterWidth && height == hleRasterHeight)
+        return;   // a new buffer of the same size keeps the bins
+    hleRasterWidth = width;
+    hleRasterHeight = height;
+    hleRasterTilesX = (width + HLE_RASTER_TILE - 1) / HLE_RASTER_TILE;
+    hleRasterTilesY = (height + HLE_RASTER_TILE - 1) / HLE_RASTER_TILE;
+    hleRasterBins.assign(hleRasterTilesX * hleRasterTilesY, std::vector<uint32_t>());
+    hleRasterActive.clear();
+}
+
+void hleRasterClear(uint32_t rgba)
+{
+    if (!hleRasterTris.empty())
+        hleRasterFlush();
+
+    hleRasterClearing = true;
+    hleRasterClearColor = rgba;
+    hleRasterActive.resize(hleRasterBins.size());
+    for (uint32_t i = 0; i < hleRasterActive.size(); i++)
+        hleRasterActive[i] = i;
+}
+
+static void hleRasterPlane(HLERASTERTRI* t, int k, const float* x, const float* y, const float* f, float det)
+{
+    float dx = ((f[1] - f[0]) * (y[2] - y[0]) - (f[2] - f[0]) * (y[1] - y[0])) / det;
+    float dy = ((f[2] - f[0]) * (x[1] - x[0]) - (f[1] - f[0]) * (x[2] - x[0])) / det;
+    t->dx[k] = dx;
+    t->dy[k] = dy;
+    t->base[k] = f[0] + dx * (0.5f - x[0]) + dy * (0.5f - y[0]);
+}
+
+void hleRasterTriangle(const HLERASTERVERTEX* v0, const HLERASTERVERTEX* v1,
+                       const HLERASTERVERTEX* v2, const HLERASTERTEXTURE* tex, bool bilinear)
+{
+    if (!hleRasterPixels)
+        return;
+    if (hleRasterTris.size() >= HLE_RASTER_TRIANGLES)
+        hleRasterFlush();
+
+    const HLERASTERVERTEX* v[3] = { v0, v1, v2 };
+    int32_t X[3], Y[3];
+    for (int i = 0; i < 3; i++)
+    {
+        X[i] = (int32_t)lrintf(v[i]->x * HLE_RASTER_SUB);
+        Y[i] = (int32_t)lrintf(v[i]->y * HLE_RASTER_SUB);
+    }
+
+    int64_t area = (int64_t)(X[1] - X[0]) * (Y[2] - Y[0]) - (int64_t)(Y[1] - Y[0]) * (X[2] - X[0]);
+    if (area == 0)
+        return;
+    if (area < 0)
+    {
+        std::swap(v[1], v[2]);
+        std::swap(X[1], X[2]);
+        std::swap(Y[1], Y[2]);
+    }
+
+    // pixels whose centres can be inside
+    HLERASTERTRI t;
+    t.minX = std::max(0, (std::min({ X[0], X[1], X[2] }) - HLE_RASTER_SUB / 2 + HLE_RASTER_SUB - 1) / HLE_RASTER_SUB);
+    t.minY = std::max(0, (std::min({ Y[0], Y[1], Y[2] }) - HLE_RASTER_SUB / 2 + HLE_RASTER_SUB - 1) / HLE_RASTER_SUB);
+    t.maxX = std::min(hleRasterWidth - 1, (std::max({ X[0], X[1], X[2] }) - HLE_RASTER_SUB / 2) >> 4);
+    t.maxY = std::min(hleRasterHeight - 1, (std::max({ Y[0], Y[1], Y[2] }) - HLE_RASTER_SUB / 2) >> 4);
+    if (t.minX > t.maxX || t.minY > t.maxY)
+        return;
+
+    for (int k = 0; k < 3; k++)
+    {
+        int i = k, j = (k + 1) % 3;
+        int32_t A = Y[i] - Y[j];
+        int32_t B = X[j] - X[i];
+        int64_t C = -((int64_t)A * X[i] + (int64_t)B * Y[i]);
+        bool topLeft = A > 0 || (A == 0 && B > 0);
+
+        t.a[k] = A * HLE_RASTER_SUB;
+        t.b[k] = B * HLE_RASTER_SUB;
+        t.c[k] = C + (int64_t)(A + B) * (HLE_RASTER_SUB / 2) - (topLeft ? 0 : 1);
+    }
+
+    float x[3], y[3], f[HLE_RASTER_PLANES][3];
+    for (int i = 0; i < 3; i++)
+    {
+        float q = v[i]->w > 0 ? 1.f / v[i]->w : 1.f;
+        x[i] = X[i] * (1.f / HLE_RASTER_SUB);
+        y[i] = Y[i] * (1.f / HLE_RASTER_SUB);
+        f[HLE_PLANE_R][i] = v[i]->r;
+        f[HLE_PLANE_G][i] = v[i]->g;
+        f[HLE_PLANE_B][i] = v[i]->b;
+        f[HLE_PLANE_U][i] = v[i]->u * q;
+        f[HLE_PLANE_V][i] = v[i]->v * q;
+        f[HLE_PLANE_Q][i] = q;
+    }
+    float det = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+    for (int k = 0; k < HLE_RASTER_PLANES; k++)
+        hleRasterPlane(&t, k, x, y, f[k], det);
+
+    t.tex = tex;
+    t.bilinear = bilinear;
+
+    uint32_t index = (uint32_t)hleRasterTris.size();
+    hleRasterTris.push_back(t);
+
+    // bin: reject tiles an edge misses, mark edges a tile is clear of
+    const int span = HLE_RASTER_TILE - 1;
+    for (int ty = t.minY / HLE_RASTER_TILE; ty <= t.maxY / HLE_RASTER_TILE; ty++)
+    {
+        for (int tx = t.minX / HLE_RASTER_TILE; tx <= t.maxX / HLE_RASTER_TILE; tx++)
+        {
+            uint32_t clear = 0;
+            bool reject = false;
+            for (int k = 0; k < 3 && !reject; k++)
+            {
+                int64_t e = t.c[k] + (int64_t)t.a[k] * tx * HLE_RASTER_TILE + (int64_t)t.b[k] * ty * HLE_RASTER_TILE;
+                int64_t lo = e + (int64_t)std::min(t.a[k], 0) * span + (int64_t)std::min(t.b[k], 0) * span;
+                int64_t hi = e + (int64_t)std::max(t.a[k], 0) * span + (int64_t)std::max(t.b[k], 0) * span;
+                if (hi < 0)
+                    reject = true;
+                else if (lo >= 0)
+                    clear |= 1 << k;
+            }
+            if (reject)
+                continue;
+
+            uint32_t tile = ty * hleRasterTilesX + tx;
+            std::vector<uint32_t>& bin = hleRasterBins[tile];
+            if (bin.empty() && !hleRasterClearing)
+                hleRasterActive.push_back(tile);
+            bin.push_back(index << 3 | clear);
+        }
+    }
+}
+
+// ---------------------- FLUSH ----------------------
+
+void hleRasterFlush()
+{
+    if (hleRasterActive.empty())
+    {
+        hleRasterTris.clear();
+        hleRasterTrimTextures();
+        return;
+    }
+
+    int participants = hleRasterWorkers + 1;
+    uint32_t tiles = (uint32_t)hleRasterActive.size();
+    for (int p = 0; p < participants; p++)
+    {
+        hleRasterSlices[p].next.store(tiles * p / participants, std::memory_order_relaxed);
+        hleRasterSlices[p].end = tiles * (p + 1) / participants;
+    }
+    if (hleRasterProfiling)
+        hleRasterTileNs.assign(tiles, 0);
+
+    if (hleRasterWorkers)
+    {
+        hleRasterPending.store(hleRasterWorkers, std::memory_order_relaxed);
+        {
+            std::lock_guard<std::mutex> lock(hleRasterLock);
+            hleRasterGeneration++;
+        }
+        hleRasterStart.notify_all();
+    }
+
+    hleRasterWork(0);
+
+    if (hleRasterWorkers)
+    {
+        std::unique_lock<std::mutex> lock(hleRasterLock);
+        hleRasterDone.wait(lock, [] { return hleRasterPending.load(std::memory_order_acquire) == 0; });
+    }
+
+    for (uint32_t tile : hleRasterActive)
+        hleRasterBins[tile].clear();
+    hleRasterActive.clear();
+    hleRasterTris.clear();
+    hleRasterClearing = false;
+    hleRasterTrimTextures();
+}
+
+void hleRasterProfile(bool on)
+{
+    hleRasterProfiling = on;
+    hleRasterTileNs.clear();
+}
+
+size_t hleRasterTileTimes(const uint32_t** ns)
+{
+    *ns = hleRasterTileNs.data();
+    return hleRasterTileNs.size();
+}
@@ -0,0 +1,65 @@
+#ifndef HLERASTER_H
+#define HLERASTER_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Software rasterizer behind GPUDrawTriangle / GPUDrawTexturedTriangle in
+// hleMain_all.
+//
+// A triangle is set up once when it is drawn (fixed-point edge equations,
+// colour and texture coordinate planes) and binned into the screen tiles it
+// touches. hleRasterFlush rasterizes the tiles on a small pool; every tile
+// belongs to one worker at a time, so nothing on the way to a pixel locks.
+// Inside a tile the edges are stepped incrementally four pixels at a time.
+// Draw order is kept within each tile, which is all a framebuffer can see.
+//
+// Textures are copied once into 4x4 texel blocks (a bilinear footprint is
+// one or two cache lines instead of two rows) and kept in a cache keyed by
+// their contents, so drawing the same texture again costs a lookup. Texture
+// coordinates are interpolated as u/w, v/w and 1/w and divided per pixel.
+
+#define HLE_RASTER_TILE       32        // pixels, multiple of 4
+#define HLE_RASTER_WORKERS    3         // besides the thread that flushes
+#define HLE_RASTER_TRIANGLES  65536     // per flush; drawing more flushes early
+#define HLE_RASTER_BLOCK      4         // texture block edge, texels
+#define HLE_RASTER_TEXTURES   (16 << 20) // cached texture bytes kept across flushes
+
+struct HLERASTERVERTEX {
+    float x, y;         // pixels
+    float r, g, b;      // 0..255
+    float u, v;         // 0..1
+    float w;            // view depth for perspective; 0 or 1 is screen-space
+};
+
+// A cached copy in blocks; valid until the flush after it was last used
+struct HLERASTERTEXTURE {
+    int             width;
+    int             height;
+    int             blocksWide;
+    const uint32_t* texels;
+};
+
+extern bool hleRasterInit(int workers);
+extern void hleRasterShutdown();
+
+// Drawing thread; the target width must be a multiple of 4
+extern void hleRasterTarget(uint32_t* pixels, int width, int height);
+extern void hleRasterClear(uint32_t rgba);
+extern void hleRasterTriangle(const HLERASTERVERTEX* v0, const HLERASTERVERTEX* v1,
+                              const HLERASTERVERTEX* v2, const HLERASTERTEXTURE* tex,
+                              bool bilinear = false);
+extern void hleRasterFlush();
+
+// RGBA8 texels, row-major. The same pointer is taken to hold the same
+// texels until the next flush, so contents are hashed once per flush.
+extern const HLERASTERTEXTURE* hleRasterTexture(const uint32_t* texels, int width, int height);
+
+// Drawing thread. With profiling on every flush times each tile it draws;
+// hleRasterTileTimes gives the last one's, in ns and in the order the tiles
+// are dealt out to the pool, for working out what the pool does with more
+// cores than the host has
+extern void   hleRasterProfile(bool on);
+extern size_t hleRasterTileTimes(const uint32_t** ns);
+
+#endif // HLERASTER_H
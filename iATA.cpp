@@ -6,12 +6,14 @@
 #include <fstream>
 #include <string>
 //#include <arpa/inet.h>   // for htons/ntohs if needed
+#include "ki.h"
 #include "iMain.h"
 #include "dynaCompiler.h"
 #include "iCPU.h"
 #include "iMemory.h"
 #include "iRom.h"
 #include "iATA.h"
+#include "iState.h"
 
 // Portable type definitions
 typedef uint32_t DWORD;
@@ -38,12 +40,17 @@ DWORD CatchMe = 0;
 
 WORD ataDriveID[6];
 
+DWORD ataBulkCopies = 0; // PIO fast path hits
+DWORD ataBulkWords = 0;  // words moved by the fast path
+
 #define MIRRORn
 #define VERBOSEn
 
+#define ATA_BUFFER_SIZE (512 * 256 * 2) // bytes per sector * max sectors per access
+
 void iATAConstruct()
 {
-    ataDataBuffer = (WORD *)malloc(512 * 256 * 2); // bytes per sector * max sectors per access
+    ataDataBuffer = (WORD *)malloc(ATA_BUFFER_SIZE);
     if (!ataDataBuffer) {
         printf("ATA: Failed to allocate data buffer\n");
         std::abort();
@@ -71,7 +78,7 @@ bool iATAOpen()
 {
     ataFile.open(theApp.m_HDImage, std::ios::in | std::ios::out | std::ios::binary);
     if (!ataFile.is_open()) {
-        printf("ATA: Failed to open HD image: %s\n", theApp.m_HDImage.c_str());
+        printf("ATA: Failed to open HD image: %s\n", theApp.m_HDImage);
         return false;
     }
 
@@ -206,6 +213,18 @@ void iATAInitParams()
 #endif
 }
 
+// Image offset of the sector the task file registers point at
+static DWORD iATAAddress()
+{
+    DWORD addy = (ataSectorNum - 1);
+    DWORD cyl = ((ataCylHigh << 8) | ataCylLow);
+    addy += (cyl * 40 * 14);
+    addy += (ataHead * 40);
+    addy *= 512;
+    addy += 0xd;
+    return addy;
+}
+
 void iATAReadSectors()
 {
     ataCurData = ataDataBuffer;
@@ -219,13 +238,7 @@ void iATAReadSectors()
     ataCylHigh = m->atReg[0x128];
     ataHead = m->atReg[0x130];
 
-    DWORD addy = (ataSectorNum - 1);
-    DWORD cyl = ((ataCylHigh << 8) | ataCylLow);
-    addy += (cyl * 40 * 14);
-    addy += (ataHead * 40);
-    addy *= 512;
-    addy += 0xd;
-
+    DWORD addy = iATAAddress();
     ataFile.seekg(addy, std::ios::beg);
     ataFile.read(reinterpret_cast<char*>(ataDataBuffer), ataSectorCount * 512);
     ataTransferMode = 0;
@@ -255,13 +268,7 @@ void iATAWriteSectors()
     ataHead = m->atReg[0x130];
 
     ataTargetLen = ataSectorCount * 512;
-    DWORD addy = (ataSectorNum - 1);
-    DWORD cyl = ((ataCylHigh << 8) | ataCylLow);
-    addy += (cyl * 40 * 14);
-    addy += (ataHead * 40);
-    addy *= 512;
-    addy += 0xd;
-
+    DWORD addy = iATAAddress();
     ataFile.seekp(addy, std::ios::beg);
     // Data write deferred until iATADataRead completes
     ataTransferMode = 1;
@@ -307,3 +314,302 @@ BYTE *iATADataRead()
 
     return add;
 }
+
+// ---------------------- SAVE STATES ----------------------
+// Drive registers and the sector buffer with the transfer position in it; the
+// image itself is not saved, so sectors written since stay written.
+
+void iATASaveState(STATESTREAM *s)
+{
+    DWORD cur = (DWORD)(ataCurData - ataDataBuffer);
+
+    iStateWrite(s, ataHeads);
+    iStateWrite(s, ataSectors);
+    iStateWrite(s, ataHead);
+    iStateWrite(s, ataSectorCount);
+    iStateWrite(s, ataSectorNum);
+    iStateWrite(s, ataCylLow);
+    iStateWrite(s, ataCylHigh);
+    iStateWrite(s, cur);
+    iStateWrite(s, ataUsed);
+    iStateWrite(s, ataBytesHead);
+    iStateWrite(s, ataTransferMode);
+    iStateWrite(s, ataTargetLen);
+    iStateWrite(s, ataDriveID);
+    iStateWrite(s, ataDataBuffer, ATA_BUFFER_SIZE);
+}
+
+void iATALoadState(STATESTREAM *s)
+{
+    DWORD cur = 0;
+
+    iStateRead(s, ataHeads);
+    iStateRead(s, ataSectors);
+    iStateRead(s, ataHead);
+    iStateRead(s, ataSectorCount);
+    iStateRead(s, ataSectorNum);
+    iStateRead(s, ataCylLow);
+    iStateRead(s, ataCylHigh);
+    iStateRead(s, cur);
+    iStateRead(s, ataUsed);
+    iStateRead(s, ataBytesHead);
+    iStateRead(s, ataTransferMode);
+    iStateRead(s, ataTargetLen);
+    iStateRead(s, ataDriveID);
+    iStateRead(s, ataDataBuffer, ATA_BUFFER_SIZE);
+
+    ataCurData = ataDataBuffer + (cur < ATA_BUFFER_SIZE / 2 ? cur : 0);
+
+    // a write in progress lands where WriteSectors pointed the image
+    if (ataTransferMode && ataFile.is_open())
+        ataFile.seekp(iATAAddress(), std::ios::beg);
+}
+
+// ---------------------- PIO FAST PATH ----------------------
+// The KI disk routines drain the data port with a tight loop along the lines
+// of  lh t,0x100(base) / sh t,0(dst) / addiu dst,dst,2 / bne cnt,zero,loop
+// which costs a full MMIO dispatch per 16-bit word. When the interpreter
+// lands on the head of such a loop mid-transfer we decode it once, work out
+// how many iterations are left and copy that much straight out of the sector
+// buffer, leaving the final iteration to run normally so the end-of-transfer
+// handling in iATADataRead() and the loop exit stay untouched.
+
+#define ATA_LOOP_MAX    8
+#define ATA_LOOP_CACHE  4
+
+#define OP_ADDI  0x08
+#define OP_ADDIU 0x09
+#define OP_BNE   0x05
+#define OP_LH    0x21
+#define OP_LHU   0x25
+#define OP_SH    0x29
+
+struct iATALoop
+{
+    DWORD Head;
+    DWORD Code[ATA_LOOP_MAX];
+    BYTE  Len;       // instructions including the delay slot
+    BYTE  Valid;     // 1 = copy loop, 2 = something else
+    BYTE  Signed;    // lh rather than lhu
+    BYTE  Data;      // register the data port is read into
+    BYTE  Base;      // register holding the ATA base address
+    short LoadImm;
+    BYTE  LoadPos;
+    BYTE  Dst;       // destination pointer
+    short StoreImm;
+    BYTE  StorePos;
+    BYTE  DstPos;    // position of addiu dst,dst,2
+    BYTE  Cnt;       // optional counter, 0 if none
+    short CntStep;
+    BYTE  CntPos;
+    BYTE  Ind;       // register the bne tests
+    BYTE  End;       // what it is tested against (0 = r0)
+    BYTE  BranchPos;
+};
+
+static iATALoop ataLoops[ATA_LOOP_CACHE];
+static DWORD ataLoopNext = 0;
+
+static inline DWORD iATAFetch(DWORD pc)
+{
+    if ((pc & 0xff000000) == 0x88000000)
+        return *(DWORD*)&m->rdRam[pc & MEM_MASK];
+    return *(DWORD*)&rom->Image[pc & 0x7ffff];
+}
+
+static void iATADecodeLoop(iATALoop *l, DWORD head)
+{
+    memset(l, 0, sizeof(iATALoop));
+    l->Head = head;
+    l->Valid = 2;
+
+    BYTE haveLoad = 0, haveStore = 0;
+    BYTE addReg[2], addPos[2], numAdd = 0;
+    short addImm[2];
+    BYTE branch = 0xff;
+    BYTE pos;
+
+    for (pos = 0; pos < ATA_LOOP_MAX; pos++)
+    {
+        DWORD op = iATAFetch(head + pos * 4);
+        l->Code[pos] = op;
+
+        BYTE rs = (op >> 21) & 0x1f;
+        BYTE rt = (op >> 16) & 0x1f;
+        short imm = (short)(op & 0xffff);
+
+        switch (op ? (op >> 26) : 0xff)
+        {
+            case 0xff: // nop
+                break;
+            case OP_LH:
+            case OP_LHU:
+                if (haveLoad || rt == 0) return;
+                haveLoad = 1;
+                l->Signed = (op >> 26) == OP_LH;
+                l->Data = rt;
+                l->Base = rs;
+                l->LoadImm = imm;
+                l->LoadPos = pos;
+                break;
+            case OP_SH:
+                if (haveStore || !haveLoad || rt != l->Data) return;
+                haveStore = 1;
+                l->Dst = rs;
+                l->StoreImm = imm;
+                l->StorePos = pos;
+                break;
+            case OP_ADDI:
+            case OP_ADDIU:
+                if (rs != rt || rt == 0 || imm == 0 || numAdd == 2) return;
+                addReg[numAdd] = rt;
+                addImm[numAdd] = imm;
+                addPos[numAdd] = pos;
+                numAdd++;
+                break;
+            case OP_BNE:
+                if (branch != 0xff) return;
+                // must branch back to the head
+                if ((DWORD)(head + pos * 4 + 4 + (imm << 2)) != head) return;
+                branch = pos;
+                l->BranchPos = pos;
+                l->Ind = rs;
+                l->End = rt;
+                break;
+            default:
+                return;
+        }
+
+        if (branch != 0xff && pos == branch + 1)
+            break;
+    }
+
+    if (branch == 0xff || pos >= ATA_LOOP_MAX) return;
+    if (!haveLoad || !haveStore) return;
+    l->Len = pos + 1;
+
+    // one addiu steps the destination by a halfword, the other is a counter
+    BYTE haveDst = 0;
+    for (BYTE i = 0; i < numAdd; i++)
+    {
+        if (addReg[i] == l->Dst && addImm[i] == 2 && !haveDst)
+        {
+            haveDst = 1;
+            l->DstPos = addPos[i];
+        }
+        else if (!l->Cnt && addReg[i] != l->Dst)
+        {
+            l->Cnt = addReg[i];
+            l->CntStep = addImm[i];
+            l->CntPos = addPos[i];
+        }
+        else
+            return;
+    }
+    if (!haveDst) return;
+
+    // bne operands: one induction register, one loop invariant
+    if (l->End == l->Dst || (l->Cnt && l->End == l->Cnt))
+    {
+        BYTE t = l->Ind;
+        l->Ind = l->End;
+        l->End = t;
+    }
+    if (l->Ind != l->Dst && (l->Ind != l->Cnt || !l->Cnt)) return;
+
+    // nothing but the induction registers and the data register may change
+    BYTE fixed[2] = { l->Base, l->End };
+    for (int i = 0; i < 2; i++)
+    {
+        if (fixed[i] == 0) continue;
+        if (fixed[i] == l->Data || fixed[i] == l->Dst || fixed[i] == l->Cnt) return;
+    }
+    if (l->Data == l->Dst || l->Data == l->Cnt) return;
+
+    l->Valid = 1;
+}
+
+static iATALoop *iATAFindLoop(DWORD head)
+{
+    for (int i = 0; i < ATA_LOOP_CACHE; i++)
+    {
+        iATALoop *l = &ataLoops[i];
+        if (!l->Valid || l->Head != head) continue;
+
+        // code may have been reloaded since we looked at it
+        BYTE len = l->Len ? l->Len : 1;
+        for (BYTE j = 0; j < len; j++)
+        {
+            if (iATAFetch(head + j * 4) != l->Code[j])
+            {
+                iATADecodeLoop(l, head);
+                break;
+            }
+        }
+        return l;
+    }
+
+    iATALoop *l = &ataLoops[ataLoopNext++ % ATA_LOOP_CACHE];
+    iATADecodeLoop(l, head);
+    return l;
+}
+
+bool iATABulkRead(DWORD pc)
+{
+    if (ataTransferMode || ataUsed >= ataTargetLen)
+        return false;
+
+    iATALoop *l = iATAFindLoop(pc);
+    if (l->Valid != 1)
+        return false;
+
+    // is it really reading our data port?
+    DWORD port = (DWORD)r->GPR[l->Base * 2] + l->LoadImm;
+    if (((port >> 24) != 0xb0 && (port >> 24) != 0xa8) || (port & 0xfff) != ATA_DATA_PORT)
+        return false;
+
+    // iterations left before the bne falls through
+    int step = (l->Ind == l->Dst) ? 2 : l->CntStep;
+    BYTE incPos = (l->Ind == l->Dst) ? l->DstPos : l->CntPos;
+    DWORD v0 = (DWORD)r->GPR[l->Ind * 2] + ((incPos < l->BranchPos) ? step : 0);
+    DWORD target = l->End ? (DWORD)r->GPR[l->End * 2] : 0;
+    DWORD dist = (step > 0) ? (target - v0) : (v0 - target);
+    DWORD mag = (step > 0) ? step : -step;
+    DWORD iters = (dist % mag) ? 0xffffffff : dist / mag + 1;
+
+    DWORD words = (ataTargetLen - ataUsed) >> 1;
+    if (iters < words) words = iters;
+    if (words < 2)
+        return false;
+    words--; // final pass goes through the interpreter
+
+    DWORD dst = (DWORD)r->GPR[l->Dst * 2] + l->StoreImm + ((l->DstPos < l->StorePos) ? 2 : 0);
+    // the whole run has to land in one stretch of RAM under the decode each
+    // sh would have gone through; the bytes are then the ones iMemWriteWord
+    // stores, since the port hands over halfwords in the same order
+    if ((dst & 0xff000000) != 0x88000000 || (dst & 1))
+        return false;
+    BYTE *to = iMemPhysWriteAddr(dst);
+    if (iMemPhysWriteAddr(dst + words * 2 - 1) != to + words * 2 - 1)
+        return false;
+
+    memcpy(to, ataCurData, words * 2);
+
+    WORD last = ataCurData[words - 1];
+    ataCurData += words;
+    ataUsed += words * 2;
+
+    *(int64_t*)&r->GPR[l->Data * 2] = l->Signed ? (int64_t)(int16_t)last : (int64_t)last;
+    *(int64_t*)&r->GPR[l->Dst * 2] = (int64_t)(int32_t)((DWORD)r->GPR[l->Dst * 2] + words * 2);
+    if (l->Cnt)
+        *(int64_t*)&r->GPR[l->Cnt * 2] = (int64_t)(int32_t)((DWORD)r->GPR[l->Cnt * 2] + l->CntStep * words);
+    r->ICount += (uint64_t)words * l->Len;
+
+    ataBulkCopies++;
+    ataBulkWords += words;
+
+#ifdef VERBOSE
+    printf("ATA bulk read %u words at PC=%08X\n", words, pc);
+#endif
+    return true;
+}
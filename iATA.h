@@ -5,6 +5,18 @@
 
 // Type definitions
 typedef uint8_t BYTE;
+typedef uint32_t DWORD;
+
+// Data register in the ATA pages (0xb0 and its 0xa8 mirror); each halfword
+// read there is the next one of the transfer, through iATADataRead
+#define ATA_DATA_PORT 0x100
+
+// Transfer state, checked by the CPU loop before trying the PIO fast path
+extern DWORD ataUsed;
+extern DWORD ataBulkCopies;
+extern DWORD ataBulkWords;
+
+struct STATESTREAM;
 
 // Function declarations
 void iATAConstruct();
@@ -17,5 +29,8 @@ void iATAReadSectors();
 void iATAWriteSectors();
 void iATADriveIdentify();
 BYTE *iATADataRead();
+bool iATABulkRead(DWORD pc);
+void iATASaveState(STATESTREAM *s);
+void iATALoadState(STATESTREAM *s);
 
 #endif // iATA_H
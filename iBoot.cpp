@@ -0,0 +1,108 @@
+#include <cstdio>
+#include <cstdlib>
+#include <switch.h>
+#include "ki.h"
+#include "iRomCheck.h"
+#include "dspLink.h"
+#include "iState.h"
+#include "iBoot.h"
+
+struct BOOTHEADER {
+    uint32_t magic;
+    uint32_t romHash;       // iRomSetHash when it was made
+    uint32_t frames;        // BOOT_SNAPSHOT_FRAMES when it was made
+    uint32_t size;          // state image that follows
+};
+
+static uint32_t bootFrames;
+
+static const char* iBootFile()
+{
+    return gRomSet == KI2 ? "ki2.boot" : "ki.boot";
+}
+
+static double iBootMs(u64 ticks)
+{
+    return armTicksToNs(ticks) / 1000000.0;
+}
+
+// The image is read whole: there is no demand paging of files to map it with,
+// and packed it is a couple of MB
+bool iBootRestore()
+{
+    bootFrames = 0;
+
+    u64 start = armGetSystemTick();
+    FILE* f = fopen(iBootFile(), "rb");
+    if (!f)
+    {
+        printf("Boot: no %s, cold boot\n", iBootFile());
+        return false;
+    }
+
+    BOOTHEADER header;
+    uint8_t* data = nullptr;
+    bool ok = fread(&header, sizeof(header), 1, f) == 1 && header.magic == BOOT_MAGIC;
+    if (ok && (header.romHash != iRomSetHash || header.frames != BOOT_SNAPSHOT_FRAMES))
+    {
+        printf("Boot: %s was made with other ROMs or HD image, cold boot\n", iBootFile());
+        ok = false;
+    }
+    else if (ok)
+    {
+        data = (uint8_t*)malloc(header.size);
+        ok = data && fread(data, 1, header.size, f) == header.size;
+        if (!ok)
+            printf("Boot: reading %s failed, cold boot\n", iBootFile());
+    }
+    fclose(f);
+
+    if (ok)
+    {
+        u64 read = armGetSystemTick();
+        dspLinkPause();
+        ok = iStateRestore(data, header.size);
+        dspLinkResume();
+        if (ok)
+            printf("Boot: restored %s, read in %.1f ms, restored in %.1f ms\n", iBootFile(),
+                   iBootMs(read - start), iBootMs(armGetSystemTick() - read));
+        else
+            printf("Boot: %s did not restore, cold boot\n", iBootFile());
+    }
+    free(data);
+    return ok;
+}
+
+static void iBootSave()
+{
+    STATEIMAGE image = {};
+    dspLinkPause();
+    bool ok = iStateCapture(&image);
+    dspLinkResume();
+
+    FILE* f = ok ? fopen(iBootFile(), "wb") : nullptr;
+    if (f)
+    {
+        BOOTHEADER header = { BOOT_MAGIC, iRomSetHash, BOOT_SNAPSHOT_FRAMES, (uint32_t)image.size };
+        ok = fwrite(&header, sizeof(header), 1, f) == 1 &&
+             fwrite(image.data, 1, image.size, f) == image.size;
+        ok = fclose(f) == 0 && ok;
+        if (!ok)
+            remove(iBootFile());
+    }
+
+    if (f && ok)
+        printf("Boot: saved %s (%zu KB) for the next launch\n", iBootFile(), image.size >> 10);
+    else
+        printf("Boot: could not save %s\n", iBootFile());
+    iStateFree(&image);
+}
+
+bool iBootFrame()
+{
+    if (++bootFrames < BOOT_SNAPSHOT_FRAMES)
+        return false;
+
+    iBootSave();
+    return true;
+}
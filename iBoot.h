@@ -0,0 +1,18 @@
+#ifndef IBOOT_H
+#define IBOOT_H
+
+#include <cstdint>
+
+// Instant boot: the machine as it stands once the cold boot (self-test and
+// the first disk reads) is over, saved by the first boot and restored by
+// later launches instead of booting again. The file carries iRomSetHash, so
+// a different program ROM, sound ROM or HD image means a cold boot and a new
+// snapshot.
+
+#define BOOT_MAGIC            0x6f42494b   // "KIBo"
+#define BOOT_SNAPSHOT_FRAMES  1800         // frames from a cold reset to the snapshot
+
+extern bool iBootRestore();     // after iMainReset, before the CPU thread starts
+extern bool iBootFrame();       // every VSYNC of a cold boot; true once it is over
+
+#endif // IBOOT_H
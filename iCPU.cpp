@@ -13,12 +13,29 @@
 #include "iIns.h"
 #include "hleMain.h"
 #include "hleDSP.h"
+#include "adsp2100.h"
+#include "dspLink.h"
+#include "audioRing.h"
+#include "iATA.h"
+#include "iState.h"
+#include "iRewind.h"
+#include "iBoot.h"
+#include "iReplay.h"
+#include "iHash.h"
+#include "iCapture.h"
+#include "iInput.h"
+#include "videoConvert.h"
+#include "videoPace.h"
+#include "ki.h"
+
+extern void emuFrameDone();
+extern uint16_t inputs[4];
 
 // --- Emulated CPU/DSP state ---
 static RS4300iReg* r = nullptr;
-static u32 iCpuNextVSYNC = 0;
 static bool iCpuResetVSYNC = false;
 static u32 iCpuVSYNCAccum = 0;
+static u64 iCpuNextDSP = 0;
 
 // --- Thread management ---
 static Thread cpuThread;
@@ -26,9 +43,6 @@ static Thread dspThread;
 static bool cpuRunning = true;
 static bool dspRunning = true;
 
-// --- Timing ---
-static u64 hleDSPPingTime = 0;
-
 // Emulated registers / app context placeholders
 extern "C" {
     extern void dynaInit();
@@ -37,6 +51,7 @@ extern "C" {
     extern void hleISR();
     extern void hleISR2();
 }
+extern void dynaInvalidate(DWORD Start, DWORD Length);
 
 // ------------------ CPU Construction ------------------
 
@@ -84,24 +99,30 @@ void iCpuReset() {
     r->NextIntCount = 6250000;
     r->CompareCount = 0;
     r->VTraceCount = 6250000;
+
+    iCpuNextDSP = 0;
+    dspLinkReset(r->ICount);
+    audioRingReset();
 }
 
 // ------------------ DSP Thread ------------------
 
+// The DSP only ever runs the cycles the CPU has paid for (dspLink); when it
+// has caught up it idles until the CPU publishes its next slice.
 void dspThreadFunc(void*) {
-    svcSleepThread(1'000'000'000); // 1s delay before start
-
     while (dspRunning) {
-        hleDSPMain();
-        hleDSPMain2();
+        if (!dspLinkService())
+            svcSleepThread(500'000); // 0.5ms
+    }
+}
 
-        if (hleDSPPingTime == 0)
-            hleDSPPingTime = armGetSystemTick() + armTicksPerMs() * 7;
+// Hand CPU progress to the DSP once per slice
+void iCpuStepDSP() {
+    if (r->ICount < iCpuNextDSP)
+        return;
 
-        // Placeholder for audio scheduling / buffer update
-        svcSleepThread(7'000'000); // 7ms
-        hleDSPMain3();
-    }
+    iCpuNextDSP = r->ICount + DSPLINK_CPU_SLICE;
+    dspLinkAdvance(r->ICount);
 }
 
 // ------------------ CPU Thread ------------------
@@ -131,46 +152,175 @@ void cpuThreadFunc(void*) {
             case EXEC_DELAY:
                 r->Delay = NO_DELAY;
                 r->PC = r->PCDelay;
+                // landed on a loop head mid-transfer: try the ATA bulk copy
+                if (ataUsed)
+                    iATABulkRead(r->PC);
                 break;
         }
 
-        iCpuVSYNC();
+        r->ICount++;
+        iCpuStepDSP();
+        if (r->ICount >= r->NextIntCount)
+            iCpuVSYNC();
     }
 }
 
 // ------------------ VSYNC / Timing ------------------
 
+static const char* iCpuReplayFile() {
+    return gRomSet == KI2 ? "ki2.inp" : "ki.inp";
+}
+
 void iCpuVSYNC() {
-    u64 now = armGetSystemTick();
-    if (iCpuNextVSYNC == 0)
-        iCpuNextVSYNC = now + armTicksPerMs() * 16;
+    // replays run flat out; pacing starts over when they end. The frame
+    // goes to the presenter thread unless the pacer is skipping it; capture
+    // counts every VSYNC so skipped frames show up as gaps
+    bool draw = true;
+    if (iReplayMode() == REPLAY_PLAY)
+        videoPaceReset();
+    else
+        draw = videoPaceFrame();
+    iCaptureVSYNC();
+
+    // the pads as late as they can be had: the frame has been waited out and
+    // the game has not started the next. An input log being replayed takes
+    // inputs[] over after this; the sticks no log can reproduce are left alone
+    INPUTSNAPSHOT pad;
+    if (iInputLatch(&pad)) {
+        memcpy(inputs, pad.inputs, sizeof(pad.inputs));
+        if (iReplayMode() == REPLAY_IDLE) {
+            r->GPR[A0 * 2] = pad.sticks[0];
+            r->GPR[A1 * 2] = pad.sticks[1];
+            r->GPR[A2 * 2] = pad.sticks[2];
+            r->GPR[A3 * 2] = pad.sticks[3];
+        }
+    }
 
-    s64 diff = (s64)iCpuNextVSYNC - (s64)now;
-    if (diff > 0)
-        svcSleepThread(diff);
+    if (draw)
+        emuFrameDone();
 
-    iCpuNextVSYNC += armTicksPerMs() * 16;
     r->ICount = r->NextIntCount;
     r->VTraceCount += 833333;
     r->NextIntCount = r->VTraceCount;
     hleISR();
+
+    if (NewTask == BOOT_STAGE0 && iBootFrame())
+        NewTask = NORMAL_GAME;
+
+    // between frames nothing is half done: take the state tasks here
+    iRewindFrame();
+    switch (NewTask) {
+        case SAVE_GAME:
+            iCpuSaveGame();
+            NewTask = NORMAL_GAME;
+            break;
+        case LOAD_GAME:
+            iCpuLoadGame();
+            NewTask = NORMAL_GAME;
+            break;
+        case STATE_CHECK:
+            NewTask = NORMAL_GAME;
+            iStateCheckStart(STATE_CHECK_FRAMES);
+            break;
+        case REWIND_GAME:
+            NewTask = NORMAL_GAME;
+            iRewindStep();
+            break;
+        case RECORD_INPUT:
+            NewTask = NORMAL_GAME;
+            if (iReplayMode() == REPLAY_RECORD)
+                iReplayStop();
+            else
+                iReplayRecord(iCpuReplayFile());
+            break;
+        case REPLAY_INPUT:
+            NewTask = NORMAL_GAME;
+            // the rewind averages CEmuObject::Replay reports cover the log alone
+            if (iReplayPlay(iCpuReplayFile(), theApp.m_ReplayFrames))
+                iRewindStats(nullptr, true);
+            break;
+        case CAPTURE_AV:
+            NewTask = NORMAL_GAME;
+            if (iCaptureActive())
+                iCaptureStop();
+            else
+                iCaptureStart(gRomSet == KI2 ? "ki2" : "ki", theApp.m_CaptureRaw ? CAPTURE_RAW : CAPTURE_Y4M,
+                              VIDEO_WIDTH, VIDEO_HEIGHT);
+            break;
+    }
+    iReplayFrame();
+    iStateCheckFrame();
+}
+
+// ------------------ Save States ------------------
+
+static const char* iCpuStateFile() {
+    return gRomSet == KI2 ? "ki2.sta" : "ki.sta";
+}
+
+void iCpuSaveGame() {
+    iStateSave(iCpuStateFile());
+}
+
+void iCpuLoadGame() {
+    iStateLoad(iCpuStateFile());
+}
+
+void iCpuSaveState(STATESTREAM* s) {
+    iStateWrite(s, *r);
+    iStateWrite(s, iCpuVSYNCAccum);
+    iStateWrite(s, iCpuNextDSP);
+    iStateWrite(s, iOpCode);
+    iStateWrite(s, iNextOpCode);
+    iStateWrite(s, iPC);
+    iStateWrite(s, iFPUMode);
+}
+
+// RAM is already back; code compiled from what was there goes, and frame
+// pacing starts over from now
+void iCpuLoadState(STATESTREAM* s) {
+    iStateRead(s, *r);
+    iStateRead(s, iCpuVSYNCAccum);
+    iStateRead(s, iCpuNextDSP);
+    iStateRead(s, iOpCode);
+    iStateRead(s, iNextOpCode);
+    iStateRead(s, iPC);
+    iStateRead(s, iFPUMode);
+
+    videoPaceReset();
+    dynaInvalidate(0, 0x800000);
+}
+
+// For input log replays; the register file is the state that drifts first
+uint64_t iCpuStateHash() {
+    return iHash64(r, sizeof(RS4300iReg));
 }
 
 // ------------------ Thread Control ------------------
 
 void iCpuStartThreads() {
+    dspLinkOpen();
+
     threadCreate(&cpuThread, cpuThreadFunc, nullptr, 0x4000, 0x2B, -2);
     threadStart(&cpuThread);
 
-    threadCreate(&dspThread, dspThreadFunc, nullptr, 0x4000, 0x2C, -2);
-    threadStart(&dspThread);
+    // second core, so the skew barrier costs the CPU nothing while the DSP keeps up
+    if (!dspLinkInline) {
+        threadCreate(&dspThread, dspThreadFunc, nullptr, 0x4000, 0x2C, 1);
+        threadStart(&dspThread);
+    }
 }
 
 void iCpuStopThreads() {
+    // let a CPU blocked on the skew barrier see cpuRunning
     cpuRunning = false;
-    dspRunning = false;
+    dspLinkClose();
     threadWaitForExit(&cpuThread);
-    threadWaitForExit(&dspThread);
     threadClose(&cpuThread);
-    threadClose(&dspThread);
+
+    if (!dspLinkInline) {
+        dspRunning = false;
+        threadWaitForExit(&dspThread);
+        threadClose(&dspThread);
+    }
 }
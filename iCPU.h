@@ -11,6 +11,8 @@ using UINT  = unsigned int;
 #define PATCH_SIN 16
 #define PATCH_COSIN 17
 
+struct STATESTREAM;
+
 // Forward declarations
 extern void iCpuConstruct();
 extern void iCpuDestruct();
@@ -56,6 +58,9 @@ extern void iCpuCheckVSYNC();
 
 extern void iCpuSaveGame();
 extern void iCpuLoadGame();
+extern void iCpuSaveState(STATESTREAM* s);
+extern void iCpuLoadState(STATESTREAM* s);
+extern uint64_t iCpuStateHash();
 extern void iCpuCheckFPU();
 extern void iCpuDoNextOp();
 extern void iCpuStepDSP();
@@ -65,7 +70,6 @@ extern std::thread iCpuThread;
 extern std::thread iDspThread;
 
 // CPU/Emulator state
-extern DWORD iCpuNextVSYNC;
 extern bool iCpuResetVSYNC;
 
 #endif // ICPU_H
@@ -0,0 +1,307 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "audioRing.h"
+#include "wave.h"
+#include "iCapture.h"
+
+// One slot of the pool: a frame and the VSYNC it was taken at
+struct CAPTURESLOT {
+    uint32_t              frame;
+    std::vector<uint32_t> pixels;
+};
+
+static int                   captureFormat;
+static int                   captureWidth, captureHeight;
+static std::atomic<bool>     captureOn(false);
+static std::atomic<uint32_t> captureVsyncs(0);
+
+// Frames: the CPU thread fills slots at head, the writer empties them at tail
+static CAPTURESLOT           captureSlots[CAPTURE_FRAMES];
+static std::atomic<uint32_t> captureFrameHead(0), captureFrameTail(0);
+
+// Samples: the DSP thread writes at head, the writer reads at tail
+static int16_t               captureSamples[CAPTURE_SAMPLES];
+static std::atomic<uint32_t> captureSampleHead(0), captureSampleTail(0);
+
+static std::thread             captureThread;
+static std::mutex              captureLock;         // the writer's sleep only
+static std::condition_variable captureWake;
+static bool                    captureQuit;
+
+// Writer thread's
+static FILE*                captureVideo;           // .y4m or .kic
+static WAVEFILE             captureWave;
+static bool                 captureFailed;
+static uint32_t             captureLast;            // frame last written
+static std::vector<uint8_t> captureYUV;             // last frame written, Y4M
+
+static std::atomic<uint32_t> captureWritten, captureDropped, captureRepeated;
+static std::atomic<uint32_t> captureSampleCount, captureSamplesDropped, captureCopyNs;
+
+// ---------------------- WRITER ----------------------
+
+static void iCaptureWrite(const void* data, size_t bytes)
+{
+    if (!captureFailed && fwrite(data, 1, bytes, captureVideo) != bytes)
+    {
+        printf("Capture: cannot write, the rest is thrown away\n");
+        captureFailed = true;
+    }
+}
+
+static void iCapturePacket(uint32_t type, uint32_t frame, const void* data, uint32_t bytes)
+{
+    CAPTUREPACKET packet = { type, frame, bytes };
+    iCaptureWrite(&packet, sizeof(packet));
+    iCaptureWrite(data, bytes);
+}
+
+// BT.601 full range in 8.8 fixed point; chroma is offset so it never goes
+// negative before the shift
+static void iCaptureConvert(uint8_t* y, uint8_t* u, uint8_t* v, const uint32_t* rgba, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        int r = rgba[i] & 0xff, g = rgba[i] >> 8 & 0xff, b = rgba[i] >> 16 & 0xff;
+        int cb = (-43 * r - 85 * g + 128 * b + 32896) >> 8;
+        int cr = (128 * r - 107 * g - 21 * b + 32896) >> 8;
+        y[i] = (uint8_t)((77 * r + 150 * g + 29 * b + 128) >> 8);
+        u[i] = (uint8_t)(cb > 255 ? 255 : cb);
+        v[i] = (uint8_t)(cr > 255 ? 255 : cr);
+    }
+}
+
+static void iCaptureWriteFrame(const CAPTURESLOT* slot)
+{
+    if (captureFormat == CAPTURE_RAW)
+    {
+        iCapturePacket(CAPTURE_PACKET_FRAME, slot->frame, slot->pixels.data(), (uint32_t)(slot->pixels.size() * 4));
+        captureWritten++;
+        return;
+    }
+
+    // the frames nobody took cover the gap
+    static const char header[] = "FRAME\n";
+    if (captureWritten)
+        for (uint32_t f = captureLast + 1; f < slot->frame; f++)
+        {
+            iCaptureWrite(header, sizeof(header) - 1);
+            iCaptureWrite(captureYUV.data(), captureYUV.size());
+            captureRepeated++;
+        }
+
+    size_t plane = (size_t)captureWidth * captureHeight;
+    iCaptureConvert(&captureYUV[0], &captureYUV[plane], &captureYUV[plane * 2], slot->pixels.data(), (int)plane);
+    iCaptureWrite(header, sizeof(header) - 1);
+    iCaptureWrite(captureYUV.data(), captureYUV.size());
+    captureWritten++;
+}
+
+static void iCaptureDrain()
+{
+    uint32_t tail = captureSampleTail.load(std::memory_order_relaxed);
+    uint32_t head = captureSampleHead.load(std::memory_order_acquire);
+    while (tail != head)
+    {
+        uint32_t at = tail & (CAPTURE_SAMPLES - 1);
+        uint32_t count = std::min(head - tail, (uint32_t)CAPTURE_SAMPLES - at);
+        if (captureFormat == CAPTURE_RAW)
+            iCapturePacket(CAPTURE_PACKET_AUDIO, captureVsyncs.load(std::memory_order_relaxed),
+                           &captureSamples[at], count * sizeof(int16_t));
+        else if (!captureFailed)
+        {
+            uint32_t wrote;
+            if (WaveWriteFile(&captureWave, count * sizeof(int16_t), (const uint8_t*)&captureSamples[at], &wrote) != 0)
+            {
+                printf("Capture: cannot write the sound, the rest is thrown away\n");
+                captureFailed = true;
+            }
+        }
+        tail += count;
+        captureSampleTail.store(tail, std::memory_order_release);
+    }
+
+    tail = captureFrameTail.load(std::memory_order_relaxed);
+    head = captureFrameHead.load(std::memory_order_acquire);
+    for (; tail != head; tail++)
+    {
+        const CAPTURESLOT* slot = &captureSlots[tail % CAPTURE_FRAMES];
+        iCaptureWriteFrame(slot);
+        captureLast = slot->frame;
+        captureFrameTail.store(tail + 1, std::memory_order_release);
+    }
+}
+
+static void iCaptureWriter()
+{
+    for (;;)
+    {
+        bool quit;
+        {
+            std::unique_lock<std::mutex> lock(captureLock);
+            captureWake.wait_for(lock, std::chrono::milliseconds(CAPTURE_POLL), [] { return captureQuit; });
+            quit = captureQuit;
+        }
+        iCaptureDrain();
+        if (quit)
+            return;
+    }
+}
+
+// ---------------------- CONTROL ----------------------
+
+static bool iCaptureOpen(const char* base)
+{
+    char path[256];
+    if (captureFormat == CAPTURE_RAW)
+    {
+        snprintf(path, sizeof(path), "%s.kic", base);
+        captureVideo = fopen(path, "wb");
+        CAPTUREHEADER header = { CAPTURE_MAGIC, CAPTURE_FORMAT, (uint16_t)captureWidth, (uint16_t)captureHeight,
+                                 1, AUDIO_RING_RATE };
+        return captureVideo && fwrite(&header, sizeof(header), 1, captureVideo) == 1;
+    }
+
+    snprintf(path, sizeof(path), "%s.y4m", base);
+    captureVideo = fopen(path, "wb");
+    if (!captureVideo ||
+        fprintf(captureVideo, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C444 XCOLORRANGE=FULL\n",
+                captureWidth, captureHeight, CAPTURE_RATE) < 0)
+        return false;
+
+    WAVEFORMATEX format = { WAVE_FORMAT_PCM, 1, AUDIO_RING_RATE, AUDIO_RING_RATE * 2, 2, 16, 0 };
+    snprintf(path, sizeof(path), "%s.wav", base);
+    return WaveCreateFile(path, &captureWave, &format) == 0 && WaveStartDataWrite(&captureWave) == 0;
+}
+
+static void iCaptureClose()
+{
+    if (captureVideo)
+        fclose(captureVideo);
+    captureVideo = nullptr;
+    WaveCloseWriteFile(&captureWave, captureSampleCount - captureSamplesDropped);
+}
+
+bool iCaptureStart(const char* base, int format, int width, int height)
+{
+    iCaptureStop();
+
+    captureFormat = format;
+    captureWidth = width;
+    captureHeight = height;
+    memset(&captureWave, 0, sizeof(captureWave));
+    captureFailed = false;
+    if (!iCaptureOpen(base))
+    {
+        printf("Capture: cannot write %s\n", base);
+        iCaptureClose();
+        return false;
+    }
+
+    // made once for a size and kept; a late copy into a slot after a stop
+    // lands in memory that is still there
+    for (CAPTURESLOT& slot : captureSlots)
+        slot.pixels.resize((size_t)width * height);
+    if (format == CAPTURE_Y4M)
+        captureYUV.assign((size_t)width * height * 3, 0);
+
+    captureFrameHead = captureFrameTail = 0;
+    captureSampleTail.store(captureSampleHead.load());
+    captureVsyncs = 0;
+    captureLast = 0;
+    captureWritten = captureDropped = captureRepeated = 0;
+    captureSampleCount = captureSamplesDropped = captureCopyNs = 0;
+    captureQuit = false;
+    captureThread = std::thread(iCaptureWriter);
+    captureOn.store(true, std::memory_order_release);
+    printf("Capture: recording %s\n", base);
+    return true;
+}
+
+// Any thread; whatever the writer has not written yet is written first
+void iCaptureStop()
+{
+    if (!captureThread.joinable())
+        return;
+
+    captureOn.store(false, std::memory_order_release);
+    {
+        std::lock_guard<std::mutex> lock(captureLock);
+        captureQuit = true;
+    }
+    captureWake.notify_one();
+    captureThread.join();
+    iCaptureClose();
+
+    printf("Capture: %u frames, %u dropped, %u repeated, %u samples\n", (uint32_t)captureWritten,
+           (uint32_t)captureDropped, (uint32_t)captureRepeated, (uint32_t)captureSampleCount);
+}
+
+bool iCaptureActive()
+{
+    return captureOn.load(std::memory_order_relaxed);
+}
+
+// ---------------------- PRODUCERS ----------------------
+
+void iCaptureVSYNC()
+{
+    if (captureOn.load(std::memory_order_relaxed))
+        captureVsyncs.fetch_add(1, std::memory_order_relaxed);
+}
+
+void iCaptureFrame(const uint32_t* pixels)
+{
+    if (!captureOn.load(std::memory_order_acquire))
+        return;
+
+    auto start = std::chrono::steady_clock::now();
+    uint32_t head = captureFrameHead.load(std::memory_order_relaxed);
+    if (head - captureFrameTail.load(std::memory_order_acquire) == CAPTURE_FRAMES)
+    {
+        captureDropped++;
+        return;
+    }
+
+    CAPTURESLOT* slot = &captureSlots[head % CAPTURE_FRAMES];
+    slot->frame = captureVsyncs.load(std::memory_order_relaxed);
+    memcpy(slot->pixels.data(), pixels, slot->pixels.size() * sizeof(uint32_t));
+    captureFrameHead.store(head + 1, std::memory_order_release);
+    captureCopyNs = (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+void iCaptureAudio(const int16_t* samples, int count)
+{
+    if (!captureOn.load(std::memory_order_acquire))
+        return;
+
+    uint32_t head = captureSampleHead.load(std::memory_order_relaxed);
+    uint32_t room = CAPTURE_SAMPLES - (head - captureSampleTail.load(std::memory_order_acquire));
+    captureSampleCount += count;
+    if ((uint32_t)count > room)
+    {
+        captureSamplesDropped += count - room;
+        count = (int)room;
+    }
+    for (int i = 0; i < count; i++)
+        captureSamples[(head + i) & (CAPTURE_SAMPLES - 1)] = samples[i];
+    captureSampleHead.store(head + count, std::memory_order_release);
+}
+
+void iCaptureStats(CAPTURESTATS* stats)
+{
+    stats->frames = captureVsyncs;
+    stats->written = captureWritten;
+    stats->dropped = captureDropped;
+    stats->repeated = captureRepeated;
+    stats->samples = captureSampleCount;
+    stats->samplesDropped = captureSamplesDropped;
+    stats->copyUs = captureCopyNs / 1000.0;
+}
@@ -0,0 +1,72 @@
+#ifndef ICAPTURE_H
+#define ICAPTURE_H
+
+#include <cstdint>
+
+// Recording what the cabinet shows and plays, for match recordings and for
+// golden outputs to check changes against.
+//
+// The emulation threads only copy: a converted frame into a slot of a pool
+// made when capture starts (CPU thread, at VSYNC), board samples into a ring
+// (DSP thread, at the autobuffer hand-off). Neither waits; with no free slot
+// a frame is dropped and counted. A writer thread of its own takes slots and
+// samples as they come and does everything else: colour conversion, files.
+//
+//   CAPTURE_Y4M   <base>.y4m, 4:4:4 full range so single pixels keep their
+//                 colour, and <base>.wav, 16-bit mono at the board's rate.
+//                 A frame dropped or not drawn repeats the one before, so
+//                 the two stay the same length.
+//   CAPTURE_RAW   <base>.kic, the RGBA8 frames and the samples as they
+//                 came, each packet tagged with the frame it belongs to.
+//                 Nothing is converted or repeated, so gaps show.
+
+#define CAPTURE_MAGIC     0x7043494b     // "KICp"
+#define CAPTURE_FORMAT    1
+#define CAPTURE_FRAMES    8              // frame slots (133 ms at 60 Hz)
+#define CAPTURE_SAMPLES   32768          // sample ring, power of two (1 s)
+#define CAPTURE_RATE      60             // frames a second in the Y4M header
+#define CAPTURE_POLL      4              // ms the writer sleeps when idle
+
+enum { CAPTURE_Y4M, CAPTURE_RAW };
+
+// CAPTURE_RAW file header, then packets of CAPTUREPACKET + bytes
+struct CAPTUREHEADER {
+    uint32_t magic;
+    uint16_t format;
+    uint16_t width;
+    uint16_t height;
+    uint16_t channels;
+    uint32_t sampleRate;
+};
+
+enum { CAPTURE_PACKET_FRAME = 'V', CAPTURE_PACKET_AUDIO = 'A' };
+
+struct CAPTUREPACKET {
+    uint32_t type;
+    uint32_t frame;         // VSYNCs since capture started
+    uint32_t bytes;
+};
+
+struct CAPTURESTATS {
+    uint32_t frames;        // VSYNCs captured
+    uint32_t written;
+    uint32_t dropped;       // no free slot
+    uint32_t repeated;      // Y4M frames written twice to cover a gap
+    uint32_t samples;
+    uint32_t samplesDropped;
+    double   copyUs;        // what iCaptureFrame cost the CPU thread, last frame
+};
+
+// CPU thread
+extern bool iCaptureStart(const char* base, int format, int width, int height);
+extern void iCaptureStop();
+extern bool iCaptureActive();
+extern void iCaptureVSYNC();                        // every VSYNC, drawn or not
+extern void iCaptureFrame(const uint32_t* pixels);  // the frame of this VSYNC, RGBA8
+
+// DSP thread
+extern void iCaptureAudio(const int16_t* samples, int count);
+
+extern void iCaptureStats(CAPTURESTATS* stats);
+
+#endif // ICAPTURE_H
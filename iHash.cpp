@@ -0,0 +1,150 @@
+#include <cstring>
+#include "iHash.h"
+
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define IHASH_STRIPE    64      // bytes a step, one word per accumulator
+#define IHASH_BLOCK     16      // steps between scrambles
+
+#define IHASH_PRIME32_1 0x9e3779b1U
+#define IHASH_PRIME32_2 0x85ebca77U
+#define IHASH_PRIME32_3 0xc2b2ae3dU
+#define IHASH_PRIME64_1 0x9e3779b185ebca87ULL
+#define IHASH_PRIME64_2 0xc2b2ae3d27d4eb4fULL
+#define IHASH_PRIME64_3 0x165667b19e3779f9ULL
+#define IHASH_PRIME64_4 0x85ebca77c2b2ae63ULL
+#define IHASH_PRIME64_5 0x27d4eb2f165667c5ULL
+
+static const uint64_t iHashKeys[8] = {
+    0xbe4ba423396cfeb8ULL, 0x1cad21f72c81017cULL, 0xdb979083e96dd4deULL, 0x1f67b3b7a4a44072ULL,
+    0x78e5c0cc4ee679cbULL, 0x2172ffcc7dd05a82ULL, 0x8e2443f7744608b8ULL, 0x4c263a81e69035e0ULL,
+};
+
+// Little-endian hosts only, which is all this runs on
+static inline uint64_t iHashRead64(const uint8_t* p)
+{
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint64_t iHashFold(uint64_t a, uint64_t b)
+{
+    unsigned __int128 m = (unsigned __int128)a * b;
+    return (uint64_t)m ^ (uint64_t)(m >> 64);
+}
+
+// ---------------------- KERNELS ----------------------
+
+// stripes steps of 64 bytes into acc; first is the number of the first step,
+// so the scrambles fall in the same places however the input is split
+static void iHashStripes(uint64_t* acc, const uint64_t* key, const uint8_t* p, size_t stripes, size_t first)
+{
+#if defined(__aarch64__)
+    uint64x2_t a[4], k[4];
+    uint32x2_t prime = vdup_n_u32(IHASH_PRIME32_1);
+    for (int i = 0; i < 4; i++)
+    {
+        a[i] = vld1q_u64(acc + i * 2);
+        k[i] = vld1q_u64(key + i * 2);
+    }
+    for (size_t s = 0; s < stripes; s++, p += IHASH_STRIPE)
+    {
+        for (int i = 0; i < 4; i++)
+        {
+            uint64x2_t d = vreinterpretq_u64_u8(vld1q_u8(p + i * 16));
+            uint64x2_t dk = veorq_u64(d, k[i]);
+            a[i] = vaddq_u64(a[i], vextq_u64(d, d, 1));
+            a[i] = vmlal_u32(a[i], vmovn_u64(dk), vshrn_n_u64(dk, 32));
+        }
+        if ((first + s + 1) % IHASH_BLOCK)
+            continue;
+        for (int i = 0; i < 4; i++)
+        {
+            uint64x2_t x = veorq_u64(veorq_u64(a[i], vshrq_n_u64(a[i], 47)), k[i]);
+            uint64x2_t hi = vshlq_n_u64(vmull_u32(vshrn_n_u64(x, 32), prime), 32);
+            a[i] = vmlal_u32(hi, vmovn_u64(x), prime);
+        }
+    }
+    for (int i = 0; i < 4; i++)
+        vst1q_u64(acc + i * 2, a[i]);
+#elif defined(__SSE2__)
+    __m128i a[4], k[4];
+    __m128i prime = _mm_set1_epi32((int)IHASH_PRIME32_1);
+    for (int i = 0; i < 4; i++)
+    {
+        a[i] = _mm_loadu_si128((const __m128i*)(acc + i * 2));
+        k[i] = _mm_loadu_si128((const __m128i*)(key + i * 2));
+    }
+    for (size_t s = 0; s < stripes; s++, p += IHASH_STRIPE)
+    {
+        for (int i = 0; i < 4; i++)
+        {
+            __m128i d = _mm_loadu_si128((const __m128i*)(p + i * 16));
+            __m128i dk = _mm_xor_si128(d, k[i]);
+            a[i] = _mm_add_epi64(a[i], _mm_shuffle_epi32(d, _MM_SHUFFLE(1, 0, 3, 2)));
+            a[i] = _mm_add_epi64(a[i], _mm_mul_epu32(dk, _mm_srli_epi64(dk, 32)));
+        }
+        if ((first + s + 1) % IHASH_BLOCK)
+            continue;
+        for (int i = 0; i < 4; i++)
+        {
+            __m128i x = _mm_xor_si128(_mm_xor_si128(a[i], _mm_srli_epi64(a[i], 47)), k[i]);
+            __m128i hi = _mm_slli_epi64(_mm_mul_epu32(_mm_srli_epi64(x, 32), prime), 32);
+            a[i] = _mm_add_epi64(_mm_mul_epu32(x, prime), hi);
+        }
+    }
+    for (int i = 0; i < 4; i++)
+        _mm_storeu_si128((__m128i*)(acc + i * 2), a[i]);
+#else
+    for (size_t s = 0; s < stripes; s++, p += IHASH_STRIPE)
+    {
+        for (int i = 0; i < 8; i++)
+        {
+            uint64_t d = iHashRead64(p + i * 8);
+            uint64_t dk = d ^ key[i];
+            acc[i ^ 1] += d;
+            acc[i] += (uint64_t)(uint32_t)dk * (dk >> 32);
+        }
+        if ((first + s + 1) % IHASH_BLOCK)
+            continue;
+        for (int i = 0; i < 8; i++)
+            acc[i] = (acc[i] ^ acc[i] >> 47 ^ key[i]) * IHASH_PRIME32_1;
+    }
+#endif
+}
+
+// ---------------------- HASH ----------------------
+
+uint64_t iHash64(const void* data, size_t size, uint64_t seed)
+{
+    const uint8_t* p = (const uint8_t*)data;
+    uint64_t acc[8] = { IHASH_PRIME32_3, IHASH_PRIME64_1, IHASH_PRIME64_2, IHASH_PRIME64_3,
+                        IHASH_PRIME64_4, IHASH_PRIME32_2, IHASH_PRIME64_5, IHASH_PRIME32_1 };
+    uint64_t key[8];
+    for (int i = 0; i < 8; i++)
+        key[i] = iHashKeys[i] + (i & 1 ? 0 - seed : seed);
+
+    // the last part step zero filled; the length, mixed in below, keeps it
+    // apart from the same bytes with zeros after them
+    size_t stripes = size / IHASH_STRIPE;
+    iHashStripes(acc, key, p, stripes, 0);
+    if (size % IHASH_STRIPE)
+    {
+        uint8_t last[IHASH_STRIPE] = {};
+        memcpy(last, p + stripes * IHASH_STRIPE, size % IHASH_STRIPE);
+        iHashStripes(acc, key, last, 1, stripes);
+    }
+
+    uint64_t h = size * IHASH_PRIME64_1;
+    for (int i = 0; i < 8; i += 2)
+        h += iHashFold(acc[i] ^ key[(i + 3) & 7], acc[i + 1] ^ key[(i + 4) & 7]);
+    h ^= h >> 37;
+    h *= IHASH_PRIME64_3;
+    h ^= h >> 32;
+    return h;
+}
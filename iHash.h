@@ -0,0 +1,20 @@
+#ifndef IHASH_H
+#define IHASH_H
+
+#include <cstddef>
+#include <cstdint>
+
+// 64-bit hash for telling outputs apart from run to run (frames, sound, the
+// register file), in the xxHash3 mould: eight 64-bit accumulators take 64
+// bytes a step, each word keyed and multiplied 32x32->64 with the word itself
+// added to its neighbour, and are scrambled every kilobyte. The
+// multiplies are the widening ones both NEON and SSE2 have, so it runs two
+// lanes to a register there; the plain C version gives the same hashes and
+// is the reference.
+//
+// Not for anything adversarial. Sizes need not be a multiple of anything;
+// the seed is how hashes of several blocks are chained.
+
+extern uint64_t iHash64(const void* data, size_t size, uint64_t seed = 0);
+
+#endif // IHASH_H
@@ -0,0 +1,440 @@
+#ifdef __SWITCH__
+#include <switch.h>
+#endif
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include "iMain.h"
+#include "iInput.h"
+
+typedef std::chrono::steady_clock INPUTCLOCK;
+
+#define INPUT_WORDS     (sizeof(INPUTSNAPSHOT) / sizeof(uint64_t))
+static_assert(sizeof(INPUTSNAPSHOT) % sizeof(uint64_t) == 0, "the seqlock copies whole words");
+
+#define INPUT_BYTES     3       // of the button mask the tables cover: buttons, d-pad, stick directions
+#define INPUT_BINDINGS  64
+#define INPUT_MACRO_L   (1u << 30)
+#define INPUT_MACRO_R   (1u << 31)
+#define INPUT_STATS     0xffff  // not a task: the stats line
+
+// A pad to the cabinet bits, player 1's on the first pad and player 2's on
+// the second unless the key map says otherwise
+static const struct {
+    uint64_t button;
+    uint16_t bit;
+} inputMap[16] = {
+    { HidNpadButton_A, 0x0001 },     { HidNpadButton_B, 0x0002 },     { HidNpadButton_X, 0x0004 },
+    { HidNpadButton_Y, 0x0008 },     { HidNpadButton_L, 0x0010 },     { HidNpadButton_R, 0x0020 },
+    { HidNpadButton_ZL, 0x0040 },    { HidNpadButton_ZR, 0x0080 },    { HidNpadButton_Plus, 0x0100 },
+    { HidNpadButton_Minus, 0x0200 }, { HidNpadButton_Up, 0x0400 },    { HidNpadButton_Down, 0x0800 },
+    { HidNpadButton_Left, 0x1000 },  { HidNpadButton_Right, 0x2000 }, { HidNpadButton_StickL, 0x4000 },
+    { HidNpadButton_StickR, 0x8000 },
+};
+
+// The cabinet bit each of ControlConfig's slots sets in its player's word:
+// B1-B6, up, down, left, right, start
+static const uint16_t inputSlotBits[INPUT_SLOTS / 2] = {
+    0x0001, 0x0002, 0x0004, 0x0008, 0x0010, 0x0020, 0x0400, 0x0800, 0x1000, 0x2000, 0x0100,
+};
+
+// The key map's joystick codes other than buttons: POV 0 is the d-pad and 1
+// and 2 the sticks (up, left, down, right), then the X, Y and Z axes, + and -
+// (DirectInput's Y grows downwards; Z is the right stick across)
+static const uint64_t inputMapPOV[3][4] = {
+    { HidNpadButton_Up, HidNpadButton_Left, HidNpadButton_Down, HidNpadButton_Right },
+    { HidNpadButton_StickLUp, HidNpadButton_StickLLeft, HidNpadButton_StickLDown, HidNpadButton_StickLRight },
+    { HidNpadButton_StickRUp, HidNpadButton_StickRLeft, HidNpadButton_StickRDown, HidNpadButton_StickRRight },
+};
+static const uint64_t inputMapAxes[6] = {
+    HidNpadButton_StickLRight, HidNpadButton_StickLLeft, HidNpadButton_StickLDown,
+    HidNpadButton_StickLUp,    HidNpadButton_StickRRight, HidNpadButton_StickRLeft,
+};
+
+// With L+R held on a pad, the first of these pressed (or held) there; the CPU
+// thread takes tasks at its next VSYNC
+static const struct {
+    uint64_t button;
+    uint16_t task;
+    bool     held;
+} inputMacros[] = {
+    { HidNpadButton_X, SAVE_GAME, false },     { HidNpadButton_Y, LOAD_GAME, false },
+    { HidNpadButton_ZR, STATE_CHECK, false },  { HidNpadButton_ZL, REWIND_GAME, true },
+    { HidNpadButton_Minus, RECORD_INPUT, false }, { HidNpadButton_Plus, REPLAY_INPUT, false },
+    { HidNpadButton_B, CAPTURE_AV, false },    { HidNpadButton_A, INPUT_STATS, false },
+};
+
+struct INPUTBINDING {
+    uint8_t  pad;
+    uint8_t  button;    // bit of the button mask
+    uint8_t  word;      // of inputs[]
+    uint16_t bit;
+};
+
+// The compiled map: for each pad and byte of its button mask, the cabinet
+// bits (player 1 low, player 2 high) or, from bit 32, the macro keys
+static uint64_t inputTable[INPUT_PADS][INPUT_BYTES][256];
+static uint32_t inputPadsUsed;                  // pads the map reads, the first always
+
+// The snapshot as published; the sequence number is odd while it is written
+static std::atomic<uint32_t> inputSeq(0);
+static std::atomic<uint64_t> inputShared[INPUT_WORDS];
+
+static std::thread             inputThread;
+static std::mutex              inputLock;       // the poller's sleep only
+static std::condition_variable inputWake;
+static bool                    inputQuit;
+static std::atomic<bool>       inputRunning(false);
+
+// Poller's
+static INPUTSNAPSHOT inputPolled;
+static uint32_t      inputMacroHeld[INPUT_PADS];    // last poll's macro keys, for what went down
+static std::atomic<bool> inputShowStats(true);
+#ifdef __SWITCH__
+static PadState      inputPads[INPUT_PADS];
+#else
+static std::atomic<uint64_t> inputInjected[INPUT_PADS];
+static std::atomic<int32_t>  inputInjectedSticks[4];
+#endif
+
+// CPU thread's
+static uint64_t inputLatched;                   // changed stamp of the snapshot last latched
+static uint64_t inputPending;                   // a change latched, for the frame after this one
+static uint64_t inputStamp;                     // a change waiting for a frame to show it
+
+static std::atomic<uint64_t> inputPolls(0);
+static std::mutex            inputStatsLock;    // the CPU thread adds, the UI reads
+static INPUTSTATS            inputStats;
+static uint64_t              inputAgeNs;
+
+static uint64_t iInputNow()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(INPUTCLOCK::now().time_since_epoch()).count();
+}
+
+// ---------------------- SEQLOCK ----------------------
+
+static void iInputPublish(const INPUTSNAPSHOT* snapshot)
+{
+    uint64_t words[INPUT_WORDS];
+    memcpy(words, snapshot, sizeof(words));
+
+    uint32_t seq = inputSeq.load(std::memory_order_relaxed);
+    inputSeq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (size_t i = 0; i < INPUT_WORDS; i++)
+        inputShared[i].store(words[i], std::memory_order_relaxed);
+    inputSeq.store(seq + 2, std::memory_order_release);
+}
+
+void iInputRead(INPUTSNAPSHOT* snapshot)
+{
+    uint64_t words[INPUT_WORDS];
+    for (;;)
+    {
+        uint32_t seq = inputSeq.load(std::memory_order_acquire);
+        for (size_t i = 0; i < INPUT_WORDS; i++)
+            words[i] = inputShared[i].load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (!(seq & 1) && inputSeq.load(std::memory_order_relaxed) == seq)
+            break;
+    }
+    memcpy(snapshot, words, sizeof(words));
+}
+
+// ---------------------- MAP ----------------------
+
+static void iInputCompileBit(int pad, int button, uint64_t out)
+{
+    uint64_t* table = inputTable[pad][button / 8];
+    for (int v = 0; v < 256; v++)
+        if (v >> (button % 8) & 1)
+            table[v] |= out;
+}
+
+static void iInputCompile(const INPUTBINDING* bindings, int count)
+{
+    memset(inputTable, 0, sizeof(inputTable));
+    inputPadsUsed = 1;
+    for (int i = 0; i < count; i++)
+    {
+        const INPUTBINDING& b = bindings[i];
+        iInputCompileBit(b.pad, b.button, (uint64_t)b.bit << (b.word * 16));
+        inputPadsUsed |= 1 << b.pad;
+    }
+    for (int pad = 0; pad < INPUT_PADS; pad++)
+    {
+        for (size_t i = 0; i < sizeof(inputMacros) / sizeof(inputMacros[0]); i++)
+            iInputCompileBit(pad, __builtin_ctzll(inputMacros[i].button), (uint64_t)1 << (32 + i));
+        iInputCompileBit(pad, __builtin_ctzll(HidNpadButton_L), (uint64_t)INPUT_MACRO_L << 32);
+        iInputCompileBit(pad, __builtin_ctzll(HidNpadButton_R), (uint64_t)INPUT_MACRO_R << 32);
+    }
+}
+
+// A key map entry: keyboard keys are below 256, anything else is (joystick +
+// 1) * 256 plus a button below 64, a POV direction or an axis. -1 for what
+// the pads here do not have
+static int iInputMapButton(uint32_t value, int* pad)
+{
+    uint32_t code = value % 256;
+    *pad = (int)(value / 256) - 1;
+    if (*pad < 0 || *pad >= INPUT_PADS)
+        return -1;
+    uint64_t button;
+    if (code < 64)
+        return code < INPUT_BYTES * 8 ? (int)code : -1;
+    else if (code < 80 && (code - 64) / 4 < 3)
+        button = inputMapPOV[(code - 64) / 4][(code - 64) % 4];
+    else if (code >= 80 && code < 86)
+        button = inputMapAxes[code - 80];
+    else
+        return -1;
+    return __builtin_ctzll(button);
+}
+
+bool iInputLoadMap(const char* path)
+{
+    INPUTBINDING bindings[INPUT_BINDINGS];
+    int count = 0;
+    for (int player = 0; player < 2; player++)
+        for (const auto& m : inputMap)
+            bindings[count++] = { (uint8_t)player, (uint8_t)__builtin_ctzll(m.button), (uint8_t)player, m.bit };
+
+    uint32_t map[INPUT_SLOTS];
+    FILE* f = path ? fopen(path, "rb") : nullptr;
+    bool loaded = f && fread(map, sizeof(map), 1, f) == 1;
+    if (f)
+        fclose(f);
+    if (f && !loaded)
+        printf("%s: cut short, using the default controls\n", path);
+
+    int keys = 0;
+    for (int slot = 0; loaded && slot < INPUT_SLOTS; slot++)
+    {
+        int pad, button = iInputMapButton(map[slot], &pad);
+        if (button < 0)
+        {
+            keys++;
+            continue;
+        }
+        // the slot's bit comes from the map alone
+        uint8_t word = slot < INPUT_SLOTS / 2;
+        uint16_t bit = inputSlotBits[slot % (INPUT_SLOTS / 2)];
+        for (int i = 0; i < count;)
+            if (bindings[i].word == word && bindings[i].bit == bit)
+                bindings[i] = bindings[--count];
+            else
+                i++;
+        bindings[count++] = { (uint8_t)pad, (uint8_t)button, word, bit };
+    }
+    if (keys)
+        printf("%s: %d of %d controls are keys or not on a pad, left on the defaults\n", path, keys, INPUT_SLOTS);
+
+    iInputCompile(bindings, count);
+    return loaded;
+}
+
+// ---------------------- POLLER ----------------------
+
+static uint64_t iInputLookup(int pad, uint64_t held)
+{
+    const uint64_t (*table)[256] = inputTable[pad];
+    return table[0][held & 0xff] | table[1][held >> 8 & 0xff] | table[2][held >> 16 & 0xff];
+}
+
+static void iInputMacros(int pad, uint32_t keys)
+{
+    uint32_t down = keys & ~inputMacroHeld[pad];
+    inputMacroHeld[pad] = keys;
+    if ((keys & (INPUT_MACRO_L | INPUT_MACRO_R)) != (INPUT_MACRO_L | INPUT_MACRO_R))
+        return;
+
+    for (size_t i = 0; i < sizeof(inputMacros) / sizeof(inputMacros[0]); i++)
+    {
+        if (!((inputMacros[i].held ? keys : down) >> i & 1))
+            continue;
+        if (inputMacros[i].task == INPUT_STATS)
+            inputShowStats = !inputShowStats;
+        else if (NewTask == NORMAL_GAME)
+            NewTask = inputMacros[i].task;
+        return;
+    }
+}
+
+static void iInputPoll()
+{
+    uint64_t held[INPUT_PADS];
+    int32_t sticks[4];
+#ifdef __SWITCH__
+    for (int pad = 0; pad < INPUT_PADS; pad++)
+        if (inputPadsUsed >> pad & 1)
+        {
+            padUpdate(&inputPads[pad]);
+            held[pad] = padGetButtons(&inputPads[pad]);
+        }
+    HidAnalogStickState left = padGetStickPos(&inputPads[0], 0), right = padGetStickPos(&inputPads[0], 1);
+    sticks[0] = left.x;
+    sticks[1] = left.y;
+    sticks[2] = right.x;
+    sticks[3] = right.y;
+#else
+    for (int pad = 0; pad < INPUT_PADS; pad++)
+        held[pad] = inputInjected[pad].load(std::memory_order_relaxed);
+    for (int i = 0; i < 4; i++)
+        sticks[i] = inputInjectedSticks[i].load(std::memory_order_relaxed);
+#endif
+
+    uint32_t cabinet = 0;
+    for (int pad = 0; pad < INPUT_PADS; pad++)
+        if (inputPadsUsed >> pad & 1)
+        {
+            uint64_t out = iInputLookup(pad, held[pad]);
+            cabinet |= (uint32_t)out;
+            iInputMacros(pad, (uint32_t)(out >> 32));
+        }
+
+    INPUTSNAPSHOT* s = &inputPolled;
+    s->polled = iInputNow();
+    if (cabinet != (s->inputs[0] | (uint32_t)s->inputs[1] << 16))
+        s->changed = s->polled;
+    s->inputs[0] = (uint16_t)cabinet;
+    s->inputs[1] = (uint16_t)(cabinet >> 16);
+    for (int i = 0; i < 4; i++)
+        s->sticks[i] = (uint16_t)std::clamp(sticks[i] + 0x8000, 0, 0xffff);
+    s->buttons = held[0];
+    iInputPublish(s);
+    inputPolls.fetch_add(1, std::memory_order_relaxed);
+}
+
+static void iInputPoller()
+{
+    const std::chrono::microseconds period(INPUT_POLL_US);
+    INPUTCLOCK::time_point next = INPUTCLOCK::now();
+    for (;;)
+    {
+        iInputPoll();
+
+        // a poll held up (the thread not scheduled) is not made up for
+        INPUTCLOCK::time_point now = INPUTCLOCK::now();
+        next = std::max(next + period, now);
+        std::unique_lock<std::mutex> lock(inputLock);
+        if (inputWake.wait_until(lock, next, [] { return inputQuit; }))
+            return;
+    }
+}
+
+// ---------------------- CONTROL ----------------------
+
+void iInputStart(const char* map)
+{
+    iInputStop();
+
+    iInputLoadMap(map);
+#ifdef __SWITCH__
+    padConfigureInput(INPUT_PADS, HidNpadStyleSet_NpadStandard);
+    padInitializeDefault(&inputPads[0]);
+    for (int pad = 1; pad < INPUT_PADS; pad++)
+        padInitialize(&inputPads[pad], (HidNpadIdType)(HidNpadIdType_No1 + pad));
+#endif
+    memset(&inputPolled, 0, sizeof(inputPolled));
+    iInputPublish(&inputPolled);
+    memset(inputMacroHeld, 0, sizeof(inputMacroHeld));
+    inputLatched = inputPending = inputStamp = 0;
+    iInputStats(nullptr, true);
+
+    inputQuit = false;
+    inputThread = std::thread(iInputPoller);
+    inputRunning.store(true, std::memory_order_release);
+}
+
+void iInputStop()
+{
+    if (!inputThread.joinable())
+        return;
+
+    inputRunning.store(false, std::memory_order_release);
+    {
+        std::lock_guard<std::mutex> lock(inputLock);
+        inputQuit = true;
+    }
+    inputWake.notify_one();
+    inputThread.join();
+}
+
+bool iInputShowStats()
+{
+    return inputShowStats;
+}
+
+void iInputInject(uint64_t buttons, const int32_t* sticks, int pad)
+{
+#ifndef __SWITCH__
+    inputInjected[pad].store(buttons, std::memory_order_relaxed);
+    for (int i = 0; i < 4 && pad == 0; i++)
+        inputInjectedSticks[i].store(sticks ? sticks[i] : 0, std::memory_order_relaxed);
+#else
+    (void)buttons;
+    (void)sticks;
+    (void)pad;
+#endif
+}
+
+// ---------------------- LATCH ----------------------
+
+bool iInputLatch(INPUTSNAPSHOT* snapshot)
+{
+    if (!inputRunning.load(std::memory_order_acquire))
+        return false;
+    iInputRead(snapshot);
+    if (!snapshot->polled)
+        return false;
+
+    // a change latched now is in the frame drawn at the next VSYNC; a change
+    // not yet shown (frames skipped) keeps its place over a later one
+    if (!inputStamp)
+        inputStamp = inputPending;
+    inputPending = 0;
+    bool change = snapshot->changed != inputLatched;
+    if (change)
+    {
+        inputLatched = snapshot->changed;
+        inputPending = snapshot->changed;
+    }
+
+    uint64_t age = iInputNow() - snapshot->polled;
+    std::lock_guard<std::mutex> lock(inputStatsLock);
+    inputStats.latches++;
+    inputStats.changes += change;
+    inputAgeNs += age;
+    inputStats.worstMs = std::max(inputStats.worstMs, age / 1e6);
+    return true;
+}
+
+uint64_t iInputFrameStamp()
+{
+    uint64_t stamp = inputStamp;
+    inputStamp = 0;
+    return stamp;
+}
+
+void iInputStats(INPUTSTATS* stats, bool clear)
+{
+    std::lock_guard<std::mutex> lock(inputStatsLock);
+    if (stats)
+    {
+        *stats = inputStats;
+        stats->polls = inputPolls.load(std::memory_order_relaxed);
+        stats->ageMs = inputStats.latches ? inputAgeNs / 1e6 / inputStats.latches : 0.0;
+    }
+    if (clear)
+    {
+        memset(&inputStats, 0, sizeof(inputStats));
+        inputAgeNs = 0;
+        inputPolls = 0;
+    }
+}
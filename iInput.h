@@ -0,0 +1,99 @@
+#ifndef IINPUT_H
+#define IINPUT_H
+
+#include <cstdint>
+
+// The cabinet controls, from one place.
+//
+// A poller thread of its own reads the pads every INPUT_POLL_US, works out
+// the cabinet bits and stick words, spots the frontend's L+R combinations,
+// and publishes what it read as a snapshot under a seqlock: the sequence
+// number is odd while the snapshot is being written and even after, and a
+// reader copies the snapshot and takes it only if the number was even and
+// did not move meanwhile. Neither side ever waits on the other.
+//
+// The CPU thread latches the newest snapshot at VSYNC, after the pacer has
+// waited out the frame, so the game runs every frame on a pad read at most a
+// poll period before it started. inputs[] and the stick registers change
+// there and nowhere else; the game never sees half of an update.
+//
+// What each pad button does is compiled, when the poller starts, from
+// ControlConfig's key map (U64KeyMap.dat: INPUT_SLOTS DWORDs, player 2's B1-B6,
+// up, down, left, right and start, then player 1's) over the defaults, player
+// 1 on the first pad and player 2 on the second. The tables are per pad and
+// per byte of the button mask, each entry the cabinet bits of both players and
+// the frontend's macro keys that byte value holds down, so a poll is three
+// lookups a pad whatever the map says. Keyboard keys in the map are left on
+// the defaults; the console has no keyboard.
+//
+// Latency is measured twice: poll to latch here, and from the poll a change
+// was first seen in to the hand-off to the display of the first frame the
+// game made with it (hlePresent, which is given the stamp). The compositor's
+// own frame or so on top of that cannot be seen from here.
+//
+// Off the console the pads are whatever iInputInject was last given, for
+// runners on a desktop.
+
+#define INPUT_POLL_US   1000
+#define INPUT_PADS      8
+#define INPUT_SLOTS     22
+#define INPUT_MAP_FILE  "U64KeyMap.dat"
+
+struct INPUTSNAPSHOT {
+    uint16_t inputs[4];     // as inputs[]: player 1, player 2
+    uint16_t sticks[4];     // for A0-A3: left x, y, right x, y; 0x8000 centred
+    uint64_t buttons;       // the first pad as read, HidNpadButton_*
+    uint64_t polled;        // steady clock ns
+    uint64_t changed;       // steady clock ns of the poll inputs[] last changed in
+};
+
+struct INPUTSTATS {
+    uint64_t polls;
+    uint32_t latches;
+    uint32_t changes;       // latches that brought a change
+    double   ageMs;         // poll to latch, on average
+    double   worstMs;
+};
+
+#ifndef __SWITCH__
+// libnx's HidNpadButton bits, for desktop builds
+enum {
+    HidNpadButton_A = 1 << 0, HidNpadButton_B = 1 << 1, HidNpadButton_X = 1 << 2, HidNpadButton_Y = 1 << 3,
+    HidNpadButton_StickL = 1 << 4, HidNpadButton_StickR = 1 << 5, HidNpadButton_L = 1 << 6,
+    HidNpadButton_R = 1 << 7, HidNpadButton_ZL = 1 << 8, HidNpadButton_ZR = 1 << 9,
+    HidNpadButton_Plus = 1 << 10, HidNpadButton_Minus = 1 << 11, HidNpadButton_Left = 1 << 12,
+    HidNpadButton_Up = 1 << 13, HidNpadButton_Right = 1 << 14, HidNpadButton_Down = 1 << 15,
+    HidNpadButton_StickLLeft = 1 << 16, HidNpadButton_StickLUp = 1 << 17, HidNpadButton_StickLRight = 1 << 18,
+    HidNpadButton_StickLDown = 1 << 19, HidNpadButton_StickRLeft = 1 << 20, HidNpadButton_StickRUp = 1 << 21,
+    HidNpadButton_StickRRight = 1 << 22, HidNpadButton_StickRDown = 1 << 23,
+};
+#endif
+
+// Compiles the key map at map (none: the defaults alone) and starts polling
+extern void iInputStart(const char* map = INPUT_MAP_FILE);
+extern void iInputStop();
+
+// With the poller stopped: false, and the defaults, when there is no map there
+extern bool iInputLoadMap(const char* path);
+
+// Any thread; the newest snapshot, all zero before the first poll
+extern void iInputRead(INPUTSNAPSHOT* snapshot);
+
+// CPU thread, at VSYNC: false with no poller running, else the snapshot now
+// in effect. The caller puts it in inputs[] and the registers
+extern bool iInputLatch(INPUTSNAPSHOT* snapshot);
+
+// CPU thread, drawing a frame: the stamp of the change it is the first frame
+// to show, 0 for none; each stamp is given out once
+extern uint64_t iInputFrameStamp();
+
+extern void iInputStats(INPUTSTATS* stats, bool clear);
+
+// L+R+A shows or hides the stats line
+extern bool iInputShowStats();
+
+// Off the console: what the poller will read next from a pad, sticks (the
+// first pad's) as libnx has them
+extern void iInputInject(uint64_t buttons, const int32_t* sticks = nullptr, int pad = 0);
+
+#endif // IINPUT_H
@@ -6,6 +6,8 @@
 #include "dynaCompiler.h"
 #include "adsp2100.h"
 #include "hleDSP.h"
+#include "iRewind.h"
+#include "iBoot.h"
 
 #include <thread>
 #include <fstream>
@@ -14,7 +16,6 @@
 
 volatile uint16_t DspTask;
 volatile uint16_t NewTask;
-extern bool dump;
 
 RS4300iReg *r;       // Registers
 N64Mem *m;           // Memory
@@ -42,6 +43,7 @@ void iMainConstruct(const char *filename)
     iRomConstruct();
     iMemConstruct();
     iCpuConstruct();
+    iRewindInit(REWIND_INTERVAL, REWIND_KEY_INTERVAL, REWIND_BUDGET);
     iDspThread = std::thread(); // Placeholder; will start later
     hleDSPConstruct();
 }
@@ -49,6 +51,7 @@ void iMainConstruct(const char *filename)
 void iMainDestruct()
 {
     hleDSPDestruct();
+    iRewindFree();
     iMemDestruct();
     iRomDestruct();
     iCpuDestruct();
@@ -60,6 +63,7 @@ void iMainReset()
     iCpuReset();
     dspBank = 1;
     iMainResetDSP();
+    iRewindReset();
 }
 
 void iMainResetDSP()
@@ -78,30 +82,15 @@ void iMainResetDSP()
         *(dst++) = tmp;
         size--;
     }
+    adsp2100_predecode();
     adsp2100_reset(nullptr);
 }
 
 void iMainStartCPU()
 {
-    NewTask = BOOT_STAGE0;
-
-    std::ifstream infile;
-    if(gRomSet == KI2)
-        infile.open("ki2.dat", std::ios::binary | std::ios::in);
-    else if(gRomSet == KI1)
-        infile.open("ki.dat", std::ios::binary | std::ios::in);
-
-    if(infile.is_open())
-    {
-        infile.read(reinterpret_cast<char *>(m->rdRam), 0x100000);
-        infile.read(reinterpret_cast<char *>(r), sizeof(RS4300iReg));
-        infile.close();
-
-        NewTask = NORMAL_GAME;
-        dump = true;
-    }
-
+    // straight to attract mode when the set has a boot snapshot
     adsp2100_set_pc(0);
+    NewTask = iBootRestore() ? NORMAL_GAME : BOOT_STAGE0;
     DspTask = NORMAL_GAME;
 
     // Launch CPU and DSP threads using std::thread
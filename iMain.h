@@ -29,6 +29,11 @@
 #define DEBUG_SINGLESTEP 11
 #define ERROR_BREAK 12
 #define DEBUG_FASTSTEP 13
+#define STATE_CHECK 14
+#define REWIND_GAME 15
+#define RECORD_INPUT 16
+#define REPLAY_INPUT 17
+#define CAPTURE_AV 18
 
 #define MI_INTR_NO  0x00
 #define MI_INTR_ALL 0x3f
@@ -9,6 +9,10 @@
 #include "iCPU.h"
 #include "iATA.h"
 #include "iRom.h"
+#include "iState.h"
+#include "dynaCompiler.h"
+#include "dspLink.h"
+#include "ki.h"
 
 using BYTE  = uint8_t;
 using WORD  = uint16_t;
@@ -115,33 +119,122 @@ bool iMemLoadROM(const char* path) {
 }
 
 // -------- CPU Memory Access --------
-BYTE iMemReadByte(DWORD addr) {
+// The same decode the compiled-code maps use: 0x88 is RAM, 0x80 the upper
+// 512K, 0xb0/0xa8 the ATA/control pages (loads from aiReg, stores to atReg),
+// and low physical addresses RAM again. Memory is in the R4600's (little
+// endian) order, so every access width reads the bytes where it finds them
+static BYTE iMemWriteSink[8];
+
+static BYTE* iMemRamAddr(DWORD addr) {
+    switch (addr >> 24) {
+        case 0x88: return &m->rdRam[addr & MEM_MASK];
+        case 0x80: return &m->rdRam[0x800000 + (addr & 0x7ffff)];
+    }
     if (addr < MemSize[0])
-        return m->rdRam[addr];
-    return m->NullMem[0];
+        return &m->rdRam[addr];
+    return nullptr;
 }
 
-void iMemWriteByte(DWORD addr, BYTE val) {
-    if (addr < MemSize[0])
-        m->rdRam[addr] = val;
+BYTE* iMemPhysReadAddr(DWORD addr) {
+    if ((addr >> 24) == 0xb0 || (addr >> 24) == 0xa8) {
+        // PIO reads from the drive come in through the data port a halfword at
+        // a time; this is what advances a transfer (and arms iATABulkRead)
+        if ((addr & 0xfff) == ATA_DATA_PORT)
+            return iATADataRead();
+        return &m->aiReg[addr & 0xfff];
+    }
+    BYTE* ram = iMemRamAddr(addr);
+    return ram ? ram : m->NullMem;
+}
+
+BYTE* iMemPhysWriteAddr(DWORD addr) {
+    if ((addr >> 24) == 0xb0 || (addr >> 24) == 0xa8)
+        return &m->atReg[addr & 0xfff];
+    BYTE* ram = iMemRamAddr(addr);
+    return ram ? ram : iMemWriteSink;
+}
+
+BYTE iMemReadByte(DWORD addr) {
+    return *iMemPhysReadAddr(addr);
+}
+
+void iMemWriteByte(BYTE val, DWORD addr) {
+    *iMemPhysWriteAddr(addr) = val;
 }
 
 WORD iMemReadWord(DWORD addr) {
-    return (iMemReadByte(addr) << 8) | iMemReadByte(addr + 1);
+    WORD val;
+    memcpy(&val, iMemPhysReadAddr(addr), sizeof(val));
+    return val;
+}
+
+void iMemWriteWord(WORD val, DWORD addr) {
+    memcpy(iMemPhysWriteAddr(addr), &val, sizeof(val));
+}
+
+// -------- Control Registers --------
+// Eight registers 8 bytes apart from 0x80 in the ATA pages, in a different
+// order on KI2. The two sound registers also drive the DSP link: a rising
+// edge on bit 1 of the sound control register sends the sound data register,
+// and reading it back has bit 1 set while the board can take another word.
+#define CTRL_BASE           0x80
+#define CTRL_REGS           8
+#define CTRL_SOUND_CONTROL  2
+#define CTRL_SOUND_DATA     3
+
+static const BYTE iMemKI2Control[CTRL_REGS] = { 2, 4, 1, 0, 3, 5, 6, 7 };
+
+static int iMemControlReg(DWORD addr) {
+    DWORD off = addr & 0xfff;
+    if (((addr >> 24) != 0xb0 && (addr >> 24) != 0xa8) || off < CTRL_BASE || off >= CTRL_BASE + CTRL_REGS * 8)
+        return -1;
+    int reg = (off - CTRL_BASE) >> 3;
+    return gRomSet == KI2 ? iMemKI2Control[reg] : reg;
+}
+
+static DWORD iMemControlOffset(int ctrl) {
+    int reg = ctrl;
+    if (gRomSet == KI2)
+        for (reg = 0; iMemKI2Control[reg] != ctrl; ++reg) {}
+    return CTRL_BASE + reg * 8;
 }
 
 DWORD iMemReadDWord(DWORD addr) {
-    return (iMemReadWord(addr) << 16) | iMemReadWord(addr + 2);
+    int ctrl = iMemControlReg(addr);
+    if (ctrl >= 0) {
+        DWORD* reg = (DWORD*)&m->aiReg[addr & 0xffc];
+        if (ctrl == CTRL_SOUND_CONTROL)
+            *reg = (*reg & ~2u) | (dspLinkWriteReady() ? 2 : 0);
+        else if (ctrl == CTRL_SOUND_DATA && dspLinkReadReady())
+            *reg = dspLinkRead();   // holds the last reply until the next
+        return *reg;
+    }
+    DWORD val;
+    memcpy(&val, iMemPhysReadAddr(addr), sizeof(val));
+    return val;
+}
+
+void iMemWriteDWord(DWORD val, DWORD addr) {
+    int ctrl = iMemControlReg(addr);
+    if (ctrl >= 0) {
+        DWORD* reg = (DWORD*)&m->atReg[addr & 0xffc];
+        DWORD old = *reg;
+        *reg = val;
+        if (ctrl == CTRL_SOUND_CONTROL && !(old & 2) && (val & 2))
+            dspLinkWrite((uint16_t)*(DWORD*)&m->atReg[iMemControlOffset(CTRL_SOUND_DATA)]);
+        return;
+    }
+    memcpy(iMemPhysWriteAddr(addr), &val, sizeof(val));
 }
 
-void iMemWriteWord(DWORD addr, WORD val) {
-    iMemWriteByte(addr, val >> 8);
-    iMemWriteByte(addr + 1, val & 0xFF);
+QWORD iMemReadQWord(DWORD addr) {
+    QWORD val;
+    memcpy(&val, iMemPhysReadAddr(addr), sizeof(val));
+    return val;
 }
 
-void iMemWriteDWord(DWORD addr, DWORD val) {
-    iMemWriteWord(addr, val >> 16);
-    iMemWriteWord(addr + 2, val & 0xFFFF);
+void iMemWriteQWord(QWORD val, DWORD addr) {
+    memcpy(iMemPhysWriteAddr(addr), &val, sizeof(val));
 }
 
 // -------- DSP Memory Access --------
@@ -229,6 +322,58 @@ void siWriteReg(BYTE reg, BYTE val) {
     m->siReg[reg % MemSize[17]] = val;
 }
 
+// -------- Save States --------
+// Every segment but the sound ROMs, which come with the ROM set, plus the
+// read-only register copies
+#define STATE_SEGMENTS (N_SEGMENTS - 1)
+
+static const int BulkSegments[IMEM_BULK_REGIONS] = { 0, 20, 21 };
+
+static bool iMemIsBulk(int seg) {
+    for (int i = 0; i < IMEM_BULK_REGIONS; ++i)
+        if (BulkSegments[i] == seg)
+            return true;
+    return false;
+}
+
+int iMemBulkRegions(MEMREGION* regions) {
+    for (int i = 0; i < IMEM_BULK_REGIONS; ++i) {
+        regions[i].base = iMemAddr[BulkSegments[i]];
+        regions[i].size = MemSize[BulkSegments[i]];
+    }
+    return IMEM_BULK_REGIONS;
+}
+
+void iMemSaveState(STATESTREAM* s) {
+    bool bulk = iStateBulk(s);
+    for (int i = 0; i < STATE_SEGMENTS; ++i)
+        if (bulk || !iMemIsBulk(i))
+            iStateWrite(s, iMemAddr[i], MemSize[i]);
+
+    iStateWrite(s, m->miRegModeRO);
+    iStateWrite(s, m->miRegIntrMaskRO);
+    iStateWrite(s, m->spRegPC);
+    iStateWrite(s, m->spRegIbist);
+    iStateWrite(s, m->spRegStatusRO);
+    iStateWrite(s, m->dpcRegStatusRO);
+    iStateWrite(s, m->piRegStatusRO);
+}
+
+void iMemLoadState(STATESTREAM* s) {
+    bool bulk = iStateBulk(s);
+    for (int i = 0; i < STATE_SEGMENTS; ++i)
+        if (bulk || !iMemIsBulk(i))
+            iStateRead(s, iMemAddr[i], MemSize[i]);
+
+    iStateRead(s, m->miRegModeRO);
+    iStateRead(s, m->miRegIntrMaskRO);
+    iStateRead(s, m->spRegPC);
+    iStateRead(s, m->spRegIbist);
+    iStateRead(s, m->spRegStatusRO);
+    iStateRead(s, m->dpcRegStatusRO);
+    iStateRead(s, m->piRegStatusRO);
+}
+
 // -------- DMA Utility (simplified) --------
 void dmaToRam(const BYTE* src, DWORD dstAddr, size_t size) {
     if (dstAddr + size <= MemSize[0])
@@ -13,6 +13,17 @@ using WORD  = uint16_t;
 using DWORD = uint32_t;
 using QWORD = uint64_t;
 
+struct STATESTREAM;
+
+// RAM and the DSP program/data memories; rewind tracks these by page and
+// leaves them out of its state images
+#define IMEM_BULK_REGIONS 3
+
+struct MEMREGION {
+    BYTE*  base;
+    size_t size;
+};
+
 // Global memory pointer
 extern N64Mem* m;
 
@@ -53,10 +64,9 @@ DWORD iMemReadDWord(DWORD addr);
 QWORD iMemReadQWord(DWORD addr);
 
 void iMemWriteByte(BYTE val, DWORD addr);
-void iMemWriteWord(DWORD addr, WORD val);
-void iMemWriteDWord(DWORD addr, DWORD val);
+void iMemWriteWord(WORD val, DWORD addr);
+void iMemWriteDWord(DWORD val, DWORD addr);
 void iMemWriteQWord(QWORD val, DWORD addr);
-void iMemWriteByte(DWORD addr, BYTE val);
 
 // DSP access
 BYTE dspReadByte(DWORD addr, bool isDMem);
@@ -82,5 +92,8 @@ void iMemDoDisplayRefresh();
 void iMemSave(std::ofstream& out);
 void iMemLoad(std::ifstream& in);
 void iMemLoadShort(std::ifstream& in);
+void iMemSaveState(STATESTREAM* s);
+void iMemLoadState(STATESTREAM* s);
+int iMemBulkRegions(MEMREGION* regions);
 
 #endif // IMEM_H
@@ -1,13 +1,8 @@
 #include <switch.h>
-#include <GLES2/gl2.h>
 #include <math.h>
-#include "ki.h"
-#include "EmuObject1.h"
-#include "mmDisplay.h"
 #include "iMain.h"
 #include "iCPU.h"
 #include "iMemory.h"
-#include "iRom.h"
 
 #define _SHIFTR(v, s, w) ((u32)(((u32)(v) >> (s)) & ((0x01 << (w)) - 1)))
 #define VERBOSE_TLB
@@ -0,0 +1,243 @@
+#include <cstring>
+#include "iPack.h"
+
+#if defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#endif
+
+#define IPACK_MIN_MATCH    4
+#define IPACK_LAST_LITS    8        // a block always ends in literals
+#define IPACK_MATCH_LIMIT  12       // no match starts closer than this to the end
+#define IPACK_MAX_OFFSET   65535
+#define IPACK_HASH_BITS    14
+#define IPACK_SKIP         6        // misses before the search starts striding
+
+// Positions by hash of the 4 bytes there; only ever called from one thread
+static uint32_t iPackHash[1 << IPACK_HASH_BITS];
+
+static inline uint32_t iPackRead32(const uint8_t* p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint64_t iPackRead64(const uint8_t* p)
+{
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint32_t iPackHashOf(uint32_t v)
+{
+    return (v * 2654435761u) >> (32 - IPACK_HASH_BITS);
+}
+
+// Bytes a and b have in common, a word at a time (little endian)
+static inline size_t iPackCommon(const uint8_t* a, const uint8_t* b, const uint8_t* end)
+{
+    const uint8_t* start = a;
+    while (a + 8 <= end)
+    {
+        uint64_t diff = iPackRead64(a) ^ iPackRead64(b);
+        if (diff)
+            return a - start + (__builtin_ctzll(diff) >> 3);
+        a += 8;
+        b += 8;
+    }
+    while (a < end && *a == *b)
+    {
+        a++;
+        b++;
+    }
+    return a - start;
+}
+
+static inline uint8_t* iPackLength(uint8_t* op, size_t len)
+{
+    while (len >= 255)
+    {
+        *op++ = 255;
+        len -= 255;
+    }
+    *op++ = (uint8_t)len;
+    return op;
+}
+
+static inline uint8_t* iPackLiterals(uint8_t* op, uint8_t* token, const uint8_t* lit, size_t count)
+{
+    *token = (uint8_t)((count < 15 ? count : 15) << 4);
+    if (count >= 15)
+        op = iPackLength(op, count - 15);
+    memcpy(op, lit, count);
+    return op + count;
+}
+
+// ---------------------- COMPRESS ----------------------
+size_t iPackCompress(uint8_t* dst, const uint8_t* src, size_t size)
+{
+    uint8_t* op = dst;
+    const uint8_t* ip = src;
+    const uint8_t* anchor = src;
+    const uint8_t* end = src + size;
+
+    if (size > IPACK_MATCH_LIMIT)
+    {
+        const uint8_t* limit = end - IPACK_MATCH_LIMIT;
+        const uint8_t* matchEnd = end - IPACK_LAST_LITS;
+        uint32_t misses = 1 << IPACK_SKIP;
+
+        memset(iPackHash, 0, sizeof(iPackHash));
+        while (ip < limit)
+        {
+            uint32_t seq = iPackRead32(ip);
+            uint32_t h = iPackHashOf(seq);
+            const uint8_t* ref = src + iPackHash[h];
+            iPackHash[h] = (uint32_t)(ip - src);
+
+            // incompressible data is skipped faster the longer it goes on
+            if (ref >= ip || ip - ref > IPACK_MAX_OFFSET || iPackRead32(ref) != seq)
+            {
+                ip += misses++ >> IPACK_SKIP;
+                continue;
+            }
+            misses = 1 << IPACK_SKIP;
+
+            while (ip > anchor && ref > src && ip[-1] == ref[-1])
+            {
+                ip--;
+                ref--;
+            }
+            size_t len = IPACK_MIN_MATCH + iPackCommon(ip + IPACK_MIN_MATCH, ref + IPACK_MIN_MATCH, matchEnd);
+
+            uint8_t* token = op++;
+            op = iPackLiterals(op, token, anchor, ip - anchor);
+
+            size_t offset = ip - ref;
+            *op++ = (uint8_t)offset;
+            *op++ = (uint8_t)(offset >> 8);
+
+            size_t extra = len - IPACK_MIN_MATCH;
+            *token |= extra < 15 ? extra : 15;
+            if (extra >= 15)
+                op = iPackLength(op, extra - 15);
+
+            ip += len;
+            anchor = ip;
+
+            // give the next search a candidate from inside this match
+            if (ip < limit)
+                iPackHash[iPackHashOf(iPackRead32(ip - 2))] = (uint32_t)(ip - 2 - src);
+        }
+    }
+
+    uint8_t* token = op++;
+    return iPackLiterals(op, token, anchor, end - anchor) - dst;
+}
+
+// ---------------------- EXPAND ----------------------
+static inline bool iPackReadLength(const uint8_t** ip, const uint8_t* end, size_t* len)
+{
+    uint8_t b;
+    do
+    {
+        if (*ip >= end)
+            return false;
+        b = *(*ip)++;
+        *len += b;
+    } while (b == 255);
+    return true;
+}
+
+bool iPackExpand(uint8_t* dst, size_t size, const uint8_t* src, size_t packed)
+{
+    const uint8_t* ip = src;
+    const uint8_t* iend = src + packed;
+    uint8_t* op = dst;
+    uint8_t* oend = dst + size;
+
+    while (ip < iend)
+    {
+        uint8_t token = *ip++;
+
+        size_t lit = token >> 4;
+        if (lit == 15 && !iPackReadLength(&ip, iend, &lit))
+            return false;
+        if (lit > (size_t)(iend - ip) || lit > (size_t)(oend - op))
+            return false;
+        memcpy(op, ip, lit);
+        op += lit;
+        ip += lit;
+
+        // the last sequence is literals only
+        if (ip == iend)
+            break;
+
+        if (iend - ip < 2)
+            return false;
+        size_t offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > (size_t)(op - dst))
+            return false;
+
+        size_t len = token & 15;
+        if (len == 15 && !iPackReadLength(&ip, iend, &len))
+            return false;
+        len += IPACK_MIN_MATCH;
+        if (len > (size_t)(oend - op))
+            return false;
+
+        // an overlapping match repeats the last offset bytes; copying from the
+        // same start doubles the run each time (zero fill is offset 1)
+        const uint8_t* from = op - offset;
+        while (len)
+        {
+            size_t n = op - from;
+            if (n > len)
+                n = len;
+            memcpy(op, from, n);
+            op += n;
+            len -= n;
+        }
+    }
+
+    return op == oend;
+}
+
+// ---------------------- CHECKSUM ----------------------
+#if !defined(__ARM_FEATURE_CRC32)
+static uint32_t iPackCrcTable[256];
+static bool     iPackCrcReady = false;
+
+static void iPackCrcInit()
+{
+    for (uint32_t n = 0; n < 256; n++)
+    {
+        uint32_t c = n;
+        for (int k = 0; k < 8; k++)
+            c = (c >> 1) ^ (0x82f63b78 & (0 - (c & 1)));
+        iPackCrcTable[n] = c;
+    }
+    iPackCrcReady = true;
+}
+#endif
+
+uint32_t iPackChecksum(const uint8_t* data, size_t size)
+{
+    uint32_t crc = 0xffffffff;
+
+#if defined(__ARM_FEATURE_CRC32)
+    for (; size >= 8; size -= 8, data += 8)
+        crc = __crc32cd(crc, iPackRead64(data));
+    for (; size; size--)
+        crc = __crc32cb(crc, *data++);
+#else
+    if (!iPackCrcReady)
+        iPackCrcInit();
+    for (; size; size--)
+        crc = (crc >> 8) ^ iPackCrcTable[(crc ^ *data++) & 0xff];
+#endif
+
+    return ~crc;
+}
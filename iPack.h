@@ -0,0 +1,24 @@
+#ifndef IPACK_H
+#define IPACK_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Byte-oriented LZ77 for save states, in the LZ4 block layout: a token with
+// literal and match length nibbles, the literals, a 16-bit offset, then
+// length extension bytes. One hash probe per position and no entropy stage;
+// RAM images are mostly zero fill and repeated tables, so speed matters more
+// than the last few percent of ratio.
+
+#define IPACK_BOUND(n)   ((n) + (n) / 255 + 16)    // worst case packed size
+
+// Returns the packed size; dst must hold IPACK_BOUND(size)
+extern size_t iPackCompress(uint8_t* dst, const uint8_t* src, size_t size);
+
+// False unless packed expands to exactly size bytes
+extern bool iPackExpand(uint8_t* dst, size_t size, const uint8_t* src, size_t packed);
+
+// CRC-32C, hardware assisted on the console
+extern uint32_t iPackChecksum(const uint8_t* data, size_t size);
+
+#endif // IPACK_H
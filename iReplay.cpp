@@ -0,0 +1,343 @@
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <switch.h>
+#include "ki.h"
+#include "iCPU.h"
+#include "dspLink.h"
+#include "iHash.h"
+#include "iState.h"
+#include "videoConvert.h"
+#include "iReplay.h"
+
+extern uint16_t inputs[4];
+extern const uint8_t* emuFrameSource();
+
+struct REPLAYHEADER {
+    uint32_t magic;
+    uint16_t format;
+    uint16_t romSet;
+    uint32_t frames;
+    uint32_t stateSize;     // state image between the header and the frames
+};
+
+static int          replayMode = REPLAY_IDLE;
+static char         replayPath[256];
+static FILE*        replayFile;         // recording: the log; playing: this run's hashes
+static uint8_t*     replayData;         // playing: the whole log
+static REPLAYHEADER replayHeader;
+static const REPLAYFRAME* replayFrames;
+static uint32_t     replayLimit;        // frames to play
+static uint32_t     replayAt;           // frames recorded / fed back
+static uint32_t     replayHashed;       // frames hashed
+static REPLAYHASH*  replayCheck;        // an earlier run's hashes, or null
+static uint32_t     replayCheckFrames;
+static uint32_t     replayDiffers;      // first frame that did not match, + 1
+static uint64_t     replayDigest;       // every frame's hashes in one
+static u64          replayStart;
+
+// The frame on show converted as the display would have it, and its hash;
+// only rehashed when a line changed
+static VIDEOFRAME   replayVideo;
+static uint64_t     replayVideoHash;
+
+static std::atomic<uint64_t> replayAudio;      // this frame's samples so far, DSP thread
+static std::atomic<uint32_t> replayEnded;
+static std::atomic<bool>     replayMatched;
+
+static double iReplaySeconds(u64 ticks)
+{
+    return armTicksToNs(ticks) / 1000000000.0;
+}
+
+int iReplayMode()
+{
+    return replayMode;
+}
+
+uint32_t iReplayEnded(bool* matched)
+{
+    uint32_t ended = replayEnded.load();
+    if (matched)
+        *matched = replayMatched.load();
+    return ended;
+}
+
+// ---------------------- RECORD ----------------------
+bool iReplayRecord(const char* path)
+{
+    iReplayStop();
+    if (!dspLinkInline)
+        printf("Replay: DSP on its own thread, %s will not replay exactly\n", path);
+
+    STATEIMAGE image = {};
+    dspLinkPause();
+    bool ok = iStateCapture(&image);
+    dspLinkResume();
+
+    FILE* f = ok ? fopen(path, "wb") : nullptr;
+    if (f)
+    {
+        replayHeader = { REPLAY_MAGIC, REPLAY_FORMAT, (uint16_t)gRomSet, 0, (uint32_t)image.size };
+        ok = fwrite(&replayHeader, sizeof(replayHeader), 1, f) == 1 &&
+             fwrite(image.data, 1, image.size, f) == image.size;
+    }
+    iStateFree(&image);
+    if (!f || !ok)
+    {
+        printf("Replay: cannot record to %s\n", path);
+        if (f)
+            fclose(f);
+        return false;
+    }
+
+    snprintf(replayPath, sizeof(replayPath), "%s", path);
+    replayFile = f;
+    replayAt = 0;
+    replayMode = REPLAY_RECORD;
+    printf("Replay: recording %s\n", path);
+    return true;
+}
+
+static void iReplayRecordFrame()
+{
+    REPLAYFRAME frame = {};
+    memcpy(frame.inputs, inputs, sizeof(frame.inputs));
+    frame.dips = theApp.m_DIPS;
+    if (fwrite(&frame, sizeof(frame), 1, replayFile) != 1)
+    {
+        printf("Replay: writing %s failed\n", replayPath);
+        iReplayStop();
+        return;
+    }
+    replayAt++;
+}
+
+// ---------------------- HASHES ----------------------
+
+// The subsystems two records differ in, for messages
+static const char* iReplaySubsystems(const REPLAYHASH* a, const REPLAYHASH* b)
+{
+    static char names[32];
+    snprintf(names, sizeof(names), "%s%s%s", a->cpu != b->cpu ? " CPU" : "",
+             a->video != b->video ? " video" : "", a->audio != b->audio ? " audio" : "");
+    return names[0] ? names + 1 : names;
+}
+
+// An earlier run's hash log, or null when there is none this ROM set can use
+static REPLAYHASH* iReplayLoadHashes(const char* path, uint32_t* frames)
+{
+    FILE* f = fopen(path, "rb");
+    if (!f)
+        return nullptr;
+
+    REPLAYHASHHEADER header;
+    REPLAYHASH* hashes = nullptr;
+    if (fread(&header, sizeof(header), 1, f) == 1 && header.magic == REPLAY_HASH_MAGIC &&
+        header.format == REPLAY_HASH_FORMAT && header.romSet == gRomSet)
+    {
+        hashes = (REPLAYHASH*)malloc(((size_t)header.frames + 1) * sizeof(REPLAYHASH));
+        if (hashes && fread(hashes, sizeof(REPLAYHASH), header.frames, f) != header.frames)
+        {
+            free(hashes);
+            hashes = nullptr;
+        }
+    }
+    fclose(f);
+    if (!hashes)
+        printf("Replay: %s is not a hash log this build can read, left alone\n", path);
+    else
+        *frames = header.frames;
+    return hashes;
+}
+
+// ---------------------- PLAY ----------------------
+
+static bool iReplayNotPlayed()
+{
+    replayMatched = false;
+    replayEnded++;
+    return false;
+}
+
+bool iReplayPlay(const char* path, uint32_t frames)
+{
+    iReplayStop();
+
+    FILE* f = fopen(path, "rb");
+    if (!f)
+    {
+        printf("Replay: no %s\n", path);
+        return iReplayNotPlayed();
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t* data = size > (long)sizeof(REPLAYHEADER) ? (uint8_t*)malloc(size) : nullptr;
+    bool ok = data && fread(data, 1, size, f) == (size_t)size;
+    fclose(f);
+
+    REPLAYHEADER header;
+    if (ok)
+    {
+        memcpy(&header, data, sizeof(header));
+        ok = header.magic == REPLAY_MAGIC && header.format == REPLAY_FORMAT &&
+             sizeof(header) + header.stateSize + (uint64_t)header.frames * sizeof(REPLAYFRAME) <= (uint64_t)size;
+    }
+    if (!ok)
+    {
+        printf("Replay: %s is not an input log this build can read\n", path);
+        free(data);
+        return iReplayNotPlayed();
+    }
+    if (header.romSet != gRomSet)
+    {
+        printf("Replay: %s was recorded with ROM set %u\n", path, header.romSet);
+        free(data);
+        return iReplayNotPlayed();
+    }
+
+    dspLinkPause();
+    ok = iStateRestore(data + sizeof(header), header.stateSize);
+    dspLinkResume();
+    if (!ok)
+    {
+        free(data);
+        return iReplayNotPlayed();
+    }
+    if (!dspLinkInline)
+        printf("Replay: DSP on its own thread, hashes may differ from run to run\n");
+
+    // the first run's hashes are kept to check later ones against
+    char hashPath[sizeof(replayPath) + 16];
+    snprintf(hashPath, sizeof(hashPath), "%s.hash", path);
+    replayCheck = iReplayLoadHashes(hashPath, &replayCheckFrames);
+    if (replayCheck)
+        snprintf(hashPath, sizeof(hashPath), "%s.last.hash", path);
+    REPLAYHASHHEADER hashHeader = { REPLAY_HASH_MAGIC, REPLAY_HASH_FORMAT, (uint16_t)gRomSet, 0, 0 };
+    replayFile = fopen(hashPath, "wb");
+    if (replayFile && fwrite(&hashHeader, sizeof(hashHeader), 1, replayFile) != 1)
+    {
+        fclose(replayFile);
+        replayFile = nullptr;
+    }
+    if (!replayFile)
+        printf("Replay: cannot write %s, this run's hashes are not kept\n", hashPath);
+
+    snprintf(replayPath, sizeof(replayPath), "%s", path);
+    replayData = data;
+    replayHeader = header;
+    replayFrames = (const REPLAYFRAME*)(data + sizeof(header) + header.stateSize);
+    replayLimit = frames && frames < header.frames ? frames : header.frames;
+    replayAt = 0;
+    replayHashed = 0;
+    replayDiffers = 0;
+    replayDigest = 0;
+    videoConvertReset(&replayVideo);
+    replayAudio = 0;
+    replayStart = armGetSystemTick();
+    replayMode = REPLAY_PLAY;
+    printf("Replay: playing %s, %u of %u frames, %s hashes\n", path, replayLimit, header.frames,
+           replayCheck ? "checking" : "writing");
+    return true;
+}
+
+// State after the frame just run
+static void iReplayHash(uint32_t frame)
+{
+    if (videoConvertFrame(&replayVideo, (const uint16_t*)emuFrameSource()))
+        replayVideoHash = iHash64(replayVideo.pixels, sizeof(replayVideo.pixels));
+    REPLAYHASH hash = { iCpuStateHash(), replayVideoHash, replayAudio.exchange(0, std::memory_order_relaxed) };
+    replayDigest = iHash64(&hash, sizeof(hash), replayDigest);
+    replayHashed++;
+
+    if (replayFile && fwrite(&hash, sizeof(hash), 1, replayFile) != 1)
+    {
+        printf("Replay: writing hashes failed, the rest are not kept\n");
+        fclose(replayFile);
+        replayFile = nullptr;
+    }
+
+    if (!replayCheck || replayDiffers || frame >= replayCheckFrames)
+        return;
+    if (memcmp(&replayCheck[frame], &hash, sizeof(hash)) != 0)
+    {
+        replayDiffers = frame + 1;
+        printf("Replay: frame %u differs (%s)\n", frame, iReplaySubsystems(&replayCheck[frame], &hash));
+    }
+}
+
+static void iReplayPlayFrame()
+{
+    if (replayAt)
+        iReplayHash(replayAt - 1);
+
+    if (replayAt == replayLimit)
+    {
+        double seconds = iReplaySeconds(armGetSystemTick() - replayStart);
+        printf("Replay: %u frames in %.2f s (%.1f fps), digest %016llx, %s\n", replayAt, seconds,
+               seconds > 0 ? replayAt / seconds : 0.0, (unsigned long long)replayDigest,
+               !replayCheck ? "hashes written" : replayDiffers ? "BEHAVIOUR CHANGED" : "hashes match");
+        if (replayCheck && replayCheckFrames < replayAt)
+            printf("Replay: the first run had %u frames, the rest were not checked\n", replayCheckFrames);
+        iReplayStop();
+        return;
+    }
+
+    const REPLAYFRAME* frame = &replayFrames[replayAt++];
+    memcpy(inputs, frame->inputs, sizeof(frame->inputs));
+    theApp.m_DIPS = frame->dips;
+}
+
+// Chained block by block; with the DSP on its own thread the order against
+// VSYNC is not fixed anyway, so nothing here is made stricter than a relaxed
+// read and write
+void iReplayAudio(const int16_t* samples, int count)
+{
+    if (replayMode != REPLAY_PLAY)
+        return;
+    uint64_t seed = replayAudio.load(std::memory_order_relaxed);
+    replayAudio.store(iHash64(samples, count * sizeof(int16_t), seed), std::memory_order_relaxed);
+}
+
+// ---------------------- CONTROL ----------------------
+void iReplayFrame()
+{
+    if (replayMode == REPLAY_RECORD)
+        iReplayRecordFrame();
+    else if (replayMode == REPLAY_PLAY)
+        iReplayPlayFrame();
+}
+
+void iReplayStop()
+{
+    if (replayMode == REPLAY_RECORD)
+    {
+        replayHeader.frames = replayAt;
+        bool ok = fseek(replayFile, 0, SEEK_SET) == 0 &&
+                  fwrite(&replayHeader, sizeof(replayHeader), 1, replayFile) == 1;
+        ok = fclose(replayFile) == 0 && ok;
+        printf("Replay: %s %u frames to %s\n", ok ? "recorded" : "FAILED recording", replayAt, replayPath);
+    }
+    else if (replayMode == REPLAY_PLAY)
+    {
+        REPLAYHASHHEADER hashHeader = { REPLAY_HASH_MAGIC, REPLAY_HASH_FORMAT, (uint16_t)gRomSet, replayHashed, 0 };
+        if (replayFile)
+        {
+            fseek(replayFile, 0, SEEK_SET);
+            fwrite(&hashHeader, sizeof(hashHeader), 1, replayFile);
+            fclose(replayFile);
+        }
+        free(replayData);
+        free(replayCheck);
+        replayData = nullptr;
+        replayFrames = nullptr;
+        replayCheck = nullptr;
+        replayMatched = !replayDiffers;
+        replayEnded++;
+    }
+
+    replayFile = nullptr;
+    replayMode = REPLAY_IDLE;
+}
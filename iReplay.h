@@ -0,0 +1,68 @@
+#ifndef IREPLAY_H
+#define IREPLAY_H
+
+#include <cstdint>
+
+// Input logs, for benchmarks that must run the same workload every time: a
+// starting save state plus what the cabinet was given each frame (inputs[]
+// and the DIP switches), taken at VSYNC on the CPU thread.
+//
+// A replay restores the state, feeds the log back in place of the pads and
+// runs unpaced, for all of the log or its first frames. Every frame it hashes
+// the R4600 register file, the frame on show as converted for the display
+// and the samples the sound board handed over (iHash64), into a hash log of
+// REPLAYHASH records. The first replay of a log writes <log>.hash; later ones
+// write <log>.last.hash, check it against the first as they go and name the
+// first frame that differs. replay_diff compares any two hash logs, on any
+// machine. Delete <log>.hash when a change is meant to alter behaviour.
+//
+// Both need dspLinkInline: a DSP on its own thread takes the CPU's latch
+// writes at whatever cycle it happens to be on. The pad sticks, which go
+// straight into CPU registers and are not in the log, are left alone while
+// recording or replaying.
+
+#define REPLAY_MAGIC    0x7052494b   // "KIRp"
+#define REPLAY_FORMAT   1
+
+#define REPLAY_HASH_MAGIC   0x6852494b   // "KIRh"
+#define REPLAY_HASH_FORMAT  1
+
+enum { REPLAY_IDLE, REPLAY_RECORD, REPLAY_PLAY };
+
+struct REPLAYFRAME {
+    uint16_t inputs[4];
+    uint16_t dips;
+    uint16_t reserved;
+};
+
+// Hash log: the header, then a record a frame
+struct REPLAYHASHHEADER {
+    uint32_t magic;
+    uint16_t format;
+    uint16_t romSet;
+    uint32_t frames;
+    uint32_t reserved;
+};
+
+struct REPLAYHASH {
+    uint64_t cpu;
+    uint64_t video;
+    uint64_t audio;         // 0 for a frame with no samples
+};
+
+// CPU thread, at VSYNC
+extern bool iReplayRecord(const char* path);
+extern bool iReplayPlay(const char* path, uint32_t frames = 0);   // 0: all of it
+extern void iReplayStop();
+extern void iReplayFrame();
+
+extern int iReplayMode();
+
+// DSP thread, at the autobuffer hand-off
+extern void iReplayAudio(const int16_t* samples, int count);
+
+// Any thread: replays ended so far (played out, stopped or never started),
+// and whether the last one kept to the hashes it was checked against
+extern uint32_t iReplayEnded(bool* matched = nullptr);
+
+#endif // IREPLAY_H
@@ -0,0 +1,449 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <switch.h>
+#include "iMemory.h"
+#include "dspLink.h"
+#include "iState.h"
+#include "iRewind.h"
+
+#define REWIND_PAGE        (1 << REWIND_PAGE_SHIFT)
+#define REWIND_PAGE_WORDS  (REWIND_PAGE / 4)
+#define REWIND_PAGE_BOUND  (REWIND_PAGE + 4)    // every other word changed
+#define REWIND_SLOTS       2048
+
+// A snapshot in the arena:
+//   u32 state image size, the image (a full one for keyframes)
+//   deltas only: u32 dirty pages, then per page u32 page, u32 size, XOR runs
+struct REWINDSNAP {
+    size_t   offset;
+    size_t   size;
+    uint32_t frame;
+    bool     key;
+};
+
+static uint8_t*   rewindArena = nullptr;
+static size_t     rewindBudget;
+static int        rewindInterval;
+static int        rewindKeyInterval;
+static REWINDSNAP rewindSnaps[REWIND_SLOTS];
+static uint32_t   rewindFirst;          // oldest snapshot, always a keyframe
+static uint32_t   rewindCount;
+static uint32_t   rewindFrameNo;        // frames since reset, rewound with the machine
+static int        rewindWait;           // frames to the next snapshot
+static int        rewindSinceKey;       // deltas since the newest keyframe
+
+static MEMREGION  rewindRegions[IMEM_BULK_REGIONS];
+static int        rewindRegionCount;
+static uint32_t   rewindPages;
+static uint8_t**  rewindPageAddr;       // live address of every page
+static uint8_t*   rewindShadow;         // the pages as of the newest snapshot
+static bool       rewindShadowValid;
+static uint64_t*  rewindDirty;          // one bit per page, from the last scan
+static STATEIMAGE rewindState;
+
+static uint64_t rewindKeyTotal, rewindDeltaTotal, rewindPageTotal;
+static uint32_t rewindKeyCount, rewindDeltaCount;
+static float    rewindSnapMs, rewindRestoreMs;
+
+static float iRewindMs(u64 ticks)
+{
+    return armTicksToNs(ticks) / 1000000.0f;
+}
+
+static inline uint8_t* iRewindPut32(uint8_t* p, uint32_t v)
+{
+    memcpy(p, &v, 4);
+    return p + 4;
+}
+
+static inline uint32_t iRewindGet32(const uint8_t* p)
+{
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+static inline REWINDSNAP* iRewindSnap(uint32_t n)
+{
+    return &rewindSnaps[(rewindFirst + n) % REWIND_SLOTS];
+}
+
+// ---------------------- SETUP ----------------------
+bool iRewindInit(int interval, int keyInterval, size_t budget)
+{
+    iRewindFree();
+    if (!budget)
+        return false;
+
+    rewindRegionCount = iMemBulkRegions(rewindRegions);
+    rewindPages = 0;
+    for (int i = 0; i < rewindRegionCount; i++)
+        rewindPages += rewindRegions[i].size >> REWIND_PAGE_SHIFT;
+
+    rewindArena = (uint8_t*)malloc(budget);
+    rewindShadow = (uint8_t*)malloc((size_t)rewindPages << REWIND_PAGE_SHIFT);
+    rewindPageAddr = (uint8_t**)malloc(rewindPages * sizeof(uint8_t*));
+    rewindDirty = (uint64_t*)malloc(((rewindPages + 63) / 64) * sizeof(uint64_t));
+    if (!rewindArena || !rewindShadow || !rewindPageAddr || !rewindDirty)
+    {
+        printf("Rewind: out of memory for a %zu MB budget\n", budget >> 20);
+        iRewindFree();
+        return false;
+    }
+
+    uint32_t page = 0;
+    for (int i = 0; i < rewindRegionCount; i++)
+        for (size_t at = 0; at < rewindRegions[i].size; at += REWIND_PAGE)
+            rewindPageAddr[page++] = rewindRegions[i].base + at;
+
+    rewindBudget = budget;
+    rewindInterval = interval > 0 ? interval : 1;
+    rewindKeyInterval = keyInterval > 0 ? keyInterval : 1;
+    iRewindReset();
+    return true;
+}
+
+void iRewindFree()
+{
+    free(rewindArena);
+    free(rewindShadow);
+    free(rewindPageAddr);
+    free(rewindDirty);
+    iStateFree(&rewindState);
+    rewindArena = nullptr;
+    rewindShadow = nullptr;
+    rewindPageAddr = nullptr;
+    rewindDirty = nullptr;
+    rewindCount = 0;
+}
+
+void iRewindReset()
+{
+    rewindFirst = 0;
+    rewindCount = 0;
+    rewindFrameNo = 0;
+    rewindWait = rewindInterval;
+    rewindSinceKey = 0;
+    rewindShadowValid = false;
+    rewindKeyTotal = rewindDeltaTotal = rewindPageTotal = 0;
+    rewindKeyCount = rewindDeltaCount = 0;
+}
+
+// ---------------------- PAGES ----------------------
+// Marks the pages that differ from the shadow
+static uint32_t iRewindScan()
+{
+    uint32_t dirty = 0;
+    memset(rewindDirty, 0, ((rewindPages + 63) / 64) * sizeof(uint64_t));
+    for (uint32_t p = 0; p < rewindPages; p++)
+    {
+        if (memcmp(rewindPageAddr[p], rewindShadow + ((size_t)p << REWIND_PAGE_SHIFT), REWIND_PAGE))
+        {
+            rewindDirty[p >> 6] |= 1ull << (p & 63);
+            dirty++;
+        }
+    }
+    return dirty;
+}
+
+// The XOR of a page against its old contents, as runs of
+// { u16 unchanged words, u16 changed words, the changed words XORed }
+static size_t iRewindPackPage(uint8_t* out, const uint8_t* page, const uint8_t* old)
+{
+    const uint32_t* a = (const uint32_t*)page;
+    const uint32_t* b = (const uint32_t*)old;
+    uint8_t* op = out;
+    uint32_t i = 0;
+
+    while (i < REWIND_PAGE_WORDS)
+    {
+        uint32_t same = i;
+        while (i < REWIND_PAGE_WORDS && a[i] == b[i])
+            i++;
+        if (i == REWIND_PAGE_WORDS)
+            break;
+
+        uint32_t from = i;
+        while (i < REWIND_PAGE_WORDS && a[i] != b[i])
+            i++;
+
+        uint16_t run[2] = { (uint16_t)(from - same), (uint16_t)(i - from) };
+        memcpy(op, run, sizeof(run));
+        op += sizeof(run);
+        for (uint32_t k = from; k < i; k++)
+            op = iRewindPut32(op, a[k] ^ b[k]);
+    }
+    return op - out;
+}
+
+// XOR is its own inverse: the same runs take a page either way
+static bool iRewindApplyPage(uint8_t* page, const uint8_t* ip, size_t size)
+{
+    uint32_t* w = (uint32_t*)page;
+    const uint8_t* end = ip + size;
+    uint32_t i = 0;
+
+    while (ip < end)
+    {
+        uint16_t run[2];
+        if (end - ip < (ptrdiff_t)sizeof(run))
+            return false;
+        memcpy(run, ip, sizeof(run));
+        ip += sizeof(run);
+
+        i += run[0];
+        if (i + run[1] > REWIND_PAGE_WORDS || (size_t)(end - ip) < run[1] * 4u)
+            return false;
+        for (uint32_t k = 0; k < run[1]; k++, ip += 4)
+            w[i++] ^= iRewindGet32(ip);
+    }
+    return true;
+}
+
+static void iRewindSyncShadow()
+{
+    for (uint32_t p = 0; p < rewindPages; p++)
+        memcpy(rewindShadow + ((size_t)p << REWIND_PAGE_SHIFT), rewindPageAddr[p], REWIND_PAGE);
+    rewindShadowValid = true;
+}
+
+// ---------------------- RING ----------------------
+// A keyframe takes its deltas with it
+static void iRewindDropOldest()
+{
+    do
+    {
+        rewindFirst = (rewindFirst + 1) % REWIND_SLOTS;
+        rewindCount--;
+    } while (rewindCount && !iRewindSnap(0)->key);
+}
+
+// Space for the next snapshot, right after the newest one or back at the
+// start of the arena; whatever it overlaps is the oldest
+static uint8_t* iRewindAlloc(size_t size, bool key)
+{
+    if (size > rewindBudget)
+        return nullptr;
+
+    size_t at = 0;
+    if (rewindCount)
+    {
+        const REWINDSNAP* last = iRewindSnap(rewindCount - 1);
+        at = last->offset + last->size;
+        if (at + size > rewindBudget)
+            at = 0;
+    }
+
+    while (rewindCount)
+    {
+        const REWINDSNAP* old = iRewindSnap(0);
+        bool overlaps = at < old->offset + old->size && old->offset < at + size;
+        if (!overlaps && rewindCount < REWIND_SLOTS)
+            break;
+        iRewindDropOldest();
+    }
+    if (!key && !rewindCount)
+        return nullptr;
+
+    REWINDSNAP* snap = iRewindSnap(rewindCount++);
+    snap->offset = at;
+    snap->size = size;
+    snap->frame = rewindFrameNo;
+    snap->key = key;
+    return rewindArena + at;
+}
+
+// ---------------------- SNAPSHOTS ----------------------
+static void iRewindKeyframe()
+{
+    if (!iStateCapture(&rewindState))
+        return;
+
+    uint8_t* out = iRewindAlloc(4 + rewindState.size, true);
+    if (!out)
+    {
+        printf("Rewind: a keyframe (%zu KB) does not fit the %zu KB budget, rewind is off\n",
+               rewindState.size >> 10, rewindBudget >> 10);
+        iRewindFree();
+        return;
+    }
+    memcpy(iRewindPut32(out, (uint32_t)rewindState.size), rewindState.data, rewindState.size);
+
+    iRewindSyncShadow();
+    rewindSinceKey = 0;
+    rewindKeyTotal += 4 + rewindState.size;
+    rewindKeyCount++;
+}
+
+// False when the ring has no keyframe left to build on
+static bool iRewindDelta()
+{
+    if (!iStateCapture(&rewindState, false))
+        return true;
+
+    uint32_t dirty = iRewindScan();
+    size_t bound = 8 + rewindState.size + (size_t)dirty * (8 + REWIND_PAGE_BOUND);
+    uint8_t* out = iRewindAlloc(bound, false);
+    if (!out)
+        return false;
+
+    uint8_t* op = iRewindPut32(out, (uint32_t)rewindState.size);
+    memcpy(op, rewindState.data, rewindState.size);
+    op = iRewindPut32(op + rewindState.size, dirty);
+
+    for (uint32_t w = 0; w < (rewindPages + 63) / 64; w++)
+    {
+        for (uint64_t bits = rewindDirty[w]; bits; bits &= bits - 1)
+        {
+            uint32_t p = w * 64 + __builtin_ctzll(bits);
+            uint8_t* shadow = rewindShadow + ((size_t)p << REWIND_PAGE_SHIFT);
+            size_t size = iRewindPackPage(op + 8, rewindPageAddr[p], shadow);
+            iRewindPut32(op, p);
+            iRewindPut32(op + 4, (uint32_t)size);
+            op += 8 + size;
+            memcpy(shadow, rewindPageAddr[p], REWIND_PAGE);
+        }
+    }
+
+    // give back what the bound did not need
+    iRewindSnap(rewindCount - 1)->size = op - out;
+    rewindSinceKey++;
+    rewindDeltaTotal += op - out;
+    rewindPageTotal += dirty;
+    rewindDeltaCount++;
+    return true;
+}
+
+void iRewindFrame()
+{
+    if (!rewindArena)
+        return;
+
+    rewindFrameNo++;
+    if (--rewindWait > 0)
+        return;
+    rewindWait = rewindInterval;
+
+    u64 start = armGetSystemTick();
+    dspLinkPause();
+    if (!rewindShadowValid || !rewindCount || rewindSinceKey >= rewindKeyInterval || !iRewindDelta())
+        iRewindKeyframe();
+    dspLinkResume();
+    rewindSnapMs = iRewindMs(armGetSystemTick() - start);
+}
+
+// ---------------------- RESTORE ----------------------
+// Keyframe k, then the page deltas up to n and n's own state image
+static bool iRewindRestore(uint32_t k, uint32_t n)
+{
+    const uint8_t* key = rewindArena + iRewindSnap(k)->offset;
+    if (!iStateRestore(key + 4, iRewindGet32(key)))
+        return false;
+
+    for (uint32_t i = k + 1; i <= n; i++)
+    {
+        const REWINDSNAP* snap = iRewindSnap(i);
+        const uint8_t* start = rewindArena + snap->offset;
+        const uint8_t* end = start + snap->size;
+        uint32_t stateSize = iRewindGet32(start);
+        const uint8_t* ip = start + 4 + stateSize;
+        uint32_t pages = iRewindGet32(ip);
+        ip += 4;
+
+        while (pages--)
+        {
+            uint32_t p = iRewindGet32(ip);
+            uint32_t size = iRewindGet32(ip + 4);
+            ip += 8;
+            if (p >= rewindPages || size > (size_t)(end - ip) || !iRewindApplyPage(rewindPageAddr[p], ip, size))
+            {
+                printf("Rewind: snapshot at frame %u is damaged\n", snap->frame);
+                return false;
+            }
+            ip += size;
+        }
+
+        if (i == n && !iStateRestore(start + 4, stateSize))
+            return false;
+    }
+
+    iRewindSyncShadow();
+    return true;
+}
+
+bool iRewindBack(uint32_t frames)
+{
+    if (!rewindArena || !rewindCount)
+        return false;
+
+    uint32_t want = rewindFrameNo > frames ? rewindFrameNo - frames : 0;
+    uint32_t n = rewindCount - 1;
+    while (n > 0 && iRewindSnap(n)->frame > want)
+        n--;
+    uint32_t k = n;
+    while (!iRewindSnap(k)->key)
+        k--;
+
+    u64 start = armGetSystemTick();
+    dspLinkPause();
+    bool ok = iRewindRestore(k, n);
+    dspLinkResume();
+    rewindRestoreMs = iRewindMs(armGetSystemTick() - start);
+
+    if (!ok)
+    {
+        iRewindReset();
+        return false;
+    }
+
+    // the frames after it are gone; skip the snapshot the next frame would take
+    rewindCount = n + 1;
+    rewindSinceKey = n - k;
+    rewindFrameNo = iRewindSnap(n)->frame;
+    rewindWait = rewindInterval + 1;
+    return true;
+}
+
+bool iRewindStep()
+{
+    // one frame has run since the last step landed on a snapshot
+    return iRewindBack(2);
+}
+
+void iRewindStats(REWINDSTATS* stats, bool clear)
+{
+    if (clear)
+    {
+        rewindKeyTotal = rewindDeltaTotal = rewindPageTotal = 0;
+        rewindKeyCount = rewindDeltaCount = 0;
+        rewindShadowValid = false;
+    }
+    if (!stats)
+        return;
+    memset(stats, 0, sizeof(*stats));
+    if (!rewindArena)
+        return;
+
+    stats->snapshots = rewindCount;
+    for (uint32_t i = 0; i < rewindCount; i++)
+    {
+        stats->keyframes += iRewindSnap(i)->key;
+        stats->used += iRewindSnap(i)->size;
+    }
+    if (rewindCount)
+        stats->frames = rewindFrameNo - iRewindSnap(0)->frame;
+    stats->keys = rewindKeyCount;
+    stats->deltas = rewindDeltaCount;
+    if (rewindKeyCount + rewindDeltaCount)
+        stats->snapBytes = (rewindKeyTotal + rewindDeltaTotal) / (rewindKeyCount + rewindDeltaCount);
+    if (rewindKeyCount)
+        stats->keyBytes = rewindKeyTotal / rewindKeyCount;
+    if (rewindDeltaCount)
+    {
+        stats->deltaBytes = rewindDeltaTotal / rewindDeltaCount;
+        stats->deltaPages = (uint32_t)(rewindPageTotal / rewindDeltaCount);
+    }
+    stats->snapMs = rewindSnapMs;
+    stats->restoreMs = rewindRestoreMs;
+}
@@ -0,0 +1,51 @@
+#ifndef IREWIND_H
+#define IREWIND_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Rewind: a ring of machine snapshots taken every few frames at VSYNC.
+//
+// RAM and the DSP memories are tracked in pages against a shadow copy made
+// at the last snapshot; a scan marks the pages that differ in a dirty
+// bitmap and only those go into the snapshot, as the XOR against their old
+// contents with runs of zero words left out. The rest of the machine is a
+// state image without those memories. Every few snapshots is a keyframe, a
+// full save state, so a restore replays at most one keyframe interval of
+// page deltas.
+//
+// Snapshots share one arena of the configured size; when it is full the
+// oldest keyframe and its deltas make room.
+
+#define REWIND_INTERVAL      4            // frames between snapshots
+#define REWIND_KEY_INTERVAL  15           // snapshots between keyframes
+#define REWIND_BUDGET        (64 << 20)   // arena bytes, 0 turns rewind off
+#define REWIND_PAGE_SHIFT    12
+
+struct REWINDSTATS {
+    uint32_t snapshots;     // in the ring
+    uint32_t keyframes;
+    uint32_t frames;        // how far back the ring reaches
+    size_t   used;          // arena bytes held by the ring
+    size_t   snapBytes;     // average snapshot of either kind since reset
+    size_t   keyBytes;      // average keyframe since reset
+    size_t   deltaBytes;    // average delta snapshot since reset
+    uint32_t deltaPages;    // average dirty pages per delta
+    uint32_t keys, deltas;  // snapshots taken since reset
+    float    snapMs;        // last snapshot
+    float    restoreMs;     // last restore
+};
+
+extern bool iRewindInit(int interval, int keyInterval, size_t budget);
+extern void iRewindFree();
+extern void iRewindReset();         // machine reset: drops every snapshot
+
+// CPU thread, at VSYNC
+extern void iRewindFrame();
+extern bool iRewindBack(uint32_t frames);   // to the newest snapshot at least this far back
+extern bool iRewindStep();                  // one snapshot back per call, for a held button
+
+// clear starts the averages over, from a keyframe at the next snapshot
+extern void iRewindStats(REWINDSTATS* stats, bool clear = false);
+
+#endif // IREWIND_H
@@ -8,6 +8,22 @@
 #include <cstring>
 #include <fstream>
 #include <iostream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+// Hosts with real file mappings map the image instead of reading it. Horizon
+// has no file-backed mmap, so the Switch build reads straight into the buffer.
+#if !defined(__SWITCH__) && defined(__unix__)
+#define IROM_MMAP
+#include <sys/mman.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__aarch64__)
+#include <arm_neon.h>
+#elif defined(__SSSE3__)
+#include <immintrin.h>
+#endif
 
 WORD EndianChangeMode = 2;
 std::ifstream iRomFileStream;
@@ -15,6 +31,76 @@ WORD iRomNumPages;
 constexpr size_t ROM_PAGE_SIZE = 0x20000;  // 128 KB
 BYTE* iRomPageMap = nullptr;
 N64RomStruct* rom = nullptr;
+bool iRomMapped = false;     // rom->Image points at a file mapping
+size_t iRomMapLength = 0;
+
+// ---------------------- ENDIAN SWAP ----------------------
+// Mode 0 (.v64) swaps the halfwords of each word, mode 1 (.z64) reverses the
+// whole word. src and dst may be the same buffer.
+void iRomSwap(BYTE* dst, const BYTE* src, DWORD Length, WORD Mode) {
+    DWORD i = 0;
+#if defined(__ARM_NEON) || defined(__aarch64__)
+    if (Mode == 0) {
+        for (; i + 64 <= Length; i += 64) {
+            uint16x8_t a = vld1q_u16((const uint16_t*)(src + i));
+            uint16x8_t b = vld1q_u16((const uint16_t*)(src + i + 16));
+            uint16x8_t c = vld1q_u16((const uint16_t*)(src + i + 32));
+            uint16x8_t d = vld1q_u16((const uint16_t*)(src + i + 48));
+            vst1q_u16((uint16_t*)(dst + i), vrev32q_u16(a));
+            vst1q_u16((uint16_t*)(dst + i + 16), vrev32q_u16(b));
+            vst1q_u16((uint16_t*)(dst + i + 32), vrev32q_u16(c));
+            vst1q_u16((uint16_t*)(dst + i + 48), vrev32q_u16(d));
+        }
+    } else {
+        for (; i + 64 <= Length; i += 64) {
+            uint8x16_t a = vld1q_u8(src + i);
+            uint8x16_t b = vld1q_u8(src + i + 16);
+            uint8x16_t c = vld1q_u8(src + i + 32);
+            uint8x16_t d = vld1q_u8(src + i + 48);
+            vst1q_u8(dst + i, vrev32q_u8(a));
+            vst1q_u8(dst + i + 16, vrev32q_u8(b));
+            vst1q_u8(dst + i + 32, vrev32q_u8(c));
+            vst1q_u8(dst + i + 48, vrev32q_u8(d));
+        }
+    }
+#elif defined(__SSSE3__)
+    const __m128i mask = (Mode == 0)
+        ? _mm_setr_epi8(2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13)
+        : _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+#if defined(__AVX2__)
+    const __m256i mask2 = _mm256_broadcastsi128_si256(mask);
+    for (; i + 32 <= Length; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(src + i));
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm256_shuffle_epi8(v, mask2));
+    }
+#endif
+    for (; i + 16 <= Length; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_shuffle_epi8(v, mask));
+    }
+#endif
+    for (; i + 4 <= Length; i += 4) {
+        BYTE b0 = src[i], b1 = src[i + 1], b2 = src[i + 2], b3 = src[i + 3];
+        if (Mode == 0) {
+            dst[i] = b2; dst[i + 1] = b3; dst[i + 2] = b0; dst[i + 3] = b1;
+        } else {
+            dst[i] = b3; dst[i + 1] = b2; dst[i + 2] = b1; dst[i + 3] = b0;
+        }
+    }
+}
+
+static void iRomFreeImage() {
+    if (!rom || !rom->Image) return;
+#ifdef IROM_MMAP
+    if (iRomMapped)
+        munmap(rom->Image, iRomMapLength);
+    else
+#endif
+        free(rom->Image);
+    rom->Image = nullptr;
+    iRomMapped = false;
+    iRomMapLength = 0;
+}
 
 void iRomConstruct() {
     rom = new N64RomStruct{};
@@ -26,7 +112,7 @@ void iRomConstruct() {
 void iRomDestruct() {
     if (iRomFileStream.is_open())
         iRomFileStream.close();
-    delete[] rom->Image;
+    iRomFreeImage();
     delete rom;
     delete[] iRomPageMap;
     rom = nullptr;
@@ -34,43 +120,77 @@ void iRomDestruct() {
 }
 
 int iRomReadImage(const char* filename) {
-    iRomFileStream.open(filename, std::ios::binary);
-    if (!iRomFileStream.is_open()) {
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
         std::cerr << "Failed to open ROM image: " << filename << std::endl;
         return -1;
     }
 
-    iRomFileStream.seekg(0, std::ios::end);
-    std::streamsize fileLength = iRomFileStream.tellg();
-    iRomFileStream.seekg(0, std::ios::beg);
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        std::cerr << "Failed to stat ROM image: " << filename << std::endl;
+        close(fd);
+        return -1;
+    }
+    size_t fileLength = static_cast<size_t>(st.st_size);
+
+    iRomFreeImage();
 
     // Round up to nearest page
     rom->Length = static_cast<DWORD>(fileLength);
     rom->Length = ((rom->Length / ROM_PAGE_SIZE) + 1) * ROM_PAGE_SIZE;
     rom->PrgCodeLength = rom->Length - 0x1000;
 
-    rom->Image = new BYTE[rom->Length]();
+#ifdef IROM_MMAP
+    // Reserve the rounded length as zero pages, then lay the file over the
+    // front of it. MAP_PRIVATE keeps the swap below from touching the file,
+    // and only pages that get swapped or written are ever copied.
+    BYTE* image = (BYTE*)mmap(nullptr, rom->Length, PROT_READ | PROT_WRITE,
+                              MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (image != MAP_FAILED && fileLength &&
+        mmap(image, fileLength, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+        munmap(image, rom->Length);
+        image = (BYTE*)MAP_FAILED;
+    }
+    if (image != MAP_FAILED) {
+        rom->Image = image;
+        iRomMapped = true;
+        iRomMapLength = rom->Length;
+    }
+#endif
+
     if (!rom->Image) {
-        std::cerr << "Failed to allocate memory for ROM image" << std::endl;
-        iRomFileStream.close();
-        return -1;
+        rom->Image = (BYTE*)malloc(rom->Length);
+        if (!rom->Image) {
+            std::cerr << "Failed to allocate memory for ROM image" << std::endl;
+            close(fd);
+            return -1;
+        }
+
+        // only the padding needs clearing, the file covers the rest
+        memset(rom->Image + fileLength, 0, rom->Length - fileLength);
+
+        size_t done = 0;
+        while (done < fileLength) {
+            ssize_t got = read(fd, rom->Image + done, fileLength - done);
+            if (got <= 0) {
+                std::cerr << "Error reading ROM image" << std::endl;
+                close(fd);
+                iRomFreeImage();
+                return -1;
+            }
+            done += static_cast<size_t>(got);
+        }
     }
+    close(fd);
 
     rom->Header = rom->Image;
     rom->BootCode = rom->Image + 0x40;
     rom->PrgCode = reinterpret_cast<DWORD*>(rom->Image + 0x1000);
 
-    iRomFileStream.read(reinterpret_cast<char*>(rom->Image), fileLength);
-    if (!iRomFileStream) {
-        std::cerr << "Error reading ROM image" << std::endl;
-        iRomFileStream.close();
-        return -1;
-    }
-
     if (EndianChangeMode != 2)
         iRomChangeRomEndian(EndianChangeMode, rom->Length);
 
-    iRomFileStream.close();
     return 0;
 }
 
@@ -89,9 +209,10 @@ int iRomReadHeader(const char* filename) {
     else return -2;
 
     if (EndianChangeMode != 2)
-        iRomChangeRomEndian(EndianChangeMode, 0x40);
+        iRomSwap(header, header, 0x40, EndianChangeMode);
 
-    rom->Image = new BYTE[0x40];
+    iRomFreeImage();
+    rom->Image = (BYTE*)malloc(0x40);
     memcpy(rom->Image, header, 0x40);
     rom->Header = rom->Image;
     rom->BootCode = rom->Image + 0x40;
@@ -128,19 +249,11 @@ int iRomReadHeader(const char* filename) {
 }
 
 void iRomChangeRomEndian(WORD Mode, DWORD Length) {
-    for (DWORD i = 0; i < Length; i += 4) {
-        char* p = reinterpret_cast<char*>(rom->Image + i);
-        if (Mode == 0) std::swap_ranges(p, p + 4, p); // Swap for mode 0
-        else std::swap(p[0], p[3]), std::swap(p[1], p[2]); // Swap for mode 1
-    }
+    iRomSwap(rom->Image, rom->Image, Length, Mode);
 }
 
 void iRomChangeRomEndianEx(WORD Mode, DWORD Length, DWORD Offset) {
-    for (DWORD i = 0; i < Length; i += 4) {
-        char* p = reinterpret_cast<char*>(rom->Image + i + Offset);
-        if (Mode == 0) std::swap_ranges(p, p + 4, p);
-        else std::swap(p[0], p[3]), std::swap(p[1], p[2]);
-    }
+    iRomSwap(rom->Image + Offset, rom->Image + Offset, Length, Mode);
 }
 
 void iRomSetupPageMap() {
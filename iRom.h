@@ -22,6 +22,7 @@ void iRomDestruct();
 int iRomReadImage(const char* filename);
 int iRomReadHeader(const char* filename);
 
+void iRomSwap(BYTE* dst, const BYTE* src, DWORD length, WORD mode);
 void iRomChangeRomEndian(WORD mode, DWORD length);
 void iRomChangeRomEndianEx(WORD mode, DWORD length, DWORD offset);
 
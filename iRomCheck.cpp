@@ -0,0 +1,444 @@
+// iRomCheck.cpp - ROM set verification against a built-in manifest
+//
+// Every file of a set is hashed (CRC32 + SHA-1) on a small worker pool and the
+// results are kept in a cache keyed by path, size and mtime, so a set that has
+// not changed since the last launch is verified without reading it again.
+
+#include "iRomCheck.h"
+#include "ki.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <string>
+#include <sys/stat.h>
+
+#if defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#endif
+
+#define IROM_CACHE_FILE "romcache.txt"
+#define IROM_PIN_FILE   "romcheck.xml"
+#define IROM_CHUNK      (1024 * 1024)
+#define IROM_MAX_JOBS   4
+
+// ---------------------- MANIFEST ----------------------
+// Sizes follow the memory map (512 KB R4600 program, eight 512 KB sound ROMs
+// filling dspRMem). The hashes are MAME's for kinst (v1.5d) and kinst2 (v1.4);
+// KI2's sound ROMs past u10 are not pinned here and pass unless romcheck.xml
+// pins them (see PINS). The HD image is left out: this port's image is a raw
+// dump behind a 13-byte header, and MAME pins the CHD it keeps the drive in,
+// so neither size nor hash would ever match.
+
+const iRomChip iRomKI1Chips[IROM_SET_CHIPS] = {
+    { "u98-l15d", 0x80000, 0x7b65ca3d, "607394d4ba1a9f9bb0cd9fc6f2d9ebc4ce6b9ec4" },
+    { "u10-l1",   0x80000, 0xb6cc155f, "810d455df4f385a66cfb2ab9ad4b8ac2c5a0eec5" },
+    { "u11-l1",   0x80000, 0x0b5e05df, "0595909cb3a307a04e6394a2eab8bdbfb6ba4eee" },
+    { "u12-l1",   0x80000, 0xd05ce6ad, "7a8ee405c118fd176b66166d7e8b1ad69fc6dc8d" },
+    { "u13-l1",   0x80000, 0x7d0954ea, "ff32b6a24a9a11e28cb42a4ca4e1da70dae7ac8b" },
+    { "u33-l1",   0x80000, 0x8bbe4f0c, "b22e365bc8d58a80eaac35fe511a8d5d7aeb3ed3" },
+    { "u34-l1",   0x80000, 0xb2e73603, "ee439f5162a2b3379d3f802328017bb3c68547a2" },
+    { "u35-l1",   0x80000, 0x0aaef4fc, "48c4c954ac9db648f28ad64f9845e19ec432eec3" },
+    { "u36-l1",   0x80000, 0x0577bb60, "cc78070cc41701e9a91fde5cfbdc7e1e83354854" },
+    { "ki.img",   0,       0, nullptr },
+};
+
+const iRomChip iRomKI2Chips[IROM_SET_CHIPS] = {
+    { "gamerom",  0x80000, 0x27d0285e, "aa7a2a9d72a17305a84efa5cd24f80e2ccb5f519" },
+    { "u10sound", 0x80000, 0xfdf6ed51, "acfc9460cd5df01403b7f00b2f68c2a8734ad6d0" },
+    { "u11sound", 0x80000, 0, nullptr },
+    { "u12sound", 0x80000, 0, nullptr },
+    { "u13sound", 0x80000, 0, nullptr },
+    { "u33sound", 0x80000, 0, nullptr },
+    { "u34sound", 0x80000, 0, nullptr },
+    { "u35sound", 0x80000, 0, nullptr },
+    { "u36sound", 0x80000, 0, nullptr },
+    { "ki2.img",  0,       0, nullptr },
+};
+
+// ---------------------- PINS ----------------------
+// Optional: `mame -listxml kinst kinst2 > romcheck.xml` (any revision of
+// either) re-pins every ROM by the board position in its name, for a set
+// from another revision than the built-in one. KI takes the first kinst*
+// machine in the file, KI2 the first kinst2* one; slots it has no good dump
+// of keep the built-in hash.
+
+static const char* const iRomPinKeys[IROM_SET_CHIPS] = {
+    "u98", "u10", "u11", "u12", "u13", "u33", "u34", "u35", "u36", nullptr,
+};
+
+// value of attribute name="..." inside one tag, empty when it has none
+static std::string iRomXmlAttr(const std::string& tag, const char* name) {
+    std::string key = std::string(" ") + name + "=\"";
+    size_t at = tag.find(key);
+    if (at == std::string::npos) return std::string();
+    at += key.size();
+    size_t end = tag.find('"', at);
+    return end == std::string::npos ? std::string() : tag.substr(at, end - at);
+}
+
+static void iRomLoadPins(WORD RomSet, iRomChip* chips, std::string* sha1) {
+    FILE* f = fopen(IROM_PIN_FILE, "r");
+    if (!f) return;
+    std::string xml;
+    char buf[4096];
+    size_t got;
+    while ((got = fread(buf, 1, sizeof(buf), f)) > 0)
+        xml.append(buf, got);
+    fclose(f);
+
+    size_t at = 0;
+    while ((at = xml.find("<machine name=\"kinst", at)) != std::string::npos) {
+        bool ki2 = xml.compare(at + 20, 1, "2") == 0;
+        size_t end = xml.find("</machine>", at);
+        if (ki2 != (RomSet == KI2)) {
+            at = end;
+            continue;
+        }
+        for (size_t rom = xml.find("<rom ", at); rom < end; rom = xml.find("<rom ", rom + 1)) {
+            std::string tag = xml.substr(rom, xml.find('>', rom) - rom);
+            std::string name = iRomXmlAttr(tag, "name"), crc = iRomXmlAttr(tag, "crc");
+            if (crc.empty() || iRomXmlAttr(tag, "status") == "baddump")
+                continue;
+            for (int i = 0; iRomPinKeys[i]; i++) {
+                if (name.find(iRomPinKeys[i]) == std::string::npos) continue;
+                chips[i].Crc = (DWORD)strtoul(crc.c_str(), nullptr, 16);
+                sha1[i] = iRomXmlAttr(tag, "sha1");
+                chips[i].Sha1 = sha1[i].empty() ? nullptr : sha1[i].c_str();
+            }
+        }
+        printf("RomCheck: hashes pinned from %s in " IROM_PIN_FILE "\n",
+               iRomXmlAttr(xml.substr(at, xml.find('>', at) - at), "name").c_str());
+        return;
+    }
+}
+
+// ---------------------- CRC32 ----------------------
+// Plain IEEE CRC32 (same as zlib). ARMv8 has it in hardware, which the
+// +crc in our -mcpu flags turns on; elsewhere a slice-by-8 table is used.
+
+#if !defined(__ARM_FEATURE_CRC32)
+static DWORD iRomCrcTable[8][256];
+static bool iRomCrcReady = false;
+
+static void iRomCrcInit() {
+    for (DWORD i = 0; i < 256; i++) {
+        DWORD c = i;
+        for (int k = 0; k < 8; k++)
+            c = (c & 1) ? (c >> 1) ^ 0xedb88320 : (c >> 1);
+        iRomCrcTable[0][i] = c;
+    }
+    for (DWORD i = 0; i < 256; i++)
+        for (int t = 1; t < 8; t++)
+            iRomCrcTable[t][i] = (iRomCrcTable[t - 1][i] >> 8) ^ iRomCrcTable[0][iRomCrcTable[t - 1][i] & 0xff];
+    iRomCrcReady = true;
+}
+#endif
+
+DWORD iRomCrc32(DWORD crc, const BYTE* data, size_t length) {
+    crc = ~crc;
+#if defined(__ARM_FEATURE_CRC32)
+    while (length && ((uintptr_t)data & 7)) {
+        crc = __crc32b(crc, *data++);
+        length--;
+    }
+    for (; length >= 32; length -= 32, data += 32) {
+        crc = __crc32d(crc, *(const uint64_t*)(data));
+        crc = __crc32d(crc, *(const uint64_t*)(data + 8));
+        crc = __crc32d(crc, *(const uint64_t*)(data + 16));
+        crc = __crc32d(crc, *(const uint64_t*)(data + 24));
+    }
+    for (; length >= 8; length -= 8, data += 8)
+        crc = __crc32d(crc, *(const uint64_t*)data);
+    while (length--)
+        crc = __crc32b(crc, *data++);
+#else
+    if (!iRomCrcReady) iRomCrcInit();
+    for (; length >= 8; length -= 8, data += 8) {
+        DWORD lo, hi;
+        memcpy(&lo, data, 4);
+        memcpy(&hi, data + 4, 4);
+        lo ^= crc;
+        crc = iRomCrcTable[7][lo & 0xff] ^ iRomCrcTable[6][(lo >> 8) & 0xff] ^
+              iRomCrcTable[5][(lo >> 16) & 0xff] ^ iRomCrcTable[4][lo >> 24] ^
+              iRomCrcTable[3][hi & 0xff] ^ iRomCrcTable[2][(hi >> 8) & 0xff] ^
+              iRomCrcTable[1][(hi >> 16) & 0xff] ^ iRomCrcTable[0][hi >> 24];
+    }
+    while (length--)
+        crc = (crc >> 8) ^ iRomCrcTable[0][(crc ^ *data++) & 0xff];
+#endif
+    return ~crc;
+}
+
+// ---------------------- SHA-1 ----------------------
+
+struct iRomSha1 {
+    DWORD State[5];
+    uint64_t Length;
+    BYTE Block[64];
+    DWORD Used;
+};
+
+static inline DWORD iRomRol(DWORD v, int s) { return (v << s) | (v >> (32 - s)); }
+
+static void iRomSha1Block(iRomSha1* s, const BYTE* p) {
+    DWORD w[80];
+    for (int i = 0; i < 16; i++)
+        w[i] = (DWORD)p[i * 4] << 24 | (DWORD)p[i * 4 + 1] << 16 | (DWORD)p[i * 4 + 2] << 8 | p[i * 4 + 3];
+    for (int i = 16; i < 80; i++)
+        w[i] = iRomRol(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+    DWORD a = s->State[0], b = s->State[1], c = s->State[2], d = s->State[3], e = s->State[4];
+    for (int i = 0; i < 80; i++) {
+        DWORD f, k;
+        if (i < 20)      { f = (b & c) | (~b & d);           k = 0x5a827999; }
+        else if (i < 40) { f = b ^ c ^ d;                    k = 0x6ed9eba1; }
+        else if (i < 60) { f = (b & c) | (b & d) | (c & d);  k = 0x8f1bbcdc; }
+        else             { f = b ^ c ^ d;                    k = 0xca62c1d6; }
+        DWORD t = iRomRol(a, 5) + f + e + k + w[i];
+        e = d; d = c; c = iRomRol(b, 30); b = a; a = t;
+    }
+    s->State[0] += a; s->State[1] += b; s->State[2] += c; s->State[3] += d; s->State[4] += e;
+}
+
+static void iRomSha1Init(iRomSha1* s) {
+    s->State[0] = 0x67452301; s->State[1] = 0xefcdab89; s->State[2] = 0x98badcfe;
+    s->State[3] = 0x10325476; s->State[4] = 0xc3d2e1f0;
+    s->Length = 0;
+    s->Used = 0;
+}
+
+static void iRomSha1Update(iRomSha1* s, const BYTE* data, size_t length) {
+    s->Length += length;
+    if (s->Used) {
+        while (length && s->Used < 64) { s->Block[s->Used++] = *data++; length--; }
+        if (s->Used < 64) return;
+        iRomSha1Block(s, s->Block);
+        s->Used = 0;
+    }
+    for (; length >= 64; length -= 64, data += 64)
+        iRomSha1Block(s, data);
+    memcpy(s->Block, data, length);
+    s->Used = (DWORD)length;
+}
+
+static void iRomSha1Final(iRomSha1* s, char* hex) {
+    uint64_t bits = s->Length * 8;
+    BYTE pad = 0x80;
+    iRomSha1Update(s, &pad, 1);
+    pad = 0;
+    while (s->Used != 56) iRomSha1Update(s, &pad, 1);
+    BYTE len[8];
+    for (int i = 0; i < 8; i++) len[i] = (BYTE)(bits >> (56 - i * 8));
+    iRomSha1Update(s, len, 8);
+    for (int i = 0; i < 5; i++)
+        sprintf(hex + i * 8, "%08x", s->State[i]);
+    hex[40] = 0;
+}
+
+// ---------------------- CACHE ----------------------
+
+struct iRomCacheEntry {
+    std::string Path;
+    uint64_t Size;
+    int64_t Time;
+    DWORD Crc;
+    char Sha1[41];
+};
+
+static std::vector<iRomCacheEntry> iRomCache;
+
+DWORD iRomSetHash = 0;
+
+static void iRomLoadCache() {
+    iRomCache.clear();
+    FILE* f = fopen(IROM_CACHE_FILE, "r");
+    if (!f) return;
+
+    char line[512];
+    while (fgets(line, sizeof(line), f)) {
+        // size mtime crc sha1 path
+        iRomCacheEntry e;
+        unsigned long long size;
+        long long time;
+        unsigned crc;
+        int used = 0;
+        if (sscanf(line, "%llu %lld %x %40s %n", &size, &time, &crc, e.Sha1, &used) < 4 || !used)
+            continue;
+        char* path = line + used;
+        path[strcspn(path, "\r\n")] = 0;
+        e.Path = path;
+        e.Size = size;
+        e.Time = time;
+        e.Crc = crc;
+        iRomCache.push_back(e);
+    }
+    fclose(f);
+}
+
+static void iRomSaveCache() {
+    FILE* f = fopen(IROM_CACHE_FILE, "w");
+    if (!f) return;
+    for (const iRomCacheEntry& e : iRomCache)
+        fprintf(f, "%llu %lld %08x %s %s\n", (unsigned long long)e.Size, (long long)e.Time,
+                e.Crc, e.Sha1, e.Path.c_str());
+    fclose(f);
+}
+
+static iRomCacheEntry* iRomFindCache(const char* path) {
+    for (iRomCacheEntry& e : iRomCache)
+        if (e.Path == path) return &e;
+    return nullptr;
+}
+
+// ---------------------- VERIFY ----------------------
+
+static bool iRomHashFile(const char* path, DWORD* crc, char* sha1) {
+    FILE* f = fopen(path, "rb");
+    if (!f) return false;
+
+    BYTE* buf = (BYTE*)malloc(IROM_CHUNK);
+    if (!buf) { fclose(f); return false; }
+
+    iRomSha1 s;
+    iRomSha1Init(&s);
+    DWORD c = 0;
+    size_t got;
+    while ((got = fread(buf, 1, IROM_CHUNK, f)) > 0) {
+        c = iRomCrc32(c, buf, got);
+        iRomSha1Update(&s, buf, got);
+    }
+    bool ok = !ferror(f);
+    fclose(f);
+    free(buf);
+
+    *crc = c;
+    iRomSha1Final(&s, sha1);
+    return ok;
+}
+
+bool iRomCheckFiles(const iRomChip* chips, const char* const* paths, int count, iRomCheckResult* results) {
+    iRomLoadCache();
+
+    // stat everything up front and pull unchanged files from the cache
+    std::vector<int> jobs;
+    std::vector<int64_t> times(count);
+    for (int i = 0; i < count; i++) {
+        iRomCheckResult* res = &results[i];
+        memset(res, 0, sizeof(iRomCheckResult));
+        res->Path = paths[i];
+
+        // slots this port never fills in are not checked
+        if (!paths[i] || !paths[i][0]) {
+            res->Ok = true;
+            continue;
+        }
+
+        struct stat st;
+        if (stat(paths[i], &st) != 0)
+            continue;
+        res->Found = true;
+        res->Size = (DWORD)st.st_size;
+        times[i] = (int64_t)st.st_mtime;
+
+        iRomCacheEntry* e = iRomFindCache(paths[i]);
+        if (e && e->Size == (uint64_t)st.st_size && e->Time == times[i]) {
+            res->Crc = e->Crc;
+            memcpy(res->Sha1, e->Sha1, sizeof(res->Sha1));
+            res->Cached = true;
+        } else
+            jobs.push_back(i);
+    }
+
+    // hash whatever changed on a small worker pool
+    if (!jobs.empty()) {
+        iRomCrc32(0, nullptr, 0); // build the table before the workers race for it
+
+        std::atomic<int> next(0);
+        auto worker = [&]() {
+            int j;
+            while ((j = next.fetch_add(1)) < (int)jobs.size()) {
+                iRomCheckResult* res = &results[jobs[j]];
+                if (!iRomHashFile(res->Path, &res->Crc, res->Sha1))
+                    res->Found = false;
+            }
+        };
+
+        int threads = (int)std::thread::hardware_concurrency();
+        if (threads < 1) threads = 1;
+        if (threads > IROM_MAX_JOBS) threads = IROM_MAX_JOBS;
+        if (threads > (int)jobs.size()) threads = (int)jobs.size();
+
+        std::vector<std::thread> pool;
+        for (int t = 1; t < threads; t++)
+            pool.emplace_back(worker);
+        worker();
+        for (std::thread& t : pool)
+            t.join();
+
+        for (int i : jobs) {
+            iRomCheckResult* res = &results[i];
+            if (!res->Found) continue;
+            iRomCacheEntry* e = iRomFindCache(res->Path);
+            if (!e) {
+                iRomCache.push_back(iRomCacheEntry());
+                e = &iRomCache.back();
+                e->Path = res->Path;
+            }
+            e->Size = res->Size;
+            e->Time = times[i];
+            e->Crc = res->Crc;
+            memcpy(e->Sha1, res->Sha1, sizeof(e->Sha1));
+        }
+        iRomSaveCache();
+    }
+
+    bool all = true;
+    for (int i = 0; i < count; i++) {
+        iRomCheckResult* res = &results[i];
+        const iRomChip* chip = &chips[i];
+        if (!res->Path || !res->Path[0]) continue;
+        res->Ok = res->Found;
+        if (res->Ok && chip->Size && res->Size != chip->Size) res->Ok = false;
+        if (res->Ok && chip->Crc && res->Crc != chip->Crc) res->Ok = false;
+        if (res->Ok && chip->Sha1 && strcmp(res->Sha1, chip->Sha1) != 0) res->Ok = false;
+        all &= res->Ok;
+    }
+    return all;
+}
+
+bool iRomCheckSet(WORD RomSet, const char* MainRom) {
+    iRomChip chips[IROM_SET_CHIPS];
+    std::string sha1[IROM_SET_CHIPS];
+    memcpy(chips, (RomSet == KI2) ? iRomKI2Chips : iRomKI1Chips, sizeof(chips));
+    iRomLoadPins(RomSet, chips, sha1);
+    const char* paths[IROM_SET_CHIPS] = {
+        MainRom,
+        theApp.m_ARom1, theApp.m_ARom2, theApp.m_ARom3, theApp.m_ARom4,
+        theApp.m_ARom5, theApp.m_ARom6, theApp.m_ARom7, theApp.m_ARom8,
+        theApp.m_HDImage,
+    };
+
+    iRomCheckResult results[IROM_SET_CHIPS];
+    bool ok = iRomCheckFiles(chips, paths, IROM_SET_CHIPS, results);
+
+    iRomSetHash = RomSet;
+    for (int i = 0; i < IROM_SET_CHIPS; i++) {
+        const iRomCheckResult* res = &results[i];
+        if (res->Found) {
+            iRomSetHash = iRomCrc32(iRomSetHash, (const BYTE*)&res->Size, sizeof(res->Size));
+            iRomSetHash = iRomCrc32(iRomSetHash, (const BYTE*)res->Sha1, 40);
+        }
+        if (!res->Path || !res->Path[0])
+            continue;
+        if (!res->Found)
+            printf("RomCheck: %-9s missing (%s)\n", chips[i].Slot, res->Path);
+        else
+            printf("RomCheck: %-9s %s size %X crc %08X sha1 %s%s\n", chips[i].Slot,
+                   res->Ok ? "ok " : "BAD", res->Size, res->Crc, res->Sha1,
+                   res->Cached ? " (cached)" : "");
+    }
+    return ok;
+}
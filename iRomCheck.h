@@ -0,0 +1,45 @@
+#ifndef IROMCHECK_H
+#define IROMCHECK_H
+
+#include <cstdint>
+#include <cstddef>
+
+using BYTE  = uint8_t;
+using WORD  = uint16_t;
+using DWORD = uint32_t;
+
+// One chip (or the HD image) of a ROM set. Size 0 skips the size check,
+// Crc 0 / Sha1 nullptr means the hash is not pinned and any content passes.
+struct iRomChip {
+    const char* Slot;
+    DWORD       Size;
+    DWORD       Crc;
+    const char* Sha1;
+};
+
+// Result for one file of the set being checked
+struct iRomCheckResult {
+    const char* Path;
+    DWORD       Size;
+    DWORD       Crc;
+    char        Sha1[41];
+    bool        Found;
+    bool        Cached;   // hashes came from the manifest cache
+    bool        Ok;
+};
+
+#define IROM_SET_CHIPS 10   // program ROM, eight sound ROMs, HD image
+
+extern const iRomChip iRomKI1Chips[IROM_SET_CHIPS];
+extern const iRomChip iRomKI2Chips[IROM_SET_CHIPS];
+
+// Size and SHA-1 of every file iRomCheckSet found, for caches that are only
+// good for the exact set they were made with
+extern DWORD iRomSetHash;
+
+DWORD iRomCrc32(DWORD crc, const BYTE* data, size_t length);
+
+bool iRomCheckFiles(const iRomChip* chips, const char* const* paths, int count, iRomCheckResult* results);
+bool iRomCheckSet(WORD RomSet, const char* MainRom);
+
+#endif // IROMCHECK_H
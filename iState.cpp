@@ -0,0 +1,560 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <switch.h>
+#include "ki.h"
+#include "iMain.h"
+#include "iCPU.h"
+#include "iMemory.h"
+#include "iATA.h"
+#include "adsp2100.h"
+#include "hleDSP.h"
+#include "dspLink.h"
+#include "iPack.h"
+#include "iState.h"
+
+#define STATE_GATHER        0x10000     // small fields packed together
+#define STATE_BLOCK_MIN     0x1000      // writes from here up get a block of their own
+#define STATE_IMAGE_MIN     0x100000
+
+#define STATE_FLAG_NO_BULK    0x0002    // RAM and DSP memories left out
+
+#define STATE_TAG(a, b, c, d)  ((uint32_t)(a) | ((uint32_t)(b) << 8) | ((uint32_t)(c) << 16) | ((uint32_t)(d) << 24))
+#define STATE_TAG_CHARS(t)     (char)(t), (char)((t) >> 8), (char)((t) >> 16), (char)((t) >> 24)
+
+struct STATEHEADER {
+    uint32_t magic;
+    uint16_t format;
+    uint16_t romSet;
+    uint32_t flags;
+    uint32_t chunks;
+};
+
+struct STATECHUNKHEADER {
+    uint32_t tag;
+    uint16_t version;
+    uint16_t reserved;
+    uint32_t size;          // bytes of blocks that follow
+    uint32_t checksum;      // iPackChecksum of those bytes
+};
+
+struct STATEBLOCK {
+    uint32_t raw;
+    uint32_t packed;        // equal to raw: stored as is
+};
+
+struct STATESTREAM {
+    STATEIMAGE*    out;     // saving
+    const uint8_t* in;      // loading: next block
+    const uint8_t* end;
+    uint16_t       version;
+    bool           bulk;
+    bool           ok;
+    uint32_t       used;    // bytes in stateGather
+    uint32_t       pos;     // loading: bytes of it read
+};
+
+typedef void (*STATEFN)(STATESTREAM* s);
+
+struct STATESECTION {
+    uint32_t tag;
+    uint16_t version;       // what save writes, the newest load understands
+    STATEFN  save;
+    STATEFN  load;
+};
+
+// Load order matters: memory first, the CPU and ADSP rebuild their code
+// caches from it
+static const STATESECTION stateSections[] = {
+    { STATE_TAG('M','E','M',' '), 1, iMemSaveState,       iMemLoadState },
+    { STATE_TAG('C','P','U',' '), 1, iCpuSaveState,       iCpuLoadState },
+    { STATE_TAG('A','D','S','P'), 1, adsp2100_save_state, adsp2100_load_state },
+    { STATE_TAG('B','O','R','D'), 1, hleDSPSaveState,     hleDSPLoadState },
+    { STATE_TAG('L','I','N','K'), 1, dspLinkSaveState,    dspLinkLoadState },
+    { STATE_TAG('A','T','A',' '), 1, iATASaveState,       iATALoadState },
+};
+
+#define STATE_SECTIONS  (sizeof(stateSections) / sizeof(stateSections[0]))
+
+static uint8_t    stateGather[STATE_GATHER];
+static STATEIMAGE stateFile;            // reused by iStateSave / iStateLoad
+
+static double iStateMs(u64 ticks)
+{
+    return armTicksToNs(ticks) / 1000000.0;
+}
+
+static void iStateFail(STATESTREAM* s, const char* why)
+{
+    if (s->ok)
+        printf("State: %s\n", why);
+    s->ok = false;
+}
+
+static bool iStateReserve(STATEIMAGE* image, size_t more)
+{
+    size_t need = image->size + more;
+    if (need <= image->capacity)
+        return true;
+
+    size_t capacity = image->capacity ? image->capacity : STATE_IMAGE_MIN;
+    while (capacity < need)
+        capacity *= 2;
+
+    uint8_t* data = (uint8_t*)realloc(image->data, capacity);
+    if (!data)
+    {
+        printf("State: out of memory (%zu bytes)\n", capacity);
+        return false;
+    }
+    image->data = data;
+    image->capacity = capacity;
+    return true;
+}
+
+// ---------------------- BLOCK STREAM ----------------------
+static void iStatePutBlock(STATESTREAM* s, const void* data, size_t size)
+{
+    if (!s->ok)
+        return;
+    if (!iStateReserve(s->out, sizeof(STATEBLOCK) + IPACK_BOUND(size)))
+    {
+        iStateFail(s, "no room for the state");
+        return;
+    }
+
+    uint8_t* at = s->out->data + s->out->size;
+    STATEBLOCK block;
+    block.raw = (uint32_t)size;
+    block.packed = (uint32_t)iPackCompress(at + sizeof(block), (const uint8_t*)data, size);
+    if (block.packed >= block.raw)
+    {
+        memcpy(at + sizeof(block), data, size);
+        block.packed = block.raw;
+    }
+    memcpy(at, &block, sizeof(block));
+    s->out->size += sizeof(block) + block.packed;
+}
+
+static void iStateFlush(STATESTREAM* s)
+{
+    if (!s->used)
+        return;
+    iStatePutBlock(s, stateGather, s->used);
+    s->used = 0;
+}
+
+// Expands the next block, which has to be size bytes, into dst
+static void iStateGetBlock(STATESTREAM* s, void* dst, size_t size)
+{
+    STATEBLOCK block;
+    if ((size_t)(s->end - s->in) < sizeof(block))
+    {
+        iStateFail(s, "chunk ends early");
+        return;
+    }
+    memcpy(&block, s->in, sizeof(block));
+    const uint8_t* src = s->in + sizeof(block);
+
+    if (block.raw != size || block.packed > block.raw || block.packed > (size_t)(s->end - src))
+    {
+        iStateFail(s, "block does not fit its field");
+        return;
+    }
+    if (block.packed == block.raw)
+        memcpy(dst, src, size);
+    else if (!iPackExpand((uint8_t*)dst, size, src, block.packed))
+    {
+        iStateFail(s, "block does not expand");
+        return;
+    }
+    s->in = src + block.packed;
+}
+
+void iStateWrite(STATESTREAM* s, const void* data, size_t size)
+{
+    if (size >= STATE_BLOCK_MIN)
+    {
+        iStateFlush(s);
+        iStatePutBlock(s, data, size);
+        return;
+    }
+
+    if (s->used + size > STATE_GATHER)
+        iStateFlush(s);
+    memcpy(stateGather + s->used, data, size);
+    s->used += (uint32_t)size;
+}
+
+void iStateRead(STATESTREAM* s, void* data, size_t size)
+{
+    if (!s->ok)
+        return;
+
+    if (size >= STATE_BLOCK_MIN)
+    {
+        if (s->pos != s->used)
+            iStateFail(s, "fields left over before an array");
+        else
+            iStateGetBlock(s, data, size);
+        return;
+    }
+
+    if (s->pos == s->used)
+    {
+        STATEBLOCK block;
+        if ((size_t)(s->end - s->in) < sizeof(block))
+        {
+            iStateFail(s, "chunk ends early");
+            return;
+        }
+        memcpy(&block, s->in, sizeof(block));
+        if (block.raw > STATE_GATHER)
+        {
+            iStateFail(s, "array where fields were expected");
+            return;
+        }
+        iStateGetBlock(s, stateGather, block.raw);
+        s->used = block.raw;
+        s->pos = 0;
+    }
+
+    if (s->pos + size > s->used)
+    {
+        iStateFail(s, "field runs past its block");
+        return;
+    }
+    memcpy(data, stateGather + s->pos, size);
+    s->pos += (uint32_t)size;
+}
+
+uint16_t iStateVersion(STATESTREAM* s)
+{
+    return s->version;
+}
+
+bool iStateBulk(STATESTREAM* s)
+{
+    return s->bulk;
+}
+
+// ---------------------- CAPTURE / RESTORE ----------------------
+bool iStateCapture(STATEIMAGE* image, bool bulk)
+{
+    image->size = 0;
+    if (!iStateReserve(image, sizeof(STATEHEADER)))
+        return false;
+
+    STATEHEADER header;
+    header.magic  = STATE_MAGIC;
+    header.format = STATE_FORMAT;
+    header.romSet = (uint16_t)gRomSet;
+    header.flags  = bulk ? 0 : STATE_FLAG_NO_BULK;
+    header.chunks = STATE_SECTIONS;
+    memcpy(image->data, &header, sizeof(header));
+    image->size = sizeof(header);
+
+    for (size_t n = 0; n < STATE_SECTIONS; n++)
+    {
+        const STATESECTION* section = &stateSections[n];
+        size_t at = image->size;
+        if (!iStateReserve(image, sizeof(STATECHUNKHEADER)))
+            return false;
+        image->size += sizeof(STATECHUNKHEADER);
+
+        STATESTREAM s = {};
+        s.out = image;
+        s.bulk = bulk;
+        s.ok = true;
+        section->save(&s);
+        iStateFlush(&s);
+        if (!s.ok)
+            return false;
+
+        STATECHUNKHEADER chunk;
+        chunk.tag      = section->tag;
+        chunk.version  = section->version;
+        chunk.reserved = 0;
+        chunk.size     = (uint32_t)(image->size - at - sizeof(chunk));
+        chunk.checksum = iPackChecksum(image->data + at + sizeof(chunk), chunk.size);
+        memcpy(image->data + at, &chunk, sizeof(chunk));
+    }
+    return true;
+}
+
+// Everything is checked before the first subsystem is touched, so a damaged
+// or foreign state leaves the machine running as it was
+bool iStateRestore(const uint8_t* data, size_t size)
+{
+    STATEHEADER header;
+    if (size < sizeof(header))
+    {
+        printf("State: too short\n");
+        return false;
+    }
+    memcpy(&header, data, sizeof(header));
+    if (header.magic != STATE_MAGIC || header.format > STATE_FORMAT)
+    {
+        printf("State: not a state this build can read\n");
+        return false;
+    }
+    if (header.romSet != gRomSet)
+    {
+        printf("State: saved with ROM set %u, running %u\n", header.romSet, (unsigned)gRomSet);
+        return false;
+    }
+
+    STATECHUNKHEADER found[STATE_SECTIONS] = {};
+    const uint8_t* foundData[STATE_SECTIONS] = {};
+    const uint8_t* at = data + sizeof(header);
+    const uint8_t* end = data + size;
+
+    for (uint32_t n = 0; n < header.chunks; n++)
+    {
+        STATECHUNKHEADER chunk;
+        if ((size_t)(end - at) < sizeof(chunk))
+        {
+            printf("State: truncated\n");
+            return false;
+        }
+        memcpy(&chunk, at, sizeof(chunk));
+        at += sizeof(chunk);
+        if (chunk.size > (size_t)(end - at) || iPackChecksum(at, chunk.size) != chunk.checksum)
+        {
+            printf("State: %c%c%c%c chunk is damaged\n", STATE_TAG_CHARS(chunk.tag));
+            return false;
+        }
+
+        for (size_t i = 0; i < STATE_SECTIONS; i++)
+        {
+            if (stateSections[i].tag != chunk.tag)
+                continue;
+            if (chunk.version > stateSections[i].version)
+            {
+                printf("State: %c%c%c%c chunk version %u is newer than this build\n",
+                       STATE_TAG_CHARS(chunk.tag), chunk.version);
+                return false;
+            }
+            found[i] = chunk;
+            foundData[i] = at;
+        }
+        at += chunk.size;
+    }
+
+    for (size_t i = 0; i < STATE_SECTIONS; i++)
+    {
+        if (!foundData[i])
+        {
+            printf("State: no %c%c%c%c chunk\n", STATE_TAG_CHARS(stateSections[i].tag));
+            return false;
+        }
+    }
+
+    for (size_t i = 0; i < STATE_SECTIONS; i++)
+    {
+        STATESTREAM s = {};
+        s.in = foundData[i];
+        s.end = foundData[i] + found[i].size;
+        s.version = found[i].version;
+        s.bulk = !(header.flags & STATE_FLAG_NO_BULK);
+        s.ok = true;
+        stateSections[i].load(&s);
+
+        if (s.ok && (s.in != s.end || s.pos != s.used))
+            iStateFail(&s, "chunk longer than its reader");
+        if (!s.ok)
+        {
+            printf("State: %c%c%c%c chunk did not load, machine state is undefined\n",
+                   STATE_TAG_CHARS(stateSections[i].tag));
+            return false;
+        }
+    }
+    return true;
+}
+
+void iStateFree(STATEIMAGE* image)
+{
+    free(image->data);
+    image->data = nullptr;
+    image->size = 0;
+    image->capacity = 0;
+}
+
+// ---------------------- FILES ----------------------
+bool iStateSave(const char* path)
+{
+    u64 start = armGetSystemTick();
+    dspLinkPause();
+    bool ok = iStateCapture(&stateFile);
+    dspLinkResume();
+    u64 captured = armGetSystemTick();
+
+    if (!ok)
+    {
+        printf("State: capture failed\n");
+        return false;
+    }
+
+    FILE* f = fopen(path, "wb");
+    if (!f)
+    {
+        printf("State: cannot write %s\n", path);
+        return false;
+    }
+    ok = fwrite(stateFile.data, 1, stateFile.size, f) == stateFile.size;
+    ok = fclose(f) == 0 && ok;
+    if (!ok)
+    {
+        printf("State: writing %s failed\n", path);
+        return false;
+    }
+
+    printf("State: saved %s, %zu KB, captured in %.2f ms, written in %.2f ms\n", path,
+           stateFile.size >> 10, iStateMs(captured - start), iStateMs(armGetSystemTick() - captured));
+    return true;
+}
+
+bool iStateLoad(const char* path)
+{
+    u64 start = armGetSystemTick();
+    FILE* f = fopen(path, "rb");
+    if (!f)
+    {
+        printf("State: no %s\n", path);
+        return false;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    stateFile.size = 0;
+    bool ok = size > 0 && iStateReserve(&stateFile, (size_t)size) &&
+              fread(stateFile.data, 1, (size_t)size, f) == (size_t)size;
+    fclose(f);
+    if (!ok)
+    {
+        printf("State: reading %s failed\n", path);
+        return false;
+    }
+    stateFile.size = (size_t)size;
+    u64 read = armGetSystemTick();
+
+    dspLinkPause();
+    ok = iStateRestore(stateFile.data, stateFile.size);
+    dspLinkResume();
+
+    if (ok)
+        printf("State: loaded %s, read in %.2f ms, restored in %.2f ms\n", path,
+               iStateMs(read - start), iStateMs(armGetSystemTick() - read));
+    return ok;
+}
+
+// ---------------------- ROUND TRIP CHECK ----------------------
+enum { STATE_CHECK_IDLE, STATE_CHECK_FIRST, STATE_CHECK_SECOND };
+
+static int        stateCheckPhase = STATE_CHECK_IDLE;
+static int        stateCheckFrames;
+static int        stateCheckLeft;
+static STATEIMAGE stateCheckStart;      // where both runs begin
+static STATEIMAGE stateCheckFirst;      // where the first one ended
+static STATEIMAGE stateCheckNow;
+
+// Chunk by chunk, so a mismatch names the subsystem that drifted
+static bool iStateCompare(const STATEIMAGE* a, const STATEIMAGE* b)
+{
+    bool same = true;
+    size_t pa = sizeof(STATEHEADER), pb = sizeof(STATEHEADER);
+
+    for (size_t n = 0; n < STATE_SECTIONS; n++)
+    {
+        STATECHUNKHEADER ca, cb;
+        memcpy(&ca, a->data + pa, sizeof(ca));
+        memcpy(&cb, b->data + pb, sizeof(cb));
+        pa += sizeof(ca);
+        pb += sizeof(cb);
+
+        if (ca.size != cb.size || memcmp(a->data + pa, b->data + pb, ca.size))
+        {
+            printf("State check: %c%c%c%c differs (%u / %u bytes packed)\n",
+                   STATE_TAG_CHARS(ca.tag), ca.size, cb.size);
+            same = false;
+        }
+        pa += ca.size;
+        pb += cb.size;
+    }
+    return same;
+}
+
+// Also checks that capture -> restore -> capture gives back the same bytes
+void iStateCheckStart(int frames)
+{
+    dspLinkPause();
+
+    u64 t0 = armGetSystemTick();
+    bool ok = iStateCapture(&stateCheckStart);
+    u64 t1 = armGetSystemTick();
+    ok = ok && iStateRestore(stateCheckStart.data, stateCheckStart.size);
+    u64 t2 = armGetSystemTick();
+    ok = ok && iStateCapture(&stateCheckNow);
+
+    dspLinkResume();
+
+    if (!ok)
+    {
+        printf("State check: capture or restore failed\n");
+        stateCheckPhase = STATE_CHECK_IDLE;
+        return;
+    }
+
+    bool same = stateCheckNow.size == stateCheckStart.size &&
+                !memcmp(stateCheckNow.data, stateCheckStart.data, stateCheckStart.size);
+    printf("State check: %zu KB, capture %.2f ms, restore %.2f ms, round trip %s\n",
+           stateCheckStart.size >> 10, iStateMs(t1 - t0), iStateMs(t2 - t1), same ? "exact" : "DIFFERS");
+    if (!same)
+        iStateCompare(&stateCheckStart, &stateCheckNow);
+
+    if (!dspLinkInline)
+        printf("State check: DSP on its own thread, latch timing may differ between runs\n");
+
+    stateCheckFrames = frames;
+    stateCheckLeft = frames;
+    stateCheckPhase = STATE_CHECK_FIRST;
+}
+
+void iStateCheckFrame()
+{
+    if (stateCheckPhase == STATE_CHECK_IDLE || --stateCheckLeft > 0)
+        return;
+
+    dspLinkPause();
+
+    if (stateCheckPhase == STATE_CHECK_FIRST)
+    {
+        // end of the first run: note where it got to and go back
+        bool ok = iStateCapture(&stateCheckFirst) &&
+                  iStateRestore(stateCheckStart.data, stateCheckStart.size);
+        dspLinkResume();
+
+        if (!ok)
+        {
+            printf("State check: capture or restore failed\n");
+            stateCheckPhase = STATE_CHECK_IDLE;
+            return;
+        }
+        stateCheckLeft = stateCheckFrames;
+        stateCheckPhase = STATE_CHECK_SECOND;
+        return;
+    }
+
+    bool ok = iStateCapture(&stateCheckNow);
+    dspLinkResume();
+    stateCheckPhase = STATE_CHECK_IDLE;
+
+    if (!ok)
+    {
+        printf("State check: capture failed\n");
+        return;
+    }
+    if (iStateCompare(&stateCheckFirst, &stateCheckNow))
+        printf("State check: %d frames replayed from the state end identically\n", stateCheckFrames);
+}
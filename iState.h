@@ -0,0 +1,59 @@
+#ifndef ISTATE_H
+#define ISTATE_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Save states: the whole machine as tagged, versioned chunks, one per
+// subsystem (RAM and register blocks, R4600, ADSP-2105 core, sound board,
+// CPU/DSP link, ATA drive).
+//
+// A file is a header and its chunks; each chunk is a tag, the version its
+// subsystem wrote, and a checksummed stream of iPack blocks. Small fields are
+// gathered into one block, large arrays get a block of their own and are
+// packed from / expanded into place, so nothing the size of RAM is copied.
+// Unknown chunks are skipped; a subsystem reading an older version of its
+// own chunk checks iStateVersion.
+//
+// Capture and restore run on the CPU thread with the DSP held (dspLinkPause).
+// The hard drive image is not part of a state.
+
+#define STATE_MAGIC     0x7453494b   // "KISt"
+#define STATE_FORMAT    1
+
+#define STATE_CHECK_FRAMES  120      // frames run twice by iStateCheckStart
+
+struct STATESTREAM;
+
+// Subsystem side: the same calls in the same order on save and load
+extern void     iStateWrite(STATESTREAM* s, const void* data, size_t size);
+extern void     iStateRead(STATESTREAM* s, void* data, size_t size);
+extern uint16_t iStateVersion(STATESTREAM* s);
+extern bool     iStateBulk(STATESTREAM* s);     // false: RAM and the DSP memories are left out
+
+template <typename T> inline void iStateWrite(STATESTREAM* s, const T& v) { iStateWrite(s, &v, sizeof(T)); }
+template <typename T> inline void iStateRead(STATESTREAM* s, T& v) { iStateRead(s, &v, sizeof(T)); }
+
+// An in-memory state; keep one around to reuse its buffer
+struct STATEIMAGE {
+    uint8_t* data;
+    size_t   size;
+    size_t   capacity;
+};
+
+// Without bulk the image leaves RAM and the DSP memories to the caller
+// (rewind keeps them as page deltas); restore follows what the image holds
+extern bool iStateCapture(STATEIMAGE* image, bool bulk = true);
+extern bool iStateRestore(const uint8_t* data, size_t size);
+extern void iStateFree(STATEIMAGE* image);
+
+extern bool iStateSave(const char* path);
+extern bool iStateLoad(const char* path);
+
+// Round trip check: capture, run, restore, run again; both runs must end in
+// the same state. Needs dspLinkInline, a threaded DSP takes the CPU's
+// latch writes at whatever cycle it happens to be on.
+extern void iStateCheckStart(int frames);
+extern void iStateCheckFrame();     // every VSYNC, on the CPU thread
+
+#endif // ISTATE_H
@@ -0,0 +1,149 @@
+// iInput check: seqlock consistency, key maps, and poll-to-frame latency of a button press
+
+#ifdef __SWITCH__
+#include <switch.h>
+#endif
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <thread>
+#include "iInput.h"
+#include "videoPace.h"
+#include "hlePresent.h"
+
+#define FRAMES  300
+#define WORK_US 6000
+
+volatile uint16_t NewTask;
+
+// the cabinet bits for a pad with every button in the low 16 bits, as iInput maps them by default
+static uint16_t cabinet(uint64_t b)
+{
+    static const int order[16] = { 0, 1, 2, 3, 6, 7, 8, 9, 10, 11, 13, 15, 12, 14, 4, 5 };
+    uint16_t bits = 0;
+    for (int i = 0; i < 16; i++)
+        if (b >> order[i] & 1)
+            bits |= 1 << i;
+    return bits;
+}
+
+static void busy(int us)
+{
+    auto until = std::chrono::steady_clock::now() + std::chrono::microseconds(us);
+    while (std::chrono::steady_clock::now() < until)
+        ;
+}
+
+int main()
+{
+#ifdef __SWITCH__
+    consoleInit(NULL);
+#endif
+    iInputStart();
+
+    // torn reads: buttons and inputs[] come from one poll or not at all
+    std::atomic<bool> stop(false);
+    std::thread player([&] {
+        for (uint64_t b = 1; !stop; b = b * 6364136223846793005ULL + 1442695040888963407ULL)
+        {
+            iInputInject(b >> 48);
+            std::this_thread::sleep_for(std::chrono::microseconds(300));
+        }
+    });
+    uint64_t reads = 0, torn = 0, seen = 0, last = 0;
+    auto until = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+    while (std::chrono::steady_clock::now() < until)
+    {
+        INPUTSNAPSHOT s;
+        iInputRead(&s);
+        reads++;
+        torn += s.inputs[0] != cabinet(s.buttons);
+        seen += s.polled != last;
+        last = s.polled;
+    }
+    stop = true;
+    player.join();
+    INPUTSTATS stats;
+    iInputStats(&stats, true);
+    printf("seqlock: %llu reads over %llu polls (%llu seen), %llu torn\n", (unsigned long long)reads,
+           (unsigned long long)stats.polls, (unsigned long long)seen, (unsigned long long)torn);
+
+    // ControlConfig's slots: player 2 then player 1; keyboard keys stay on the defaults
+    uint32_t map[INPUT_SLOTS];
+    for (int i = 0; i < INPUT_SLOTS; i++)
+        map[i] = 0x10 + i;
+    map[11] = 3 * 256 + 2;      // player 1 B1: the third pad's X
+    map[6] = 6 * 256 + 64;      // player 2 up: the sixth pad's d-pad up
+    map[10] = 8 * 256 + 83;     // player 2 start: the eighth pad's left stick up (Y-)
+    FILE* f = fopen("input_runner.map", "wb");
+    fwrite(map, sizeof(map), 1, f);
+    fclose(f);
+    iInputInject(0);
+    iInputStart("input_runner.map");
+    static const struct {
+        int      pad;
+        uint64_t buttons;
+        uint16_t player1, player2;
+    } cases[] = {
+        { 0, HidNpadButton_A, 0, 0 },          { 0, HidNpadButton_B, 0x0002, 0 },
+        { 2, HidNpadButton_X, 0x0001, 0 },     { 1, HidNpadButton_Up, 0, 0 },
+        { 1, HidNpadButton_Down, 0, 0x0800 },  { 5, HidNpadButton_Up, 0, 0x0400 },
+        { 7, HidNpadButton_StickLUp, 0, 0x0100 }, { 3, HidNpadButton_A, 0, 0 },
+    };
+    int wrong = 0;
+    for (const auto& c : cases)
+    {
+        iInputInject(c.buttons, nullptr, c.pad);
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        INPUTSNAPSHOT s;
+        iInputRead(&s);
+        wrong += s.inputs[0] != c.player1 || s.inputs[1] != c.player2;
+        iInputInject(0, nullptr, c.pad);
+    }
+    remove("input_runner.map");
+    printf("key map: %d of %d wrong\n", wrong, (int)(sizeof(cases) / sizeof(cases[0])));
+    iInputStart(nullptr);
+
+    // press to photon, as far as the emulator can see it
+    iInputInject(0);
+    hlePresentInit(320, 240, HLE_PRESENT_NULL);
+    videoPaceConfig(0, false);
+    stop = false;
+    std::thread presser([&] {
+        uint64_t b = 0;
+        while (!stop)
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(20000 + rand() % 30000));
+            b ^= 1;
+            iInputInject(b);
+        }
+    });
+    for (int f = 0; f < FRAMES; f++)
+    {
+        busy(WORK_US);
+        videoPaceFrame();
+        INPUTSNAPSHOT s;
+        iInputLatch(&s);
+        hlePresentBuffer();
+        hlePresentSubmit(iInputFrameStamp());
+    }
+    stop = true;
+    presser.join();
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    HLEPRESENTSTATS present;
+    hlePresentStats(&present);
+    iInputStats(&stats, false);
+    printf("%u frames, %u with a change: poll to latch %.2f ms (worst %.2f), press to hand-off %.1f ms (worst %.1f) over %llu frames\n",
+           stats.latches, stats.changes, stats.ageMs, stats.worstMs, present.inputMs, present.inputWorstMs,
+           (unsigned long long)present.inputFrames);
+    hlePresentShutdown();
+    iInputStop();
+#ifdef __SWITCH__
+    consoleUpdate(NULL);
+    consoleExit(NULL);
+#endif
+    return 0;
+}
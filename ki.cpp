@@ -4,6 +4,8 @@
 #include <string.h>
 #include <cstdlib>
 #include "CEmuObject.h"
+#include "videoPace.h"
+#include "iInput.h"
 
 // --- Globals ---
 bool bQuitSignal = false;
@@ -91,17 +93,25 @@ void BootKI1(void)
     printf("BootKI1(): emulator initialized successfully.\n");
     fflush(stdout);
 
+    videoPaceConfig(theApp.m_FrameDelay, false);
+
     // --- Setup controller input ---
+    // The pads are read by iInput's poller; this loop only looks at its
+    // snapshot for +. The pad here is the one StepCPU reads for itself
     PadState pad;
     padConfigureInput(1, HidNpadStyleSet_NpadStandard);
     padInitializeDefault(&pad);
+    iInputStart();
 
     // --- Emulation loop ---
     bool emuRunning = true;
+    u64 held = 0;
     while (appletMainLoop() && emuRunning)
     {
-        padUpdate(&pad);
-        u64 kDown = padGetButtonsDown(&pad);
+        INPUTSNAPSHOT input;
+        iInputRead(&input);
+        u64 kDown = input.buttons & ~held;
+        held = input.buttons;
 
         if (kDown & HidNpadButton_Plus)
         {
@@ -114,11 +124,12 @@ void BootKI1(void)
         // Update emulator: CPU step + display
         e.UpdateDisplay(&pad);
 
-        // 60 FPS delay
-        svcSleepThread(16000);
+        // Wait out the rest of the frame; this loop draws every one
+        videoPaceFrame();
     }
 
     // --- Clean shutdown ---
+    iInputStop();
     e.Shutdown();
     printf("BootKI1(): exited cleanly.\n");
     fflush(stdout);
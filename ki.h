@@ -73,6 +73,9 @@ public:
     bool m_Auto = false;
     bool m_Skip = false;
     bool m_ScanLines = false;
+    bool m_CaptureRaw = false;  // CAPTURE_RAW instead of Y4M + WAV
+    bool m_Headless = false;    // no display or sound, for CEmuObject::Replay
+    uint32_t m_ReplayFrames = 0;    // of an input log to replay, 0 for all of it
     bool m_FakeCOP1 = false;
     bool m_PalShift = false;
     bool m_ShowFPS = false;
@@ -88,6 +91,8 @@ public:
     uint16_t m_Indent = 0;
     int m_FullScreen = 0;
     int m_ScreenRes = 0;
+    int m_Filter = 0;           // VIDEO_SCALE_*
+    int m_FilterScale = 1;      // for VIDEO_SCALE_NEAREST
     int m_DeviceNum[4]{};
     bool m_FitToWindow = false;
     int m_IgnoreSecondary = 0;
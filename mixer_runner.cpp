@@ -0,0 +1,142 @@
+// hleMixer check: cost at 16 and 64 voices, and accuracy against a per-sample reference
+
+#ifdef __SWITCH__
+#include <switch.h>
+#endif
+#include <cstdio>
+#include <cstdint>
+#include <cmath>
+#include <chrono>
+#include "hleMixer.h"
+
+#define RATE     48000
+#define BLOCK    1024
+
+static float   left[BLOCK], right[BLOCK];
+static int16_t stereo[BLOCK * 2];
+
+// what HLEAudioChannel::mix computed for one sample
+static float reference(int wave, double phase)
+{
+    double t = phase / (2 * M_PI);
+    switch (wave)
+    {
+    case HLE_WAVE_SINE:     return (float)sin(phase);
+    case HLE_WAVE_SQUARE:   return phase < M_PI ? 1.f : -1.f;
+    case HLE_WAVE_TRIANGLE: return (float)(2 * fabs(2 * (t - floor(t + 0.5))) - 1);
+    default:                return (float)(2 * (t - floor(t + 0.5)));
+    }
+}
+
+static void start(int voices)
+{
+    hleMixInit(RATE);
+    for (int n = 0; n < voices; n++)
+    {
+        hleMixPlay(n, 55.f * (n + 1), 1.f / voices, n % 4);
+        hleMixPan(n, (n % 3) - 1.f);
+    }
+}
+
+// the old per-sample path, for comparison
+static void benchmarkReference(int voices)
+{
+    const int seconds = 10;
+    const int samples = seconds * RATE;
+    double phase[64] = {};
+    float sink = 0;
+
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < samples; i++)
+    {
+        float sum = 0;
+        for (int n = 0; n < voices; n++)
+        {
+            sum += reference(n % 4, phase[n]) / voices;
+            phase[n] += 2 * M_PI * 55.0 * (n + 1) / RATE;
+            if (phase[n] > 2 * M_PI)
+                phase[n] -= 2 * M_PI;
+        }
+        sink += sum;
+    }
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+    printf("%2d voices, per-sample sin/switch: %.1f ms (sum %g)\n", voices, ms, sink);
+}
+
+static void benchmark(int voices)
+{
+    start(voices);
+    const int seconds = 10;
+    const int blocks = seconds * RATE / BLOCK;
+
+    auto t0 = std::chrono::steady_clock::now();
+    for (int b = 0; b < blocks; b++)
+    {
+        hleMix(left, right, BLOCK);
+        hleMixInterleave(stereo, left, right, BLOCK);
+    }
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+
+    printf("%2d voices: %d s of output in %.1f ms (%.3f%% of one core, %.2f ns per voice-sample)\n",
+           voices, seconds, ms, ms / (seconds * 10.0), ms * 1e6 / ((double)blocks * BLOCK * voices));
+}
+
+// one voice per waveform, centred, against the reference
+static void accuracy()
+{
+    const char* names[4] = { "sine", "square", "triangle", "saw" };
+    for (int w = 0; w < 4; w++)
+    {
+        float freq = 441.f;
+        hleMixInit(RATE);
+        hleMixPlay(0, freq, 1.f, w);
+        hleMix(left, right, BLOCK);
+        hleMixInterleave(stereo, left, right, BLOCK);
+
+        double worst = 0, err = 0, sig = 0;
+        double inc = (double)(uint32_t)(freq / RATE * 4294967296.0) / 4294967296.0 * 2 * M_PI;
+        int edges = 0;
+        for (int i = 0; i < BLOCK; i++)
+        {
+            double ph = fmod(i * inc, 2 * M_PI);
+            double want = reference(w, ph);
+            double e = fabs(left[i] - want);
+            // discontinuities of square/saw can land a sample either side
+            if (e > 0.5) { edges++; continue; }
+            worst = fmax(worst, e);
+            err += e * e;
+            sig += want * want;
+            if (stereo[i * 2] != stereo[i * 2 + 1])
+                edges += 1000;
+        }
+        printf("%-8s  max error %.5f  SNR %5.1f dB  edge samples %d\n",
+               names[w], worst, 10 * log10(sig / err), edges);
+    }
+}
+
+int main()
+{
+#ifdef __SWITCH__
+    consoleInit(NULL);
+#endif
+
+    printf("hleMixer at %d Hz\n\n", RATE);
+    accuracy();
+    printf("\n");
+    benchmark(16);
+    benchmark(64);
+    benchmarkReference(16);
+    benchmarkReference(64);
+
+#ifdef __SWITCH__
+    printf("\nPress + to exit.\n");
+    consoleUpdate(NULL);
+    while (appletMainLoop()) {
+        hidScanInput();
+        if (hidKeysDown(CONTROLLER_P1_AUTO) & KEY_PLUS) break;
+        consoleUpdate(NULL);
+    }
+    consoleExit(NULL);
+#endif
+    return 0;
+}
@@ -75,7 +75,7 @@ void main() {
 // ------------------------------------------
 
 mmDisplay::mmDisplay()
-    : m_IsOpen(false),
+    : m_FrameCount(0), m_IsOpen(false),
       mShaderProgram(0), mVertexShader(0), mFragmentShader(0),
       mWidth(1280), mHeight(720),
       mFogEnabled(false)
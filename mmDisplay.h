@@ -35,6 +35,8 @@ public:
     void SetTexture(GLuint texture);
     void ReleaseTexture(GLuint texture);
 
+    int m_FrameCount;
+
 private:
     bool m_IsOpen;
     int m_Width, m_Height;
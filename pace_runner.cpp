@@ -0,0 +1,92 @@
+// videoPace check: late, undrawn and drifting frames with frame skip off and on
+
+#ifdef __SWITCH__
+#include <switch.h>
+#endif
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <thread>
+#include "videoPace.h"
+#include "videoConvert.h"
+
+#define FRAMES      300
+#define WORK_MS     6       // emulating a frame
+#define DRAW_MS     5       // drawing one; what a skip saves
+#define SPIKE_MS    30      // every SPIKE_EVERY frames
+#define SPIKE_EVERY 50
+
+static void busy(double ms)
+{
+    auto until = std::chrono::steady_clock::now() + std::chrono::microseconds((long)(ms * 1000));
+    while (std::chrono::steady_clock::now() < until)
+        ;
+}
+
+static void run(bool skip, double drawMs)
+{
+    videoPaceConfig(0, skip);
+    VIDEOPACESTATS stats;
+    videoPaceStats(&stats, true);
+
+    auto t0 = std::chrono::steady_clock::now();
+    for (int f = 0; f < FRAMES; f++)
+    {
+        busy(f % SPIKE_EVERY == SPIKE_EVERY - 1 ? SPIKE_MS : WORK_MS);
+        if (videoPaceFrame())
+            busy(drawMs);
+    }
+    double took = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    videoPaceStats(&stats, true);
+    printf("skip %-3s draw %2.0f ms: %3u drawn %3u skipped %3u late %u resyncs; frame %.0f/%.0f ms, worst %.1f; "
+           "drift %+.1f ms\n",
+           skip ? "on" : "off", drawMs, stats.drawn, stats.skipped, stats.late, stats.resyncs,
+           videoPaceQuantile(stats.frame, 0.5), videoPaceQuantile(stats.frame, 0.99), stats.worstMs,
+           took * 1000 - FRAMES * 1000.0 / 60);
+}
+
+// Buffers handed back in no particular order must still end up whole
+static int copies()
+{
+    static VIDEOFRAME frame;
+    static uint16_t source[VIDEO_WIDTH * VIDEO_HEIGHT];
+    static uint32_t slots[3][VIDEO_WIDTH * VIDEO_HEIGHT];
+    uint32_t serial[3] = { 0, 0, 0 };
+
+    int bad = 0, lines = 0;
+    videoConvertReset(&frame);
+    for (int f = 0; f < 1000; f++)
+    {
+        for (int k = 0; k < 4; k++)
+            source[rand() % (VIDEO_WIDTH * VIDEO_HEIGHT)] = (uint16_t)(rand() & 0x7fff);
+        if (f == 500)
+            videoConvertReset(&frame);
+        videoConvertFrame(&frame, source);
+
+        int s = rand() % 3;
+        lines += videoConvertCopy(&frame, slots[s], &serial[s]);
+        bad += memcmp(slots[s], frame.pixels, sizeof(frame.pixels)) != 0;
+    }
+    printf("present buffers out of date: %d of 1000, %.1f lines copied a frame\n", bad, lines / 1000.0);
+    return bad;
+}
+
+int main()
+{
+#ifdef __SWITCH__
+    consoleInit(NULL);
+#endif
+    run(false, DRAW_MS);
+    run(true, DRAW_MS);
+    run(false, 12);
+    run(true, 12);
+    copies();
+#ifdef __SWITCH__
+    consoleUpdate(NULL);
+    consoleExit(NULL);
+#endif
+    return 0;
+}
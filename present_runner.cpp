@@ -0,0 +1,87 @@
+// hlePresent check: what presenting a frame costs the thread that draws it
+
+#ifdef __SWITCH__
+#include <switch.h>
+#endif
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include "hlePresent.h"
+
+#define FRAMES  300
+
+static double seconds(std::chrono::steady_clock::time_point t0)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+static void run(int width, int height)
+{
+    size_t n = (size_t)width * height;
+    std::vector<uint32_t> frame(n);
+    for (size_t i = 0; i < n; i++)
+        frame[i] = (uint32_t)(i * 2654435761u) | 0xff000000;
+
+    // the old way, minus the display
+    volatile uint32_t sink = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    for (int f = 0; f < FRAMES; f++)
+    {
+        uint32_t* fb = (uint32_t*)malloc(n * sizeof(uint32_t));
+        const uint8_t* c = (const uint8_t*)frame.data();
+        for (size_t i = 0; i < n; i++, c += 4)
+            fb[i] = (c[3] << 24) | (c[2] << 16) | (c[1] << 8) | c[0];
+        sink = sink + fb[f % n];
+        free(fb);
+    }
+    double old = seconds(t0);
+
+    // as fast as the producer can go, and at 60 Hz. The frame is drawn
+    // straight into the free buffer (the memcpy stands in for the drawing and
+    // is not timed); handing it over and taking the next buffer is
+    for (int paced = 0; paced < 2; paced++)
+    {
+        hlePresentInit(width, height, HLE_PRESENT_NULL);
+        double producer = 0;
+        auto start = std::chrono::steady_clock::now();
+        uint32_t* fb = hlePresentBuffer();
+        for (int f = 0; f < FRAMES / (paced ? 5 : 1); f++)
+        {
+            memcpy(fb, frame.data(), n * sizeof(uint32_t));
+            t0 = std::chrono::steady_clock::now();
+            hlePresentSubmit();
+            fb = hlePresentBuffer();
+            producer += seconds(t0);
+            if (paced)
+                std::this_thread::sleep_until(start + std::chrono::microseconds(16667 * (f + 1)));
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        HLEPRESENTSTATS stats;
+        hlePresentStats(&stats);
+        hlePresentShutdown();
+
+        printf("%dx%d %s: old %.3f ms/frame on the drawing thread, now %.3f ms; presenter %.3f ms; "
+               "%llu submitted, %llu shown, %llu dropped\n",
+               width, height, paced ? "60 Hz    " : "unpaced  ", old * 1000 / FRAMES,
+               producer * 1000 / stats.submitted, stats.convertMs, (unsigned long long)stats.submitted,
+               (unsigned long long)stats.presented, (unsigned long long)stats.dropped);
+    }
+}
+
+int main()
+{
+#ifdef __SWITCH__
+    consoleInit(NULL);
+#endif
+    run(640, 480);
+    run(1280, 720);
+#ifdef __SWITCH__
+    consoleUpdate(NULL);
+    consoleExit(NULL);
+#endif
+    return 0;
+}
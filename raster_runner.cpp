@@ -0,0 +1,503 @@
+// hleRaster check: coverage against the fill rule, triangle and fill rates against the old per-pixel loop, and the texture cache
+
+#ifdef __SWITCH__
+#include <switch.h>
+#endif
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cmath>
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "hleRaster.h"
+
+#define FRAMES      20
+#define TEXTURE     64
+
+struct SCENE {
+    int width, height;
+    int triangles;          // per frame
+    float size;             // longest side, roughly
+};
+
+static std::vector<HLERASTERVERTEX> vertices;
+static uint32_t texels[TEXTURE * TEXTURE];
+static std::mutex pixelMutex;
+
+static float edge(const HLERASTERVERTEX& a, const HLERASTERVERTEX& b, float px, float py)
+{
+    return (px - a.x) * (b.y - a.y) - (py - a.y) * (b.x - a.x);
+}
+
+// Wound the way the old loop draws, so both paths cover the same triangles
+static void makeScene(const SCENE& s)
+{
+    srand(1);
+    vertices.clear();
+    for (int i = 0; i < s.triangles; i++)
+    {
+        float cx = (float)(rand() % s.width), cy = (float)(rand() % s.height);
+        HLERASTERVERTEX v[3];
+        for (int k = 0; k < 3; k++)
+        {
+            v[k].x = std::clamp(cx + (rand() / (float)RAND_MAX - 0.5f) * s.size, 0.f, (float)s.width);
+            v[k].y = std::clamp(cy + (rand() / (float)RAND_MAX - 0.5f) * s.size, 0.f, (float)s.height);
+            v[k].r = (float)(rand() % 256);
+            v[k].g = (float)(rand() % 256);
+            v[k].b = (float)(rand() % 256);
+            v[k].u = rand() / (float)RAND_MAX;
+            v[k].v = rand() / (float)RAND_MAX;
+            v[k].w = 1.f;
+        }
+        if (edge(v[0], v[1], v[2].x, v[2].y) < 0)
+            std::swap(v[1], v[2]);
+        vertices.insert(vertices.end(), v, v + 3);
+    }
+    for (int i = 0; i < TEXTURE * TEXTURE; i++)
+        texels[i] = 0xff000000 | (uint32_t)(i * 2654435761u >> 8);
+}
+
+// what GPUDrawTriangle / GPUDrawTexturedTriangle did, GPUSetPixel included
+static uint64_t drawReference(uint32_t* fb, int width, int height, bool textured)
+{
+    uint64_t covered = 0;
+    for (size_t i = 0; i < vertices.size(); i += 3)
+    {
+        const HLERASTERVERTEX &v0 = vertices[i], &v1 = vertices[i + 1], &v2 = vertices[i + 2];
+        int minX = std::max(0, int(std::floor(std::min({ v0.x, v1.x, v2.x }))));
+        int maxX = std::min(width - 1, int(std::ceil(std::max({ v0.x, v1.x, v2.x }))));
+        int minY = std::max(0, int(std::floor(std::min({ v0.y, v1.y, v2.y }))));
+        int maxY = std::min(height - 1, int(std::ceil(std::max({ v0.y, v1.y, v2.y }))));
+        if (std::abs(edge(v0, v1, v2.x, v2.y)) < 1e-6f)
+            continue;
+
+        for (int y = minY; y <= maxY; y++)
+        {
+            for (int x = minX; x <= maxX; x++)
+            {
+                float w0 = edge(v1, v2, x + 0.5f, y + 0.5f);
+                float w1 = edge(v2, v0, x + 0.5f, y + 0.5f);
+                float w2 = edge(v0, v1, x + 0.5f, y + 0.5f);
+                if (w0 < 0 || w1 < 0 || w2 < 0)
+                    continue;
+                float sum = w0 + w1 + w2;
+                uint32_t c;
+                if (textured)
+                {
+                    float u = (v0.u * w0 + v1.u * w1 + v2.u * w2) / sum;
+                    float v = (v0.v * w0 + v1.v * w1 + v2.v * w2) / sum;
+                    int tx = std::clamp(int(u * TEXTURE), 0, TEXTURE - 1);
+                    int ty = std::clamp(int(v * TEXTURE), 0, TEXTURE - 1);
+                    c = texels[ty * TEXTURE + tx];
+                }
+                else
+                {
+                    uint32_t r = uint8_t((v0.r * w0 + v1.r * w1 + v2.r * w2) / sum);
+                    uint32_t g = uint8_t((v0.g * w0 + v1.g * w1 + v2.g * w2) / sum);
+                    uint32_t b = uint8_t((v0.b * w0 + v1.b * w1 + v2.b * w2) / sum);
+                    c = 0xff000000 | b << 16 | g << 8 | r;
+                }
+                std::lock_guard<std::mutex> lock(pixelMutex);
+                fb[y * width + x] = c;
+                covered++;
+            }
+        }
+    }
+    return covered;
+}
+
+static void drawRaster(bool textured)
+{
+    const HLERASTERTEXTURE* tex = textured ? hleRasterTexture(texels, TEXTURE, TEXTURE) : nullptr;
+    hleRasterClear(0xff000000);
+    for (size_t i = 0; i < vertices.size(); i += 3)
+        hleRasterTriangle(&vertices[i], &vertices[i + 1], &vertices[i + 2], tex);
+    hleRasterFlush();
+}
+
+// What hleRaster has to draw, worked out per pixel on its own: vertices
+// snapped to 1/16 pixel, a pixel drawn when its centre is inside all three
+// edges or on an edge that is a top or left one. hits counts the triangles
+// drawn on each pixel
+static void drawExact(uint32_t* fb, uint8_t* hits, int width, int height,
+                      const std::vector<HLERASTERVERTEX>& tris, const std::vector<uint32_t>& colours)
+{
+    for (size_t i = 0; i < tris.size(); i += 3)
+    {
+        int64_t X[3], Y[3];
+        for (int k = 0; k < 3; k++)
+        {
+            X[k] = lrintf(tris[i + k].x * 16);
+            Y[k] = lrintf(tris[i + k].y * 16);
+        }
+        int64_t area = (X[1] - X[0]) * (Y[2] - Y[0]) - (Y[1] - Y[0]) * (X[2] - X[0]);
+        if (area == 0)
+            continue;
+        if (area < 0)
+        {
+            std::swap(X[1], X[2]);
+            std::swap(Y[1], Y[2]);
+        }
+
+        int minX = std::max<int64_t>(0, std::min({ X[0], X[1], X[2] }) / 16 - 1);
+        int maxX = std::min<int64_t>(width - 1, std::max({ X[0], X[1], X[2] }) / 16 + 1);
+        int minY = std::max<int64_t>(0, std::min({ Y[0], Y[1], Y[2] }) / 16 - 1);
+        int maxY = std::min<int64_t>(height - 1, std::max({ Y[0], Y[1], Y[2] }) / 16 + 1);
+        for (int y = minY; y <= maxY; y++)
+            for (int x = minX; x <= maxX; x++)
+            {
+                int64_t px = x * 16 + 8, py = y * 16 + 8;
+                bool inside = true;
+                for (int k = 0; k < 3 && inside; k++)
+                {
+                    int64_t dx = X[(k + 1) % 3] - X[k], dy = Y[(k + 1) % 3] - Y[k];
+                    int64_t e = dx * (py - Y[k]) - dy * (px - X[k]);
+                    bool topLeft = dy < 0 || (dy == 0 && dx > 0);
+                    inside = e > 0 || (e == 0 && topLeft);
+                }
+                if (inside)
+                {
+                    fb[y * width + x] = colours[i / 3];
+                    hits[y * width + x]++;
+                }
+            }
+    }
+}
+
+// Exact agreement with drawExact, for random overlapping triangles of either
+// winding and for a mesh of jittered quads whose shared edges each pixel of
+// the mesh has to fall on exactly one side of
+static int exact(int width, int height)
+{
+    size_t n = (size_t)width * height;
+    std::vector<HLERASTERVERTEX> tris;
+    std::vector<uint32_t> colours;
+    auto add = [&](HLERASTERVERTEX a, HLERASTERVERTEX b, HLERASTERVERTEX c) {
+        uint32_t id = (uint32_t)colours.size() + 1;
+        colours.push_back(0xff000000 | (id * 2654435761u >> 8));
+        for (HLERASTERVERTEX* v : { &a, &b, &c })
+        {
+            v->r = (float)(colours.back() & 0xff);
+            v->g = (float)(colours.back() >> 8 & 0xff);
+            v->b = (float)(colours.back() >> 16 & 0xff);
+            v->u = v->v = 0;
+            v->w = 1;
+        }
+        tris.insert(tris.end(), { a, b, c });
+    };
+
+    int wrong = 0;
+    for (int mesh = 0; mesh < 2; mesh++)
+    {
+        tris.clear();
+        colours.clear();
+        srand(7);
+        int x0 = 37, y0 = 21, cell = 23, cellsX = (width - 2 * x0) / cell, cellsY = (height - 2 * y0) / cell;
+        if (!mesh)
+        {
+            for (int i = 0; i < 4000; i++)
+            {
+                float cx = (float)(rand() % width), cy = (float)(rand() % height), size = 4.f + rand() % 60;
+                HLERASTERVERTEX v[3];
+                for (int k = 0; k < 3; k++)
+                {
+                    v[k].x = cx + (rand() / (float)RAND_MAX - 0.5f) * size;
+                    v[k].y = cy + (rand() / (float)RAND_MAX - 0.5f) * size;
+                    if (i % 4 == 0)     // some on the subpixel grid, for edges through centres
+                    {
+                        v[k].x = std::round(v[k].x * 2) / 2;
+                        v[k].y = std::round(v[k].y * 2) / 2;
+                    }
+                }
+                add(v[0], v[1], v[2]);
+            }
+        }
+        else
+        {
+            // corners of the mesh on whole pixels, the inside jittered
+            std::vector<HLERASTERVERTEX> grid((cellsX + 1) * (cellsY + 1));
+            for (int j = 0; j <= cellsY; j++)
+                for (int i = 0; i <= cellsX; i++)
+                {
+                    HLERASTERVERTEX& g = grid[j * (cellsX + 1) + i];
+                    g.x = (float)(x0 + i * cell);
+                    g.y = (float)(y0 + j * cell);
+                    if (i > 0 && i < cellsX && j > 0 && j < cellsY)
+                    {
+                        g.x += (rand() / (float)RAND_MAX - 0.5f) * cell * 0.4f;
+                        g.y += (rand() / (float)RAND_MAX - 0.5f) * cell * 0.4f;
+                    }
+                }
+            for (int j = 0; j < cellsY; j++)
+                for (int i = 0; i < cellsX; i++)
+                {
+                    const HLERASTERVERTEX& a = grid[j * (cellsX + 1) + i];
+                    const HLERASTERVERTEX& b = grid[j * (cellsX + 1) + i + 1];
+                    const HLERASTERVERTEX& c = grid[(j + 1) * (cellsX + 1) + i + 1];
+                    const HLERASTERVERTEX& d = grid[(j + 1) * (cellsX + 1) + i];
+                    if ((i + j) & 1)
+                    {
+                        add(a, b, c);
+                        add(a, d, c);
+                    }
+                    else
+                    {
+                        add(a, b, d);
+                        add(b, c, d);
+                    }
+                }
+        }
+
+        std::vector<uint32_t> reference(n, 0xff000000), raster(n);
+        std::vector<uint8_t> hits(n, 0);
+        drawExact(reference.data(), hits.data(), width, height, tris, colours);
+
+        size_t twice = 0, gaps = 0;
+        if (mesh)
+            for (int y = 0; y < height; y++)
+                for (int x = 0; x < width; x++)
+                {
+                    bool in = x >= x0 && x < x0 + cellsX * cell && y >= y0 && y < y0 + cellsY * cell;
+                    twice += hits[y * width + x] > 1;
+                    gaps += in ? hits[y * width + x] == 0 : hits[y * width + x] != 0;
+                }
+
+        for (int workers = 0; workers <= HLE_RASTER_WORKERS; workers += HLE_RASTER_WORKERS)
+        {
+            hleRasterInit(workers);
+            hleRasterTarget(raster.data(), width, height);
+            hleRasterClear(0xff000000);
+            for (size_t i = 0; i < tris.size(); i += 3)
+                hleRasterTriangle(&tris[i], &tris[i + 1], &tris[i + 2], nullptr);
+            hleRasterFlush();
+            hleRasterShutdown();
+
+            size_t different = 0;
+            for (size_t i = 0; i < n; i++)
+                different += reference[i] != raster[i];
+            bool ok = different == 0 && twice == 0 && gaps == 0;
+            printf("%dx%d %s, %zu triangles, %d+1: %zu pixels differ from the exact rule", width, height,
+                   mesh ? "jittered mesh  " : "random overlaps", tris.size() / 3, workers, different);
+            if (mesh)
+                printf(", %zu drawn twice, %zu missed", twice, gaps);
+            printf("%s\n", ok ? "" : "  WRONG");
+            wrong += !ok;
+        }
+    }
+    return wrong;
+}
+
+// Tile times from one flush dealt out the way hleRasterWork deals them:
+// every participant has a slice, works through its own and then takes from
+// the others. Gives the time to the last tile done; waking the pool is not
+// counted
+static double schedule(const uint32_t* ns, size_t tiles, int participants)
+{
+    std::vector<size_t> next(participants), end(participants);
+    std::vector<int> at(participants);
+    std::vector<double> clock(participants, 0);
+    std::vector<bool> done(participants, false);
+    for (int p = 0; p < participants; p++)
+    {
+        next[p] = tiles * p / participants;
+        end[p] = tiles * (p + 1) / participants;
+        at[p] = p;
+    }
+    double last = 0;
+    for (int left = participants; left > 0;)
+    {
+        // whoever is free first takes the next tile
+        int p = -1;
+        for (int q = 0; q < participants; q++)
+            if (!done[q] && (p < 0 || clock[q] < clock[p]))
+                p = q;
+        while (at[p] < p + participants && next[at[p] % participants] >= end[at[p] % participants])
+            at[p]++;
+        if (at[p] == p + participants)
+        {
+            done[p] = true;
+            last = std::max(last, clock[p]);
+            left--;
+            continue;
+        }
+        clock[p] += ns[next[at[p] % participants]++];
+    }
+    return last;
+}
+
+static double seconds(std::chrono::steady_clock::time_point t0)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+// colour channels more than one apart; the planes round differently from
+// the old divide by a hair
+static int differs(uint32_t a, uint32_t b)
+{
+    for (int s = 0; s < 32; s += 8)
+        if (abs((int)(a >> s & 0xff) - (int)(b >> s & 0xff)) > 1)
+            return 1;
+    return 0;
+}
+
+static void run(const SCENE& s, bool textured)
+{
+    size_t n = (size_t)s.width * s.height;
+    std::vector<uint32_t> reference(n), raster(n);
+    makeScene(s);
+
+    uint64_t covered = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    for (int f = 0; f < FRAMES; f++)
+    {
+        std::fill(reference.begin(), reference.end(), 0xff000000);
+        covered = drawReference(reference.data(), s.width, s.height, textured);
+    }
+    double old = seconds(t0);
+
+    printf("%dx%d, %d %s triangles of ~%.0f px, %.1f Mpixel per frame\n", s.width, s.height, s.triangles,
+           textured ? "textured" : "flat", s.size, covered / 1e6);
+    printf("  per-pixel mutex   %8.2f ms/frame  %6.2f Mtri/s  %7.1f Mpixel/s\n", old * 1000 / FRAMES,
+           s.triangles * FRAMES / old / 1e6, covered * FRAMES / old / 1e6);
+
+    for (int workers = 0; workers <= HLE_RASTER_WORKERS; workers += HLE_RASTER_WORKERS)
+    {
+        hleRasterInit(workers);
+        hleRasterTarget(raster.data(), s.width, s.height);
+        drawRaster(textured);
+        t0 = std::chrono::steady_clock::now();
+        for (int f = 0; f < FRAMES; f++)
+            drawRaster(textured);
+        double t = seconds(t0);
+
+        size_t different = 0;
+        for (size_t i = 0; i < n; i++)
+            different += differs(reference[i], raster[i]);
+        printf("  hleRaster, %d+1    %8.2f ms/frame  %6.2f Mtri/s  %7.1f Mpixel/s  x%.1f  %zu pixels differ (%.3f%%)\n",
+               workers, t * 1000 / FRAMES, s.triangles * FRAMES / t / 1e6, covered * FRAMES / t / 1e6,
+               old / t, different, 100.0 * different / n);
+    }
+
+    // what the pool makes of these tiles on more cores than this host has:
+    // each tile timed on one thread, then dealt out as a flush deals them
+    hleRasterInit(0);
+    hleRasterTarget(raster.data(), s.width, s.height);
+    hleRasterProfile(true);
+    double total = 0, spread[2] = { 0, 0 };
+    for (int f = 0; f < FRAMES; f++)
+    {
+        drawRaster(textured);
+        const uint32_t* ns;
+        size_t tiles = hleRasterTileTimes(&ns);
+        for (size_t i = 0; i < tiles; i++)
+            total += ns[i];
+        spread[0] += schedule(ns, tiles, 2);
+        spread[1] += schedule(ns, tiles, HLE_RASTER_WORKERS + 1);
+    }
+    hleRasterProfile(false);
+    printf("  tile pool, tiles timed one by one: %.2f ms/frame of tiles, x%.2f on 1+1 cores, x%.2f on %d+1\n",
+           total / 1e6 / FRAMES, total / spread[0], total / spread[1], HLE_RASTER_WORKERS);
+    hleRasterShutdown();
+}
+
+// A floor from the bottom of the screen to a horizon, depth 1 to 16, with
+// the texture repeated by hand as a grid of quads
+static void perspective(int width, int height)
+{
+    const int side = 256, cells = 8;
+    std::vector<uint32_t> floorTexels(side * side), fb((size_t)width * height);
+    for (int i = 0; i < side * side; i++)
+        floorTexels[i] = ((i / side / 32 + i % side / 32) & 1 ? 0xffc0c0c0 : 0xff404040) ^ (i * 2654435761u >> 24);
+
+    std::vector<HLERASTERVERTEX> quads;
+    float horizon = height * 0.3f;
+    for (int j = 0; j < cells; j++)
+        for (int i = 0; i < cells; i++)
+        {
+            HLERASTERVERTEX q[4];
+            for (int k = 0; k < 4; k++)
+            {
+                float gx = (float)(i + (k == 1 || k == 2)) / cells - 0.5f;
+                float gz = (float)(j + (k >= 2)) / cells;
+                float w = 1.f + 15.f * gz;
+                q[k] = { width * 0.5f + gx * width * 2 / w, horizon + (height - horizon) / w, 255, 255, 255,
+                         (float)(k == 1 || k == 2), (float)(k >= 2), w };
+            }
+            quads.insert(quads.end(), { q[0], q[1], q[2], q[0], q[2], q[3] });
+        }
+
+    hleRasterInit(HLE_RASTER_WORKERS);
+    hleRasterTarget(fb.data(), width, height);
+    for (int bilinear = 0; bilinear < 2; bilinear++)
+    {
+        auto t0 = std::chrono::steady_clock::now();
+        for (int f = 0; f < FRAMES; f++)
+        {
+            const HLERASTERTEXTURE* tex = hleRasterTexture(floorTexels.data(), side, side);
+            hleRasterClear(0xff000000);
+            for (size_t i = 0; i < quads.size(); i += 3)
+                hleRasterTriangle(&quads[i], &quads[i + 1], &quads[i + 2], tex, bilinear);
+            hleRasterFlush();
+        }
+        double t = seconds(t0);
+        size_t covered = 0;
+        for (uint32_t p : fb)
+            covered += p != 0xff000000;
+        printf("%dx%d perspective floor, %s: %8.2f ms/frame  %7.1f Mpixel/s\n", width, height,
+               bilinear ? "bilinear" : "nearest ", t * 1000 / FRAMES, covered * FRAMES / t / 1e6);
+    }
+
+    // the same texels at new addresses each frame: hashed, found, not converted
+    std::vector<uint32_t> copy;
+    auto t0 = std::chrono::steady_clock::now();
+    for (int f = 0; f < FRAMES; f++)
+    {
+        copy = floorTexels;
+        hleRasterTexture(copy.data(), side, side);
+        hleRasterFlush();
+    }
+    double hit = seconds(t0);
+    t0 = std::chrono::steady_clock::now();
+    for (int f = 0; f < FRAMES; f++)
+    {
+        copy = floorTexels;
+        copy[0] = f;        // new contents: converted again
+        hleRasterTexture(copy.data(), side, side);
+        hleRasterFlush();
+    }
+    double miss = seconds(t0);
+    printf("%dx%d texture: cached %.3f ms, converted %.3f ms\n", side, side, hit * 1000 / FRAMES, miss * 1000 / FRAMES);
+    hleRasterShutdown();
+}
+
+int main()
+{
+#ifdef __SWITCH__
+    consoleInit(NULL);
+#endif
+    printf("%u hardware threads here; the %d+1 rows only gain on more than one\n",
+           std::thread::hardware_concurrency(), HLE_RASTER_WORKERS);
+    int wrong = exact(640, 480) + exact(1280, 720);
+
+    const SCENE scenes[] = {
+        { 640, 480, 20000, 16 },
+        { 640, 480, 2000, 96 },
+        { 1280, 720, 20000, 24 },
+        { 1280, 720, 500, 400 },
+    };
+    for (const SCENE& s : scenes)
+    {
+        run(s, false);
+        run(s, true);
+    }
+    perspective(1280, 720);
+    printf("%d wrong\n", wrong);
+#ifdef __SWITCH__
+    consoleUpdate(NULL);
+    consoleExit(NULL);
+#endif
+    return wrong != 0;
+}
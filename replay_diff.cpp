@@ -0,0 +1,90 @@
+// Compares two replay hash logs (iReplay.h): where CPU, video and audio part, and by how much
+
+#include <cstdio>
+#include <cstdint>
+#include <vector>
+#include "iReplay.h"
+
+struct HASHLOG {
+    REPLAYHASHHEADER        header;
+    std::vector<REPLAYHASH> frames;
+};
+
+static uint64_t part(const REPLAYHASH& hash, int s)
+{
+    return s == 0 ? hash.cpu : s == 1 ? hash.video : hash.audio;
+}
+
+static bool load(const char* path, HASHLOG* log)
+{
+    FILE* f = fopen(path, "rb");
+    if (!f)
+    {
+        printf("%s: cannot open\n", path);
+        return false;
+    }
+    bool ok = fread(&log->header, sizeof(log->header), 1, f) == 1 && log->header.magic == REPLAY_HASH_MAGIC &&
+              log->header.format == REPLAY_HASH_FORMAT;
+    if (ok)
+    {
+        log->frames.resize(log->header.frames);
+        ok = fread(log->frames.data(), sizeof(REPLAYHASH), log->frames.size(), f) == log->frames.size();
+    }
+    fclose(f);
+    if (!ok)
+        printf("%s: not a hash log, or cut short\n", path);
+    return ok;
+}
+
+int main(int argc, char* argv[])
+{
+    HASHLOG a, b;
+    if (argc != 3)
+    {
+        printf("replay_diff <first.hash> <second.hash>\n");
+        return 2;
+    }
+    if (!load(argv[1], &a) || !load(argv[2], &b))
+        return 2;
+    if (a.header.romSet != b.header.romSet)
+    {
+        printf("ROM sets %u and %u, nothing to compare\n", a.header.romSet, b.header.romSet);
+        return 2;
+    }
+
+    static const char* names[3] = { "CPU", "video", "audio" };
+    uint32_t frames = a.header.frames < b.header.frames ? a.header.frames : b.header.frames;
+    uint32_t first[3], count[3] = {};
+    int firstFrame = -1;
+    for (uint32_t f = 0; f < frames; f++)
+    {
+        for (int s = 0; s < 3; s++)
+            if (part(a.frames[f], s) != part(b.frames[f], s) && !count[s]++)
+                first[s] = f;
+        if (firstFrame < 0 && (count[0] || count[1] || count[2]))
+            firstFrame = (int)f;
+    }
+
+    printf("%s: %u frames, %s: %u frames, ROM set %u\n", argv[1], a.header.frames, argv[2], b.header.frames,
+           a.header.romSet);
+    if (firstFrame < 0)
+    {
+        printf("the first %u frames agree%s\n", frames,
+               a.header.frames != b.header.frames ? "; the longer log goes on past the other" : "");
+        return a.header.frames != b.header.frames;
+    }
+
+    printf("first difference: frame %d (", firstFrame);
+    for (int s = 0, n = 0; s < 3; s++)
+        if (count[s] && first[s] == (uint32_t)firstFrame)
+            printf("%s%s", n++ ? " " : "", names[s]);
+    printf(")\n");
+    for (int s = 0; s < 3; s++)
+    {
+        if (count[s])
+            printf("  %-5s from frame %u, %u of %u frames differ\n", names[s], first[s], count[s], frames);
+        else
+            printf("  %-5s the same throughout\n", names[s]);
+    }
+    return 1;
+}
@@ -0,0 +1,127 @@
+// audioResample check: CPU cost and THD+N over a stepped sine sweep
+
+#ifdef __SWITCH__
+#include <switch.h>
+#endif
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cmath>
+#include <chrono>
+#include "audioResample.h"
+
+#define IN_RATE     32000
+#define OUT_RATE    48000
+#define BLOCK       720             // output frames per run, as audioOut
+#define SETTLE      2               // blocks dropped while the history fills
+#define BLOCKS      24
+
+static int16_t input[AUDIO_RS_MAX_IN];
+static int16_t output[BLOCK * BLOCKS];
+
+// Resample a sine of freq Hz (amplitude 0.5 FS) with the step scaled by drc,
+// fit sin/cos/DC at the expected output frequency and return residual / fit
+// power in dB
+static double thdn(double freq, double drc)
+{
+    audioResampleInit(IN_RATE, OUT_RATE);
+    double level = 1024.0 * (1.0 + drc / AUDIO_RS_DRC_MAX);
+    for (int n = 0; n < 64; n++)
+        audioResampleControl((uint32_t)level, 1024);
+
+    double step = (double)IN_RATE / OUT_RATE * audioResampleScale();
+    double phase = 0;
+    for (int b = 0; b < BLOCKS; b++)
+    {
+        uint32_t count = audioResampleInput(BLOCK);
+        for (uint32_t i = 0; i < count; i++, phase += 2 * M_PI * freq / IN_RATE)
+            input[i] = (int16_t)lrint(16384.0 * sin(phase));
+        audioResampleRun(output + b * BLOCK, input, BLOCK);
+    }
+
+    // least squares against sin, cos and DC (3x3 normal equations)
+    double w = 2 * M_PI * freq / IN_RATE * step;
+    double m[3][4] = {};
+    int first = SETTLE * BLOCK, last = BLOCKS * BLOCK;
+    for (int k = first; k < last; k++)
+    {
+        double v[3] = { sin(w * k), cos(w * k), 1.0 };
+        for (int i = 0; i < 3; i++)
+        {
+            for (int j = 0; j < 3; j++)
+                m[i][j] += v[i] * v[j];
+            m[i][3] += v[i] * output[k];
+        }
+    }
+    for (int i = 0; i < 3; i++)
+        for (int r = 0; r < 3; r++)
+            if (r != i)
+            {
+                double f = m[r][i] / m[i][i];
+                for (int j = 0; j < 4; j++)
+                    m[r][j] -= f * m[i][j];
+            }
+    double a = m[0][3] / m[0][0], b = m[1][3] / m[1][1], dc = m[2][3] / m[2][2];
+
+    double sig = 0, err = 0;
+    for (int k = first; k < last; k++)
+    {
+        double fit = a * sin(w * k) + b * cos(w * k);
+        double e = output[k] - fit - dc;
+        sig += fit * fit;
+        err += e * e;
+    }
+    return 10 * log10(err / sig);
+}
+
+static void benchmark()
+{
+    audioResampleInit(IN_RATE, OUT_RATE);
+    for (int i = 0; i < AUDIO_RS_MAX_IN; i++)
+        input[i] = (int16_t)(rand() - RAND_MAX / 2);
+
+    const int seconds = 60;
+    const int runs = seconds * OUT_RATE / BLOCK;
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < runs; r++)
+    {
+        audioResampleControl(1000 + (r & 63), 1024);
+        audioResampleRun(output, input, BLOCK);
+    }
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    printf("cost: %d s of 48 kHz output in %.1f ms (%.3f%% of one core, %.1f ns/sample)\n",
+           seconds, ms, ms / (seconds * 10.0), ms * 1e6 / ((double)runs * BLOCK));
+}
+
+int main()
+{
+#ifdef __SWITCH__
+    consoleInit(NULL);
+#endif
+
+    printf("audioResample %d -> %d Hz, %d taps x %d phases\n\n", IN_RATE, OUT_RATE, AUDIO_RS_TAPS, AUDIO_RS_PHASES);
+    benchmark();
+
+    printf("\n  freq Hz   THD+N dB   (DRC -0.5%%)   (DRC +0.5%%)\n");
+    double worst = -200;
+    for (double f = 50; f <= 12800; f *= 1.4142135)
+    {
+        double mid = thdn(f, 0), lo = thdn(f, -AUDIO_RS_DRC_MAX), hi = thdn(f, AUDIO_RS_DRC_MAX);
+        printf("  %7.0f   %8.1f   %11.1f   %11.1f\n", f, mid, lo, hi);
+        worst = fmax(worst, fmax(mid, fmax(lo, hi)));
+    }
+    printf("\nworst THD+N %.1f dB\n", worst);
+
+#ifdef __SWITCH__
+    printf("\nPress + to exit.\n");
+    consoleUpdate(NULL);
+    while (appletMainLoop()) {
+        hidScanInput();
+        if (hidKeysDown(CONTROLLER_P1_AUTO) & KEY_PLUS) break;
+        consoleUpdate(NULL);
+    }
+    consoleExit(NULL);
+#endif
+    return 0;
+}
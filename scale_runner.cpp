@@ -0,0 +1,185 @@
+// videoScale check: every filter against a per-pixel reference, then its throughput
+
+#ifdef __SWITCH__
+#include <switch.h>
+#endif
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+#include "videoScale.h"
+
+#define W       VIDEO_WIDTH
+#define H       VIDEO_HEIGHT
+#define FRAMES  200
+
+static uint32_t px(const std::vector<uint32_t>& s, int x, int y)
+{
+    return s[std::clamp(y, 0, H - 1) * W + std::clamp(x, 0, W - 1)];
+}
+
+static int dist(uint32_t a, uint32_t b)
+{
+    int d = 0;
+    for (int s = 0; s < 24; s += 8)
+        d += abs((int)(a >> s & 0xff) - (int)(b >> s & 0xff));
+    return d;
+}
+
+static uint32_t avg(uint32_t a, uint32_t b)
+{
+    uint32_t r = 0;
+    for (int s = 0; s < 32; s += 8)
+        r |= (((a >> s & 0xff) + (b >> s & 0xff) + 1) >> 1) << s;
+    return r;
+}
+
+static uint32_t xbr(uint32_t E, uint32_t along, uint32_t across, uint32_t p, uint32_t q)
+{
+    if (along >= across)
+        return E;
+    return avg(E, dist(E, q) < dist(E, p) ? q : p);
+}
+
+static void reference(const VIDEOSCALE& sc, const std::vector<uint32_t>& s, std::vector<uint32_t>& d)
+{
+    int f = videoScaleFactor(&sc);
+    for (int y = 0; y < H; y++)
+        for (int x = 0; x < W; x++)
+        {
+            uint32_t A = px(s, x - 1, y - 1), B = px(s, x, y - 1), C = px(s, x + 1, y - 1);
+            uint32_t D = px(s, x - 1, y), E = px(s, x, y), F = px(s, x + 1, y);
+            uint32_t G = px(s, x - 1, y + 1), Hh = px(s, x, y + 1), I = px(s, x + 1, y + 1);
+            uint32_t o[16];
+            for (int i = 0; i < f * f; i++)
+                o[i] = E;
+            bool edge = B != Hh && D != F;
+            switch (sc.filter)
+            {
+                case VIDEO_SCALE_2X:
+                    if (edge)
+                    {
+                        o[0] = D == B ? D : E;
+                        o[1] = B == F ? F : E;
+                        o[2] = D == Hh ? D : E;
+                        o[3] = Hh == F ? F : E;
+                    }
+                    break;
+                case VIDEO_SCALE_3X:
+                    if (edge)
+                    {
+                        o[0] = D == B ? D : E;
+                        o[1] = (D == B && E != C) || (B == F && E != A) ? B : E;
+                        o[2] = B == F ? F : E;
+                        o[3] = (D == B && E != G) || (D == Hh && E != A) ? D : E;
+                        o[5] = (B == F && E != I) || (Hh == F && E != C) ? F : E;
+                        o[6] = D == Hh ? D : E;
+                        o[7] = (D == Hh && E != I) || (Hh == F && E != G) ? Hh : E;
+                        o[8] = Hh == F ? F : E;
+                    }
+                    break;
+                case VIDEO_SCALE_XBR:
+                    o[0] = xbr(E, dist(E, G) + dist(E, C) + 4 * dist(D, B), dist(F, B) + dist(Hh, D) + 4 * dist(E, A), D, B);
+                    o[1] = xbr(E, dist(E, I) + dist(E, A) + 4 * dist(F, B), dist(D, B) + dist(F, Hh) + 4 * dist(E, C), F, B);
+                    o[2] = xbr(E, dist(E, A) + dist(E, I) + 4 * dist(Hh, D), dist(F, Hh) + dist(D, B) + 4 * dist(E, G), D, Hh);
+                    o[3] = xbr(E, dist(E, C) + dist(E, G) + 4 * dist(F, Hh), dist(Hh, D) + dist(F, B) + 4 * dist(E, I), F, Hh);
+                    break;
+            }
+            for (int j = 0; j < f; j++)
+                for (int i = 0; i < f; i++)
+                {
+                    uint32_t p = o[j * f + i];
+                    if (sc.scanlines && f > 1 && j == f - 1)
+                        p = (p >> 1 & 0x007f7f7f) | (p & 0xff000000);
+                    d[(size_t)(y * f + j) * W * f + x * f + i] = p;
+                }
+        }
+}
+
+static double seconds(std::chrono::steady_clock::time_point t0)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+int main()
+{
+#ifdef __SWITCH__
+    consoleInit(NULL);
+#endif
+    static const uint32_t palette[4] = { 0xff000000, 0xff2040e0, 0xffe0c020, 0xffffffff };
+    std::vector<uint32_t> shapes(W * H), noise(W * H);
+    for (int y = 0; y < H; y++)
+        for (int x = 0; x < W; x++)
+        {
+            shapes[y * W + x] = palette[((x / 7 + y / 5) ^ (x * y / 97)) & 3];
+            noise[y * W + x] = 0xff000000 | ((uint32_t)rand() << 8 ^ (uint32_t)rand());
+        }
+
+    const VIDEOSCALE filters[] = {
+        { VIDEO_SCALE_NEAREST, 3, false }, { VIDEO_SCALE_NEAREST, 4, true }, { VIDEO_SCALE_NEAREST, 1, true },
+        { VIDEO_SCALE_2X, 0, false }, { VIDEO_SCALE_3X, 0, true }, { VIDEO_SCALE_XBR, 0, false },
+        { VIDEO_SCALE_XBR, 0, true },
+    };
+
+    videoScaleInit(VIDEO_SCALE_WORKERS);
+    for (const VIDEOSCALE& sc : filters)
+    {
+        int f = videoScaleFactor(&sc);
+        std::vector<uint32_t> got((size_t)W * H * f * f), want(got.size());
+        int bad = 0;
+        for (const std::vector<uint32_t>* src : { &shapes, &noise })
+        {
+            reference(sc, *src, want);
+            videoScaleImage(&sc, got.data(), (size_t)W * f, src->data(), W, H, nullptr);
+            for (size_t i = 0; i < got.size(); i++)
+                bad += got[i] != want[i];
+        }
+
+        auto t0 = std::chrono::steady_clock::now();
+        for (int i = 0; i < FRAMES; i++)
+            videoScaleRows(&sc, got.data(), (size_t)W * f, shapes.data(), W, H, 0, H);
+        double one = seconds(t0) / FRAMES;
+        t0 = std::chrono::steady_clock::now();
+        for (int i = 0; i < FRAMES; i++)
+            videoScaleImage(&sc, got.data(), (size_t)W * f, shapes.data(), W, H, nullptr);
+        double pool = seconds(t0) / FRAMES;
+
+        printf("%-8s %dx%s -> %4dx%-4d: %d wrong; one thread %.2f ms (%4.0f Mpix/s out), pool %.2f ms (%4.0f Mpix/s)\n",
+               videoScaleName(sc.filter), f, sc.scanlines ? "+scanlines" : "          ", W * f, H * f, bad,
+               one * 1e3, W * H * f * f / one / 1e6, pool * 1e3, W * H * f * f / pool / 1e6);
+    }
+
+    // a few rows changing, as on the attract screens
+    static VIDEOFRAME frame;
+    static uint16_t source[W * H];
+    VIDEOSCALE sc = { VIDEO_SCALE_XBR, 0, true };
+    std::vector<uint32_t> out((size_t)W * H * 4);
+    uint32_t serial = 0;
+    videoConvertReset(&frame);
+    int rows = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < FRAMES; i++)
+    {
+        for (int k = 0; k < 8; k++)
+            source[((i * 8 + k) * 29 % H) * W + k] ^= 0x421;
+        videoConvertFrame(&frame, source);
+        rows += videoScaleFrame(&sc, &frame, out.data(), &serial);
+    }
+    double partial = seconds(t0) / FRAMES;
+
+    std::vector<uint32_t> whole(out.size());
+    videoScaleImage(&sc, whole.data(), W * 2, frame.pixels, W, H, nullptr);
+    int stale = 0;
+    for (size_t i = 0; i < (size_t)W * H * 4; i++)
+        stale += out[i] != whole[i];
+    printf("xbr, 8 rows a frame change: %.2f ms a frame including conversion, %d rows scaled, %d pixels stale\n",
+           partial * 1e3, rows / FRAMES, stale);
+    videoScaleShutdown();
+#ifdef __SWITCH__
+    consoleUpdate(NULL);
+    consoleExit(NULL);
+#endif
+    return 0;
+}
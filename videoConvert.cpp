@@ -0,0 +1,101 @@
+#include <cstring>
+#include "videoConvert.h"
+
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// 5 bits to 8 by repeating the top bits into the bottom, so 31 is 255
+static inline uint32_t videoPixel(uint16_t p)
+{
+    uint32_t r = (p >> 10) & 0x1f, g = (p >> 5) & 0x1f, b = p & 0x1f;
+    r = (r << 3) | (r >> 2);
+    g = (g << 3) | (g >> 2);
+    b = (b << 3) | (b >> 2);
+    return r | (g << 8) | (b << 16) | 0xff000000;
+}
+
+// ---------------------- KERNELS ----------------------
+
+// Eight pixels a step: the channels are worked out in 16-bit lanes and
+// interleaved into RGBA on the store (NEON) or by unpacking (SSE2)
+void videoConvertLine(uint32_t* dst, const uint16_t* src, int count)
+{
+    int x = 0;
+#if defined(__aarch64__)
+    uint16x8_t mask = vdupq_n_u16(0xf8), low = vdupq_n_u16(0x07);
+    uint8x8_t alpha = vdup_n_u8(0xff);
+    for (; x + 8 <= count; x += 8)
+    {
+        uint16x8_t p = vld1q_u16(src + x);
+        uint16x8_t r = vorrq_u16(vandq_u16(vshrq_n_u16(p, 7), mask), vandq_u16(vshrq_n_u16(p, 12), low));
+        uint16x8_t g = vorrq_u16(vandq_u16(vshrq_n_u16(p, 2), mask), vandq_u16(vshrq_n_u16(p, 7), low));
+        uint16x8_t b = vorrq_u16(vandq_u16(vshlq_n_u16(p, 3), mask), vandq_u16(vshrq_n_u16(p, 2), low));
+        uint8x8x4_t rgba = { { vmovn_u16(r), vmovn_u16(g), vmovn_u16(b), alpha } };
+        vst4_u8((uint8_t*)(dst + x), rgba);
+    }
+#elif defined(__SSE2__)
+    __m128i mask = _mm_set1_epi16(0xf8), low = _mm_set1_epi16(0x07), alpha = _mm_set1_epi16((short)0xff00);
+    for (; x + 8 <= count; x += 8)
+    {
+        __m128i p = _mm_loadu_si128((const __m128i*)(src + x));
+        __m128i r = _mm_or_si128(_mm_and_si128(_mm_srli_epi16(p, 7), mask), _mm_and_si128(_mm_srli_epi16(p, 12), low));
+        __m128i g = _mm_or_si128(_mm_and_si128(_mm_srli_epi16(p, 2), mask), _mm_and_si128(_mm_srli_epi16(p, 7), low));
+        __m128i b = _mm_or_si128(_mm_and_si128(_mm_slli_epi16(p, 3), mask), _mm_and_si128(_mm_srli_epi16(p, 2), low));
+        __m128i rg = _mm_or_si128(r, _mm_slli_epi16(g, 8));
+        __m128i ba = _mm_or_si128(b, alpha);
+        _mm_storeu_si128((__m128i*)(dst + x), _mm_unpacklo_epi16(rg, ba));
+        _mm_storeu_si128((__m128i*)(dst + x + 4), _mm_unpackhi_epi16(rg, ba));
+    }
+#endif
+    for (; x < count; x++)
+        dst[x] = videoPixel(src[x]);
+}
+
+// ---------------------- FRAME ----------------------
+
+void videoConvertReset(VIDEOFRAME* frame)
+{
+    frame->valid = false;
+}
+
+int videoConvertFrame(VIDEOFRAME* frame, const uint16_t* source)
+{
+    const size_t lineBytes = VIDEO_WIDTH * sizeof(uint16_t);
+    int lines = 0;
+    frame->serial++;
+    for (int y = 0; y < VIDEO_HEIGHT; y++)
+    {
+        const uint16_t* src = source + y * VIDEO_WIDTH;
+        uint16_t* shadow = frame->shadow + y * VIDEO_WIDTH;
+        bool changed = !frame->valid || memcmp(src, shadow, lineBytes) != 0;
+        frame->dirty[y] = changed;
+        if (!changed)
+            continue;
+
+        memcpy(shadow, src, lineBytes);
+        videoConvertLine(frame->pixels + y * VIDEO_WIDTH, shadow, VIDEO_WIDTH);
+        frame->changed[y] = frame->serial;
+        lines++;
+    }
+    frame->dirtyLines = lines;
+    frame->valid = true;
+    return lines;
+}
+
+int videoConvertCopy(const VIDEOFRAME* frame, uint32_t* dst, uint32_t* serial)
+{
+    const size_t lineBytes = VIDEO_WIDTH * sizeof(uint32_t);
+    int lines = 0;
+    for (int y = 0; y < VIDEO_HEIGHT; y++)
+    {
+        if (frame->changed[y] <= *serial)
+            continue;
+        memcpy(dst + y * VIDEO_WIDTH, frame->pixels + y * VIDEO_WIDTH, lineBytes);
+        lines++;
+    }
+    *serial = frame->serial;
+    return lines;
+}
@@ -0,0 +1,42 @@
+#ifndef VIDEOCONVERT_H
+#define VIDEOCONVERT_H
+
+#include <cstdint>
+
+// The KI frame, 320x240 halfwords in SRAM as the blitter leaves them
+// (x1RRRRRGGGGGBBBBB, top bit unused), turned into RGBA8 for the display.
+//
+// A copy of the source as last converted is kept, and each frame a line is
+// compared against it before anything else is done: lines that have not
+// changed are neither converted nor marked for upload. Attract screens and
+// menus change a few lines a frame, or none. Comparing is exact, so a
+// restored state or a page flip can never leave a stale line.
+//
+// Every conversion is numbered, and each line remembers the number it last
+// changed in. Whoever keeps a copy of the pixels (a present buffer, say)
+// keeps the number it is up to and takes only the lines changed since.
+
+#define VIDEO_WIDTH     320
+#define VIDEO_HEIGHT    240
+
+struct VIDEOFRAME {
+    uint32_t pixels[VIDEO_WIDTH * VIDEO_HEIGHT];    // RGBA8
+    uint16_t shadow[VIDEO_WIDTH * VIDEO_HEIGHT];    // source as last converted
+    uint8_t  dirty[VIDEO_HEIGHT];                   // changed by the last videoConvertFrame
+    uint32_t changed[VIDEO_HEIGHT];                 // serial each line last changed in
+    uint32_t serial;                                // of the last videoConvertFrame, from 1
+    int      dirtyLines;
+    bool     valid;                                 // false: convert every line next time
+};
+
+extern void videoConvertReset(VIDEOFRAME* frame);
+extern int  videoConvertFrame(VIDEOFRAME* frame, const uint16_t* source);
+
+// Lines changed after *serial into a full frame copy at dst, *serial brought
+// up to date; 0 for a copy that has nothing. Returns the lines copied.
+extern int  videoConvertCopy(const VIDEOFRAME* frame, uint32_t* dst, uint32_t* serial);
+
+// One run of pixels; count need not be a multiple of anything
+extern void videoConvertLine(uint32_t* dst, const uint16_t* src, int count);
+
+#endif // VIDEOCONVERT_H
@@ -0,0 +1,127 @@
+#include <chrono>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include "videoPace.h"
+
+typedef std::chrono::steady_clock PACECLOCK;
+
+static const std::chrono::nanoseconds paceDefault(1000000000 / 60);
+static std::chrono::nanoseconds       pacePeriod = paceDefault;
+static bool                          paceSkip = false;
+
+static bool                  paceStarted = false;
+static PACECLOCK::time_point paceDeadline;      // when the next VSYNC is due
+static PACECLOCK::time_point paceLast;          // when the last VSYNC went back to emulating
+static int                   paceSkipRun = 0;
+
+static std::mutex            paceStatsLock;     // the CPU thread adds, the UI reads
+static VIDEOPACESTATS        paceStats;
+
+// ---------------------- CONFIG ----------------------
+
+void videoPaceConfig(uint32_t frameDelayMs, bool skip)
+{
+    pacePeriod = frameDelayMs ? std::chrono::nanoseconds(std::chrono::milliseconds(frameDelayMs)) : paceDefault;
+    paceSkip = skip;
+    paceStarted = false;
+}
+
+void videoPaceReset()
+{
+    paceStarted = false;
+}
+
+// ---------------------- PACING ----------------------
+
+static void videoPaceBucket(uint32_t* histogram, double ms)
+{
+    int b = (int)ms;
+    histogram[b < VIDEO_PACE_BUCKETS - 1 ? b : VIDEO_PACE_BUCKETS - 1]++;
+}
+
+bool videoPaceFrame()
+{
+    PACECLOCK::time_point now = PACECLOCK::now();
+    if (!paceStarted)
+    {
+        paceStarted = true;
+        paceDeadline = now + pacePeriod;
+        paceLast = now;
+        paceSkipRun = 0;
+        return true;
+    }
+
+    bool draw = true, late = false, resync = false;
+    if (now < paceDeadline)
+    {
+        std::this_thread::sleep_until(paceDeadline);
+        paceSkipRun = 0;
+    }
+    else
+    {
+        late = true;
+        PACECLOCK::duration behind = now - paceDeadline;
+        if (behind > pacePeriod * VIDEO_PACE_RESYNC)
+        {
+            paceDeadline = now;
+            resync = true;
+            paceSkipRun = 0;
+        }
+        // a quarter of a frame is jitter, not falling behind
+        else if (paceSkip && behind > pacePeriod / 4 && paceSkipRun < VIDEO_PACE_MAX_SKIP)
+        {
+            draw = false;
+            paceSkipRun++;
+        }
+        else
+            paceSkipRun = 0;
+    }
+    paceDeadline += pacePeriod;
+
+    PACECLOCK::time_point after = PACECLOCK::now();
+    double workMs = std::chrono::duration<double, std::milli>(now - paceLast).count();
+    double frameMs = std::chrono::duration<double, std::milli>(after - paceLast).count();
+    paceLast = after;
+
+    std::lock_guard<std::mutex> lock(paceStatsLock);
+    paceStats.frames++;
+    paceStats.drawn += draw;
+    paceStats.skipped += !draw;
+    paceStats.late += late;
+    paceStats.resyncs += resync;
+    videoPaceBucket(paceStats.work, workMs);
+    videoPaceBucket(paceStats.frame, frameMs);
+    if (frameMs > paceStats.worstMs)
+        paceStats.worstMs = frameMs;
+    return draw;
+}
+
+// ---------------------- STATS ----------------------
+
+void videoPaceStats(VIDEOPACESTATS* stats, bool clear)
+{
+    std::lock_guard<std::mutex> lock(paceStatsLock);
+    *stats = paceStats;
+    if (clear)
+        memset(&paceStats, 0, sizeof(paceStats));
+}
+
+// Upper edge of the bucket the q'th fraction of frames falls in, in ms
+double videoPaceQuantile(const uint32_t* histogram, double q)
+{
+    uint64_t total = 0;
+    for (int b = 0; b < VIDEO_PACE_BUCKETS; b++)
+        total += histogram[b];
+    if (!total)
+        return 0;
+
+    uint64_t seen = 0;
+    for (int b = 0; b < VIDEO_PACE_BUCKETS; b++)
+    {
+        seen += histogram[b];
+        if (seen >= q * total)
+            return b + 1;
+    }
+    return VIDEO_PACE_BUCKETS;
+}
@@ -0,0 +1,43 @@
+#ifndef VIDEOPACE_H
+#define VIDEOPACE_H
+
+#include <cstdint>
+
+// The one place that decides when a frame is due. The CPU thread calls
+// videoPaceFrame at every VSYNC: ahead of time it sleeps to the deadline,
+// behind it carries straight on, and with frame skip on it may answer that
+// the frame need not be drawn. Drawing is handing the frame to the presenter
+// thread (hlePresent), which shows it at the host's VSYNC; nothing here
+// waits for the display.
+//
+// Deadlines are whole periods from where pacing started, so a late frame is
+// made up by the ones after it instead of pushing every later one back. Far
+// enough behind (loading a state, a stall in the host) pacing starts over
+// from now rather than racing to catch up.
+
+#define VIDEO_PACE_MAX_SKIP     3       // frames left undrawn in a row at most
+#define VIDEO_PACE_RESYNC       6       // periods behind after which pacing starts over
+#define VIDEO_PACE_BUCKETS      24      // 1 ms each; the last holds everything longer
+
+struct VIDEOPACESTATS {
+    uint32_t frames;                        // VSYNCs paced
+    uint32_t drawn;
+    uint32_t skipped;
+    uint32_t late;                          // reached after their deadline
+    uint32_t resyncs;
+    uint32_t work[VIDEO_PACE_BUCKETS];      // emulating a frame, the wait left out
+    uint32_t frame[VIDEO_PACE_BUCKETS];     // VSYNC to VSYNC
+    double   worstMs;                       // longest VSYNC to VSYNC
+};
+
+// frameDelayMs as in CKIApp::m_FrameDelay, 0 for 60 Hz; skip as m_Skip
+extern void videoPaceConfig(uint32_t frameDelayMs, bool skip);
+extern void videoPaceReset();
+
+// CPU thread, at VSYNC; true when the frame should be drawn
+extern bool videoPaceFrame();
+
+extern void   videoPaceStats(VIDEOPACESTATS* stats, bool clear);
+extern double videoPaceQuantile(const uint32_t* histogram, double q);
+
+#endif // VIDEOPACE_H
@@ -0,0 +1,496 @@
+// Upscalers
+//
+// A source row is scaled from three rows (above, itself, below; repeated at
+// the top and bottom edges) four pixels at a time. The nine neighbours of
+// four pixels are nine unaligned loads, except in the first and last group
+// of a row, which are gathered with the edge pixel repeated. Results go out
+// interleaved: pixel x of the source is pixels x*f to x*f+f-1 of each of the
+// f output rows.
+//
+// Scale2x and Scale3x only compare colours for equality. The xBR distance is
+// the sum of absolute RGB differences; for the bottom right corner
+//
+//   e = d(E,C) + d(E,G) + 4 d(F,H)     how much changes along "/"
+//   i = d(D,H) + d(B,F) + 4 d(E,I)     how much changes along "\"
+//
+// and e < i means an edge runs along "/" between E and I, so that corner
+// takes the average of E and whichever of F and H is nearer to E. The other
+// three corners are the same mirrored.
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "videoScale.h"
+
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+static std::thread             scaleThreads[VIDEO_SCALE_WORKERS];
+static int                     scaleWorkers = 0;
+static std::mutex              scaleLock;             // handshake only
+static std::condition_variable scaleStart, scaleDone;
+static uint32_t                scaleGeneration = 0;
+static bool                    scaleQuit = false;
+static std::atomic<int>        scalePending(0);
+
+// The image being scaled and its bands
+static const VIDEOSCALE*                 scaleJob;
+static uint32_t*                         scaleDst;
+static size_t                            scaleDstStride;
+static const uint32_t*                   scaleSrc;
+static int                               scaleWidth, scaleHeight;
+static std::vector<std::pair<int, int>>  scaleBands;     // source rows, end not included
+static std::atomic<uint32_t>             scaleNext(0);
+
+// ---------------------- LANES ----------------------
+
+#if defined(__aarch64__)
+typedef uint32x4_t VIDEOU4;
+static inline VIDEOU4 u4Load(const uint32_t* p)             { return vld1q_u32(p); }
+static inline void    u4Store(uint32_t* p, VIDEOU4 a)       { vst1q_u32(p, a); }
+static inline VIDEOU4 u4Eq(VIDEOU4 a, VIDEOU4 b)            { return vceqq_u32(a, b); }
+static inline VIDEOU4 u4And(VIDEOU4 a, VIDEOU4 b)           { return vandq_u32(a, b); }
+static inline VIDEOU4 u4Or(VIDEOU4 a, VIDEOU4 b)            { return vorrq_u32(a, b); }
+static inline VIDEOU4 u4AndNot(VIDEOU4 a, VIDEOU4 b)        { return vbicq_u32(a, b); }
+static inline VIDEOU4 u4Select(VIDEOU4 m, VIDEOU4 a, VIDEOU4 b) { return vbslq_u32(m, a, b); }
+static inline VIDEOU4 u4Add(VIDEOU4 a, VIDEOU4 b)           { return vaddq_u32(a, b); }
+static inline VIDEOU4 u4Times4(VIDEOU4 a)                   { return vshlq_n_u32(a, 2); }
+static inline VIDEOU4 u4Less(VIDEOU4 a, VIDEOU4 b)          { return vcltq_s32(vreinterpretq_s32_u32(a), vreinterpretq_s32_u32(b)); }
+static inline VIDEOU4 u4Average(VIDEOU4 a, VIDEOU4 b)       { return vreinterpretq_u32_u8(vrhaddq_u8(vreinterpretq_u8_u32(a), vreinterpretq_u8_u32(b))); }
+static inline VIDEOU4 u4Distance(VIDEOU4 a, VIDEOU4 b)
+{
+    uint8x16_t d = vabdq_u8(vreinterpretq_u8_u32(a), vreinterpretq_u8_u32(b));
+    d = vandq_u8(d, vreinterpretq_u8_u32(vdupq_n_u32(0x00ffffff)));
+    return vpaddlq_u16(vpaddlq_u8(d));
+}
+static inline VIDEOU4 u4Half(VIDEOU4 a)
+{
+    return vorrq_u32(vandq_u32(vshrq_n_u32(a, 1), vdupq_n_u32(0x007f7f7f)), vandq_u32(a, vdupq_n_u32(0xff000000)));
+}
+static inline void u4Store2(uint32_t* p, VIDEOU4 a, VIDEOU4 b)                       { vst2q_u32(p, (uint32x4x2_t{ { a, b } })); }
+static inline void u4Store3(uint32_t* p, VIDEOU4 a, VIDEOU4 b, VIDEOU4 c)            { vst3q_u32(p, (uint32x4x3_t{ { a, b, c } })); }
+static inline void u4Store4(uint32_t* p, VIDEOU4 a, VIDEOU4 b, VIDEOU4 c, VIDEOU4 d) { vst4q_u32(p, (uint32x4x4_t{ { a, b, c, d } })); }
+#elif defined(__SSE2__)
+typedef __m128i VIDEOU4;
+static inline VIDEOU4 u4Load(const uint32_t* p)             { return _mm_loadu_si128((const __m128i*)p); }
+static inline void    u4Store(uint32_t* p, VIDEOU4 a)       { _mm_storeu_si128((__m128i*)p, a); }
+static inline VIDEOU4 u4Eq(VIDEOU4 a, VIDEOU4 b)            { return _mm_cmpeq_epi32(a, b); }
+static inline VIDEOU4 u4And(VIDEOU4 a, VIDEOU4 b)           { return _mm_and_si128(a, b); }
+static inline VIDEOU4 u4Or(VIDEOU4 a, VIDEOU4 b)            { return _mm_or_si128(a, b); }
+static inline VIDEOU4 u4AndNot(VIDEOU4 a, VIDEOU4 b)        { return _mm_andnot_si128(b, a); }
+static inline VIDEOU4 u4Select(VIDEOU4 m, VIDEOU4 a, VIDEOU4 b) { return _mm_or_si128(_mm_and_si128(m, a), _mm_andnot_si128(m, b)); }
+static inline VIDEOU4 u4Add(VIDEOU4 a, VIDEOU4 b)           { return _mm_add_epi32(a, b); }
+static inline VIDEOU4 u4Times4(VIDEOU4 a)                   { return _mm_slli_epi32(a, 2); }
+static inline VIDEOU4 u4Less(VIDEOU4 a, VIDEOU4 b)          { return _mm_cmplt_epi32(a, b); }
+static inline VIDEOU4 u4Average(VIDEOU4 a, VIDEOU4 b)       { return _mm_avg_epu8(a, b); }
+static inline VIDEOU4 u4Distance(VIDEOU4 a, VIDEOU4 b)
+{
+    // bytes 0 and 2, then byte 1, summed a lane at a time; alpha is masked off
+    __m128i d = _mm_and_si128(_mm_or_si128(_mm_subs_epu8(a, b), _mm_subs_epu8(b, a)), _mm_set1_epi32(0x00ffffff));
+    __m128i ones = _mm_set1_epi16(1), low = _mm_set1_epi32(0x00ff00ff);
+    return _mm_add_epi32(_mm_madd_epi16(_mm_and_si128(d, low), ones), _mm_madd_epi16(_mm_and_si128(_mm_srli_epi32(d, 8), low), ones));
+}
+static inline VIDEOU4 u4Half(VIDEOU4 a)
+{
+    return _mm_or_si128(_mm_and_si128(_mm_srli_epi32(a, 1), _mm_set1_epi32(0x007f7f7f)), _mm_and_si128(a, _mm_set1_epi32((int)0xff000000)));
+}
+static inline void u4Store2(uint32_t* p, VIDEOU4 a, VIDEOU4 b)
+{
+    _mm_storeu_si128((__m128i*)p, _mm_unpacklo_epi32(a, b));
+    _mm_storeu_si128((__m128i*)(p + 4), _mm_unpackhi_epi32(a, b));
+}
+static inline void u4Store3(uint32_t* p, VIDEOU4 a, VIDEOU4 b, VIDEOU4 c)
+{
+    alignas(16) uint32_t l[3][4];
+    _mm_store_si128((__m128i*)l[0], a);
+    _mm_store_si128((__m128i*)l[1], b);
+    _mm_store_si128((__m128i*)l[2], c);
+    for (int i = 0; i < 4; i++)
+    {
+        p[i * 3] = l[0][i];
+        p[i * 3 + 1] = l[1][i];
+        p[i * 3 + 2] = l[2][i];
+    }
+}
+static inline void u4Store4(uint32_t* p, VIDEOU4 a, VIDEOU4 b, VIDEOU4 c, VIDEOU4 d)
+{
+    __m128i ab0 = _mm_unpacklo_epi32(a, b), cd0 = _mm_unpacklo_epi32(c, d);
+    __m128i ab1 = _mm_unpackhi_epi32(a, b), cd1 = _mm_unpackhi_epi32(c, d);
+    _mm_storeu_si128((__m128i*)p, _mm_unpacklo_epi64(ab0, cd0));
+    _mm_storeu_si128((__m128i*)(p + 4), _mm_unpackhi_epi64(ab0, cd0));
+    _mm_storeu_si128((__m128i*)(p + 8), _mm_unpacklo_epi64(ab1, cd1));
+    _mm_storeu_si128((__m128i*)(p + 12), _mm_unpackhi_epi64(ab1, cd1));
+}
+#else
+struct VIDEOU4 { uint32_t v[4]; };
+#define VIDEO_LANES(expr) VIDEOU4 r; for (int i = 0; i < 4; i++) r.v[i] = (expr); return r
+static inline VIDEOU4 u4Load(const uint32_t* p)             { VIDEO_LANES(p[i]); }
+static inline void    u4Store(uint32_t* p, VIDEOU4 a)       { for (int i = 0; i < 4; i++) p[i] = a.v[i]; }
+static inline VIDEOU4 u4Eq(VIDEOU4 a, VIDEOU4 b)            { VIDEO_LANES(a.v[i] == b.v[i] ? ~0u : 0u); }
+static inline VIDEOU4 u4And(VIDEOU4 a, VIDEOU4 b)           { VIDEO_LANES(a.v[i] & b.v[i]); }
+static inline VIDEOU4 u4Or(VIDEOU4 a, VIDEOU4 b)            { VIDEO_LANES(a.v[i] | b.v[i]); }
+static inline VIDEOU4 u4AndNot(VIDEOU4 a, VIDEOU4 b)        { VIDEO_LANES(a.v[i] & ~b.v[i]); }
+static inline VIDEOU4 u4Select(VIDEOU4 m, VIDEOU4 a, VIDEOU4 b) { VIDEO_LANES((m.v[i] & a.v[i]) | (~m.v[i] & b.v[i])); }
+static inline VIDEOU4 u4Add(VIDEOU4 a, VIDEOU4 b)           { VIDEO_LANES(a.v[i] + b.v[i]); }
+static inline VIDEOU4 u4Times4(VIDEOU4 a)                   { VIDEO_LANES(a.v[i] << 2); }
+static inline VIDEOU4 u4Less(VIDEOU4 a, VIDEOU4 b)          { VIDEO_LANES((int32_t)a.v[i] < (int32_t)b.v[i] ? ~0u : 0u); }
+static inline uint32_t videoAverage(uint32_t a, uint32_t b)
+{
+    uint32_t r = 0;
+    for (int s = 0; s < 32; s += 8)
+        r |= (((a >> s & 0xff) + (b >> s & 0xff) + 1) >> 1) << s;
+    return r;
+}
+static inline uint32_t videoDistance(uint32_t a, uint32_t b)
+{
+    uint32_t r = 0;
+    for (int s = 0; s < 24; s += 8)
+        r += (uint32_t)abs((int)(a >> s & 0xff) - (int)(b >> s & 0xff));
+    return r;
+}
+static inline VIDEOU4 u4Average(VIDEOU4 a, VIDEOU4 b)       { VIDEO_LANES(videoAverage(a.v[i], b.v[i])); }
+static inline VIDEOU4 u4Distance(VIDEOU4 a, VIDEOU4 b)      { VIDEO_LANES(videoDistance(a.v[i], b.v[i])); }
+static inline VIDEOU4 u4Half(VIDEOU4 a)                     { VIDEO_LANES((a.v[i] >> 1 & 0x007f7f7f) | (a.v[i] & 0xff000000)); }
+#undef VIDEO_LANES
+static inline void u4Store2(uint32_t* p, VIDEOU4 a, VIDEOU4 b)
+{
+    for (int i = 0; i < 4; i++) { p[i * 2] = a.v[i]; p[i * 2 + 1] = b.v[i]; }
+}
+static inline void u4Store3(uint32_t* p, VIDEOU4 a, VIDEOU4 b, VIDEOU4 c)
+{
+    for (int i = 0; i < 4; i++) { p[i * 3] = a.v[i]; p[i * 3 + 1] = b.v[i]; p[i * 3 + 2] = c.v[i]; }
+}
+static inline void u4Store4(uint32_t* p, VIDEOU4 a, VIDEOU4 b, VIDEOU4 c, VIDEOU4 d)
+{
+    for (int i = 0; i < 4; i++) { p[i * 4] = a.v[i]; p[i * 4 + 1] = b.v[i]; p[i * 4 + 2] = c.v[i]; p[i * 4 + 3] = d.v[i]; }
+}
+#endif
+
+static inline VIDEOU4 u4Not(VIDEOU4 a)
+{
+    return u4AndNot(u4Eq(a, a), a);
+}
+
+// ---------------------- NEIGHBOURS ----------------------
+
+enum { NA, NB, NC, ND, NE, NF, NG, NH, NI };
+
+// A B C
+// D E F    for the four pixels from x; off the row the edge pixel repeats
+// G H I
+static inline void videoNeighbours(const uint32_t* const* rows, int x, int width, VIDEOU4* n)
+{
+    if (x > 0 && x + 5 <= width)
+    {
+        for (int r = 0; r < 3; r++)
+        {
+            n[r * 3] = u4Load(rows[r] + x - 1);
+            n[r * 3 + 1] = u4Load(rows[r] + x);
+            n[r * 3 + 2] = u4Load(rows[r] + x + 1);
+        }
+        return;
+    }
+
+    alignas(16) uint32_t line[6];
+    for (int r = 0; r < 3; r++)
+    {
+        for (int i = 0; i < 6; i++)
+            line[i] = rows[r][std::clamp(x - 1 + i, 0, width - 1)];
+        n[r * 3] = u4Load(line);
+        n[r * 3 + 1] = u4Load(line + 1);
+        n[r * 3 + 2] = u4Load(line + 2);
+    }
+}
+
+// ---------------------- FILTERS ----------------------
+
+static void videoNearestRow(uint32_t* const* out, int f, const uint32_t* src, int width)
+{
+    for (int x = 0; x < width; x += 4)
+    {
+        VIDEOU4 p = u4Load(src + x);
+        switch (f)
+        {
+            case 1: u4Store(out[0] + x, p); break;
+            case 2: u4Store2(out[0] + x * 2, p, p); break;
+            case 3: u4Store3(out[0] + x * 3, p, p, p); break;
+            default: u4Store4(out[0] + x * 4, p, p, p, p); break;
+        }
+    }
+    for (int k = 1; k < f; k++)
+        memcpy(out[k], out[0], (size_t)width * f * sizeof(uint32_t));
+}
+
+static void videoScale2xRow(uint32_t* const* out, const uint32_t* const* rows, int width)
+{
+    VIDEOU4 n[9];
+    for (int x = 0; x < width; x += 4)
+    {
+        videoNeighbours(rows, x, width, n);
+        VIDEOU4 e = n[NE];
+        VIDEOU4 edge = u4Not(u4Or(u4Eq(n[NB], n[NH]), u4Eq(n[ND], n[NF])));
+        VIDEOU4 db = u4And(edge, u4Eq(n[ND], n[NB]));
+        VIDEOU4 bf = u4And(edge, u4Eq(n[NB], n[NF]));
+        VIDEOU4 dh = u4And(edge, u4Eq(n[ND], n[NH]));
+        VIDEOU4 hf = u4And(edge, u4Eq(n[NH], n[NF]));
+        u4Store2(out[0] + x * 2, u4Select(db, n[ND], e), u4Select(bf, n[NF], e));
+        u4Store2(out[1] + x * 2, u4Select(dh, n[ND], e), u4Select(hf, n[NF], e));
+    }
+}
+
+static void videoScale3xRow(uint32_t* const* out, const uint32_t* const* rows, int width)
+{
+    VIDEOU4 n[9];
+    for (int x = 0; x < width; x += 4)
+    {
+        videoNeighbours(rows, x, width, n);
+        VIDEOU4 e = n[NE];
+        VIDEOU4 edge = u4Not(u4Or(u4Eq(n[NB], n[NH]), u4Eq(n[ND], n[NF])));
+        VIDEOU4 db = u4And(edge, u4Eq(n[ND], n[NB]));
+        VIDEOU4 bf = u4And(edge, u4Eq(n[NB], n[NF]));
+        VIDEOU4 dh = u4And(edge, u4Eq(n[ND], n[NH]));
+        VIDEOU4 hf = u4And(edge, u4Eq(n[NH], n[NF]));
+        VIDEOU4 ea = u4Eq(e, n[NA]), ec = u4Eq(e, n[NC]), eg = u4Eq(e, n[NG]), ei = u4Eq(e, n[NI]);
+
+        VIDEOU4 e1 = u4Or(u4AndNot(db, ec), u4AndNot(bf, ea));
+        VIDEOU4 e3 = u4Or(u4AndNot(db, eg), u4AndNot(dh, ea));
+        VIDEOU4 e5 = u4Or(u4AndNot(bf, ei), u4AndNot(hf, ec));
+        VIDEOU4 e7 = u4Or(u4AndNot(dh, ei), u4AndNot(hf, eg));
+        u4Store3(out[0] + x * 3, u4Select(db, n[ND], e), u4Select(e1, n[NB], e), u4Select(bf, n[NF], e));
+        u4Store3(out[1] + x * 3, u4Select(e3, n[ND], e), e, u4Select(e5, n[NF], e));
+        u4Store3(out[2] + x * 3, u4Select(dh, n[ND], e), u4Select(e7, n[NH], e), u4Select(hf, n[NF], e));
+    }
+}
+
+// One corner: p and q the two neighbours beside it, across the nearer of
+// which the corner is blended when along (e) changes less than across (i)
+static inline VIDEOU4 videoXbrCorner(VIDEOU4 e, VIDEOU4 along, VIDEOU4 across,
+                                     VIDEOU4 p, VIDEOU4 q, VIDEOU4 dp, VIDEOU4 dq)
+{
+    VIDEOU4 nearer = u4Select(u4Less(dq, dp), q, p);
+    return u4Select(u4Less(along, across), u4Average(e, nearer), e);
+}
+
+static void videoXbrRow(uint32_t* const* out, const uint32_t* const* rows, int width)
+{
+    VIDEOU4 n[9];
+    for (int x = 0; x < width; x += 4)
+    {
+        videoNeighbours(rows, x, width, n);
+        VIDEOU4 e = n[NE];
+        VIDEOU4 ea = u4Distance(e, n[NA]), eb = u4Distance(e, n[NB]), ec = u4Distance(e, n[NC]);
+        VIDEOU4 ed = u4Distance(e, n[ND]), ef = u4Distance(e, n[NF]);
+        VIDEOU4 eg = u4Distance(e, n[NG]), eh = u4Distance(e, n[NH]), ei = u4Distance(e, n[NI]);
+        VIDEOU4 fh = u4Distance(n[NF], n[NH]), hd = u4Distance(n[NH], n[ND]);
+        VIDEOU4 fb = u4Distance(n[NF], n[NB]), db = u4Distance(n[ND], n[NB]);
+
+        VIDEOU4 tl = videoXbrCorner(e, u4Add(u4Add(eg, ec), u4Times4(db)), u4Add(u4Add(fb, hd), u4Times4(ea)),
+                                    n[ND], n[NB], ed, eb);
+        VIDEOU4 tr = videoXbrCorner(e, u4Add(u4Add(ei, ea), u4Times4(fb)), u4Add(u4Add(db, fh), u4Times4(ec)),
+                                    n[NF], n[NB], ef, eb);
+        VIDEOU4 bl = videoXbrCorner(e, u4Add(u4Add(ea, ei), u4Times4(hd)), u4Add(u4Add(fh, db), u4Times4(eg)),
+                                    n[ND], n[NH], ed, eh);
+        VIDEOU4 br = videoXbrCorner(e, u4Add(u4Add(ec, eg), u4Times4(fh)), u4Add(u4Add(hd, fb), u4Times4(ei)),
+                                    n[NF], n[NH], ef, eh);
+        u4Store2(out[0] + x * 2, tl, tr);
+        u4Store2(out[1] + x * 2, bl, br);
+    }
+}
+
+static void videoScanline(uint32_t* row, int count)
+{
+    for (int x = 0; x < count; x += 4)
+        u4Store(row + x, u4Half(u4Load(row + x)));
+}
+
+// ---------------------- ROWS ----------------------
+
+int videoScaleFactor(const VIDEOSCALE* scale)
+{
+    switch (scale->filter)
+    {
+        case VIDEO_SCALE_2X:  return 2;
+        case VIDEO_SCALE_3X:  return 3;
+        case VIDEO_SCALE_XBR: return 2;
+        default:
+            return std::clamp(scale->factor, scale->scanlines ? 2 : 1, VIDEO_SCALE_MAX);
+    }
+}
+
+const char* videoScaleName(int filter)
+{
+    static const char* names[VIDEO_SCALE_FILTERS] = { "nearest", "scale2x", "scale3x", "xbr" };
+    return filter >= 0 && filter < VIDEO_SCALE_FILTERS ? names[filter] : "?";
+}
+
+void videoScaleRows(const VIDEOSCALE* scale, uint32_t* dst, size_t dstStride,
+                    const uint32_t* src, int width, int height, int y0, int y1)
+{
+    if (width % 4)
+    {
+        printf("Scale: width %d is not a multiple of 4\n", width);
+        return;
+    }
+
+    int f = videoScaleFactor(scale);
+    for (int y = y0; y < y1; y++)
+    {
+        const uint32_t* rows[3] = {
+            src + (size_t)std::max(y - 1, 0) * width,
+            src + (size_t)y * width,
+            src + (size_t)std::min(y + 1, height - 1) * width,
+        };
+        uint32_t* out[VIDEO_SCALE_MAX];
+        for (int k = 0; k < f; k++)
+            out[k] = dst + ((size_t)y * f + k) * dstStride;
+
+        switch (scale->filter)
+        {
+            case VIDEO_SCALE_2X:  videoScale2xRow(out, rows, width); break;
+            case VIDEO_SCALE_3X:  videoScale3xRow(out, rows, width); break;
+            case VIDEO_SCALE_XBR: videoXbrRow(out, rows, width); break;
+            default:              videoNearestRow(out, f, rows[1], width); break;
+        }
+        if (scale->scanlines && f > 1)
+            videoScanline(out[f - 1], width * f);
+    }
+}
+
+// ---------------------- POOL ----------------------
+
+static void videoScaleWork()
+{
+    for (;;)
+    {
+        uint32_t i = scaleNext.fetch_add(1, std::memory_order_relaxed);
+        if (i >= scaleBands.size())
+            return;
+        videoScaleRows(scaleJob, scaleDst, scaleDstStride, scaleSrc, scaleWidth, scaleHeight,
+                       scaleBands[i].first, scaleBands[i].second);
+    }
+}
+
+static void videoScaleWorker()
+{
+    uint32_t seen = 0;
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(scaleLock);
+            scaleStart.wait(lock, [&] { return scaleQuit || scaleGeneration != seen; });
+            if (scaleQuit)
+                return;
+            seen = scaleGeneration;
+        }
+        videoScaleWork();
+        if (scalePending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            std::lock_guard<std::mutex> lock(scaleLock);
+            scaleDone.notify_one();
+        }
+    }
+}
+
+bool videoScaleInit(int workers)
+{
+    videoScaleShutdown();
+    scaleWorkers = std::clamp(workers, 0, VIDEO_SCALE_WORKERS);
+    for (int i = 0; i < scaleWorkers; i++)
+        scaleThreads[i] = std::thread(videoScaleWorker);
+    return true;
+}
+
+void videoScaleShutdown()
+{
+    {
+        std::lock_guard<std::mutex> lock(scaleLock);
+        scaleQuit = true;
+    }
+    scaleStart.notify_all();
+    for (int i = 0; i < scaleWorkers; i++)
+        scaleThreads[i].join();
+    scaleWorkers = 0;
+    scaleQuit = false;
+}
+
+int videoScaleImage(const VIDEOSCALE* scale, uint32_t* dst, size_t dstStride,
+                    const uint32_t* src, int width, int height, const uint8_t* rows)
+{
+    // runs of flagged rows, cut into bands
+    scaleBands.clear();
+    int count = 0;
+    for (int y = 0; y < height;)
+    {
+        if (rows && !rows[y])
+        {
+            y++;
+            continue;
+        }
+        int end = y + 1;
+        while (end < height && end - y < VIDEO_SCALE_BAND && (!rows || rows[end]))
+            end++;
+        scaleBands.emplace_back(y, end);
+        count += end - y;
+        y = end;
+    }
+    if (!count)
+        return 0;
+
+    scaleJob = scale;
+    scaleDst = dst;
+    scaleDstStride = dstStride;
+    scaleSrc = src;
+    scaleWidth = width;
+    scaleHeight = height;
+    scaleNext.store(0, std::memory_order_relaxed);
+
+    // one band is not worth waking anyone for
+    int helpers = scaleBands.size() > 1 ? scaleWorkers : 0;
+    if (helpers)
+    {
+        scalePending.store(helpers, std::memory_order_relaxed);
+        {
+            std::lock_guard<std::mutex> lock(scaleLock);
+            scaleGeneration++;
+        }
+        scaleStart.notify_all();
+    }
+
+    videoScaleWork();
+
+    if (helpers)
+    {
+        std::unique_lock<std::mutex> lock(scaleLock);
+        scaleDone.wait(lock, [] { return scalePending.load(std::memory_order_acquire) == 0; });
+    }
+    return count;
+}
+
+int videoScaleFrame(const VIDEOSCALE* scale, const VIDEOFRAME* frame, uint32_t* dst, uint32_t* serial)
+{
+    int f = videoScaleFactor(scale);
+    if (f == 1)
+        return videoConvertCopy(frame, dst, serial);
+
+    // the filters that read a row's neighbours change when those do
+    int reach = scale->filter == VIDEO_SCALE_NEAREST ? 0 : 1;
+    uint8_t rows[VIDEO_HEIGHT];
+    for (int y = 0; y < VIDEO_HEIGHT; y++)
+    {
+        rows[y] = 0;
+        for (int k = std::max(y - reach, 0); k <= std::min(y + reach, VIDEO_HEIGHT - 1); k++)
+            rows[y] |= frame->changed[k] > *serial;
+    }
+    *serial = frame->serial;
+    return videoScaleImage(scale, dst, (size_t)VIDEO_WIDTH * f, frame->pixels, VIDEO_WIDTH, VIDEO_HEIGHT, rows);
+}
@@ -0,0 +1,61 @@
+#ifndef VIDEOSCALE_H
+#define VIDEOSCALE_H
+
+#include <cstddef>
+#include <cstdint>
+#include "videoConvert.h"
+
+// Upscalers for the 320-wide KI frame, run on the CPU so the display gets a
+// picture at panel size instead of scaling it however it likes.
+//
+//   NEAREST   every pixel repeated, 1x to 4x
+//   2X, 3X    Scale2x / Scale3x (AdvMAME): edges between two flat colours
+//             are redrawn along the diagonal, nothing is blended
+//   XBR       2x, a 3x3 xBR: a corner is blended halfway toward the
+//             neighbour across an edge, when the colour distances say the
+//             edge runs along that diagonal rather than across it
+//
+// Scanlines darken the last output row of every source row to half, as the
+// cabinet's monitor does; they need 2x at least, so NEAREST 1x goes to 2x.
+//
+// Every filter works four source pixels at a time in vector lanes. A frame
+// is split into bands of source rows that a small pool takes one at a time;
+// the calling thread takes bands too. Rows only depend on the source, so
+// the bands need nothing from each other.
+
+#define VIDEO_SCALE_WORKERS   2         // besides the calling thread
+#define VIDEO_SCALE_MAX       4         // largest NEAREST factor
+#define VIDEO_SCALE_BAND      16        // source rows a pool job takes
+
+enum { VIDEO_SCALE_NEAREST, VIDEO_SCALE_2X, VIDEO_SCALE_3X, VIDEO_SCALE_XBR, VIDEO_SCALE_FILTERS };
+
+struct VIDEOSCALE {
+    int  filter;
+    int  factor;        // NEAREST only; the others have their own
+    bool scanlines;
+};
+
+extern bool videoScaleInit(int workers);
+extern void videoScaleShutdown();
+
+extern int         videoScaleFactor(const VIDEOSCALE* scale);  // output pixels per source pixel, each way
+extern const char* videoScaleName(int filter);
+
+// Source rows y0 to y1 (not included) of a width x height RGBA8 image into
+// dst, factor times the size with dstStride pixels a row. Reads the rows
+// either side for the filters that look at neighbours. Width must be a
+// multiple of 4. Any thread.
+extern void videoScaleRows(const VIDEOSCALE* scale, uint32_t* dst, size_t dstStride,
+                           const uint32_t* src, int width, int height, int y0, int y1);
+
+// The rows flagged in rows (every row for nullptr), split over the pool;
+// one caller at a time. Returns the source rows scaled.
+extern int videoScaleImage(const VIDEOSCALE* scale, uint32_t* dst, size_t dstStride,
+                           const uint32_t* src, int width, int height, const uint8_t* rows);
+
+// The KI frame into a full-size copy at dst that is up to *serial (see
+// videoConvertCopy): rows changed since, and the rows next to them for the
+// filters that read those, are scaled again. Returns the source rows scaled.
+extern int videoScaleFrame(const VIDEOSCALE* scale, const VIDEOFRAME* frame, uint32_t* dst, uint32_t* serial);
+
+#endif // VIDEOSCALE_H
@@ -0,0 +1,112 @@
+// videoConvert check: every pixel value against a reference, then the cost per frame
+
+#ifdef __SWITCH__
+#include <switch.h>
+#endif
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <chrono>
+#include "videoConvert.h"
+
+#define FRAMES  2000
+
+static VIDEOFRAME frame;
+static uint16_t   source[VIDEO_WIDTH * VIDEO_HEIGHT];
+static uint32_t   reference[VIDEO_WIDTH * VIDEO_HEIGHT];
+
+// what converting a pixel at a time looks like
+static uint32_t referencePixel(uint16_t p)
+{
+    uint32_t r = (p >> 10) & 0x1f, g = (p >> 5) & 0x1f, b = p & 0x1f;
+    return ((r * 255 + 15) / 31) | ((g * 255 + 15) / 31) << 8 | ((b * 255 + 15) / 31) << 16 | 0xff000000;
+}
+
+static double seconds(std::chrono::steady_clock::time_point t0)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+// channels more than one apart; bit replication and rounding differ by one
+static bool differs(uint32_t a, uint32_t b)
+{
+    for (int s = 0; s < 32; s += 8)
+        if (abs((int)(a >> s & 0xff) - (int)(b >> s & 0xff)) > 1)
+            return true;
+    return false;
+}
+
+static int check()
+{
+    static uint16_t all[65536];
+    static uint32_t out[65536];
+    for (int i = 0; i < 65536; i++)
+        all[i] = (uint16_t)i;
+    videoConvertLine(out, all, 65536);
+
+    int bad = 0;
+    for (int i = 0; i < 65536; i++)
+        bad += differs(out[i], referencePixel((uint16_t)i));
+    return bad;
+}
+
+int main()
+{
+#ifdef __SWITCH__
+    consoleInit(NULL);
+#endif
+    printf("pixel values off by more than one: %d of 65536\n", check());
+
+    for (int i = 0; i < VIDEO_WIDTH * VIDEO_HEIGHT; i++)
+        source[i] = (uint16_t)(rand() & 0x7fff);
+
+    volatile uint32_t sink = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    for (int f = 0; f < FRAMES; f++)
+    {
+        source[f % (VIDEO_WIDTH * VIDEO_HEIGHT)] ^= 1;
+        for (int i = 0; i < VIDEO_WIDTH * VIDEO_HEIGHT; i++)
+            reference[i] = referencePixel(source[i]);
+        sink = sink + reference[f];
+    }
+    double scalar = seconds(t0);
+
+    int lines = 0;
+    t0 = std::chrono::steady_clock::now();
+    for (int f = 0; f < FRAMES; f++)
+    {
+        videoConvertReset(&frame);
+        lines += videoConvertFrame(&frame, source);
+    }
+    double full = seconds(t0);
+    printf("every line new : %7.1f us/frame (%d lines), per-pixel %7.1f us/frame\n",
+           full * 1e6 / FRAMES, lines / FRAMES, scalar * 1e6 / FRAMES);
+
+    lines = 0;
+    t0 = std::chrono::steady_clock::now();
+    for (int f = 0; f < FRAMES; f++)
+    {
+        for (int k = 0; k < 8; k++)
+            source[((f * 8 + k) * 29 % VIDEO_HEIGHT) * VIDEO_WIDTH + k] ^= 0x421;
+        lines += videoConvertFrame(&frame, source);
+    }
+    double attract = seconds(t0);
+    printf("8 lines change : %7.1f us/frame (%d lines)\n", attract * 1e6 / FRAMES, lines / FRAMES);
+
+    lines = 0;
+    t0 = std::chrono::steady_clock::now();
+    for (int f = 0; f < FRAMES; f++)
+        lines += videoConvertFrame(&frame, source);
+    double still = seconds(t0);
+    printf("nothing changes: %7.1f us/frame (%d lines)\n", still * 1e6 / FRAMES, lines / FRAMES);
+
+    int stale = 0;
+    for (int i = 0; i < VIDEO_WIDTH * VIDEO_HEIGHT; i++)
+        stale += differs(frame.pixels[i], referencePixel(source[i]));
+    printf("pixels left stale: %d\n", stale);
+#ifdef __SWITCH__
+    consoleUpdate(NULL);
+    consoleExit(NULL);
+#endif
+    return 0;
+}
@@ -16,18 +16,24 @@
 ***************************************************************************/
 
 /* PROTOTYPES */
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
 #include "stdafx.h"
 #include "math.h"
 
 #include "global.h"
 
 #include <mmsystem.h>
+#include "windowsx.h"
+#endif
 #include "wave.h"
 //#include "debug.h"
-#include "windowsx.h"
 
 extern "C" {
 
+#ifdef _WIN32
 /* ROUTINES */
 /* -------------------------------------------------------*/
 
@@ -314,121 +320,81 @@ int WaveCloseReadFile(
 	
 }
 
+#endif // _WIN32
+
+/*      The writing half goes through stdio rather than mmio, so it builds on every host.  The file
+comes out as it always did: RIFF 'WAVE', then 'fmt ', a 'fact' chunk and 'data'.  The sizes and the
+fact sample count are left zero and filled in by WaveCloseWriteFile, which seeks back to them.
+*/
+
+static int WavePut(FILE *file, const void *pv, uint32_t cb)
+{
+	return fwrite(pv, 1, cb, file) == cb ? 0 : ER_CANNOTWRITE;
+}
+
+static int WavePut32(FILE *file, uint32_t dw)
+{
+	return WavePut(file, &dw, sizeof(dw));
+}
+
 /*      This routine will create a wave file for writing.  This will automatically overwrite any
 existing file with the same name, so be careful and check before hand!!!
 pszFileName     - Pointer to filename to write.
-phmmioOut               - Pointer to HMMIO handle that is used for further writes
-pwfxDest                - Valid waveformatex destination structure.
-pckOut                  - Pointer to be set with the MMCKINFO.
-pckOutRIFF              - Pointer to be set with the RIFF info.
+pwfOut          - Writer state, used for further writes.
+pwfxDest        - Valid waveformatex destination structure.
 
 */
 int WaveCreateFile(
-				   TCHAR*pszFileName,                              // (IN)
-				   HMMIO *phmmioOut,                               // (OUT)
-				   WAVEFORMATEX *pwfxDest,                 // (IN)
-				   MMCKINFO *pckOut,                               // (OUT)
-				   MMCKINFO *pckOutRIFF                    // (OUT)
-				   
+				   const char *pszFileName,                 // (IN)
+				   WAVEFILE *pwfOut,                        // (OUT)
+				   const WAVEFORMATEX *pwfxDest             // (IN)
 				   )
 {
 	
 	int             nError;                         // Return value.
-	DWORD           dwFactChunk;            // Contains the actual fact chunk. Garbage until WaveCloseWriteFile.
-	MMCKINFO        ckOut1;
+	uint32_t        cbFormat;
 	
-	dwFactChunk = (DWORD)-1;
+	memset(pwfOut, 0, sizeof(*pwfOut));
 	nError = 0;
 	
-	*phmmioOut = mmioOpen(pszFileName, NULL,
-		MMIO_ALLOCBUF | MMIO_READWRITE|MMIO_CREATE);
-	
-    if (*phmmioOut == NULL)
+	pwfOut->file = fopen(pszFileName, "wb");
+	if (pwfOut->file == NULL)
 	{
 		nError = ER_CANNOTWRITE;
 		goto ERROR_CANNOT_WRITE;    // cannot save WAVE file
 	}
 	
-    /* Create the output file RIFF chunk of form type 'WAVE'.
-	*/
-    pckOutRIFF->fccType = mmioFOURCC('W', 'A', 'V', 'E');       
-	pckOutRIFF->cksize = 0; 
-    if ((nError = mmioCreateChunk(*phmmioOut, pckOutRIFF, MMIO_CREATERIFF)) != 0)
-	{
-		goto ERROR_CANNOT_WRITE;    // cannot write file, probably
-	}
-	
-    /* We are now descended into the 'RIFF' chunk we just created.
-	* Now create the 'fmt ' chunk. Since we know the size of this chunk,
-	* specify it in the MMCKINFO structure so MMIO doesn't have to seek
-	* back and set the chunk size after ascending from the chunk.
-	*/
-    pckOut->ckid = mmioFOURCC('f', 'm', 't', ' ');
-    pckOut->cksize = sizeof(PCMWAVEFORMAT);   // we know the size of this ck.
-    if ((nError = mmioCreateChunk(*phmmioOut, pckOut, 0)) != 0)
-	{
-		goto ERROR_CANNOT_WRITE;    // cannot write file, probably
-	}
-	
-    /* Write the PCMWAVEFORMAT structure to the 'fmt ' chunk if its that type. */
-    if (pwfxDest->wFormatTag == WAVE_FORMAT_PCM)
-	{
-		if (mmioWrite(*phmmioOut, (HPSTR) pwfxDest, sizeof(PCMWAVEFORMAT))
-			!= sizeof(PCMWAVEFORMAT))
-		{
-			nError = ER_CANNOTWRITE;
-			goto ERROR_CANNOT_WRITE;    // cannot write file, probably
-		}
-	}
-	
-	else 
-	{
-		// Write the variable length size.
-		if ((UINT)mmioWrite(*phmmioOut, (HPSTR) pwfxDest, sizeof(*pwfxDest)+pwfxDest->cbSize)
-			!= (sizeof(*pwfxDest)+pwfxDest->cbSize))
-		{
-			nError = ER_CANNOTWRITE;
-			goto ERROR_CANNOT_WRITE;    // cannot write file, probably
-		} 
-		
-	}  
+	/* The 'RIFF' chunk of form type 'WAVE'; its size is written on close. */
+	if ((nError = WavePut(pwfOut->file, "RIFF", 4)) != 0)
+		goto ERROR_CANNOT_WRITE;
+	pwfOut->riffSize = ftell(pwfOut->file);
+	if ((nError = WavePut32(pwfOut->file, 0)) != 0 || (nError = WavePut(pwfOut->file, "WAVE", 4)) != 0)
+		goto ERROR_CANNOT_WRITE;
 	
-    /* Ascend out of the 'fmt ' chunk, back into the 'RIFF' chunk.
-	*/
-    if ((nError = mmioAscend(*phmmioOut, pckOut, 0)) != 0)
-	{
-		goto ERROR_CANNOT_WRITE;    // cannot write file, probably
-	}
+	/* The 'fmt ' chunk: a PCMWAVEFORMAT if that is all it is, else the variable length size. */
+	cbFormat = pwfxDest->wFormatTag == WAVE_FORMAT_PCM ? 16 : 18 + pwfxDest->cbSize;
+	if ((nError = WavePut(pwfOut->file, "fmt ", 4)) != 0 || (nError = WavePut32(pwfOut->file, cbFormat)) != 0 ||
+		(nError = WavePut(pwfOut->file, pwfxDest, cbFormat)) != 0)
+		goto ERROR_CANNOT_WRITE;
 	
 	// Now create the fact chunk, not required for PCM but nice to have.  This is filled
 	// in when the close routine is called.
-	ckOut1.ckid = mmioFOURCC('f', 'a', 'c', 't');
-	ckOut1.cksize = 0;
-    if ((nError = mmioCreateChunk(*phmmioOut, &ckOut1, 0)) != 0)
-	{
-		goto ERROR_CANNOT_WRITE;    // cannot write file, probably
-	}
-	
-	if (mmioWrite(*phmmioOut, (HPSTR)&dwFactChunk, sizeof(dwFactChunk)) != sizeof(dwFactChunk))
-	{
-		nError = ER_CANNOTWRITE;
+	if ((nError = WavePut(pwfOut->file, "fact", 4)) != 0 || (nError = WavePut32(pwfOut->file, 4)) != 0)
 		goto ERROR_CANNOT_WRITE;
-	}
-	
-	// Now ascend out of the fact chunk...
-    if ((nError = mmioAscend(*phmmioOut, &ckOut1, 0)) != 0)
-	{
-		nError = ER_CANNOTWRITE;        // cannot write file, probably
+	pwfOut->factSamples = ftell(pwfOut->file);
+	if ((nError = WavePut32(pwfOut->file, (uint32_t)-1)) != 0)
 		goto ERROR_CANNOT_WRITE;
-	}
-	
-	
 	
 	goto DONE_CREATE;
 	
 ERROR_CANNOT_WRITE:
 	// Maybe delete the half-written file?  Ah forget it for now, its good to leave the
 	// file there for debugging...
+	if (pwfOut->file != NULL)
+	{
+		fclose(pwfOut->file);
+		pwfOut->file = NULL;
+	}
 	
 DONE_CREATE:
 	return(nError);
@@ -440,42 +406,25 @@ sets up the data to write, and creates the data chunk.
 */
 
 int WaveStartDataWrite(
-					   HMMIO *phmmioOut,                               // (IN)
-					   MMCKINFO *pckOut,                               // (IN)
-					   MMIOINFO *pmmioinfoOut                  // (OUT)
+					   WAVEFILE *pwfOut                          // (IN)
 					   )
 {
 	
 	int             nError;
 	
-	nError = 0;
 	/* Create the 'data' chunk that holds the waveform samples.  */
-    pckOut->ckid = mmioFOURCC('d', 'a', 't', 'a');
-	pckOut->cksize = 0;
-    if ((nError = mmioCreateChunk(*phmmioOut, pckOut, 0)) != 0)
-	{
-		goto ERROR_CANNOT_WRITE;    // cannot write file, probably
-	}
-	
-	if ((nError = mmioGetInfo(*phmmioOut, pmmioinfoOut, 0)) != 0)
-	{
-		goto ERROR_CANNOT_WRITE;
-	}
-	
-	goto CLEANUP;
-ERROR_CANNOT_WRITE:     
-	
-CLEANUP:
-	return(nError);
+	if ((nError = WavePut(pwfOut->file, "data", 4)) != 0)
+		return(nError);
+	pwfOut->dataSize = ftell(pwfOut->file);
+	pwfOut->dataBytes = 0;
+	return(WavePut32(pwfOut->file, 0));
 }
 
 /* This routine will write out data to a wave file. 
-hmmioOut                - Handle to hmmioOut filled by WaveCreateFile
+pwfOut                  - Writer state filled by WaveCreateFile
 cbWrite                 - # of bytes to write out.
 pbSrc                   - Pointer to source.
-pckOut                  - pointer to ckOut filled by WaveCreateFile
 cbActualWrite   - # of actual bytes written.
-pmmioinfoOut    - Pointer to mmioinfoOut filled by WaveCreateFile.
 
   Returns 0 if successful, else the error code.
   
@@ -483,43 +432,16 @@ pmmioinfoOut    - Pointer to mmioinfoOut filled by WaveCreateFile.
 
 
 int WaveWriteFile(
-				  HMMIO hmmioOut,                         // (IN)
-				  UINT cbWrite,                           // (IN)
-				  BYTE *pbSrc,                            // (IN)
-				  MMCKINFO *pckOut,                       // (IN)
-				  UINT *cbActualWrite,            // (OUT)
-				  MMIOINFO *pmmioinfoOut          // (IN)
+				  WAVEFILE *pwfOut,                       // (IN)
+				  uint32_t cbWrite,                       // (IN)
+				  const uint8_t *pbSrc,                   // (IN)
+				  uint32_t *cbActualWrite                 // (OUT)
 				  )
 {
 	
-	
-	int                     nError;
-	UINT            cT;
-	
-	nError = 0;
-	
-	*cbActualWrite = 0;
-	
-	for (cT=0; cT < cbWrite; cT++)
-	{       
-		if (pmmioinfoOut->pchNext == pmmioinfoOut->pchEndWrite)
-		{
-			pmmioinfoOut->dwFlags |= MMIO_DIRTY;
-			if ((nError = mmioAdvance(hmmioOut, pmmioinfoOut, MMIO_WRITE)) != 0)
-			{
-				goto ERROR_CANNOT_WRITE;
-			}
-		}
-		*((BYTE*)pmmioinfoOut->pchNext++) = *((BYTE*)pbSrc+cT);
-		(*cbActualWrite)++;
-	}
-	
-	
-ERROR_CANNOT_WRITE:
-	// What to do here?  Well, for now, nothing, just return that error.  (maybe delete the
-	// file later?
-	
-	return(nError);
+	*cbActualWrite = (uint32_t)fwrite(pbSrc, 1, cbWrite, pwfOut->file);
+	pwfOut->dataBytes += *cbActualWrite;
+	return *cbActualWrite == cbWrite ? 0 : ER_CANNOTWRITE;
 	
 }
 
@@ -527,10 +449,7 @@ ERROR_CANNOT_WRITE:
 
 /*      This routine will close a wave file used for writing.  Returns 0 if successful, else
 the error code.
-phmmioOut       - Pointer to mmio handle for saving.
-pckOut          - Pointer to the MMCKINFO for saving.
-pckOutRiff      - Pointer to the riff MMCKINFO for saving.
-pmmioinfoOut- Pointer to mmioinfo for saving.
+pwfOut          - Writer state for saving.
 cSamples        - # of samples saved, for the fact chunk.  For PCM, this isn't used but
 will be written anyway, so this can be zero as long as programs ignore
 this field when they load PCM formats.
@@ -539,82 +458,46 @@ this field when they load PCM formats.
 	
 */
 int WaveCloseWriteFile(
-					   HMMIO *phmmioOut,               // (IN)
-					   MMCKINFO *pckOut,               // (IN)
-					   MMCKINFO *pckOutRIFF,   // (IN)
-					   MMIOINFO *pmmioinfoOut, // (IN)
-					   DWORD cSamples                  // (IN)
+					   WAVEFILE *pwfOut,               // (IN)
+					   uint32_t cSamples               // (IN)
 					   )
 {
 	
 	int                     nError;                         
+	uint32_t                cbData;
 	
 	nError = 0;
 	
-	if (*phmmioOut == NULL)
+	if (pwfOut->file == NULL)
 		return(0);
 	
-	pmmioinfoOut->dwFlags |= MMIO_DIRTY;
-    if ((nError = mmioSetInfo(*phmmioOut, pmmioinfoOut, 0)) != 0)
-	{
-		// cannot flush, probably...
-		goto ERROR_CANNOT_WRITE;                                
-	}
-	
-	/* Ascend the output file out of the 'data' chunk -- this will cause
-	* the chunk size of the 'data' chunk to be written.
-	*/
-    if ((nError = mmioAscend(*phmmioOut, pckOut, 0)) != 0)
-		goto ERROR_CANNOT_WRITE;    // cannot write file, probably
-	
-	
-	// Do this here instead...
-	if ((nError = mmioAscend(*phmmioOut, pckOutRIFF, 0)) != 0)
-		goto ERROR_CANNOT_WRITE;    // cannot write file, probably
-	
-	
-	nError = mmioSeek(*phmmioOut, 0, SEEK_SET);
-	if ((nError = (int)mmioDescend(*phmmioOut, pckOutRIFF, NULL, 0)) != 0)
-	{
+	/* Chunks are word aligned; an odd-sized 'data' chunk gets a pad byte after it. */
+	cbData = pwfOut->dataBytes;
+	if ((cbData & 1) && (nError = WavePut(pwfOut->file, "", 1)) != 0)
 		goto ERROR_CANNOT_WRITE;
-	}
 	
-	nError = 0;
-	pckOut->ckid = mmioFOURCC('f', 'a', 'c', 't');
-	if ((nError = mmioDescend(*phmmioOut, pckOut, pckOutRIFF, MMIO_FINDCHUNK)) == 0)
-	{
-		// If it didn't fail, write the fact chunk out, if it failed, not critical, just
-		// assert (below).
-		nError = mmioWrite(*phmmioOut, (HPSTR)&cSamples, sizeof(DWORD));
-		nError = mmioAscend(*phmmioOut, pckOut, 0); 
-		nError = 0;
-	}
-	else 
-	{
-		nError = 0;
-		ASSERT(FALSE);
-	}
-	
-	// CANTWRITEFACT:
-    /* Ascend the output file out of the 'RIFF' chunk -- this will cause
-	* the chunk size of the 'RIFF' chunk to be written.
+	/* The 'data' size, the fact sample count and the 'RIFF' size, which covers
+	* everything after it.
 	*/
-    if ((nError = mmioAscend(*phmmioOut, pckOutRIFF, 0)) != 0)
-		goto ERROR_CANNOT_WRITE;    // cannot write file, probably
-	
-	
+	if (fseek(pwfOut->file, pwfOut->dataSize, SEEK_SET) != 0 || (nError = WavePut32(pwfOut->file, cbData)) != 0)
+		goto ERROR_CANNOT_WRITE;
+	if (fseek(pwfOut->file, pwfOut->factSamples, SEEK_SET) != 0 || (nError = WavePut32(pwfOut->file, cSamples)) != 0)
+		goto ERROR_CANNOT_WRITE;
+	if (fseek(pwfOut->file, pwfOut->riffSize, SEEK_SET) != 0 ||
+		(nError = WavePut32(pwfOut->file, (uint32_t)(pwfOut->dataSize + 4 + cbData + (cbData & 1) - pwfOut->riffSize - 4))) != 0)
+		goto ERROR_CANNOT_WRITE;
 	
 ERROR_CANNOT_WRITE:
-	if (*phmmioOut != NULL)
-	{
-		mmioClose(*phmmioOut, 0);
-		*phmmioOut = NULL;
-	}
+	if (fclose(pwfOut->file) != 0 && nError == 0)
+		nError = ER_CANNOTWRITE;
+	pwfOut->file = NULL;
 	
 	return(nError);
 	
 }
 
+
+#ifdef _WIN32
 /*      This routine will copy from a source wave file to a destination wave file all those useless chunks
 (well, the ones useless to conversions, etc --> apparently people use them!).  The source will be
 seeked to the begining, but the destination has to be at a current pointer to put the new chunks.
@@ -848,6 +731,8 @@ DONE_LOADING:
 	
 }
 
+#endif // _WIN32
+
 /*      This routine saves a wave file in currently in memory.
 pszFileName -   FileName to save to.  Automatically overwritten, be careful!
 cbSize          -       Size in bytes to write.
@@ -857,37 +742,36 @@ pbData          -       Pointer to the data.
 */      
 
 int WaveSaveFile(
-				 TCHAR*pszFileName,                      // (IN)
-				 UINT cbSize,                            // (IN)
-				 DWORD cSamples,                         // (IN) 
-				 WAVEFORMATEX *pwfxDest,         // (IN)
-				 BYTE *pbData                            // (IN)
+				 const char *pszFileName,                // (IN)
+				 uint32_t cbSize,                        // (IN)
+				 uint32_t cSamples,                      // (IN) 
+				 const WAVEFORMATEX *pwfxDest,           // (IN)
+				 const uint8_t *pbData                   // (IN)
 				 )
 {
 	
-	HMMIO           hmmioOut;
-	MMCKINFO        ckOut;
-	MMCKINFO        ckOutRIFF;
-	MMIOINFO        mmioinfoOut;
-	UINT            cbActualWrite;
+	WAVEFILE        wfOut;
+	uint32_t        cbActualWrite;
 	int                     nError;
 	
-	if ((nError = WaveCreateFile(pszFileName, &hmmioOut, pwfxDest, &ckOut, &ckOutRIFF)) != 0)
+	if ((nError = WaveCreateFile(pszFileName, &wfOut, pwfxDest)) != 0)
 	{
 		goto ERROR_SAVING;
 	}
 	
-	if ((nError = WaveStartDataWrite(&hmmioOut, &ckOut, &mmioinfoOut)) != 0)
+	if ((nError = WaveStartDataWrite(&wfOut)) != 0)
 	{
+		WaveCloseWriteFile(&wfOut, cSamples);
 		goto ERROR_SAVING;
 	}
 	
-	if ((nError = WaveWriteFile(hmmioOut, cbSize, pbData, &ckOut, &cbActualWrite, &mmioinfoOut)) != 0)
+	if ((nError = WaveWriteFile(&wfOut, cbSize, pbData, &cbActualWrite)) != 0)
 	{
+		WaveCloseWriteFile(&wfOut, cSamples);
 		goto ERROR_SAVING;
 	}
 	
-	if ((nError = WaveCloseWriteFile(&hmmioOut, &ckOut, &ckOutRIFF, &mmioinfoOut, cSamples)) != 0)
+	if ((nError = WaveCloseWriteFile(&wfOut, cSamples)) != 0)
 	{
 		goto ERROR_SAVING;
 	}       
@@ -8,7 +8,25 @@
  ***************************************************************************/
 #ifndef __WAVE_INCLUDED__
 #define __WAVE_INCLUDED__
+#include <stdint.h>
+#include <stdio.h>
+#ifdef _WIN32
 #include <windows.h>
+#else
+#define WAVE_FORMAT_PCM		1
+
+#pragma pack(push, 1)
+typedef struct {
+	uint16_t	wFormatTag;
+	uint16_t	nChannels;
+	uint32_t	nSamplesPerSec;
+	uint32_t	nAvgBytesPerSec;
+	uint16_t	nBlockAlign;
+	uint16_t	wBitsPerSample;
+	uint16_t	cbSize;
+} WAVEFORMATEX;
+#pragma pack(pop)
+#endif
 
 #ifdef __cplusplus
 extern "C" {
@@ -42,21 +60,33 @@ extern "C" {
 
 
 
+#ifdef _WIN32
 int WaveOpenFile(TCHAR*, HMMIO *, WAVEFORMATEX **, MMCKINFO *);
 int WaveStartDataRead(HMMIO *, MMCKINFO *, MMCKINFO *);
 int WaveReadFile(HMMIO, UINT, BYTE *, MMCKINFO *, UINT *);
 int WaveCloseReadFile(HMMIO *, WAVEFORMATEX **);
 
-int WaveCreateFile(TCHAR*, HMMIO *, WAVEFORMATEX *, MMCKINFO *, MMCKINFO *);
-int WaveStartDataWrite(HMMIO *, MMCKINFO *, MMIOINFO *);
-int WaveWriteFile(HMMIO, UINT, BYTE *, MMCKINFO *, UINT *, MMIOINFO *);
-int WaveCloseWriteFile(HMMIO *, MMCKINFO *, MMCKINFO *, MMIOINFO *, DWORD);
-
 int WaveLoadFile(TCHAR*, UINT *, WAVEFORMATEX **, BYTE **);
-int WaveSaveFile(TCHAR*, UINT, DWORD, WAVEFORMATEX *, BYTE *);
 
 int WaveCopyUselessChunks(HMMIO *, MMCKINFO *, MMCKINFO *, HMMIO *, MMCKINFO *, MMCKINFO *);
 BOOL riffCopyChunk(HMMIO, HMMIO, const LPMMCKINFO);
+#endif
+
+/* Writing is stdio on every host; the offsets are where the sizes go on close */
+typedef struct {
+	FILE		*file;
+	long		riffSize;
+	long		factSamples;
+	long		dataSize;
+	uint32_t	dataBytes;
+} WAVEFILE;
+
+int WaveCreateFile(const char *, WAVEFILE *, const WAVEFORMATEX *);
+int WaveStartDataWrite(WAVEFILE *);
+int WaveWriteFile(WAVEFILE *, uint32_t, const uint8_t *, uint32_t *);
+int WaveCloseWriteFile(WAVEFILE *, uint32_t);
+
+int WaveSaveFile(const char *, uint32_t, uint32_t, const WAVEFORMATEX *, const uint8_t *);
 
 
 #ifdef __cplusplus